@@ -0,0 +1,234 @@
+#include "Fixtures.hpp"
+
+
+// Exceptions
+#include <stdexcept>
+// Math
+#include <cmath>
+// Fixed size integers
+#include <cstdint>
+// Files
+#include <filesystem>
+// Console output
+#include <cstdio>
+// FFMPEG
+extern "C"
+{
+#include <libavutil/opt.h>
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+}
+
+
+// Sample rates of fixtures
+#define FIXTURE_SAMPLE_RATES {22050, 44100, 48000}
+// Number of channels of fixtures
+#define FIXTURE_CHANNELS 2
+// Bit rate of lossy fixtures
+#define FIXTURE_BIT_RATE 128000
+// Frame size used for codecs without fixed one
+#define DEFAULT_FRAME_SIZE 1024
+
+
+/**
+ * Describes how container is encoded.
+ */
+struct Encoding
+{
+    // File extension (also selects muxer).
+    const char *container;
+    // Codec.
+    AVCodecID codec;
+    // Sample format accepted by encoder.
+    AVSampleFormat sampleFormat;
+};
+
+
+static const Encoding ENCODINGS[] = {
+    {"wav", AV_CODEC_ID_PCM_S16LE, AV_SAMPLE_FMT_S16},
+    {"mp3", AV_CODEC_ID_MP3, AV_SAMPLE_FMT_FLTP},
+    {"ogg", AV_CODEC_ID_VORBIS, AV_SAMPLE_FMT_FLTP},
+    {"mp4", AV_CODEC_ID_AAC, AV_SAMPLE_FMT_FLTP}
+};
+
+
+std::vector<Fixture> Fixtures::generate(const std::string &directory, double seconds)
+{
+    std::filesystem::create_directories(directory);
+
+    std::vector<Fixture> fixtures;
+    for (const Encoding &encoding : ENCODINGS)
+    {
+        for (int sample_rate : FIXTURE_SAMPLE_RATES)
+        {
+            Fixture fixture;
+            fixture.container = encoding.container;
+            fixture.sampleRate = sample_rate;
+            fixture.filepath = directory + "/fixture_" + std::to_string(sample_rate) + "." + encoding.container;
+
+            try
+            {
+                if (!std::filesystem::exists(fixture.filepath))
+                    encode(fixture, seconds);
+                fixtures.push_back(fixture);
+            }
+            catch(const std::exception& e)
+            {
+                std::fprintf(stderr, "Skipping %s: %s\n", fixture.filepath.c_str(), e.what());
+            }
+        }
+    }
+    return fixtures;
+}
+
+
+void Fixtures::fillSignal(float *buffer, int frames, int sampleRate, long offset)
+{
+    for (int i = 0; i < frames; i++)
+    {
+        // Slow sweep keeps every codec busy across the spectrum
+        double t = static_cast<double>(offset + i) / sampleRate;
+        double tone = 0.5 * std::sin(2 * M_PI * (110 + 40 * t) * t);
+
+        // Integer hash noise is identical on every platform
+        uint32_t hash = static_cast<uint32_t>(offset + i) * 2654435761u;
+        hash ^= hash >> 16;
+        double noise = (static_cast<double>(hash & 0xFFFF) / 0xFFFF - 0.5) * 0.1;
+
+        buffer[i * FIXTURE_CHANNELS] = static_cast<float>(tone + noise);
+        buffer[i * FIXTURE_CHANNELS + 1] = static_cast<float>(tone - noise);
+    }
+}
+
+
+void Fixtures::encode(const Fixture &fixture, double seconds)
+{
+    const Encoding *encoding = nullptr;
+    for (const Encoding &e : ENCODINGS)
+    {
+        if (fixture.container == e.container)
+            encoding = &e;
+    }
+    if (!encoding)
+        throw std::runtime_error("unknown container");
+
+    const AVCodec *encoder = avcodec_find_encoder(encoding->codec);
+    if (!encoder)
+        throw std::runtime_error("encoder is missing");
+
+    // Partially written files must never be reused
+    std::string temporary_path = fixture.filepath + ".part." + fixture.container;
+
+    AVFormatContext *format_ctx = nullptr;
+    AVCodecContext *encoder_ctx = nullptr;
+    AVFrame *frame = nullptr;
+    AVPacket *packet = nullptr;
+    try
+    {
+        if (avformat_alloc_output_context2(&format_ctx, NULL, NULL, temporary_path.c_str()) < 0)
+            throw std::runtime_error("unable to create muxer");
+        AVStream *stream = avformat_new_stream(format_ctx, NULL);
+        if (!stream)
+            throw std::runtime_error("unable to create stream");
+
+        // Encoder
+        encoder_ctx = avcodec_alloc_context3(encoder);
+        if (!encoder_ctx)
+            throw std::runtime_error("unable to create encoder");
+        encoder_ctx->sample_rate = fixture.sampleRate;
+        encoder_ctx->sample_fmt = encoding->sampleFormat;
+        encoder_ctx->bit_rate = FIXTURE_BIT_RATE;
+        encoder_ctx->time_base = {1, fixture.sampleRate};
+        encoder_ctx->flags |= AV_CODEC_FLAG_BITEXACT;
+        // Native vorbis encoder is still experimental
+        encoder_ctx->strict_std_compliance = FF_COMPLIANCE_EXPERIMENTAL;
+        av_channel_layout_default(&encoder_ctx->ch_layout, FIXTURE_CHANNELS);
+        if (format_ctx->oformat->flags & AVFMT_GLOBALHEADER)
+            encoder_ctx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+        if (avcodec_open2(encoder_ctx, encoder, NULL) < 0)
+            throw std::runtime_error("unable to open encoder");
+        if (avcodec_parameters_from_context(stream->codecpar, encoder_ctx) < 0)
+            throw std::runtime_error("unable to configure stream");
+        stream->time_base = encoder_ctx->time_base;
+
+        if (avio_open(&format_ctx->pb, temporary_path.c_str(), AVIO_FLAG_WRITE) < 0)
+            throw std::runtime_error("unable to create file");
+        if (avformat_write_header(format_ctx, NULL) < 0)
+            throw std::runtime_error("unable to write header");
+
+        // Frames
+        int frame_size = (encoder_ctx->frame_size > 0) ? encoder_ctx->frame_size : DEFAULT_FRAME_SIZE;
+        frame = av_frame_alloc();
+        packet = av_packet_alloc();
+        if (!frame || !packet)
+            throw std::runtime_error("out of memory");
+        frame->nb_samples = frame_size;
+        frame->format = encoder_ctx->sample_fmt;
+        frame->sample_rate = fixture.sampleRate;
+        av_channel_layout_copy(&frame->ch_layout, &encoder_ctx->ch_layout);
+        if (av_frame_get_buffer(frame, 0) < 0)
+            throw std::runtime_error("unable to allocate frame");
+
+        std::vector<float> signal(frame_size * FIXTURE_CHANNELS);
+        long total_frames = static_cast<long>(seconds * fixture.sampleRate);
+        for (long offset = 0; ; offset += frame_size)
+        {
+            // Last iteration flushes encoder
+            bool is_last = offset >= total_frames;
+            if (!is_last)
+            {
+                if (av_frame_make_writable(frame) < 0)
+                    throw std::runtime_error("unable to write frame");
+                fillSignal(signal.data(), frame_size, fixture.sampleRate, offset);
+                for (int i = 0; i < frame_size; i++)
+                {
+                    for (int c = 0; c < FIXTURE_CHANNELS; c++)
+                    {
+                        float sample = signal[i * FIXTURE_CHANNELS + c];
+                        if (encoding->sampleFormat == AV_SAMPLE_FMT_S16)
+                            ((int16_t*)frame->data[0])[i * FIXTURE_CHANNELS + c] = static_cast<int16_t>(sample * 32767);
+                        else
+                            ((float*)frame->data[c])[i] = sample;
+                    }
+                }
+                frame->pts = offset;
+            }
+
+            if (avcodec_send_frame(encoder_ctx, is_last ? NULL : frame) < 0)
+                throw std::runtime_error("unable to encode frame");
+            while (avcodec_receive_packet(encoder_ctx, packet) == 0)
+            {
+                av_packet_rescale_ts(packet, encoder_ctx->time_base, stream->time_base);
+                packet->stream_index = 0;
+                if (av_interleaved_write_frame(format_ctx, packet) < 0)
+                    throw std::runtime_error("unable to write packet");
+            }
+
+            if (is_last)
+                break;
+        }
+
+        if (av_write_trailer(format_ctx) < 0)
+            throw std::runtime_error("unable to write trailer");
+    }
+    catch(const std::exception& e)
+    {
+        av_packet_free(&packet);
+        av_frame_free(&frame);
+        avcodec_free_context(&encoder_ctx);
+        if (format_ctx)
+        {
+            avio_closep(&format_ctx->pb);
+            avformat_free_context(format_ctx);
+        }
+        std::filesystem::remove(temporary_path);
+        throw;
+    }
+
+    av_packet_free(&packet);
+    av_frame_free(&frame);
+    avcodec_free_context(&encoder_ctx);
+    avio_closep(&format_ctx->pb);
+    avformat_free_context(format_ctx);
+    std::filesystem::rename(temporary_path, fixture.filepath);
+}
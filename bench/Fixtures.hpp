@@ -0,0 +1,57 @@
+#pragma once
+
+
+// Strings
+#include <string>
+// Containers
+#include <vector>
+
+
+/**
+ * Synthetic media file used by benchmarks.
+ */
+struct Fixture
+{
+    // Container name (wav, mp3, ogg, mp4).
+    std::string container;
+    // Sample rate.
+    int sampleRate;
+    // Media file path.
+    std::string filepath;
+};
+
+
+/**
+ * Generates reproducible synthetic media files (same signal and encoder settings on every run).
+ */
+class Fixtures
+{
+public:
+
+    /**
+     * Encodes every container at every sample rate into directory (files that already exist are reused).
+     * Containers whose encoder is missing in FFMPEG build are skipped.
+     *
+     * @param directory output directory
+     * @param seconds duration of each file
+     *
+     * @return generated fixtures
+     */
+    static std::vector<Fixture> generate(const std::string &directory, double seconds);
+
+    /**
+     * Fills interleaved stereo float buffer with benchmark signal (tone sweep with noise).
+     *
+     * @param offset index of first sample frame
+     */
+    static void fillSignal(float *buffer, int frames, int sampleRate, long offset);
+
+private:
+
+    /**
+     * Encodes single file.
+     *
+     * @throws Runtime Error if encoder is missing or encoding fails.
+     */
+    static void encode(const Fixture &fixture, double seconds);
+};
@@ -0,0 +1,387 @@
+// Benchmarks
+#include <benchmark/benchmark.h>
+// Console output
+#include <cstdio>
+// Environment
+#include <cstdlib>
+// Strings
+#include <string>
+// Containers
+#include <vector>
+// Shared buffers
+#include <memory>
+// SDL3
+#include <SDL3/SDL.h>
+// FFMPEG media files reader
+#include <FFMPEG/AudioTrackReader.hpp>
+// Audio device stream
+#include <SDL/DeviceStream.hpp>
+// Pipeline spans
+#include <Engine/Tracer.hpp>
+// Saved library
+#include <Library/LibraryIndex.hpp>
+// Library search
+#include <Library/SearchIndex.hpp>
+// Waveforms
+#include <Library/PeakPyramid.hpp>
+// Loudness analysis
+#include <Library/LoudnessMeter.hpp>
+// Silence threshold
+#include <Library/ClipAnalysis.hpp>
+// Synthetic media files
+#include "Fixtures.hpp"
+
+
+// Duration of fixtures in seconds
+#define FIXTURE_SECONDS 30
+// Number of seek positions visited by seek benchmark
+#define SEEK_POSITIONS 16
+// Size of resampled and written chunk in sample frames
+#define CHUNK_SIZE 1024
+// Device stream queue is cleared after this many bytes (dummy driver consumes in real time)
+#define MAX_QUEUED_BYTES 4*1024*1024
+// Number of tracks in library index benchmark
+#define LIBRARY_RECORDS 50000
+// Tracks per directory in library index benchmark
+#define LIBRARY_DIRECTORY_RECORDS 100
+// Number of tracks in library search benchmark
+#define SEARCH_ENTRIES 100000
+// Duration of track reduced by waveform and loudness benchmarks in seconds
+#define PEAKS_SECONDS 600
+
+
+/**
+ * Measures decoding and resampling throughput of AudioTrackContext::read().
+ */
+static void benchmarkTrackRead(benchmark::State &state, Fixture fixture)
+{
+    AudioTrackContext track(fixture.filepath);
+    track.init();
+
+    int64_t samples = 0;
+    for (auto _ : state)
+    {
+        track.read();
+        if (track.getAudioDataSamplesCount() == 0)
+        {
+            // Rewind outside of measurement
+            state.PauseTiming();
+            track.close();
+            track.init();
+            state.ResumeTiming();
+            continue;
+        }
+        samples += track.getAudioDataSamplesCount();
+        benchmark::DoNotOptimize(track.getAudioData()[0]);
+    }
+
+    state.SetItemsProcessed(samples);
+    // Seconds of audio decoded per second
+    state.counters["realtime_x"] = benchmark::Counter(static_cast<double>(samples) / fixture.sampleRate, benchmark::Counter::kIsRate);
+}
+
+
+/**
+ * Measures AudioTrackContext::setTime() latency including decoding of first frame after seek.
+ */
+static void benchmarkTrackSeek(benchmark::State &state, Fixture fixture)
+{
+    AudioTrackContext track(fixture.filepath);
+    track.init();
+
+    // Same positions on every run
+    int position = 0;
+    for (auto _ : state)
+    {
+        double seconds = (FIXTURE_SECONDS - 1) * ((position * 7) % SEEK_POSITIONS) / static_cast<double>(SEEK_POSITIONS);
+        position++;
+        track.setTime(seconds);
+        track.read();
+        benchmark::DoNotOptimize(track.getAudioData()[0]);
+    }
+}
+
+
+/**
+ * Measures swresample conversion of one chunk between given formats.
+ */
+static void benchmarkResample(benchmark::State &state, AVSampleFormat inFormat, int inRate, AVSampleFormat outFormat, int outRate)
+{
+    AVChannelLayout layout;
+    av_channel_layout_default(&layout, 2);
+
+    SwrContext *swr_ctx = nullptr;
+    if ((swr_alloc_set_opts2(&swr_ctx, &layout, outFormat, outRate, &layout, inFormat, inRate, 0, NULL) < 0) || (swr_init(swr_ctx) < 0))
+    {
+        swr_free(&swr_ctx);
+        state.SkipWithError("Unable to init resampler");
+        return;
+    }
+
+    // Input is converted from benchmark signal once
+    uint8_t **input = nullptr;
+    uint8_t **output = nullptr;
+    int linesize;
+    int out_samples = CHUNK_SIZE * outRate / inRate + 64;
+    av_samples_alloc_array_and_samples(&input, &linesize, 2, CHUNK_SIZE, inFormat, 0);
+    av_samples_alloc_array_and_samples(&output, &linesize, 2, out_samples, outFormat, 0);
+    {
+        std::vector<float> signal(CHUNK_SIZE * 2);
+        Fixtures::fillSignal(signal.data(), CHUNK_SIZE, inRate, 0);
+        SwrContext *fill_ctx = nullptr;
+        swr_alloc_set_opts2(&fill_ctx, &layout, inFormat, inRate, &layout, AV_SAMPLE_FMT_FLT, inRate, 0, NULL);
+        swr_init(fill_ctx);
+        const uint8_t *signal_data = (const uint8_t*)signal.data();
+        swr_convert(fill_ctx, input, CHUNK_SIZE, &signal_data, CHUNK_SIZE);
+        swr_free(&fill_ctx);
+    }
+
+    for (auto _ : state)
+    {
+        int converted = swr_convert(swr_ctx, output, out_samples, (const uint8_t**)input, CHUNK_SIZE);
+        benchmark::DoNotOptimize(converted);
+    }
+    state.SetItemsProcessed(state.iterations() * CHUNK_SIZE);
+
+    av_freep(&input[0]);
+    av_freep(&input);
+    av_freep(&output[0]);
+    av_freep(&output);
+    swr_free(&swr_ctx);
+}
+
+
+/**
+ * Measures DeviceStream::write() (or writeShared()) of one chunk against SDL dummy driver.
+ */
+static void benchmarkDeviceWrite(benchmark::State &state, int sampleRate, bool isShared)
+{
+    SDL_AudioSpec format;
+    format.format = SDL_AUDIO_F32;
+    format.channels = 2;
+    format.freq = sampleRate;
+
+    DeviceStream stream(SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK, format);
+    std::shared_ptr<std::vector<float>> signal = std::make_shared<std::vector<float>>(CHUNK_SIZE * 2);
+    Fixtures::fillSignal(signal->data(), CHUNK_SIZE, sampleRate, 0);
+    // Shared writes are measured while stream can still reference them
+    int max_queued = isShared ? SHARED_BLOCK_COUNT / 2 * CHUNK_SIZE * 2 * sizeof(float) : MAX_QUEUED_BYTES;
+
+    for (auto _ : state)
+    {
+        if (isShared)
+            stream.writeShared(signal, signal->data(), CHUNK_SIZE);
+        else
+            stream.write(signal->data(), CHUNK_SIZE);
+
+        // Keep queue bounded outside of measurement
+        if (SDL_GetAudioStreamQueued(stream.stream()) > max_queued)
+        {
+            state.PauseTiming();
+            SDL_ClearAudioStream(stream.stream());
+            state.ResumeTiming();
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * CHUNK_SIZE * 2 * sizeof(float));
+}
+
+
+/**
+ * Measures cost of one span with tracer enabled or disabled.
+ */
+static void benchmarkTraceSpan(benchmark::State &state, bool enabled)
+{
+    if (enabled)
+        Tracer::start();
+
+    for (auto _ : state)
+    {
+        TraceSpan span("bench");
+        benchmark::ClobberMemory();
+    }
+
+    Tracer::stop();
+}
+
+
+/**
+ * Measures startup load of large library index (mapping plus reading every record, as track table does).
+ */
+static void benchmarkLibraryIndexLoad(benchmark::State &state, std::string path)
+{
+    std::vector<PeakBucket> peaks(PeakPyramid::BUCKET_COUNT, PeakBucket{-64, 64, 32});
+    std::vector<LibraryRecord> records(LIBRARY_RECORDS);
+    for (int i = 0; i < LIBRARY_RECORDS; i++)
+    {
+        LibraryRecord &record = records[i];
+        record.filepath = "/library/folder" + std::to_string(i / LIBRARY_DIRECTORY_RECORDS) + "/clip" + std::to_string(i) + ".wav";
+        record.size = i;
+        record.modified = i;
+        record.duration = 1;
+        record.peaks = peaks.data();
+    }
+    LibraryIndex::write(path, "/library", records, DEFAULT_SILENCE_THRESHOLD);
+
+    for (auto _ : state)
+    {
+        LibraryIndex index;
+        index.open(path);
+        for (size_t i = 0; i < index.size(); i++)
+        {
+            benchmark::DoNotOptimize(index.getFilepath(i));
+            benchmark::DoNotOptimize(index.getPeaks(i));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * LIBRARY_RECORDS);
+}
+
+
+/**
+ * Measures waveform pyramid reduction of decoded stereo track (decoding itself is left out).
+ */
+static void benchmarkPeakBuild(benchmark::State &state)
+{
+    const int sample_rate = 48000;
+    std::vector<float> chunk(CHUNK_SIZE * 2);
+    for (size_t i = 0; i < chunk.size(); i++)
+        chunk[i] = static_cast<float>((i * 7919) % 2001) / 1000.0f - 1.0f;
+
+    const int chunks = PEAKS_SECONDS * sample_rate / CHUNK_SIZE;
+    for (auto _ : state)
+    {
+        PeakBuilder builder(static_cast<double>(chunks) * CHUNK_SIZE, 2);
+        for (int i = 0; i < chunks; i++)
+            builder.add(chunk.data(), CHUNK_SIZE);
+        benchmark::DoNotOptimize(builder.finish());
+    }
+    state.SetItemsProcessed(state.iterations() * chunks * CHUNK_SIZE);
+}
+
+
+/**
+ * Measures loudness and true peak analysis of decoded stereo track (decoding itself is left out).
+ */
+static void benchmarkLoudness(benchmark::State &state)
+{
+    const int sample_rate = 48000;
+    std::vector<float> chunk(CHUNK_SIZE * 2);
+    for (size_t i = 0; i < chunk.size(); i++)
+        chunk[i] = static_cast<float>((i * 7919) % 2001) / 1000.0f - 1.0f;
+
+    const int chunks = PEAKS_SECONDS * sample_rate / CHUNK_SIZE;
+    for (auto _ : state)
+    {
+        LoudnessMeter meter(sample_rate, 2);
+        for (int i = 0; i < chunks; i++)
+            meter.add(chunk.data(), CHUNK_SIZE);
+        benchmark::DoNotOptimize(meter.getLoudness());
+        benchmark::DoNotOptimize(meter.getTruePeak());
+    }
+    state.SetItemsProcessed(state.iterations() * chunks * CHUNK_SIZE);
+}
+
+
+/**
+ * Measures one keystroke of library search (time until first batch of best results).
+ */
+static void benchmarkLibrarySearch(benchmark::State &state, std::string query)
+{
+    static const char *words[] = {"kick", "snare", "hihat", "crash", "vocal", "riser", "impact", "whoosh", "applause", "ambient"};
+    SearchIndex index;
+    for (uint32_t i = 0; i < SEARCH_ENTRIES; i++)
+        index.add(i, "Folder " + std::to_string(i % 300) + "/" + words[i % 10] + "_" + words[i / 10 % 10] + "_" + std::to_string(i) + ".wav");
+
+    for (auto _ : state)
+    {
+        index.find(query, [](const std::vector<uint32_t> &ids)
+        {
+            benchmark::DoNotOptimize(ids.data());
+            return false;
+        });
+    }
+}
+
+
+/**
+ * Registers all benchmarks (fixtures are known only at runtime).
+ *
+ * @param directory fixtures directory
+ */
+static void registerBenchmarks(const std::vector<Fixture> &fixtures, const std::string &directory)
+{
+    for (const Fixture &fixture : fixtures)
+    {
+        std::string suffix = "/" + fixture.container + "/" + std::to_string(fixture.sampleRate);
+        benchmark::RegisterBenchmark(("TrackRead" + suffix).c_str(), benchmarkTrackRead, fixture);
+        benchmark::RegisterBenchmark(("TrackSeek" + suffix).c_str(), benchmarkTrackSeek, fixture)->Unit(benchmark::kMicrosecond);
+    }
+
+    // Decoder output formats to player format, and rate conversions
+    struct FormatPair
+    {
+        const char *name;
+        AVSampleFormat inFormat;
+        int inRate;
+        AVSampleFormat outFormat;
+        int outRate;
+    };
+    static const FormatPair pairs[] = {
+        {"s16_to_flt/44100", AV_SAMPLE_FMT_S16, 44100, AV_SAMPLE_FMT_FLT, 44100},
+        {"s16p_to_flt/44100", AV_SAMPLE_FMT_S16P, 44100, AV_SAMPLE_FMT_FLT, 44100},
+        {"fltp_to_flt/48000", AV_SAMPLE_FMT_FLTP, 48000, AV_SAMPLE_FMT_FLT, 48000},
+        {"fltp_to_flt/44100_48000", AV_SAMPLE_FMT_FLTP, 44100, AV_SAMPLE_FMT_FLT, 48000},
+        {"fltp_to_flt/48000_44100", AV_SAMPLE_FMT_FLTP, 48000, AV_SAMPLE_FMT_FLT, 44100},
+        {"s16_to_flt/22050_48000", AV_SAMPLE_FMT_S16, 22050, AV_SAMPLE_FMT_FLT, 48000}
+    };
+    for (const FormatPair &pair : pairs)
+        benchmark::RegisterBenchmark((std::string("Resample/") + pair.name).c_str(), benchmarkResample,
+                                     pair.inFormat, pair.inRate, pair.outFormat, pair.outRate);
+
+    benchmark::RegisterBenchmark("TraceSpan/on", benchmarkTraceSpan, true);
+    benchmark::RegisterBenchmark("TraceSpan/off", benchmarkTraceSpan, false);
+
+    for (int sample_rate : {44100, 48000})
+    {
+        benchmark::RegisterBenchmark(("DeviceWrite/" + std::to_string(sample_rate)).c_str(), benchmarkDeviceWrite, sample_rate, false);
+        benchmark::RegisterBenchmark(("DeviceWriteShared/" + std::to_string(sample_rate)).c_str(), benchmarkDeviceWrite,
+                                     sample_rate, true);
+    }
+
+    benchmark::RegisterBenchmark(("LibraryIndexLoad/" + std::to_string(LIBRARY_RECORDS)).c_str(), benchmarkLibraryIndexLoad,
+                                 directory + "/library.idx")->Unit(benchmark::kMillisecond);
+
+    benchmark::RegisterBenchmark(("PeakBuild/" + std::to_string(PEAKS_SECONDS)).c_str(), benchmarkPeakBuild)
+        ->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark(("Loudness/" + std::to_string(PEAKS_SECONDS)).c_str(), benchmarkLoudness)
+        ->Unit(benchmark::kMillisecond);
+
+    // Short prefix (no trigrams), word, several words and typo
+    for (const char *query : {"k", "kick", "kick snare 12", "applasue"})
+        benchmark::RegisterBenchmark((std::string("LibrarySearch/") + query).c_str(), benchmarkLibrarySearch, query)
+            ->Unit(benchmark::kMicrosecond);
+}
+
+
+int main(int argc, char *argv[])
+{
+    benchmark::Initialize(&argc, argv);
+
+    // Device benchmarks never touch real hardware
+    SDL_SetHint(SDL_HINT_AUDIO_DRIVER, "dummy");
+    if (!SDL_Init(SDL_INIT_AUDIO))
+    {
+        std::fprintf(stderr, "SDL3 init error: %s\n", SDL_GetError());
+        return 1;
+    }
+
+    // Fixtures are generated next to executable unless directory is given
+    const char *fixtures_env = std::getenv("OPENSOUNDBOARD_BENCH_FIXTURES");
+    std::string fixtures_dir = fixtures_env ? fixtures_env : "bench_fixtures";
+    registerBenchmarks(Fixtures::generate(fixtures_dir, FIXTURE_SECONDS), fixtures_dir);
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+
+    SDL_Quit();
+    return 0;
+}
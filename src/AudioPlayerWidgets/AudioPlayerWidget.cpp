@@ -1,18 +1,19 @@
 #include <AudioPlayerWidgets/AudioPlayerWidget.hpp>
 
 
-AudioPlayerWidget::AudioPlayerWidget(AudioPlayer *player, QString name, QWidget *parent)
+AudioPlayerWidget::AudioPlayerWidget(AudioEngine *engine, AudioPlayer *player, QString name, QWidget *parent)
 : QWidget(parent)
 {
+    this->engine = engine;
     this->player = player;
     this->name = name;
 
-    // Create threadpool and disable thread expiry (only we terminate threads explicitly)
-    threadpool = new QThreadPool();
-    threadpool->setExpiryTimeout(-1);
-
-    // Connect signal to player
-    connect(this->player, AudioPlayer::signalError, this, &AudioPlayerWidget::playerError);
+    // Player errors arrive from player thread so pass them to GUI thread
+    this->player->setErrorCallback([this](const std::string &message)
+    {
+        QString text = QString::fromStdString(message);
+        QMetaObject::invokeMethod(this, [this, text]() { playerError(text); }, Qt::QueuedConnection);
+    });
 
     // Main layout
     layout = new QVBoxLayout();
@@ -23,9 +24,8 @@ AudioPlayerWidget::AudioPlayerWidget(AudioPlayer *player, QString name, QWidget
 
 AudioPlayerWidget::~AudioPlayerWidget()
 {
-    // Delete player and threadpool
-    delete player;
-    delete threadpool;
+    // Player outlives widget so it must not call us anymore (subclasses stop player before)
+    player->setErrorCallback(nullptr);
 }
 
 
@@ -43,10 +43,4 @@ void AudioPlayerWidget::playerError(QString message)
     displayWarning(name + " error:\n" + message);
     // Update player state
     stop();
-}
-
-
-void AudioPlayerWidget::updateDevices()
-{
-    emit askToUpdateDevices();
 }
\ No newline at end of file
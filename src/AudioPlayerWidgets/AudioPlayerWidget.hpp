@@ -3,7 +3,7 @@
 
 // Qt core
 #include <QtCore/QMimeData>
-#include <QtCore/QThreadPool>
+#include <QtCore/QMetaObject>
 // Qt GUI
 #include <QtGui/QPainter>
 #include <QtGui/QDragEnterEvent>
@@ -14,8 +14,8 @@
 #include <QtWidgets/QLabel>
 // Message boxes
 #include <WidgetMessageBoxing/WidgetWarning.cpp>
-// Audio player
-#include <AudioPlayers/AudioPlayer.hpp>
+// Audio engine
+#include <Engine/AudioEngine.hpp>
 
 
 /**
@@ -33,9 +33,9 @@ protected:
     // Widget main layout.
     QVBoxLayout *layout = nullptr;
 
-    // Thread pool where player will run.
-    QThreadPool *threadpool = nullptr;
-    // Audio player.
+    // Audio engine that runs player.
+    AudioEngine *engine = nullptr;
+    // Audio player (owned by engine).
     AudioPlayer *player = nullptr;
 
 public:
@@ -43,10 +43,11 @@ public:
     /**
      * Constructor.
      * 
-     * @param player Audio player
+     * @param engine audio engine that runs player
+     * @param player audio player
      * @param name player name
      */
-    explicit AudioPlayerWidget(AudioPlayer *player, QString name, QWidget *parent = nullptr);
+    explicit AudioPlayerWidget(AudioEngine *engine, AudioPlayer *player, QString name, QWidget *parent = nullptr);
     /**
      * Destructor.
      */
@@ -77,15 +78,4 @@ public:
      * Stop player.
      */
     virtual void stop() = 0;
-
-    /**
-     * Updates devices in running player.
-     */
-    void updateDevices();
-
-signals:
-    /**
-     * Signals player to update devices.
-     */
-    void askToUpdateDevices();
 };
\ No newline at end of file
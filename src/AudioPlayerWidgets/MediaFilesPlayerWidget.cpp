@@ -1,30 +1,43 @@
 #include <AudioPlayerWidgets/MediaFilesPlayerWidget.hpp>
 
 
+// Track measurement
+#include <Library/TrackSummary.hpp>
+
+
 // Scaling of volume slider for better time control
 #define VOLUME_SLIDER_SCALE 10
 // Default labels values
 #define NO_TRACK_STR "<No track>"
 #define NO_DURATION_STR "0:00:00/0:00:00"
+// Milliseconds between player status reads (display rate)
+#define STATUS_REFRESH_INTERVAL 16
+// Range of level meter in decibels
+#define LEVEL_METER_RANGE 60
+// Crossfade across loop seam when it is enabled (seconds)
+#define LOOP_CROSSFADE_TIME 0.05
 
 
-MediaFilesPlayerWidget::MediaFilesPlayerWidget(QTabWidget const *devices, QString name, QWidget *parent)
-// Init of the player happens here
-: AudioPlayerWidget(new MediaFilesPlayer(devices), name, parent)
+MediaFilesPlayerWidget::MediaFilesPlayerWidget(AudioEngine *engine, int voice, QString name, QWidget *parent)
+// Player is owned by engine
+: AudioPlayerWidget(engine, engine->getVoice(voice), name, parent)
 {
+    this->voice = voice;
+
     // Allow dropping of draggable widgets
     setAcceptDrops(true);
 
-    // Connect signals to player
-    connect(this, &MediaFilesPlayerWidget::askToUpdateDevices, (MediaFilesPlayer*)this->player, MediaFilesPlayer::updateAudioDevices);
-    connect(this, &MediaFilesPlayerWidget::askNewTrack, (MediaFilesPlayer*)this->player, MediaFilesPlayer::setTrack);
-    connect(this, &MediaFilesPlayerWidget::askRemoveTrack, (MediaFilesPlayer*)this->player, MediaFilesPlayer::removeTrack);
-    connect(this, &MediaFilesPlayerWidget::askNewVolume, (MediaFilesPlayer*)this->player, MediaFilesPlayer::setVolume);
-    connect(this, &MediaFilesPlayerWidget::askNewState, (MediaFilesPlayer*)this->player, MediaFilesPlayer::scheduleState);
-    connect(this, &MediaFilesPlayerWidget::askNewTime, (MediaFilesPlayer*)this->player, &MediaFilesPlayer::scheduleTime);
-    connect((MediaFilesPlayer*)this->player, MediaFilesPlayer::signalState, this, &MediaFilesPlayerWidget::onStateChanged);
-    connect((MediaFilesPlayer*)this->player, &MediaFilesPlayer::signalDuration, this, &MediaFilesPlayerWidget::onDurationChanged);
-    connect((MediaFilesPlayer*)this->player, &MediaFilesPlayer::signalTime, this, &MediaFilesPlayerWidget::onTimeChanged);
+    // Player notifications arrive from player thread so pass them to GUI thread
+    MediaFilesPlayer *mediafilesPlayer = (MediaFilesPlayer*)this->player;
+    mediafilesPlayer->setDurationCallback([this](double seconds)
+    {
+        QMetaObject::invokeMethod(this, [this, seconds]() { onDurationChanged(seconds); }, Qt::QueuedConnection);
+    });
+    mediafilesPlayer->setTrackCallback([this](const std::string &filepath)
+    {
+        QString path = QString::fromStdString(filepath);
+        QMetaObject::invokeMethod(this, [this, path]() { onTrackChanged(path); }, Qt::QueuedConnection);
+    });
 
     /*
     // Header label:
@@ -52,8 +65,8 @@ MediaFilesPlayerWidget::MediaFilesPlayerWidget(QTabWidget const *devices, QStrin
     trackDuration->setAlignment(Qt::AlignRight);  // snap to the right
     box_layout1->addWidget(trackDuration);
 
-    // Time slider
-    timeSlider = new QSlider(Qt::Horizontal);
+    // Time slider (waveform of track is drawn behind it)
+    timeSlider = new WaveformSlider();
     timeSlider->setTracking(false);            // Only fire valueChanged event after releasing slider
     timeSlider->setRange(0, 0);                // Will be updated when audio is loaded
     connect(timeSlider, &QSlider::sliderPressed, this, &MediaFilesPlayerWidget::pauseOnTimeChange);        // pause player when slider was pressed
@@ -84,12 +97,35 @@ MediaFilesPlayerWidget::MediaFilesPlayerWidget(QTabWidget const *devices, QStrin
     volume_slider->setSizePolicy(QSizePolicy::Minimum, QSizePolicy::Maximum);
     box_layout3->addWidget(volume_slider);
     box_layout3->addWidget(volumeLabel);
+    // Level meter
+    levelMeter = new QProgressBar();
+    levelMeter->setRange(0, LEVEL_METER_RANGE);
+    levelMeter->setValue(0);
+    levelMeter->setTextVisible(false);
+    levelMeter->setFixedHeight(8);
+    box_layout3->addWidget(levelMeter);
+
+    // Position, state and levels are read from player instead of being sent by it
+    statusTimer = new QTimer(this);
+    connect(statusTimer, &QTimer::timeout, this, &MediaFilesPlayerWidget::refreshStatus);
+    statusTimer->start(STATUS_REFRESH_INTERVAL);
 }
 
 
 MediaFilesPlayerWidget::~MediaFilesPlayerWidget()
 {
     stop();
+
+    // Player outlives widget so it must not call us anymore
+    MediaFilesPlayer *mediafilesPlayer = (MediaFilesPlayer*)player;
+    mediafilesPlayer->setDurationCallback(nullptr);
+    mediafilesPlayer->setTrackCallback(nullptr);
+}
+
+
+void MediaFilesPlayerWidget::setLibrary(const TrackLibraryModel *library)
+{
+    this->library = library;
 }
 
 
@@ -124,11 +160,8 @@ void MediaFilesPlayerWidget::dropEvent(QDropEvent *event)
     // Get file path and name
     QStringList list = QString::fromUtf8(event->mimeData()->data("filepath&name")).split("?");
     
-    // Stop player and ask to change track
-    stop();
-    emit askNewTrack(list[0]);
-    // Update track name
-    trackName->setText(list[1]);
+    // Change track in background, playing one crossfades into it (track name is updated by player notification)
+    engine->swap(voice, list[0].toStdString());
 
     // Exit event
     event->acceptProposedAction();
@@ -146,17 +179,73 @@ void MediaFilesPlayerWidget::contextMenuEvent(QContextMenuEvent *event)
     {
         // Stop player and remove track
         this->stop();
-        emit this->askRemoveTrack();
+        this->engine->unload(this->voice);
         // Update labels
-        this->trackName->setText(NO_TRACK_STR);
         this->trackDuration->setText(NO_DURATION_STR);
     });
 
+    // Add region actions (points are set at position being heard)
+    menu.addSeparator();
+    double position = ((MediaFilesPlayer*)player)->getStatus().position;
+    auto addPointAction = [&](const char *name, double MediaFilesPlayer::Region::*point)
+    {
+        QAction *action = menu.addAction(name);
+        action->setEnabled(!shownTrack.isEmpty());
+        connect(action, &QAction::triggered, this, [this, point, position]()
+        {
+            region.*point = position;
+            applyRegion();
+        });
+    };
+    addPointAction("Set in point", &MediaFilesPlayer::Region::in);
+    addPointAction("Set out point", &MediaFilesPlayer::Region::out);
+    addPointAction("Set loop start", &MediaFilesPlayer::Region::loopStart);
+    addPointAction("Set loop end", &MediaFilesPlayer::Region::loopEnd);
+
+    QAction *crossfadeAction = menu.addAction("Crossfade loop seam");
+    crossfadeAction->setCheckable(true);
+    crossfadeAction->setChecked(region.crossfade > 0);
+    crossfadeAction->setEnabled(region.hasLoop());
+    connect(crossfadeAction, &QAction::toggled, this, [this](bool checked)
+    {
+        region.crossfade = checked ? LOOP_CROSSFADE_TIME : 0;
+        applyRegion();
+    });
+
+    QAction *clearAction = menu.addAction("Clear points");
+    clearAction->setEnabled(!region.isEmpty());
+    connect(clearAction, &QAction::triggered, this, [this]()
+    {
+        region = MediaFilesPlayer::Region();
+        applyRegion();
+    });
+
     // Place menu at correct position (of cursor)
     menu.exec(event->globalPos());
 }
 
 
+void MediaFilesPlayerWidget::applyRegion()
+{
+    // Track plays region from its next trigger (loop that is too long is dropped)
+    if (!shownTrack.isEmpty())
+    {
+        try
+        {
+            engine->setClipRegion(shownTrack.toStdString(), region);
+        }
+        catch(const std::exception& e)
+        {
+            displayWarning(e.what());
+            region.loopStart = -1;
+            region.loopEnd = -1;
+            engine->setClipRegion(shownTrack.toStdString(), region);
+        }
+    }
+    timeSlider->setRegion(region, ((MediaFilesPlayer*)player)->getDuration());
+}
+
+
 double MediaFilesPlayerWidget::convertLogToLinear(float value) {
     // Avoid non-zero from log
     if (value <= 0.0) return 0.0;
@@ -169,7 +258,7 @@ double MediaFilesPlayerWidget::convertLogToLinear(float value) {
 void MediaFilesPlayerWidget::setVolume(int value)
 {
     // Ask player to change volume
-    emit askNewVolume(convertLogToLinear(value / 100.0));
+    engine->setGain(voice, convertLogToLinear(value / 100.0));
     // Update volume label
     volumeLabel->setText(QString::number(value));
 }
@@ -178,7 +267,7 @@ void MediaFilesPlayerWidget::setVolume(int value)
 void MediaFilesPlayerWidget::setTime(int value)
 {
     // Ask player to change time
-    emit askNewTime(static_cast<double>(value) / VOLUME_SLIDER_SCALE);
+    engine->seek(voice, static_cast<double>(value) / VOLUME_SLIDER_SCALE);
 }
 
 
@@ -188,7 +277,7 @@ void MediaFilesPlayerWidget::pauseOnTimeChange()
     if (((MediaFilesPlayer*)player)->getState() == MediaFilesPlayer::PLAYING)
     {
         // Pause player
-        emit askNewState(MediaFilesPlayer::PAUSED);
+        engine->pause(voice);
         // Save our messing around with player
         wasPausedByTimeSlider = true;
     }
@@ -201,7 +290,7 @@ void MediaFilesPlayerWidget::resumeAfterTimeChange()
     if (wasPausedByTimeSlider && ((MediaFilesPlayer*)player)->getState() == MediaFilesPlayer::PAUSED)
     {
         // Resume player
-        emit askNewState(MediaFilesPlayer::PLAYING);
+        engine->play(voice);
         // Release flag
         wasPausedByTimeSlider = false;
     }
@@ -214,8 +303,7 @@ void MediaFilesPlayerWidget::stop()
     if (((MediaFilesPlayer*)player)->getState() != MediaFilesPlayer::STOPPED)
     {
         // Stop player
-        emit askNewState(MediaFilesPlayer::STOPPED);
-        threadpool->waitForDone(-1);
+        engine->stop(voice, true);
         // Update this flag on stopping player
         wasPausedByTimeSlider = false;
     }
@@ -227,23 +315,76 @@ void MediaFilesPlayerWidget::startStop()
     // Play-pause track
     switch (((MediaFilesPlayer*)player)->getState())
     {
-        // Start player
+        // Start player or set playing
         case MediaFilesPlayer::STOPPED:
-            threadpool->waitForDone(-1);
-            threadpool->start(player);
-            break;
-        // Set playing
         case MediaFilesPlayer::PAUSED:
-            emit askNewState(MediaFilesPlayer::PLAYING);
+            engine->play(voice);
             break;
         // Set paused
         case MediaFilesPlayer::PLAYING:
-            emit askNewState(MediaFilesPlayer::PAUSED);
+            engine->pause(voice);
             break;
     }
 }
 
 
+void MediaFilesPlayerWidget::onTrackChanged(QString filepath)
+{
+    trackName->setText(filepath.isEmpty() ? NO_TRACK_STR : filepath.mid(filepath.lastIndexOf('/') + 1));
+
+    shownTrack = filepath;
+    timeSlider->setPeaks(nullptr);
+    region = filepath.isEmpty() ? MediaFilesPlayer::Region() : engine->getClipRegion(filepath.toStdString());
+    timeSlider->setRegion(region, ((MediaFilesPlayer*)player)->getDuration());
+    if (filepath.isEmpty())
+        return;
+
+    // Library usually measured track already
+    std::shared_ptr<const PeakPyramid> peaks = library ? library->findPeaks(filepath) : nullptr;
+    if (peaks)
+    {
+        timeSlider->setPeaks(peaks);
+        return;
+    }
+
+    // Otherwise it is measured in background (widget may be gone by then)
+    QPointer<MediaFilesPlayerWidget> widget(this);
+    std::string path = filepath.toStdString();
+    double silence_threshold = library ? library->getSilenceThreshold() : DEFAULT_SILENCE_THRESHOLD;
+    engine->getWorkers()->submit([widget, filepath, path, silence_threshold]()
+    {
+        std::shared_ptr<const PeakPyramid> peaks;
+        ClipAnalysis analysis;
+        try
+        {
+            TrackSummary summary = TrackSummary::of(path, silence_threshold);
+            peaks = std::make_shared<const PeakPyramid>(std::move(summary.peaks));
+            analysis = summary.analysis;
+        }
+        catch(const std::exception&)
+        {
+            // Broken file shows no waveform
+            return;
+        }
+        QMetaObject::invokeMethod(QCoreApplication::instance(), [widget, filepath, peaks, analysis]()
+        {
+            if (widget)
+                widget->onSummary(filepath, peaks, analysis);
+        }, Qt::QueuedConnection);
+    }, WorkerPool::LOW);
+}
+
+
+void MediaFilesPlayerWidget::onSummary(const QString &filepath, std::shared_ptr<const PeakPyramid> peaks,
+                                       const ClipAnalysis &analysis)
+{
+    // Track is trimmed and normalized from its next trigger
+    engine->setClipAnalysis(filepath.toStdString(), analysis);
+    if (filepath == shownTrack)
+        timeSlider->setPeaks(std::move(peaks));
+}
+
+
 void MediaFilesPlayerWidget::onStateChanged(MediaFilesPlayer::State state)
 {
     // Avoid button changes when moving time slider
@@ -266,6 +407,27 @@ void MediaFilesPlayerWidget::onStateChanged(MediaFilesPlayer::State state)
 }
 
 
+void MediaFilesPlayerWidget::refreshStatus()
+{
+    MediaFilesPlayer::Status status = ((MediaFilesPlayer*)player)->getStatus();
+
+    if (status.state != shownState)
+    {
+        shownState = status.state;
+        onStateChanged(status.state);
+    }
+
+    onTimeChanged(status.position);
+
+    // Meter shows peak in decibels
+    int level = 0;
+    if (status.peak > 0)
+        level = std::clamp(static_cast<int>(20 * std::log10(status.peak)) + LEVEL_METER_RANGE, 0, LEVEL_METER_RANGE);
+    if (level != levelMeter->value())
+        levelMeter->setValue(level);
+}
+
+
 std::string MediaFilesPlayerWidget::formatTime(int seconds) {
     // Convert from slider value
     seconds /= VOLUME_SLIDER_SCALE;
@@ -296,17 +458,21 @@ void MediaFilesPlayerWidget::onDurationChanged(double seconds)
 {
     timeSlider->setMaximum(static_cast<int>(seconds * VOLUME_SLIDER_SCALE));
     trackDuration->setText(getDurationLabel(timeSlider->value(), timeSlider->maximum()));
+    timeSlider->setRegion(region, seconds);
 }
 
 
 void MediaFilesPlayerWidget::onTimeChanged(double seconds)
 {
-    // Updtae only if user is not holding slider
-    if (!timeSlider->isSliderDown())
+    // Updtae only if user is not holding slider and something visible has changed
+    int value = std::min(static_cast<int>(seconds * VOLUME_SLIDER_SCALE), timeSlider->maximum());
+    if (!timeSlider->isSliderDown() && (value != timeSlider->value()))
     {
+        bool is_new_second = (value / VOLUME_SLIDER_SCALE) != (timeSlider->value() / VOLUME_SLIDER_SCALE);
         timeSlider->blockSignals(true);
-        timeSlider->setValue(static_cast<int>(seconds * VOLUME_SLIDER_SCALE));
-        trackDuration->setText(getDurationLabel(timeSlider->value(), timeSlider->maximum()));
+        timeSlider->setValue(value);
+        if (is_new_second)
+            trackDuration->setText(getDurationLabel(timeSlider->value(), timeSlider->maximum()));
         timeSlider->blockSignals(false);
     }
 }
\ No newline at end of file
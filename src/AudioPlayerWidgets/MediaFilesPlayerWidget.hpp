@@ -8,8 +8,16 @@
 #include <iomanip>
 // For time utilities
 #include <chrono>
+// Math
+#include <cmath>
+// Min/max
+#include <algorithm>
+// Qt core
+#include <QtCore/QTimer>
+#include <QtCore/QPointer>
 // Qt widgets
 #include <QtWidgets/QApplication>
+#include <QtWidgets/QProgressBar>
 #include <QtWidgets/QHBoxLayout>
 #include <QtWidgets/QPushButton>
 #include <QtWidgets/QMenu>
@@ -17,6 +25,10 @@
 #include <AudioPlayerWidgets/AudioPlayerWidget.hpp>
 // Media files player
 #include <AudioPlayers/MediaFilesPlayer.hpp>
+// Slider with waveform
+#include <AudioPlayerWidgets/WaveformSlider.hpp>
+// Measured library tracks
+#include <TrackLibrary/TrackLibraryModel.hpp>
 
 
 /**
@@ -36,24 +48,45 @@ class MediaFilesPlayerWidget : public AudioPlayerWidget
     // Volume label.
     QLabel *volumeLabel = nullptr;
     // Time slider.
-    QSlider *timeSlider = nullptr;
+    WaveformSlider *timeSlider = nullptr;
     // Whether player was paused by time slider.
     bool wasPausedByTimeSlider = false;
+    // Level meter.
+    QProgressBar *levelMeter = nullptr;
+    // Polls player status at display rate.
+    QTimer *statusTimer = nullptr;
+    // Player state shown by widget.
+    MediaFilesPlayer::State shownState = MediaFilesPlayer::STOPPED;
+
+    // Engine voice index of player.
+    int voice;
+    // Library that has waveforms of its tracks (nullptr if there is none).
+    const TrackLibraryModel *library = nullptr;
+    // Media file whose waveform is shown.
+    QString shownTrack;
+    // In/out points and loop of shown media file.
+    MediaFilesPlayer::Region region;
 
 public:
 
     /**
      * Constructor.
      * 
-     * @param player Audio player.
+     * @param engine audio engine that runs player
+     * @param voice engine voice index of player
      * @param name Player name.
      */
-    explicit MediaFilesPlayerWidget(QTabWidget const *devices, QString name, QWidget *parent = nullptr);
+    explicit MediaFilesPlayerWidget(AudioEngine *engine, int voice, QString name, QWidget *parent = nullptr);
     /**
      * Destructor.
      */
     ~MediaFilesPlayerWidget();
 
+    /**
+     * @param library library whose measured waveforms are shown instead of measuring track again
+     */
+    void setLibrary(const TrackLibraryModel *library);
+
 private:
 
     /**
@@ -77,6 +110,11 @@ private:
      */
     void contextMenuEvent(QContextMenuEvent *event) override;
 
+    /**
+     * Passes region of shown track to engine and slider.
+     */
+    void applyRegion();
+
     /**
      * Converts sound volume for better human perception
      */
@@ -118,10 +156,29 @@ public:
     void stop() override;
     
     /**
-     * Handler for player state update signal.
+     * Handler for player track update signal.
+     * 
+     * @param filepath media file path (empty if track was removed)
+     */
+    void onTrackChanged(QString filepath);
+
+    /**
+     * Shows waveform of track measured outside of library and passes its analysis to engine (GUI thread).
+     *
+     * @param filepath media file that was measured (waveform is ignored if track changed meanwhile)
+     */
+    void onSummary(const QString &filepath, std::shared_ptr<const PeakPyramid> peaks, const ClipAnalysis &analysis);
+
+    /**
+     * Handler for player state change.
      */
     void onStateChanged(MediaFilesPlayer::State state);
 
+    /**
+     * Reads player status and updates widgets that show something new.
+     */
+    void refreshStatus();
+
 private:
 
     /**
@@ -145,39 +202,9 @@ public:
     void onDurationChanged(double seconds);
     
     /**
-     * Handler for player time update signal.
+     * Handler for player time change.
      * 
      * @param seconds time in seconds
      */
     void onTimeChanged(double seconds);
-
-signals:
-    /**
-     * Ask player to change track.
-     * 
-     * @param filepath media file path
-     */
-    void askNewTrack(QString filepath);
-    /**
-     * Ask player to remove track.
-     */
-    void askRemoveTrack();
-    /**
-     * Ask player to change state.
-     * 
-     * @param state new state
-     */
-    void askNewState(MediaFilesPlayer::State state);
-    /**
-     * Ask player to change volume.
-     * 
-     * @param volume volume value
-     */
-    void askNewVolume(float volume);
-    /**
-     * Ask player to change time.
-     * 
-     * @param seconds time in seconds
-     */
-    void askNewTime(double seconds);
 };
\ No newline at end of file
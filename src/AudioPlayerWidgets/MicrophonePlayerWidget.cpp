@@ -1,14 +1,10 @@
 #include <AudioPlayerWidgets/MicrophonePlayerWidget.hpp>
 
 
-MicrophonePlayerWidget::MicrophonePlayerWidget(QTabWidget const *devices, QString name, QWidget *parent)
-// Init of the player happens here
-: AudioPlayerWidget(new MicrophonePlayer(devices), name, parent)
+MicrophonePlayerWidget::MicrophonePlayerWidget(AudioEngine *engine, QString name, QWidget *parent)
+// Player is owned by engine
+: AudioPlayerWidget(engine, engine->getMicrophone(), name, parent)
 {
-    // Connect signals to player
-    connect(this, &MicrophonePlayerWidget::askToStop, (MicrophonePlayer*)this->player, MicrophonePlayer::stop);
-    connect(this, &MicrophonePlayerWidget::askToUpdateDevices, (MicrophonePlayer*)this->player, MicrophonePlayer::updateAudioDevices);
-
     /*
     // Header layout:
     */
@@ -38,8 +34,7 @@ void MicrophonePlayerWidget::stop()
     if (((MicrophonePlayer*)player)->getState())
     {
         // Stop player and wait for it to finish
-        emit askToStop();
-        threadpool->waitForDone(-1);
+        engine->stopMicrophone();
         // Update button
         buttonStartStop->setText("Start");
     }
@@ -55,7 +50,7 @@ void MicrophonePlayerWidget::startStop()
     else
     {
         // Start player
-        threadpool->start(player);
+        engine->startMicrophone();
         // Update button
         buttonStartStop->setText("Stop");
     }
@@ -26,10 +26,10 @@ public:
     /**
      * Constructor.
      * 
-     * @param player Audio player
+     * @param engine audio engine that runs microphone rerouter
      * @param name player name
      */
-    explicit MicrophonePlayerWidget(QTabWidget const *devices, QString name, QWidget *parent = nullptr);
+    explicit MicrophonePlayerWidget(AudioEngine *engine, QString name, QWidget *parent = nullptr);
     /**
      * Destructor.
      */
@@ -48,10 +48,4 @@ public:
      * Stop player.
      */
     void stop() override;
-
-signals:
-    /**
-     * Signals player to stop.
-     */
-    void askToStop();
 };
\ No newline at end of file
@@ -0,0 +1,77 @@
+#include <AudioPlayerWidgets/WaveformSlider.hpp>
+
+
+// Min/max
+#include <algorithm>
+// Qt GUI
+#include <QtGui/QPainter>
+// Qt widgets
+#include <QtWidgets/QStyle>
+#include <QtWidgets/QStyleOptionSlider>
+// Waveform drawing
+#include <TrackLibrary/WaveformPainter.hpp>
+
+
+// Height of slider with waveform (pixels)
+#define WAVEFORM_SLIDER_HEIGHT 36
+// Opacity of loop area (0..255)
+#define LOOP_AREA_ALPHA 48
+
+
+WaveformSlider::WaveformSlider(QWidget *parent) : QSlider(Qt::Horizontal, parent)
+{
+    setMinimumHeight(WAVEFORM_SLIDER_HEIGHT);
+}
+
+
+void WaveformSlider::setPeaks(std::shared_ptr<const PeakPyramid> peaks)
+{
+    this->peaks = std::move(peaks);
+    update();
+}
+
+
+void WaveformSlider::setRegion(const MediaFilesPlayer::Region &region, double duration)
+{
+    this->region = region;
+    this->duration = duration;
+    update();
+}
+
+
+void WaveformSlider::paintEvent(QPaintEvent *event)
+{
+    // Waveform and region span groove, so positions on it match handle
+    QStyleOptionSlider option;
+    initStyleOption(&option);
+    QRect groove = style()->subControlRect(QStyle::CC_Slider, &option, QStyle::SC_SliderGroove, this);
+    QRect rect(groove.left(), contentsRect().top(), groove.width(), contentsRect().height());
+    QPainter painter(this);
+
+    if (peaks)
+        WaveformPainter::paint(&painter, rect, peaks->buckets.data(), palette().color(QPalette::WindowText));
+
+    if (duration > 0)
+    {
+        // Pixel column of time
+        auto x = [&](double seconds)
+        {
+            return rect.left() + static_cast<int>(std::min(seconds / duration, 1.0) * rect.width());
+        };
+        QColor color = palette().color(QPalette::Highlight);
+        if (region.hasLoop())
+        {
+            QColor area = color;
+            area.setAlpha(LOOP_AREA_ALPHA);
+            painter.fillRect(QRect(QPoint(x(region.loopStart), rect.top()), QPoint(x(region.loopEnd), rect.bottom())), area);
+        }
+        painter.setPen(color);
+        if (region.in >= 0)
+            painter.drawLine(x(region.in), rect.top(), x(region.in), rect.bottom());
+        if (region.out >= 0)
+            painter.drawLine(x(region.out), rect.top(), x(region.out), rect.bottom());
+    }
+    painter.end();
+
+    QSlider::paintEvent(event);
+}
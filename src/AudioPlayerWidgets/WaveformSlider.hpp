@@ -0,0 +1,56 @@
+#pragma once
+
+
+// Shared waveforms
+#include <memory>
+// Qt widgets
+#include <QtWidgets/QSlider>
+// Waveforms
+#include <Library/PeakPyramid.hpp>
+// Regions
+#include <AudioPlayers/MediaFilesPlayer.hpp>
+
+
+/**
+ * Horizontal slider with track waveform, in/out points and loop drawn behind its groove.
+ */
+class WaveformSlider : public QSlider
+{
+    // Mandatory for QWidget stuff to work
+    Q_OBJECT
+
+    // Shown waveform (nullptr if there is none).
+    std::shared_ptr<const PeakPyramid> peaks;
+    // Shown region.
+    MediaFilesPlayer::Region region;
+    // Track duration in seconds (region is hidden unless it is positive).
+    double duration = 0;
+
+public:
+
+    /**
+     * Constructor.
+     */
+    explicit WaveformSlider(QWidget *parent = nullptr);
+
+    /**
+     * Replaces shown waveform.
+     *
+     * @param peaks waveform pyramid of track (nullptr hides waveform)
+     */
+    void setPeaks(std::shared_ptr<const PeakPyramid> peaks);
+
+    /**
+     * Replaces shown region.
+     *
+     * @param duration track duration in seconds
+     */
+    void setRegion(const MediaFilesPlayer::Region &region, double duration);
+
+protected:
+
+    /**
+     * Paints waveform and region and then slider over them.
+     */
+    void paintEvent(QPaintEvent *event) override;
+};
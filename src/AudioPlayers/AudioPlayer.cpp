@@ -1,12 +1,31 @@
 #include <AudioPlayers/AudioPlayer.hpp>
 
 
-AudioPlayer::AudioPlayer(QTabWidget const* devices)
+// Exceptions
+#include <stdexcept>
+// Min/max
+#include <algorithm>
+
+
+void AudioPlayer::setErrorCallback(ErrorCallback callback)
+{
+    errorCallback = callback;
+}
+
+
+void AudioPlayer::setWorkers(WorkerPool *workers)
 {
-    this->devices = devices;
+    this->workers = workers;
+}
+
 
-    // Do not allow thread pool to destroy us
-    setAutoDelete(false);
+void AudioPlayer::setRoutes(const Routes &routes)
+{
+    {
+        std::lock_guard<std::mutex> lock(routesMutex);
+        offeredRoutes = routes;
+    }
+    mustUpdateDevices = true;
 }
 
 
@@ -16,34 +35,214 @@ void AudioPlayer::updateAudioDevices()
 }
 
 
-void AudioPlayer::stopAudioStream(DeviceStream **audioStream)
+bool AudioPlayer::updateDeviceSlot(DeviceSlot &slot, int index)
+{
+    if (!slot.update())
+        return false;
+
+    // New stream counts its own underruns
+    stats.devices[index].device = slot.device();
+    stats.devices[index].sampleRate = slot.stream()->format().freq;
+    stats.devices[index].streamUnderruns = 0;
+    return true;
+}
+
+
+bool AudioPlayer::openSinks(const SDL_AudioSpec *format)
+{
+    // Routes are changed by control thread, take them next time if it holds them right now (flag is
+    // lowered first, so routes offered meanwhile are taken next time too)
+    mustUpdateDevices = false;
+    if (!routesMutex.try_lock())
+    {
+        mustUpdateDevices = true;
+        return false;
+    }
+    Routes routes = offeredRoutes;
+    routesMutex.unlock();
+    if (routes.empty())
+        throw std::runtime_error("Player has no output routes");
+    if (routes.size() > MAX_PLAYER_ROUTES)
+        routes.resize(MAX_PLAYER_ROUTES);
+
+    // Sinks of devices that stay routed keep their streams
+    std::vector<std::unique_ptr<RouteSink>> kept;
+    for (const Route &route : routes)
+    {
+        auto sink = std::find_if(sinks.begin(), sinks.end(), [&](const std::unique_ptr<RouteSink> &sink)
+        {
+            return sink && (sink->route.device == route.device);
+        });
+        if (sink != sinks.end())
+            kept.push_back(std::move(*sink));
+        else
+        {
+            kept.push_back(std::make_unique<RouteSink>());
+            kept.back()->slot.setWorkers(workers);
+        }
+        kept.back()->route = route;
+    }
+    // Others are closed (destroying stream only unbinds it from device, it is done by worker pool)
+    for (std::unique_ptr<RouteSink> &sink : sinks)
+    {
+        if (sink)
+            sink->slot.close();
+    }
+    sinks = std::move(kept);
+
+    for (size_t i = 0; i < MAX_PLAYER_ROUTES; i++)
+    {
+        DeviceStats &device = stats.devices[i + 1];
+        if ((i < sinks.size()) && sinks[i]->slot.isOpen())
+        {
+            DeviceStream *stream = sinks[i]->slot.stream();
+            device.device = sinks[i]->slot.device();
+            device.sampleRate = stream->format().freq;
+            device.streamUnderruns = stream->underruns();
+        }
+        else
+        {
+            device.device = 0;
+            device.queuedBytes = 0;
+            device.targetSize = 0;
+            device.streamUnderruns = 0;
+        }
+    }
+
+    setSinksVolume(sinksVolume);
+    for (std::unique_ptr<RouteSink> &sink : sinks)
+        sink->slot.open(sink->route.device, format);
+    return true;
+}
+
+
+bool AudioPlayer::updateSinks()
+{
+    bool is_updated = false;
+    for (size_t i = 0; i < sinks.size(); i++)
+    {
+        if (updateDeviceSlot(sinks[i]->slot, static_cast<int>(i) + 1))
+            is_updated = true;
+    }
+    return is_updated;
+}
+
+
+bool AudioPlayer::isSinksOpen()
+{
+    bool is_any_open = false;
+    for (const std::unique_ptr<RouteSink> &sink : sinks)
+    {
+        if (sink->slot.isOpen())
+            is_any_open = true;
+        else if (isWaitingForSinks)
+            return false;
+    }
+    // Audio has started, routes added later join without holding it back
+    if (is_any_open)
+        isWaitingForSinks = false;
+    return is_any_open;
+}
+
+
+bool AudioPlayer::isSinksReadyForWrite()
+{
+    for (const std::unique_ptr<RouteSink> &sink : sinks)
+    {
+        if (sink->slot.isOpen() && !sink->slot.stream()->isReadyForWrite())
+            return false;
+    }
+    return true;
+}
+
+
+bool AudioPlayer::isSinksEmpty()
 {
-    // Stop and delete previous audio stream
-    if (*audioStream)
+    for (const std::unique_ptr<RouteSink> &sink : sinks)
     {
-        delete *audioStream;
-        *audioStream = nullptr;
+        if (sink->slot.isOpen() && !sink->slot.stream()->isEmpty())
+            return false;
     }
+    return true;
 }
 
 
-DeviceStream* AudioPlayer::restartAudioStream(DeviceStream **audioSink, DeviceTab *deviceTab, const SDL_AudioSpec &format)
+bool AudioPlayer::isSinksFormat(const SDL_AudioSpec &format) const
 {
-    // Stop audio sink
-    stopAudioStream(audioSink);
+    for (const std::unique_ptr<RouteSink> &sink : sinks)
+    {
+        if (!sink->slot.isOpen())
+            continue;
+        SDL_AudioSpec current = sink->slot.stream()->format();
+        if ((current.channels != format.channels) || (current.freq != format.freq))
+            return false;
+    }
+    return true;
+}
+
 
-    // Init and start new audio
-    return new DeviceStream(deviceTab->getDevice(), format);
+int AudioPlayer::queuedInSinks()
+{
+    int queued = 0;
+    for (const std::unique_ptr<RouteSink> &sink : sinks)
+    {
+        if (sink->slot.isOpen())
+            queued = std::max(queued, sink->slot.stream()->queued());
+    }
+    return queued;
 }
 
 
-DeviceStream* AudioPlayer::restartAudioStream(DeviceStream **audioSink, DeviceTab *deviceTab)
+void AudioPlayer::holdSinks()
 {
-    // Stop audio sink
-    stopAudioStream(audioSink);
+    for (std::unique_ptr<RouteSink> &sink : sinks)
+    {
+        if (sink->slot.isOpen())
+            sink->slot.stream()->hold();
+    }
+}
 
-    // Init and start new audio
-    return new DeviceStream(deviceTab->getDevice());
+
+void AudioPlayer::flushSinks()
+{
+    for (std::unique_ptr<RouteSink> &sink : sinks)
+    {
+        if (sink->slot.isOpen())
+            sink->slot.stream()->flush();
+    }
+}
+
+
+void AudioPlayer::setSinksVolume(float volume)
+{
+    sinksVolume = volume;
+    for (std::unique_ptr<RouteSink> &sink : sinks)
+        sink->slot.volume(sink->route.isMuted ? 0 : volume * sink->route.gain);
+}
+
+
+void AudioPlayer::writeSinks(const float *buffer, int size, std::shared_ptr<const void> owner)
+{
+    // Audio is decoded once whatever the number of routes is
+    for (size_t i = 0; i < sinks.size(); i++)
+    {
+        DeviceSlot &slot = sinks[i]->slot;
+        if (!slot.isOpen())
+            continue;
+        countWrite(static_cast<int>(i) + 1, slot.stream(), size);
+        if (owner)
+            slot.writeShared(owner, buffer, size);
+        else
+            slot.write(buffer, size);
+    }
+}
+
+
+void AudioPlayer::closeSinks()
+{
+    for (std::unique_ptr<RouteSink> &sink : sinks)
+        sink->slot.close();
+    isWaitingForSinks = true;
 }
 
 
@@ -53,4 +252,31 @@ void AudioPlayer::reset()
     mustUpdateDevices = true;
     shouldReadSamples = true;
     shouldFlush = true;
-}
\ No newline at end of file
+
+    // Streams are closed
+    for (DeviceStats &device : stats.devices)
+    {
+        device.device = 0;
+        device.queuedBytes = 0;
+        device.targetSize = 0;
+    }
+}
+
+
+void AudioPlayer::countWrite(int index, DeviceStream *audioSink, int size)
+{
+    DeviceStats &device = stats.devices[index];
+    uint64_t underruns = audioSink->underruns();
+    device.underruns += underruns - device.streamUnderruns;
+    device.streamUnderruns = underruns;
+    device.queuedBytes = SDL_GetAudioStreamQueued(audioSink->stream());
+    device.targetSize = audioSink->targetSize();
+    device.framesWritten += size;
+}
+
+
+void AudioPlayer::signalError(const std::string &message)
+{
+    if (errorCallback)
+        errorCallback(message);
+}
@@ -1,37 +1,103 @@
 #pragma once
 
 
-// Qt core
-#include <QtCore/QObject>
-#include <QtCore/QString>
-#include <QtCore/QRunnable>
-// Qt widgets
-#include <QtWidgets/QWidget>
-#include <QtWidgets/QTabWidget>
-// Audio device tab widget
-#include <DeviceTab.hpp>
-// Audio device stream
-#include <SDL/DeviceStream.cpp>
+// Strings
+#include <string>
+// Containers
+#include <vector>
+// Smart pointers
+#include <memory>
+// Callbacks
+#include <functional>
+// Threads
+#include <mutex>
+#include <atomic>
+// Switchable audio device stream
+#include <AudioPlayers/DeviceSlot.hpp>
+// Player counters
+#include <Engine/PlayerStats.hpp>
 
 
 /**
  * Basic player class.
  */
-class AudioPlayer : public QObject, public QRunnable
+class AudioPlayer
 {
-    // Mandatory for QWidget stuff to work
-    Q_OBJECT
+public:
+
+    /**
+     * Output of player to one audio device.
+     */
+    struct Route
+    {
+        // Audio device.
+        SDL_AudioDeviceID device = 0;
+        // Linear gain.
+        float gain = 1;
+        // Whether route is silenced (its stream stays open, so unmuting is instant).
+        bool isMuted = false;
+    };
+
+    /**
+     * Outputs of player (at most one per device).
+     */
+    typedef std::vector<Route> Routes;
+
+    /**
+     * Receives player error message.
+     */
+    typedef std::function<void(const std::string&)> ErrorCallback;
+
+    /**
+     * Describes result of one iteration of player cycle.
+     */
+    enum CycleResult
+    {
+        // Nothing to do right now (device buffers are full or waiting for input).
+        IDLE,
+        // Some work was done.
+        BUSY,
+        // Player cycle has ended.
+        FINISHED
+    };
 
 protected:
 
-    // Tab widget that describes available devices.
-    QTabWidget const *devices = nullptr;
+    /**
+     * Device stream of one route.
+     */
+    struct RouteSink
+    {
+        // Route.
+        Route route;
+        // Stream on route device.
+        DeviceSlot slot;
+    };
+
+    // Notified about player errors.
+    ErrorCallback errorCallback;
+    // Opens and closes device streams in background (nullptr opens them in place).
+    WorkerPool *workers = nullptr;
+
+    // Routes offered by control thread.
+    Routes offeredRoutes;
+    // Guards offeredRoutes.
+    std::mutex routesMutex;
+    // Streams of routes taken over by audio thread (in order of routes).
+    std::vector<std::unique_ptr<RouteSink>> sinks;
+    // Player volume routes are scaled by (audio thread).
+    float sinksVolume = 1;
+    // Whether writes wait until every sink is open (set when player cycle starts).
+    bool isWaitingForSinks = true;
+
+    // Whether player cycle is run by audio thread.
+    std::atomic<bool> active = false;
 
-    // Audio output (virtual cable).
-    DeviceStream *audioVCableSink = nullptr;
+    // Player counters.
+    PlayerStats stats;
 
     // Whether devices should be updated (always update at startup).
-    bool mustUpdateDevices = true;
+    std::atomic<bool> mustUpdateDevices = true;
     // Whether player should read next samples (always read on startup)
     bool shouldReadSamples = true;
     // Whether stream has to be flushed for correct track ending
@@ -40,45 +106,145 @@ protected:
 public:
 
     /**
-     * Constructor.
-     * 
-     * @param devices tab widget that describes avaliavle devices
+     * Destructor.
+     */
+    virtual ~AudioPlayer() = default;
+
+    /**
+     * @param callback function that will receive player errors
+     */
+    void setErrorCallback(ErrorCallback callback);
+    /**
+     * Singals about player error.
+     *
+     * @param message error message
+     */
+    void signalError(const std::string &message);
+
+    /**
+     * @return whether player cycle is run by audio thread
+     */
+    bool isActive() const { return active; }
+    /**
+     * Marks player cycle as run (or no longer run) by audio thread.
+     */
+    void setActive(bool active) { this->active = active; }
+
+    /**
+     * @return player counters
+     */
+    PlayerStats& getStats() { return stats; }
+
+    /**
+     * @param workers pool that opens and closes device streams in background
+     */
+    virtual void setWorkers(WorkerPool *workers);
+
+    /**
+     * Replaces outputs of player. Running player keeps streams of devices that are still routed, so gain
+     * and mute changes never interrupt audio (safe to call from any thread).
      */
-    explicit AudioPlayer(QTabWidget const *devices);
+    void setRoutes(const Routes &routes);
 
 protected:
 
     /**
-     * Stops given audio stream.
+     * Switches device slot to stream opened in background, if any.
+     *
+     * @param slot device slot
+     * @param index index of stream counters
+     *
+     * @return whether slot has switched to new stream
      */
-    void stopAudioStream(DeviceStream **audioStream);
+    bool updateDeviceSlot(DeviceSlot &slot, int index);
 
     /**
-     * Restarts given audio stream.
-     * 
-     * @param audioSink audio stream to close
-     * @param deviceTab device tab with audio device info
-     * @param format audio format
-     * 
-     * @return new audio stream
+     * Takes over offered routes and requests their streams (streams of dropped routes are closed).
+     *
+     * @param format audio format of streams (nullptr for native rate and channels of each device)
+     *
+     * @return false if routes are being changed right now (call again on next iteration)
+     *
+     * @throws Runtime Error if player has no routes.
      */
-    DeviceStream* restartAudioStream(DeviceStream **audioSink, DeviceTab *deviceTab, const SDL_AudioSpec &format);
+    bool openSinks(const SDL_AudioSpec *format);
 
     /**
-     * Restarts given audio stream with native format.
-     * 
-     * @param audioSink audio stream to close
-     * @param deviceTab device tab with audio device info
-     * 
-     * @return new audio stream
+     * Switches sinks to streams opened in background.
+     *
+     * @return whether any sink has switched to new stream
      */
-    DeviceStream* restartAudioStream(DeviceStream **audioSink, DeviceTab *deviceTab);
+    bool updateSinks();
+
+    /**
+     * @return whether audio can be written (every sink is open when player cycle starts, routes added later
+     *         join once their streams are open)
+     */
+    bool isSinksOpen();
+
+    /**
+     * @return whether every open sink has less audio queued than its target
+     */
+    bool isSinksReadyForWrite();
+
+    /**
+     * @return whether every open sink has played all its audio
+     */
+    bool isSinksEmpty();
+
+    /**
+     * @return whether every open sink has given rate and channel count
+     */
+    bool isSinksFormat(const SDL_AudioSpec &format) const;
+
+    /**
+     * @return largest amount of audio queued in open sinks in samples
+     */
+    int queuedInSinks();
+
+    /**
+     * Tells open sinks that upcoming gap in written audio is intended.
+     */
+    void holdSinks();
+
+    /**
+     * Flushes open sinks indicating end of data.
+     */
+    void flushSinks();
+
+    /**
+     * Sets player volume of sinks (each route applies its own gain and mute on top).
+     */
+    void setSinksVolume(float volume);
+
+    /**
+     * Writes audio data to open sinks and counts it.
+     *
+     * @param buffer audio data buffer
+     * @param size size of data in samples
+     * @param owner keeps immutable audio alive while sinks reference it (nullptr copies audio into sinks)
+     */
+    void writeSinks(const float *buffer, int size, std::shared_ptr<const void> owner = nullptr);
+
+    /**
+     * Closes streams of all sinks.
+     */
+    void closeSinks();
 
     /**
      * Resets player variables.
      */
     void reset();
 
+    /**
+     * Updates device counters before audio is written to device stream.
+     *
+     * @param index index of stream counters
+     * @param audioSink device stream
+     * @param size size of written data in samples
+     */
+    void countWrite(int index, DeviceStream *audioSink, int size);
+
 public:
 
     /**
@@ -87,15 +253,18 @@ public:
     virtual void updateAudioDevices();
 
     /**
-     * Player cycle.
+     * Begins player cycle. Player cycle is run by audio thread: prepare(), process() until it
+     * finishes, finish(). None of them blocks.
+     *
+     * @return false if there is nothing to play (finish() must still be called)
      */
-    virtual void run() = 0;
-
-signals:
+    virtual bool prepare() = 0;
     /**
-     * Singals about player error.
-     * 
-     * @param message error message
+     * Runs one iteration of player cycle.
+     */
+    virtual CycleResult process() = 0;
+    /**
+     * Ends player cycle and releases devices.
      */
-    void signalError(QString message);
-};
\ No newline at end of file
+    virtual void finish() = 0;
+};
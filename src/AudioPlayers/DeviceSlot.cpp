@@ -0,0 +1,396 @@
+#include <AudioPlayers/DeviceSlot.hpp>
+
+
+// Exceptions
+#include <stdexcept>
+// Min/max
+#include <algorithm>
+// Memory copying
+#include <cstring>
+// Console output
+#include <cstdio>
+// Pipeline spans
+#include <Engine/Tracer.hpp>
+
+
+// Audio kept for moving queue between streams (seconds, must exceed highest buffer target)
+#define HISTORY_TIME 1.0
+// Written blocks kept for moving queue between streams (must cover highest buffer target at smallest block)
+#define HISTORY_BLOCK_COUNT 256
+// Crossfade between old and new stream (seconds)
+#define CROSSFADE_TIME 0.02
+// Old stream lives this long after its queued audio should have played (nanoseconds, covers device buffer)
+#define RETIRE_DELAY 100000000
+
+
+/**
+ * Opens stream on device.
+ *
+ * @param format audio format (nullptr for native rate and channels of device as 32-bit float)
+ */
+static DeviceStream* createStream(SDL_AudioDeviceID device, const SDL_AudioSpec *format)
+{
+    if (format)
+        return new DeviceStream(device, *format);
+
+    SDL_AudioSpec native;
+    if (!SDL_GetAudioDeviceFormat(device, &native, NULL))
+        throw std::runtime_error("Audio device: unable to get device format");
+    native.format = SDL_AUDIO_F32;
+    return new DeviceStream(device, native);
+}
+
+
+/**
+ * @return whether formats are equal
+ */
+static bool isSameFormat(const SDL_AudioSpec &a, const SDL_AudioSpec &b)
+{
+    return (a.format == b.format) && (a.channels == b.channels) && (a.freq == b.freq);
+}
+
+
+DeviceSlot::~DeviceSlot()
+{
+    // Slots are closed by their players before, streams left at shutdown outlive worker pool
+    close(false);
+}
+
+
+void DeviceSlot::open(SDL_AudioDeviceID device, const SDL_AudioSpec *format)
+{
+    OpenRequest wanted;
+    wanted.device = device;
+    wanted.isNative = (format == nullptr);
+    if (format)
+        wanted.format = *format;
+
+    // Already there or on the way
+    if (pending && isSameRequest(*pending, wanted))
+        return;
+    abandon(true);
+    if (current && isSameRequest(*currentRequest, wanted))
+        return;
+
+    pending = std::make_shared<OpenRequest>();
+    pending->device = wanted.device;
+    pending->isNative = wanted.isNative;
+    pending->format = wanted.format;
+    if (workers)
+    {
+        std::shared_ptr<OpenRequest> request = pending;
+        workers->submit([request]() { openStream(request); }, WorkerPool::HIGH);
+    }
+    else
+        openStream(pending);
+}
+
+
+bool DeviceSlot::update()
+{
+    // Delete faded out streams
+    if (!retiring.empty())
+    {
+        Uint64 now = SDL_GetTicksNS();
+        for (size_t i = 0; i < retiring.size();)
+        {
+            if (now >= retiring[i].deadline)
+            {
+                deleteStream(retiring[i].stream, true);
+                retiring[i] = retiring.back();
+                retiring.pop_back();
+            }
+            else
+                i++;
+        }
+    }
+
+    // Adopt opened stream
+    if (!pending || (pending->state.load(std::memory_order_acquire) != DONE))
+        return false;
+    std::shared_ptr<OpenRequest> request = pending;
+    pending.reset();
+
+    if (!request->stream)
+    {
+        // Keep playing on current device
+        if (!current)
+            throw std::runtime_error(request->error);
+        #ifdef DEBUG
+        printf("Device slot: keeping current device, %s\n", request->error.c_str());
+        #endif
+        return false;
+    }
+
+    adopt(request);
+    return true;
+}
+
+
+void DeviceSlot::volume(float value)
+{
+    gain = value;
+    if (current)
+        current->volume(value);
+}
+
+
+void DeviceSlot::write(const float *buffer, int size)
+{
+    current->write(buffer, size);
+    remember(buffer, size);
+}
+
+
+void DeviceSlot::writeShared(std::shared_ptr<const void> owner, const float *buffer, int size)
+{
+    remember(buffer, size, owner);
+    current->writeShared(std::move(owner), buffer, size);
+}
+
+
+void DeviceSlot::remember(const float *buffer, int size, std::shared_ptr<const void> owner)
+{
+    // Remember audio in case it has to be moved to another stream
+    if (history.empty())
+        return;
+    size_t count = static_cast<size_t>(size) * current->format().channels;
+    HistoryBlock &block = historyBlocks[historyBlocksHead % historyBlocks.size()];
+    historyBlocksHead++;
+
+    // Shared audio stays alive through its owner, so it is only referenced
+    if (owner)
+    {
+        block.owner = std::move(owner);
+        block.data = buffer;
+        block.size = count;
+        return;
+    }
+
+    // Only latest audio fits
+    if (count > history.size())
+    {
+        buffer += count - history.size();
+        historyHead += count - history.size();
+        count = history.size();
+    }
+    block.owner.reset();
+    block.data = nullptr;
+    block.position = historyHead;
+    block.size = count;
+    size_t position = historyHead % history.size();
+    size_t first = std::min(count, history.size() - position);
+    std::memcpy(history.data() + position, buffer, first * sizeof(float));
+    std::memcpy(history.data(), buffer + first, (count - first) * sizeof(float));
+    historyHead += count;
+}
+
+
+size_t DeviceSlot::recall(size_t count)
+{
+    // Latest blocks are walked back and fill migrated from its end
+    count = std::min(count, history.size());
+    migrated.resize(count);
+    size_t gathered = 0;
+    size_t blocks = static_cast<size_t>(std::min<uint64_t>(historyBlocksHead, historyBlocks.size()));
+    for (size_t i = 1; (i <= blocks) && (gathered < count); i++)
+    {
+        const HistoryBlock &block = historyBlocks[(historyBlocksHead - i) % historyBlocks.size()];
+        size_t taken = std::min(block.size, count - gathered);
+        float *target = migrated.data() + count - gathered - taken;
+        if (block.data)
+            std::memcpy(target, block.data + block.size - taken, taken * sizeof(float));
+        else
+        {
+            // Copied audio may already be overwritten by newer audio
+            if (block.position + history.size() < historyHead)
+                break;
+            size_t start = (block.position + block.size - taken) % history.size();
+            size_t first = std::min(taken, history.size() - start);
+            std::memcpy(target, history.data() + start, first * sizeof(float));
+            std::memcpy(target + first, history.data(), (taken - first) * sizeof(float));
+        }
+        gathered += taken;
+    }
+
+    // Only audio right before end is usable
+    if (gathered < count)
+        migrated.erase(migrated.begin(), migrated.begin() + (count - gathered));
+    return gathered;
+}
+
+
+void DeviceSlot::close(bool inBackground)
+{
+    // Destroying stream waits for device, so audio thread only silences streams and leaves them to workers
+    abandon(inBackground);
+    if (current)
+    {
+        current->clear();
+        deleteStream(current, inBackground);
+        current = nullptr;
+        currentRequest.reset();
+    }
+    for (RetiringStream &stream : retiring)
+    {
+        stream.stream->clear();
+        deleteStream(stream.stream, inBackground);
+    }
+    retiring.clear();
+    historyHead = 0;
+    historyBlocksHead = 0;
+    for (HistoryBlock &block : historyBlocks)
+        block.owner.reset();
+}
+
+
+bool DeviceSlot::isSameRequest(const OpenRequest &a, const OpenRequest &b)
+{
+    if ((a.device != b.device) || (a.isNative != b.isNative))
+        return false;
+    return a.isNative || isSameFormat(a.format, b.format);
+}
+
+
+void DeviceSlot::openStream(std::shared_ptr<OpenRequest> request)
+{
+    TraceSpan span("device open");
+
+    const SDL_AudioSpec *format = request->isNative ? nullptr : &request->format;
+    try
+    {
+        request->stream = createStream(request->device, format);
+        request->openedDevice = request->device;
+    }
+    catch(const std::exception& e)
+    {
+        request->error = e.what();
+
+        // Unplugged or broken device is replaced by default one
+        SDL_AudioDeviceID fallback = SDL_IsAudioDevicePlayback(request->device) ? SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK
+                                                                                 : SDL_AUDIO_DEVICE_DEFAULT_RECORDING;
+        if (fallback != request->device)
+        {
+            try
+            {
+                request->stream = createStream(fallback, format);
+                request->openedDevice = fallback;
+            }
+            catch(const std::exception&)
+            {
+            }
+        }
+    }
+
+    // Nobody is going to take stream
+    if (request->state.exchange(DONE) == ABANDONED)
+    {
+        delete request->stream;
+        request->stream = nullptr;
+    }
+}
+
+
+void DeviceSlot::abandon(bool inBackground)
+{
+    if (!pending)
+        return;
+
+    // Job that has already finished leaves its stream to us
+    if ((pending->state.exchange(ABANDONED) == DONE) && pending->stream)
+        deleteStream(pending->stream, inBackground);
+    pending.reset();
+}
+
+
+void DeviceSlot::adopt(std::shared_ptr<OpenRequest> request)
+{
+    TraceSpan span("device restart");
+
+    DeviceStream *next = request->stream;
+    bool is_same_format = current && isSameFormat(current->format(), next->format());
+    if (current)
+    {
+        // Old stream plays out its fade out, or everything it has queued if audio can not be moved
+        Uint64 play_time = 0;
+        if (is_same_format && !history.empty())
+            play_time = crossfade(next);
+        else
+        {
+            current->hold();
+            current->flush();
+            play_time = static_cast<Uint64>(current->queued()) * 1000000000 / current->format().freq;
+        }
+        retiring.push_back({current, SDL_GetTicksNS() + play_time + RETIRE_DELAY});
+    }
+
+    current = next;
+    currentRequest = request;
+    current->volume(gain);
+
+    // Playback streams remember their latest audio (buffers never grow while audio flows)
+    if (!is_same_format)
+    {
+        SDL_AudioSpec format = current->format();
+        size_t size = 0;
+        if ((current->targetSize() > 0) && (format.format == SDL_AUDIO_F32))
+            size = static_cast<size_t>(HISTORY_TIME * format.freq) * format.channels;
+        history.assign(size, 0);
+        historyBlocks.assign(size > 0 ? HISTORY_BLOCK_COUNT : 0, HistoryBlock());
+        migrated.reserve(size);
+        fadeOut.reserve(size);
+        historyHead = 0;
+        historyBlocksHead = 0;
+    }
+}
+
+
+Uint64 DeviceSlot::crossfade(DeviceStream *next)
+{
+    SDL_AudioSpec format = current->format();
+    int channels = format.channels;
+
+    // Device must not pull between clearing and refilling
+    SDL_LockAudioStream(current->stream());
+
+    // Audio that current device has not played yet
+    size_t queued = static_cast<size_t>(current->queued()) * channels;
+    int unplayed = static_cast<int>(recall(queued) / channels);
+
+    // Current stream only fades out
+    int fade = std::min(unplayed, static_cast<int>(CROSSFADE_TIME * format.freq));
+    fadeOut.resize(static_cast<size_t>(fade) * channels);
+    for (int i = 0; i < fade; i++)
+    {
+        float factor = 1.0f - static_cast<float>(i) / fade;
+        for (int c = 0; c < channels; c++)
+            fadeOut[i * channels + c] = migrated[i * channels + c] * factor;
+    }
+    SDL_ClearAudioStream(current->stream());
+    if (fade > 0)
+        SDL_PutAudioStreamData(current->stream(), fadeOut.data(), fade * channels * sizeof(float));
+    SDL_UnlockAudioStream(current->stream());
+    current->flush();
+
+    // New stream fades in and continues
+    for (int i = 0; i < fade; i++)
+    {
+        float factor = static_cast<float>(i) / fade;
+        for (int c = 0; c < channels; c++)
+            migrated[i * channels + c] *= factor;
+    }
+    if (unplayed > 0)
+        next->write(migrated.data(), unplayed);
+
+    return static_cast<Uint64>(fade) * 1000000000 / format.freq;
+}
+
+
+void DeviceSlot::deleteStream(DeviceStream *stream, bool inBackground)
+{
+    // Destroying stream waits for device thread
+    if (inBackground && workers)
+        workers->retire([stream]() { delete stream; }, WorkerPool::NORMAL);
+    else
+        delete stream;
+}
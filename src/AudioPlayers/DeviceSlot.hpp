@@ -0,0 +1,240 @@
+#pragma once
+
+
+// Strings
+#include <string>
+// Containers
+#include <vector>
+// Smart pointers
+#include <memory>
+// Atomics
+#include <atomic>
+// Audio device stream
+#include <SDL/DeviceStream.hpp>
+// Background jobs
+#include <Engine/WorkerPool.hpp>
+
+
+/**
+ * Device stream of player that can be switched to another device without interrupting audio. New
+ * stream is opened in background while current one keeps playing, then audio queued in current stream
+ * is moved to new one and both are crossfaded. Used by audio thread only.
+ *
+ * Audio written through slot must be 32-bit float.
+ */
+class DeviceSlot
+{
+    /**
+     * Describes progress of background open.
+     */
+    enum RequestState
+    {
+        // Job is running.
+        OPENING,
+        // Job has finished.
+        DONE,
+        // Slot no longer wants result (job deletes stream itself if it finishes later).
+        ABANDONED
+    };
+
+    /**
+     * Stream requested from worker pool.
+     */
+    struct OpenRequest
+    {
+        // Requested device.
+        SDL_AudioDeviceID device = 0;
+        // Requested format (ignored if native).
+        SDL_AudioSpec format = {};
+        // Whether stream uses native format of device.
+        bool isNative = false;
+        // Progress.
+        std::atomic<int> state = OPENING;
+        // Opened stream (nullptr on failure).
+        DeviceStream *stream = nullptr;
+        // Device stream was actually opened on (default one if requested device failed).
+        SDL_AudioDeviceID openedDevice = 0;
+        // Error message on failure.
+        std::string error;
+    };
+
+    /**
+     * Stream fading out after switch.
+     */
+    struct RetiringStream
+    {
+        // Stream.
+        DeviceStream *stream;
+        // Time stream is deleted at in SDL nanosecond ticks.
+        Uint64 deadline;
+    };
+
+    // Closes streams in background (nullptr means streams are opened and closed in place).
+    WorkerPool *workers = nullptr;
+
+    // Stream audio is written to.
+    DeviceStream *current = nullptr;
+    // Request current stream was opened by.
+    std::shared_ptr<OpenRequest> currentRequest;
+    // Request being opened.
+    std::shared_ptr<OpenRequest> pending;
+    // Streams fading out.
+    std::vector<RetiringStream> retiring;
+    // Gain of streams.
+    float gain = 1;
+
+    /**
+     * Block of audio written to current stream.
+     */
+    struct HistoryBlock
+    {
+        // Keeps shared audio alive (nullptr if audio was copied to history).
+        std::shared_ptr<const void> owner;
+        // Shared audio (nullptr if audio was copied to history).
+        const float *data = nullptr;
+        // Position of copied audio (in samples ever copied to history).
+        uint64_t position = 0;
+        // Size (in samples of all channels).
+        size_t size = 0;
+    };
+
+    // Latest audio copied to current stream (ring).
+    std::vector<float> history;
+    // Number of samples ever copied to history.
+    uint64_t historyHead = 0;
+    // Latest blocks written to current stream, shared ones only referenced (ring).
+    std::vector<HistoryBlock> historyBlocks;
+    // Number of blocks ever written to current stream.
+    uint64_t historyBlocksHead = 0;
+    // Audio moved between streams on switch.
+    std::vector<float> migrated;
+    // Faded out copy of migrated audio.
+    std::vector<float> fadeOut;
+
+public:
+
+    /**
+     * Destructor. Closes all streams.
+     */
+    ~DeviceSlot();
+
+    /**
+     * @param workers pool that opens and closes streams (nullptr opens them in place)
+     */
+    void setWorkers(WorkerPool *workers) { this->workers = workers; }
+
+    /**
+     * Requests stream on given device. Does nothing if current stream already matches request,
+     * otherwise stream is opened in background and adopted by update().
+     *
+     * @param device audio device
+     * @param format audio format (nullptr for native rate and channels of device)
+     */
+    void open(SDL_AudioDeviceID device, const SDL_AudioSpec *format);
+
+    /**
+     * Adopts opened stream (moving queued audio to it and crossfading) and deletes faded out streams.
+     *
+     * @return whether current stream has changed
+     *
+     * @throws Runtime Error if stream could not be opened and there is no current one.
+     */
+    bool update();
+
+    /**
+     * @return current stream (nullptr until first stream is opened)
+     */
+    DeviceStream* stream() const { return current; }
+
+    /**
+     * @return whether slot has stream to write to
+     */
+    bool isOpen() const { return current != nullptr; }
+
+    /**
+     * @return device current stream is opened on (0 if there is none)
+     */
+    SDL_AudioDeviceID device() const { return currentRequest ? currentRequest->openedDevice : 0; }
+
+    /**
+     * Sets gain of current and future streams.
+     */
+    void volume(float value);
+
+    /**
+     * Writes audio data to current stream.
+     *
+     * @param buffer audio data buffer
+     * @param size size of data in samples
+     */
+    void write(const float *buffer, int size);
+
+    /**
+     * Writes immutable audio data to current stream without copying it.
+     *
+     * @param owner keeps audio data buffer alive until device has consumed it
+     * @param buffer audio data buffer
+     * @param size size of data in samples
+     */
+    void writeShared(std::shared_ptr<const void> owner, const float *buffer, int size);
+
+    /**
+     * Silences all streams right away, deletes them and forgets pending request.
+     *
+     * @param inBackground whether streams may be deleted by worker pool (only shutdown deletes them in place)
+     */
+    void close(bool inBackground = true);
+
+private:
+
+    /**
+     * @return whether request asks for same stream as given one
+     */
+    static bool isSameRequest(const OpenRequest &a, const OpenRequest &b);
+
+    /**
+     * Keeps written audio in history.
+     *
+     * @param owner keeps shared audio alive (nullptr to copy audio)
+     */
+    void remember(const float *buffer, int size, std::shared_ptr<const void> owner = nullptr);
+
+    /**
+     * Gathers latest audio from history.
+     *
+     * @param count number of samples wanted (of all channels)
+     * @return number of samples gathered into migrated (fewer if history is shorter)
+     */
+    size_t recall(size_t count);
+
+    /**
+     * Opens stream of request (job body).
+     */
+    static void openStream(std::shared_ptr<OpenRequest> request);
+
+    /**
+     * Gives up pending request.
+     *
+     * @param inBackground whether stream that was already opened may be deleted in background
+     */
+    void abandon(bool inBackground);
+
+    /**
+     * Makes opened stream current.
+     */
+    void adopt(std::shared_ptr<OpenRequest> request);
+
+    /**
+     * Moves audio queued in current stream to given one, fading current stream out and given one in.
+     *
+     * @return duration of fade out in nanoseconds
+     */
+    Uint64 crossfade(DeviceStream *next);
+
+    /**
+     * Deletes stream.
+     *
+     * @param inBackground whether stream may be deleted by worker pool
+     */
+    void deleteStream(DeviceStream *stream, bool inBackground);
+};
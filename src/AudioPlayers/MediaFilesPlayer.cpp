@@ -1,15 +1,82 @@
 #include <AudioPlayers/MediaFilesPlayer.hpp>
 
 
-MediaFilesPlayer::MediaFilesPlayer(QTabWidget const *devices) : AudioPlayer(devices) {}
+// Min/max
+#include <algorithm>
+// Square root
+#include <cmath>
+// Exceptions
+#include <stdexcept>
+// Worker pool
+#include <Engine/WorkerPool.hpp>
+
+
+// Fade out into last audible sample (seconds)
+#define AUDIBLE_FADE_OUT_TIME 0.01
+// Audio served from memory is written in parts of this size (frames)
+#define MEMORY_WRITE_FRAMES 1024
+// Pi
+#define PI 3.14159265358979323846
+// Old track fades out over start of track that replaces it (seconds)
+#define SWAP_CROSSFADE_TIME 0.1
+// Old track is decoded this far ahead of player cycle for its fade out, covers time until swap (seconds)
+#define SWAP_TAIL_LEAD 0.25
+// Streams move to new normalization gain over this time, long against their queue so queued audio barely
+// drifts in level (seconds)
+#define CLIP_GAIN_RAMP_TIME 0.5
+// Written audio is scaled in parts of this size (samples of all channels)
+#define SCALED_AUDIO_SIZE 4096
+
+
+/**
+ * Measures levels of interleaved audio.
+ */
+static void measureLevels(const float *data, size_t count, float &peak, float &rms)
+{
+    float max = 0;
+    float sum = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        max = std::max(max, std::fabs(data[i]));
+        sum += data[i] * data[i];
+    }
+    peak = max;
+    rms = (count > 0) ? std::sqrt(sum / count) : 0;
+}
 
 
 MediaFilesPlayer::~MediaFilesPlayer()
 {
+    delete incomingTrack.exchange(nullptr);
+    delete incomingTail.exchange(nullptr);
     delete track;
 }
 
 
+void MediaFilesPlayer::setStateCallback(StateCallback callback)
+{
+    stateCallback = callback;
+}
+
+
+void MediaFilesPlayer::setDurationCallback(TimeCallback callback)
+{
+    durationCallback = callback;
+}
+
+
+void MediaFilesPlayer::setLatencyCallback(TimeCallback callback)
+{
+    latencyCallback = callback;
+}
+
+
+void MediaFilesPlayer::setTrackCallback(TrackCallback callback)
+{
+    trackCallback = callback;
+}
+
+
 void MediaFilesPlayer::setState(State state)
 {
     if (track)
@@ -18,11 +85,19 @@ void MediaFilesPlayer::setState(State state)
         if (((this->state == PLAYING) || (this->state == PAUSED)) && (state == STOPPED))
         {
             track->close();
+            isWrapPending = false;
+            isLooping = false;
+            isPlayingHead = false;
+            fadeOut.clear();
+            fadePosition = 0;
+            decodedEnd = -1;
         }
-        // Start track if was stopped
+        // Start track if was stopped (at in point or first audible sample)
         if ((this->state == STOPPED) && ((state == PLAYING) || (state == PAUSED)))
         {
             track->init();
+            updateBounds();
+            startAt(playStart);
         }
 
         // Update state
@@ -30,93 +105,155 @@ void MediaFilesPlayer::setState(State state)
         scheduledState = state;
 
         // Notify
-        emit signalState(this->state);
+        signalState(this->state);
     }
 }
 
 
-void MediaFilesPlayer::run()
+bool MediaFilesPlayer::prepare()
 {
     // No track ==>> no playing
     if (track == nullptr)
-        return;
+        return false;
 
     try
     {
-        // Start playing track
-        setState(PLAYING);
+        // Track offered while player was not running replaces current one
+        adoptIncomingTrack();
+
+        // Start playing track (unless it was stopped before player cycle started)
+        setState(scheduledState);
 
         // Audio stream format
-        SDL_AudioSpec format;
         format.format = SDL_AUDIO_F32;
         format.channels = track->getChannelCount();
         format.freq = track->getSampleRate();
 
-        // Player cycle
-        while (state != STOPPED)
+        // Scaling never allocates while audio flows
+        scaledAudio.resize(SCALED_AUDIO_SIZE);
+    }
+    catch(const std::exception& e)
+    {
+        // Error: update track state and notify
+        setState(STOPPED);
+        signalError(e.what());
+    }
+
+    return state != STOPPED;
+}
+
+
+AudioPlayer::CycleResult MediaFilesPlayer::process()
+{
+    CycleResult result = IDLE;
+
+    try
+    {
+        // Request streams on routed devices (opened in background)
+        if (mustUpdateDevices)
         {
-            // Update audio streams if needed
-            if (mustUpdateDevices)
-            {
-                audioVCableSink = restartAudioStream(&audioVCableSink, (DeviceTab*)devices->widget(1), format);
-                audioVCableSink->volume(volume);
-                audioSink = restartAudioStream(&audioSink, (DeviceTab*)devices->widget(2), format);
-                audioSink->volume(volume);
-                mustUpdateDevices = false;
-            }
+            sinksVolume = volume * sinksClipGain;
+            openSinks(&format);
+            result = BUSY;
+        }
 
-            // Set scheduled state
-            if (state != scheduledState)
-            {
-                setState(scheduledState);
-            }
+        // Switch to opened streams
+        if (updateSinks())
+            result = BUSY;
+
+        // Nothing to write to yet
+        if (!isSinksOpen())
+            return result;
+
+        // Set scheduled state
+        if (state != scheduledState)
+        {
+            setState(scheduledState);
+            holdSinks();
+            result = BUSY;
+        }
+
+        // Track offered in background replaces current one
+        if ((state != STOPPED) && (incomingTrack.load() != nullptr))
+        {
+            swapTrack(incomingTrack.exchange(nullptr));
+            result = BUSY;
+        }
+
+        // Audio of new format waits for its streams
+        if (isFormatPending)
+        {
+            if (!isSinksFormat(format))
+                return result;
+            isFormatPending = false;
+        }
+
+        // Set scheduled timestamp
+        if (scheduledTime >= 0)
+        {
+            // Rewinding lands on in point or first audible sample, decoder takes over from loop buffer
+            int64_t sample = std::max(static_cast<int64_t>(std::llround(scheduledTime * format.freq)), playStart);
+            isWrapPending = false;
+            isLooping = false;
+            startAt(sample);
+            publishStatus(static_cast<double>(sample) / format.freq, 0, 0, 0);
+            scheduledTime = -1;
+            stats.seeks++;
+            shouldReadSamples = true;
+            holdSinks();
+            result = BUSY;
+        }
+
+        if (state == PLAYING)
+        {
+            // Prefetched start and loop are played from memory
+            if (isPlayingHead)
+                return (playHead() == BUSY) ? BUSY : result;
+            if (isLooping)
+                return (playLoop() == BUSY) ? BUSY : result;
 
-            // Set scheduled timestamp
-            if (scheduledTime >= 0)
+            // Read samples
+            if (shouldReadSamples)
             {
-                track->setTime(scheduledTime);
-                scheduledTime = -1;
-                shouldReadSamples = true;
+                readSamples();
+                result = BUSY;
             }
 
-            if (state == PLAYING)
+            // If sample count is positive
+            if (playedSamples > 0)
             {
-                // Read samples
-                if (shouldReadSamples)
+                // Write data if enough space is available
+                if (isSinksReadyForWrite())
                 {
-                    track->read();
-                    emit signalTime(track->getTime());
-                    shouldReadSamples = false;
-                }
+                    mixFadeOut(reinterpret_cast<float*>(track->getAudioData()[0]), playedSamples);
+                    writeAudio(reinterpret_cast<const float*>(track->getAudioData()[0]), playedSamples,
+                               track->getTime() + static_cast<double>(playedSamples) / format.freq);
+                    shouldReadSamples = true;
+                    result = BUSY;
 
-                // If sample count is positive
-                if (track->getAudioDataSamplesCount() > 0)
-                {
-                    // Write data if enough space is available
-                    if (audioVCableSink->isReadyForWrite(track->getAudioDataSamplesCount())
-                        && audioSink->isReadyForWrite(track->getAudioDataSamplesCount()))
+                    // Loop buffer continues right after written audio
+                    if (isWrapPending)
                     {
-                        audioVCableSink->write(track->getAudioData()[0], track->getAudioDataSamplesCount());
-                        audioSink->write(track->getAudioData()[0], track->getAudioDataSamplesCount());
-                        shouldReadSamples = true;
+                        isWrapPending = false;
+                        isLooping = true;
+                        loopPosition = 0;
                     }
                 }
-                else
+            }
+            else
+            {
+                // Flush for correct audio ending
+                if (shouldFlush)
                 {
-                    // Flush for correct audio ending
-                    if (shouldFlush)
-                    {
-                        audioVCableSink->flush();
-                        audioSink->flush();
-                        shouldFlush = false;
-                    }
+                    flushSinks();
+                    shouldFlush = false;
+                }
 
-                    // If all previous data was consumed by all streams
-                    if (audioVCableSink->isEmpty() && audioSink->isEmpty())
-                    {
-                        // Set state to stopped
-                        setState(STOPPED);
-                    }
+                // If all previous data was consumed by all streams
+                if (isSinksEmpty())
+                {
+                    // Set state to stopped
+                    setState(STOPPED);
                 }
             }
         }
@@ -125,22 +262,27 @@ void MediaFilesPlayer::run()
     {
         // Error: update track state and notify
         setState(STOPPED);
-        emit signalError(e.what());
+        signalError(e.what());
     }
 
+    return (state == STOPPED) ? FINISHED : result;
+}
+
+
+void MediaFilesPlayer::finish()
+{
     // Update track timestamp
-    emit signalTime(0);
+    publishStatus(0, 0, 0, 0);
 
     // Stop streams
-    stopAudioStream(&audioVCableSink);
-    stopAudioStream(&audioSink);
+    closeSinks();
     
     // Reset player
     reset();
 }
 
 
-void MediaFilesPlayer::setTrack(QString filepath)
+void MediaFilesPlayer::setTrack(const std::string &filepath)
 {
     // Flush old track
     removeTrack();
@@ -148,28 +290,77 @@ void MediaFilesPlayer::setTrack(QString filepath)
     // Try to open media file
     try
     {
+        // Loop and start of previous track are no longer needed
+        loop.reset();
+        loopWrap = -1;
+        isWrapPending = false;
+        isLooping = false;
+        head.reset();
+        isPlayingHead = false;
+
         // Create new track context
-        track = new AudioTrackContext(filepath.toStdString());
+        track = new AudioTrackContext(filepath);
+        hasTrack = true;
+        this->filepath = filepath;
+        signalTrack(filepath);
 
         // Update time slider
-        emit signalTime(track->getTime());
-        emit signalDuration(track->getDuration());
+        duration = track->getDuration();
+        publishStatus(track->getTime(), 0, 0, 0);
+        signalDuration(duration);
     }
     catch(const std::exception& e)
     {
         // Error: clear track and notify
         removeTrack();
-        emit signalError(e.what());
+        signalError(e.what());
     }
 }
 
 
+bool MediaFilesPlayer::offerTrack(const std::string &filepath)
+{
+    AudioTrackContext *incoming = new AudioTrackContext(filepath);
+    double seconds;
+    try
+    {
+        seconds = incoming->getDuration();
+        incoming->init();
+    }
+    catch(const std::exception& e)
+    {
+        // Current track keeps playing
+        delete incoming;
+        signalError(e.what());
+        return false;
+    }
+
+    // Rest of playing track is decoded here too, track that was offered earlier and not taken yet is dropped
+    delete incomingTail.exchange(renderSwapTail());
+    delete incomingTrack.exchange(incoming);
+    this->filepath = filepath;
+    signalTrack(filepath);
+    duration = seconds;
+    signalDuration(duration);
+    return true;
+}
+
+
 void MediaFilesPlayer::removeTrack()
 {
+    // Offered track goes too
+    delete incomingTrack.exchange(nullptr);
+    delete incomingTail.exchange(nullptr);
+
     if (track)
     {
+        hasTrack = false;
         delete track;
         track = nullptr;
+        filepath.clear();
+        duration = 0;
+        publishStatus(0, 0, 0, 0);
+        signalTrack("");
     }
 }
 
@@ -178,20 +369,672 @@ void MediaFilesPlayer::setVolume(float volume)
 {
     this->volume = volume;
     // Update volume in all opened audio streams
-    if (audioVCableSink)
-        audioVCableSink->volume(volume);
-    if (audioSink)
-       audioSink->volume(volume);
+    setSinksVolume(volume * sinksClipGain);
+}
+
+
+void MediaFilesPlayer::setClip(float gain, int64_t start, int64_t end)
+{
+    clipGain = gain;
+    clipStart = start;
+    clipEnd = end;
+}
+
+
+void MediaFilesPlayer::setRegion(const Region &region)
+{
+    regionIn = region.in;
+    regionOut = region.out;
+    regionLoopStart = region.loopStart;
+    regionLoopEnd = region.loopEnd;
+    regionCrossfade = region.crossfade;
+}
+
+
+void MediaFilesPlayer::setHead(std::shared_ptr<const CachedClip> head)
+{
+    std::lock_guard<std::mutex> lock(headMutex);
+    offeredHead = std::move(head);
 }
 
+
 void MediaFilesPlayer::scheduleState(State state)
 {
-    if (track)
+    if (hasTrack)
         scheduledState = state;
 }
 
 void MediaFilesPlayer::scheduleTime(double seconds)
 {
-    if (track)
+    if (hasTrack)
+    {
+        seekTicks = SDL_GetTicksNS();
         scheduledTime = seconds;
-}
\ No newline at end of file
+    }
+}
+
+
+void MediaFilesPlayer::markTrigger()
+{
+    triggerTicks = SDL_GetTicksNS();
+    takeOverClip();
+
+    // Stopped track gets its bounds once it is opened
+    if (state != STOPPED)
+        updateBounds();
+}
+
+
+void MediaFilesPlayer::takeOverClip()
+{
+    // Normalization, audible part and region follow track being triggered
+    appliedClipStart = clipStart;
+    appliedClipEnd = clipEnd;
+    appliedClipGain = clipGain;
+    // Streams with queued audio keep its gain (see writeAudio)
+    scaledSamples = 0;
+    sinksClipGainStep = 0;
+    if ((sinksClipGain != appliedClipGain) && (queuedInSinks() == 0))
+    {
+        sinksClipGain = appliedClipGain;
+        setSinksVolume(volume * sinksClipGain);
+    }
+    appliedRegion.in = regionIn;
+    appliedRegion.out = regionOut;
+    appliedRegion.loopStart = regionLoopStart;
+    appliedRegion.loopEnd = regionLoopEnd;
+    appliedRegion.crossfade = regionCrossfade;
+
+    // Head that is being offered right now is taken next time
+    if (headMutex.try_lock())
+    {
+        head = offeredHead;
+        headMutex.unlock();
+    }
+}
+
+
+void MediaFilesPlayer::adoptIncomingTrack()
+{
+    delete incomingTail.exchange(nullptr);
+    AudioTrackContext *incoming = incomingTrack.exchange(nullptr);
+    if (!incoming)
+        return;
+
+    // Track is opened again by player cycle
+    incoming->close();
+    delete track;
+    track = incoming;
+    loop.reset();
+    loopWrap = -1;
+}
+
+
+void MediaFilesPlayer::swapTrack(AudioTrackContext *incoming)
+{
+    if (!incoming)
+        return;
+
+    // Old track fades out only into audio of same format
+    int channels = incoming->getChannelCount();
+    int rate = incoming->getSampleRate();
+    bool is_same_format = (channels == format.channels) && (rate == format.freq);
+    fadeOut.clear();
+    fadePosition = 0;
+    SwapTail *tail = incomingTail.exchange(nullptr);
+    if ((state == PLAYING) && is_same_format)
+        renderFadeOut(std::llround(SWAP_CROSSFADE_TIME * rate), tail);
+    if (tail && workers)
+        workers->retire([tail]() { delete tail; });
+    else
+        delete tail;
+
+    retireTrack(track);
+    track = incoming;
+    loop.reset();
+    loopWrap = -1;
+    isWrapPending = false;
+    isLooping = false;
+    isPlayingHead = false;
+    scheduledTime = -1;
+    decodedEnd = -1;
+
+    // New track starts at its in point with its own normalization (fade out keeps level of old track)
+    float old_gain = appliedClipGain;
+    takeOverClip();
+    updateBounds();
+    if (playStart > 0)
+        track->setSample(playStart);
+    for (float &sample : fadeOut)
+        sample *= old_gain / appliedClipGain;
+    publishStatus(static_cast<double>(playStart) / rate, 0, 0, 0);
+    shouldReadSamples = true;
+    shouldFlush = true;
+
+    // Other format needs new streams (old ones play out what they have)
+    if (!is_same_format)
+    {
+        format.channels = channels;
+        format.freq = rate;
+        mustUpdateDevices = true;
+        isFormatPending = true;
+    }
+}
+
+
+MediaFilesPlayer::SwapTail* MediaFilesPlayer::renderSwapTail()
+{
+    // Tail starts where player cycle has decoded to (it is a few milliseconds ahead of swap)
+    int64_t start = decodedEnd;
+    if ((state != PLAYING) || (start < 0) || filepath.empty())
+        return nullptr;
+
+    SwapTail *tail = new SwapTail();
+    try
+    {
+        AudioTrackContext playing(filepath);
+        playing.init();
+        tail->filepath = filepath;
+        tail->start = start;
+        tail->channels = playing.getChannelCount();
+        tail->sampleRate = playing.getSampleRate();
+
+        size_t count = static_cast<size_t>(std::llround((SWAP_TAIL_LEAD + SWAP_CROSSFADE_TIME) * tail->sampleRate)) *
+                       tail->channels;
+        tail->samples.reserve(count);
+        playing.setSample(start);
+        while (tail->samples.size() < count)
+        {
+            playing.read();
+            int samples = playing.getAudioDataSamplesCount();
+            if (samples <= 0)
+                break;
+            const float *data = reinterpret_cast<const float*>(playing.getAudioData()[0]);
+            size_t size = std::min(count - tail->samples.size(), static_cast<size_t>(samples) * tail->channels);
+            tail->samples.insert(tail->samples.end(), data, data + size);
+        }
+    }
+    catch(const std::exception&)
+    {
+        // Old track is cut off instead of fading out
+        delete tail;
+        return nullptr;
+    }
+    return tail;
+}
+
+
+void MediaFilesPlayer::renderFadeOut(int64_t frames, const SwapTail *tail)
+{
+    int channels = format.channels;
+    fadeOut.reserve(frames * channels);
+    auto append = [&](const float *data, int64_t count)
+    {
+        count = std::min<int64_t>(count, frames - static_cast<int64_t>(fadeOut.size()) / channels);
+        fadeOut.insert(fadeOut.end(), data, data + count * channels);
+        return count;
+    };
+
+    // Rest of prefetched start goes first, audio that was decoded and not written yet follows it
+    if (isPlayingHead)
+        append(head->samples.data() + headPosition * channels, head->getFrameCount() - headPosition);
+    if (!isLooping && !shouldReadSamples && (playedSamples > 0))
+        append(reinterpret_cast<const float*>(track->getAudioData()[0]), playedSamples);
+
+    // Decoder is continued by tail (up to loop wrap or end of playback)
+    int64_t next = decodedEnd;
+    if (!isLooping && !isWrapPending && tail && (next >= tail->start) && (tail->filepath == track->getFilepath()) &&
+        (tail->channels == channels) && (tail->sampleRate == format.freq))
+    {
+        int64_t end = tail->start + static_cast<int64_t>(tail->samples.size()) / channels;
+        if (playEnd >= 0)
+            end = std::min(end, playEnd);
+        if ((loopWrap >= 0) && (next < loopWrap) && (loopWrap <= end))
+        {
+            end = loopWrap;
+            isWrapPending = true;
+        }
+        int64_t count = (end > next) ? append(tail->samples.data() + (next - tail->start) * channels, end - next) : 0;
+
+        // Gain falls linearly to zero at end of playback (as in trimToBounds)
+        if ((playEnd >= 0) && (next + count == playEnd))
+        {
+            float *data = fadeOut.data() + fadeOut.size() - count * channels;
+            int64_t fade_frames = std::max<int64_t>(1, std::llround(AUDIBLE_FADE_OUT_TIME * format.freq));
+            for (int64_t frame = std::max<int64_t>(0, count - fade_frames); frame < count; frame++)
+            {
+                float gain = static_cast<float>(count - frame) / fade_frames;
+                for (int channel = 0; channel < channels; channel++)
+                    data[frame * channels + channel] *= gain;
+            }
+        }
+    }
+
+    // Loop continues from memory if it is ready
+    if (isWrapPending)
+    {
+        isLooping = true;
+        loopPosition = 0;
+    }
+    if (isLooping && loop && (loop->state == LOOP_READY))
+    {
+        int64_t loop_frames = static_cast<int64_t>(loop->samples.size()) / channels;
+        while (static_cast<int64_t>(fadeOut.size()) < frames * channels)
+        {
+            int64_t count = loop_frames - loopPosition;
+            append(loop->samples.data() + loopPosition * channels, count);
+            loopPosition = (loopPosition + count) % loop_frames;
+        }
+    }
+
+    // Gain falls linearly to zero (track that ended sooner is followed by silence)
+    int64_t count = static_cast<int64_t>(fadeOut.size()) / channels;
+    fadeOut.resize(frames * channels, 0);
+    for (int64_t frame = 0; frame < count; frame++)
+    {
+        float gain = 1.0f - static_cast<float>(frame) / frames;
+        for (int channel = 0; channel < channels; channel++)
+            fadeOut[frame * channels + channel] *= gain;
+    }
+}
+
+
+void MediaFilesPlayer::mixFadeOut(float *data, int samples)
+{
+    int channels = format.channels;
+    size_t frames = fadeOut.size() / channels;
+    if (fadePosition >= frames)
+        return;
+
+    // New track fades in while old one fades out
+    size_t count = std::min(frames - fadePosition, static_cast<size_t>(samples));
+    for (size_t frame = 0; frame < count; frame++)
+    {
+        float gain = static_cast<float>(fadePosition + frame) / frames;
+        for (int channel = 0; channel < channels; channel++)
+            data[frame * channels + channel] = data[frame * channels + channel] * gain +
+                                               fadeOut[(fadePosition + frame) * channels + channel];
+    }
+    fadePosition += count;
+}
+
+
+void MediaFilesPlayer::retireTrack(AudioTrackContext *retired)
+{
+    if (workers)
+        workers->retire([retired]() { delete retired; });
+    else
+        delete retired;
+}
+
+
+void MediaFilesPlayer::updateBounds()
+{
+    int rate = track->getSampleRate();
+    playStart = (appliedRegion.in >= 0) ? std::llround(appliedRegion.in * rate) : appliedClipStart;
+    playEnd = (appliedRegion.out >= 0) ? std::llround(appliedRegion.out * rate) : appliedClipEnd;
+
+    // Loop ends no later than playback
+    int64_t start = std::llround(appliedRegion.loopStart * rate);
+    int64_t end = std::llround(appliedRegion.loopEnd * rate);
+    if (playEnd >= 0)
+        end = std::min(end, playEnd);
+    // Engine refuses longer loops, so memory of loop buffer stays bounded
+    if (!appliedRegion.hasLoop() || (end <= start) || (end - start > static_cast<int64_t>(MAX_LOOP_TIME) * rate))
+    {
+        loop.reset();
+        loopWrap = -1;
+        isWrapPending = false;
+        isLooping = false;
+        return;
+    }
+
+    // Decoder hands over to loop buffer where crossfade begins
+    int64_t crossfade = std::clamp<int64_t>(std::llround(appliedRegion.crossfade * rate), 0, (end - start) / 2);
+    loopWrap = end - crossfade;
+    if (loop && (loop->filepath == track->getFilepath()) && (loop->start == start) && (loop->end == end) &&
+        (loop->crossfade == crossfade))
+        return;
+
+    // Loop being played was changed, decoder continues from new loop start
+    if (isLooping)
+    {
+        track->setSample(start);
+        isLooping = false;
+        shouldReadSamples = true;
+        decodedEnd = -1;
+    }
+    isWrapPending = false;
+
+    // Decode new loop in background
+    std::shared_ptr<LoopBuffer> request = std::make_shared<LoopBuffer>();
+    request->filepath = track->getFilepath();
+    request->start = start;
+    request->end = end;
+    request->crossfade = crossfade;
+    request->channels = track->getChannelCount();
+    loop = request;
+    if (workers)
+        workers->submit([request]() { decodeLoop(request); });
+    else
+        decodeLoop(request);
+}
+
+
+void MediaFilesPlayer::decodeLoop(std::shared_ptr<LoopBuffer> loop)
+{
+    try
+    {
+        AudioTrackContext track(loop->filepath);
+        track.init();
+        if (track.getChannelCount() != loop->channels)
+            throw std::runtime_error("Unable to decode loop: track has changed");
+
+        // Decode loop region exactly
+        int channels = loop->channels;
+        loop->samples.reserve(static_cast<size_t>(loop->end - loop->start) * channels);
+        track.setSample(loop->start);
+        while (true)
+        {
+            track.read();
+            int64_t count = std::min<int64_t>(track.getAudioDataSamplesCount(), loop->end - track.getSamplePosition());
+            if (count <= 0)
+                break;
+            const float *data = reinterpret_cast<const float*>(track.getAudioData()[0]);
+            loop->samples.insert(loop->samples.end(), data, data + count * channels);
+        }
+
+        // Tail fades out over head with equal power, then it is dropped, so buffer repeats without seam
+        int64_t frames = loop->samples.size() / channels;
+        int64_t crossfade = std::min(loop->crossfade, frames / 2);
+        float *head = loop->samples.data();
+        const float *tail = head + (frames - crossfade) * channels;
+        for (int64_t frame = 0; frame < crossfade; frame++)
+        {
+            double phase = (frame + 0.5) / crossfade * PI / 2;
+            float fade_in = static_cast<float>(std::sin(phase));
+            float fade_out = static_cast<float>(std::cos(phase));
+            for (int channel = 0; channel < channels; channel++)
+                head[frame * channels + channel] = head[frame * channels + channel] * fade_in +
+                                                   tail[frame * channels + channel] * fade_out;
+        }
+        loop->samples.resize((frames - crossfade) * channels);
+        if (loop->samples.empty())
+            throw std::runtime_error("Unable to decode loop: region is empty");
+
+        loop->state = LOOP_READY;
+    }
+    catch(const std::exception& e)
+    {
+        loop->error = e.what();
+        loop->state = LOOP_FAILED;
+    }
+}
+
+
+void MediaFilesPlayer::measureTriggerLatency(int queued, int sampleRate)
+{
+    // Only first write after request is measured
+    Uint64 ticks = triggerTicks.exchange(0);
+    if (ticks == 0)
+        return;
+
+    // Time spent before audio reached device plus time of audio queued ahead of it
+    triggerLatency = (SDL_GetTicksNS() - ticks) / 1e9 + static_cast<double>(queued) / sampleRate;
+    signalLatency(triggerLatency);
+}
+
+
+void MediaFilesPlayer::measureSeekLatency()
+{
+    Uint64 ticks = seekTicks.exchange(0);
+    if (ticks != 0)
+        stats.seekLatency.record(SDL_GetTicksNS() - ticks);
+}
+
+
+void MediaFilesPlayer::readSamples()
+{
+    Uint64 decode_start = SDL_GetTicksNS();
+    track->read();
+    stats.decodeTime.record(SDL_GetTicksNS() - decode_start);
+    stats.framesDecoded += track->getAudioDataSamplesCount();
+    playedSamples = trimToBounds();
+    shouldReadSamples = false;
+    decodedEnd = (playedSamples > 0) ? track->getSamplePosition() + playedSamples : -1;
+}
+
+
+int MediaFilesPlayer::trimToBounds()
+{
+    int samples = track->getAudioDataSamplesCount();
+    if (samples <= 0)
+        return samples;
+    int64_t position = track->getSamplePosition();
+
+    // Audio up to loop wrap is played as is, loop buffer continues it
+    if ((loopWrap >= 0) && (position < loopWrap) && (position + samples >= loopWrap))
+    {
+        isWrapPending = true;
+        return static_cast<int>(loopWrap - position);
+    }
+
+    if (playEnd < 0)
+        return samples;
+    samples = static_cast<int>(std::clamp<int64_t>(playEnd - position, 0, samples));
+
+    // Gain falls linearly to zero at end
+    int64_t fade_frames = std::max<int64_t>(1, std::llround(AUDIBLE_FADE_OUT_TIME * format.freq));
+    float *data = reinterpret_cast<float*>(track->getAudioData()[0]);
+    for (int64_t frame = std::max<int64_t>(0, playEnd - fade_frames - position); frame < samples; frame++)
+    {
+        float gain = static_cast<float>(playEnd - position - frame) / fade_frames;
+        for (int channel = 0; channel < format.channels; channel++)
+            data[frame * format.channels + channel] *= gain;
+    }
+    return samples;
+}
+
+
+void MediaFilesPlayer::writeAudio(const float *data, int samples, double time, std::shared_ptr<const void> owner)
+{
+    int queued = queuedInSinks();
+    measureTriggerLatency(queued, format.freq);
+    measureSeekLatency();
+
+    // Changing gain of streams would change audio they have queued too, so empty streams switch at once
+    if ((sinksClipGain != appliedClipGain) && (queued == 0))
+    {
+        sinksClipGain = appliedClipGain;
+        setSinksVolume(volume * sinksClipGain);
+    }
+    // Once audio written with old gain has played, streams ramp to new gain at block boundaries
+    else if ((sinksClipGain != appliedClipGain) && (queued <= scaledSamples))
+    {
+        if (sinksClipGainStep == 0)
+            sinksClipGainStep = (appliedClipGain - sinksClipGain) / static_cast<float>(CLIP_GAIN_RAMP_TIME * format.freq);
+        float gain = sinksClipGain + sinksClipGainStep * samples;
+        bool is_reached = (sinksClipGainStep > 0) ? (gain >= appliedClipGain) : (gain <= appliedClipGain);
+        sinksClipGain = is_reached ? appliedClipGain : gain;
+        setSinksVolume(volume * sinksClipGain);
+    }
+
+    if (sinksClipGain != appliedClipGain)
+    {
+        // Until then audio carries the difference itself
+        float ratio = appliedClipGain / sinksClipGain;
+        int part_frames = SCALED_AUDIO_SIZE / format.channels;
+        for (int written = 0; written < samples; written += part_frames)
+        {
+            int frames = std::min(part_frames, samples - written);
+            const float *part = data + static_cast<size_t>(written) * format.channels;
+            size_t count = static_cast<size_t>(frames) * format.channels;
+            for (size_t i = 0; i < count; i++)
+                scaledAudio[i] = part[i] * ratio;
+            writeSinks(scaledAudio.data(), frames);
+        }
+        scaledSamples += samples;
+    }
+    else
+    {
+        // Audio held in memory is queued by reference
+        writeSinks(data, samples, std::move(owner));
+    }
+
+    // Written audio is heard once output device plays what was queued before it
+    float peak, rms;
+    measureLevels(data, static_cast<size_t>(samples) * format.channels, peak, rms);
+    publishStatus(time, static_cast<double>(queued + samples) / format.freq, peak * volume * appliedClipGain,
+                  rms * volume * appliedClipGain);
+}
+
+
+AudioPlayer::CycleResult MediaFilesPlayer::playLoop()
+{
+    switch (loop->state.load())
+    {
+        case LOOP_DECODING:
+            // Decoding is far faster than playback, so this wait is rare and short
+            return IDLE;
+        case LOOP_FAILED:
+            // Playback ends at loop wrap (decoder is past it and seeking back would block audio thread)
+            signalError(loop->error);
+            loop.reset();
+            loopWrap = -1;
+            isLooping = false;
+            playedSamples = 0;
+            shouldReadSamples = false;
+            return BUSY;
+        default:
+            break;
+    }
+
+    if (!isSinksReadyForWrite())
+        return IDLE;
+
+    int64_t frames = static_cast<int64_t>(loop->samples.size()) / loop->channels;
+    int samples = static_cast<int>(std::min<int64_t>(MEMORY_WRITE_FRAMES, frames - loopPosition));
+    writeAudio(loop->samples.data() + loopPosition * loop->channels, samples,
+               static_cast<double>(loop->start + loopPosition + samples) / format.freq, loop);
+    loopPosition = (loopPosition + samples) % frames;
+    return BUSY;
+}
+
+
+void MediaFilesPlayer::startAt(int64_t sample)
+{
+    // Head is used only when it is whole part of playback
+    int64_t frames = head ? head->getFrameCount() : 0;
+    isPlayingHead = (frames > 0) && (head->start == sample) && (head->filepath == track->getFilepath()) &&
+                    (head->channels == track->getChannelCount()) && (head->sampleRate == track->getSampleRate()) &&
+                    ((playEnd < 0) || (sample + frames <= playEnd)) && ((loopWrap < 0) || (sample + frames <= loopWrap));
+    headPosition = 0;
+    // Cache keeps often triggered clips longer
+    if (isPlayingHead && head->triggers)
+        head->triggers->fetch_add(1, std::memory_order_relaxed);
+
+    // Decoder continues where head ends
+    track->setSample(isPlayingHead ? sample + frames : sample);
+    shouldReadSamples = true;
+    decodedEnd = -1;
+}
+
+
+AudioPlayer::CycleResult MediaFilesPlayer::playHead()
+{
+    // Decoder reaches end of head while streams are full
+    if (!isSinksReadyForWrite())
+    {
+        if (!shouldReadSamples)
+            return IDLE;
+        readSamples();
+        return BUSY;
+    }
+
+    int64_t frames = head->getFrameCount();
+    int samples = static_cast<int>(std::min<int64_t>(MEMORY_WRITE_FRAMES, frames - headPosition));
+    writeAudio(head->samples.data() + headPosition * head->channels, samples,
+               static_cast<double>(head->start + headPosition + samples) / format.freq, head);
+    headPosition += samples;
+    if (headPosition >= frames)
+        isPlayingHead = false;
+    return BUSY;
+}
+
+
+void MediaFilesPlayer::signalState(State state)
+{
+    if (stateCallback)
+        stateCallback(state);
+}
+
+
+void MediaFilesPlayer::signalDuration(double seconds)
+{
+    if (durationCallback)
+        durationCallback(seconds);
+}
+
+
+MediaFilesPlayer::Status MediaFilesPlayer::getStatus()
+{
+    double time, queued;
+    Uint64 ticks;
+    float peak, rms;
+    uint32_t sequence;
+    do
+    {
+        sequence = statusSequence.load(std::memory_order_acquire);
+        time = writtenTime.load(std::memory_order_relaxed);
+        queued = queuedTime.load(std::memory_order_relaxed);
+        ticks = writtenTicks.load(std::memory_order_relaxed);
+        peak = writtenPeak.load(std::memory_order_relaxed);
+        rms = writtenRms.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+    }
+    while ((sequence & 1) || (sequence != statusSequence.load(std::memory_order_relaxed)));
+
+    Status status;
+    status.state = getState();
+    status.position = time;
+
+    // Queued audio is being played since it was written
+    double elapsed = (SDL_GetTicksNS() - ticks) / 1e9;
+    if (elapsed < queued)
+    {
+        status.position = time - queued + elapsed;
+        status.peak = peak;
+        status.rms = rms;
+    }
+    return status;
+}
+
+
+void MediaFilesPlayer::publishStatus(double time, double queued, float peak, float rms)
+{
+    uint32_t sequence = statusSequence.load(std::memory_order_relaxed);
+    statusSequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    writtenTime.store(time, std::memory_order_relaxed);
+    queuedTime.store(queued, std::memory_order_relaxed);
+    writtenTicks.store(SDL_GetTicksNS(), std::memory_order_relaxed);
+    writtenPeak.store(peak, std::memory_order_relaxed);
+    writtenRms.store(rms, std::memory_order_relaxed);
+
+    statusSequence.store(sequence + 2, std::memory_order_release);
+}
+
+
+void MediaFilesPlayer::signalLatency(double seconds)
+{
+    if (latencyCallback)
+        latencyCallback(seconds);
+}
+
+
+void MediaFilesPlayer::signalTrack(const std::string &filepath)
+{
+    if (trackCallback)
+        trackCallback(filepath);
+}
@@ -4,7 +4,16 @@
 // Audio player
 #include <AudioPlayers/AudioPlayer.hpp>
 // FFMPEG media files reader
-#include <FFMPEG/AudioTrackReader.cpp>
+#include <FFMPEG/AudioTrackReader.hpp>
+// Loop buffers
+#include <memory>
+#include <vector>
+// Prefetched starts of tracks
+#include <Engine/ClipCache.hpp>
+
+
+// Longest loop decoded into memory (seconds)
+#define MAX_LOOP_TIME 30
 
 
 /**
@@ -12,9 +21,6 @@
  */
 class  MediaFilesPlayer : public AudioPlayer
 {
-    // Mandatory for QWidget stuff to work
-    Q_OBJECT
-
 public:
 
     /**
@@ -26,41 +32,287 @@ public:
         PAUSED
     };
 
+    /**
+     * Receives new player state.
+     */
+    typedef std::function<void(State)> StateCallback;
+
+    /**
+     * Receives time value in seconds (track duration, current timestamp or latency).
+     */
+    typedef std::function<void(double)> TimeCallback;
+
+    /**
+     * Receives media file path of new track (empty if track was removed).
+     */
+    typedef std::function<void(const std::string&)> TrackCallback;
+
+    /**
+     * Playback as it is heard from output device.
+     */
+    struct Status
+    {
+        // Player state.
+        State state = STOPPED;
+        // Track timestamp being heard in seconds.
+        double position = 0;
+        // Peak level of audio being heard (0 when nothing is heard).
+        float peak = 0;
+        // RMS level of audio being heard (0 when nothing is heard).
+        float rms = 0;
+    };
+
+    /**
+     * Part of track chosen by user. Times are in seconds, negative ones are not set.
+     */
+    struct Region
+    {
+        // Playback starts here (at first audible sample if not set).
+        double in = -1;
+        // Playback ends here (at last audible sample if not set).
+        double out = -1;
+        // Once playback reaches loop end it repeats from loop start (loop is off unless both are set).
+        double loopStart = -1;
+        double loopEnd = -1;
+        // Crossfade across loop seam (0 jumps right away).
+        double crossfade = 0;
+
+        /**
+         * @return whether loop is set
+         */
+        bool hasLoop() const { return (loopStart >= 0) && (loopEnd > loopStart); }
+
+        /**
+         * @return whether nothing is set
+         */
+        bool isEmpty() const { return (in < 0) && (out < 0) && !hasLoop(); }
+    };
+
 private:
 
-    // Audio output.
-    DeviceStream *audioSink = nullptr;
+    /**
+     * Describes progress of loop decoding.
+     */
+    enum LoopState
+    {
+        // Job is running.
+        LOOP_DECODING,
+        // Samples are ready.
+        LOOP_READY,
+        // Loop could not be decoded.
+        LOOP_FAILED
+    };
 
-    // Current track.
+    /**
+     * Loop region decoded into memory by worker pool, so it repeats without seeking.
+     */
+    struct LoopBuffer
+    {
+        // Media file.
+        std::string filepath;
+        // Loop region in samples.
+        int64_t start = 0;
+        int64_t end = 0;
+        // Crossfade across seam in samples.
+        int64_t crossfade = 0;
+        // Number of channels.
+        int channels = 0;
+        // Progress.
+        std::atomic<int> state = LOOP_DECODING;
+        // Interleaved samples played in circle (tail is already crossfaded into head and dropped).
+        std::vector<float> samples;
+        // Error message on failure.
+        std::string error;
+    };
+
+    /**
+     * Continuation of playing track decoded by worker pool along with track that replaces it, so fade out
+     * of swap is not decoded by audio thread.
+     */
+    struct SwapTail
+    {
+        // Media file.
+        std::string filepath;
+        // First sample.
+        int64_t start = 0;
+        // Audio format.
+        int channels = 0;
+        int sampleRate = 0;
+        // Interleaved samples.
+        std::vector<float> samples;
+    };
+
+    // Audio stream format of current player cycle.
+    SDL_AudioSpec format;
+
+    // Current track (audio thread while player cycle runs, it may replace track).
     AudioTrackContext *track = nullptr;
+    // Whether there is current track (other threads ask this instead of reading track).
+    std::atomic<bool> hasTrack = false;
+    // Media file path of current track (kept apart from track, which audio thread may replace).
+    std::string filepath;
+    // Track opened in background to replace current one (nullptr if there is none).
+    std::atomic<AudioTrackContext*> incomingTrack = nullptr;
+    // Continuation of current track decoded along with incomingTrack (nullptr if there is none).
+    std::atomic<SwapTail*> incomingTail = nullptr;
+    // Sample that follows audio decoded by player cycle (negative until track is read after start or seek).
+    std::atomic<int64_t> decodedEnd = -1;
+    // Rest of replaced track with fade out applied, mixed into new track (audio thread).
+    std::vector<float> fadeOut;
+    // Frames of fadeOut that were mixed (audio thread).
+    size_t fadePosition = 0;
+    // Whether audio waits for streams of new track format (audio thread).
+    bool isFormatPending = false;
     // Current state.
-    State state = STOPPED;
+    std::atomic<State> state = STOPPED;
     // Requested state.
-    State scheduledState = state;
+    std::atomic<State> scheduledState = STOPPED;
 
     // Requested timestamp.
-    double scheduledTime = -1;
+    std::atomic<double> scheduledTime = -1;
+    // Current track duration in seconds.
+    std::atomic<double> duration = 0;
 
     // Audio volume.
-    float volume = 0.5;
+    std::atomic<float> volume = 0.5;
+    // Loudness normalization gain of current track (taken over when playback is requested).
+    std::atomic<float> clipGain = 1;
+    // Audible part of current track in samples (taken over when playback is requested, negative end is
+    // end of track).
+    std::atomic<int64_t> clipStart = 0;
+    std::atomic<int64_t> clipEnd = -1;
+    // Normalization gain of audio being written (audio thread).
+    float appliedClipGain = 1;
+    // Normalization gain streams are using, it lags behind appliedClipGain until audio queued with it has
+    // played (audio thread).
+    float sinksClipGain = 1;
+    // Change of sinksClipGain per sample while it ramps to appliedClipGain (audio thread).
+    float sinksClipGainStep = 0;
+    // Samples written scaled since appliedClipGain changed (audio thread).
+    int64_t scaledSamples = 0;
+    // Written audio scaled by ratio of both normalization gains (audio thread).
+    std::vector<float> scaledAudio;
+    // Audible part playback is using (audio thread).
+    int64_t appliedClipStart = 0;
+    int64_t appliedClipEnd = -1;
+    // Samples of decoded audio data that are played (audio thread).
+    int playedSamples = 0;
+
+    // Region of current track (taken over when playback is requested).
+    std::atomic<double> regionIn = -1;
+    std::atomic<double> regionOut = -1;
+    std::atomic<double> regionLoopStart = -1;
+    std::atomic<double> regionLoopEnd = -1;
+    std::atomic<double> regionCrossfade = 0;
+    // Region playback is using (audio thread).
+    Region appliedRegion;
+    // Playback bounds in samples (audio thread, negative end is end of track).
+    int64_t playStart = 0;
+    int64_t playEnd = -1;
+    // Sample decoded playback moves into loop buffer at (negative if there is no loop, audio thread).
+    int64_t loopWrap = -1;
+    // Loop region of current track (nullptr if there is none, audio thread).
+    std::shared_ptr<LoopBuffer> loop;
+    // Whether decoded audio being written ends at loop wrap (audio thread).
+    bool isWrapPending = false;
+    // Whether audio is served from loop buffer (audio thread).
+    bool isLooping = false;
+    // Position in loop buffer in frames (audio thread).
+    int64_t loopPosition = 0;
+
+    // Prefetched start of current track (nullptr if there is none).
+    std::shared_ptr<const CachedClip> offeredHead;
+    // Guards offeredHead (audio thread only tries it, so it never waits).
+    std::mutex headMutex;
+    // Prefetched start playback is using (audio thread).
+    std::shared_ptr<const CachedClip> head;
+    // Whether audio is served from head (audio thread).
+    bool isPlayingHead = false;
+    // Position in head in frames (audio thread).
+    int64_t headPosition = 0;
+
+    // Time of last playback request in nanoseconds (0 if it was already served).
+    std::atomic<Uint64> triggerTicks = 0;
+    // Last measured delay between playback request and its audio being heard in seconds.
+    std::atomic<double> triggerLatency = 0;
+    // Time of last seek request in nanoseconds (0 if it was already served).
+    std::atomic<Uint64> seekTicks = 0;
+
+    // Published playback (seqlock: odd while being written, written by one thread at a time).
+    std::atomic<uint32_t> statusSequence = 0;
+    // Track timestamp at end of latest written audio in seconds.
+    std::atomic<double> writtenTime = 0;
+    // Audio queued ahead of device after latest write in seconds.
+    std::atomic<double> queuedTime = 0;
+    // Time of latest write in SDL nanosecond ticks.
+    std::atomic<Uint64> writtenTicks = 0;
+    // Levels of latest written audio.
+    std::atomic<float> writtenPeak = 0;
+    std::atomic<float> writtenRms = 0;
+
+    // Notified about state changes.
+    StateCallback stateCallback;
+    // Notified about track duration changes.
+    TimeCallback durationCallback;
+    // Notified about measured trigger latency.
+    TimeCallback latencyCallback;
+    // Notified about track changes.
+    TrackCallback trackCallback;
 
 public:
 
-    /**
-     * Constructor.
-     * 
-     * @param devices tab widget that describes available devices
-     */
-    explicit MediaFilesPlayer(QTabWidget const *devices);
     /**
      * Destructor.
      */
     ~MediaFilesPlayer();
 
     /**
-     * @return player state
+     * @return player state (requested state if player cycle was not started yet)
+     */
+    State getState()
+    {
+        if (!hasTrack)
+            return STOPPED;
+        return (state == STOPPED) ? scheduledState.load() : state.load();
+    }
+
+    /**
+     * @return media file path of current track (empty if there is none)
      */
-    State getState() { return track == nullptr ? STOPPED : state; }
+    std::string getFilepath() { return filepath; }
+
+    /**
+     * @return current track duration in seconds
+     */
+    double getDuration() { return duration; }
+
+    /**
+     * @param callback function that will receive player state updates
+     */
+    void setStateCallback(StateCallback callback);
+    /**
+     * @param callback function that will receive track duration updates
+     */
+    void setDurationCallback(TimeCallback callback);
+    /**
+     * @param callback function that will receive trigger latency measurements
+     */
+    void setLatencyCallback(TimeCallback callback);
+    /**
+     * @param callback function that will receive track changes
+     */
+    void setTrackCallback(TrackCallback callback);
+
+    /**
+     * @return last measured delay between playback request and its audio being heard in seconds
+     */
+    double getTriggerLatency() { return triggerLatency; }
+
+    /**
+     * Reads published playback without locks (any thread). Position advances between writes and stops
+     * where written audio ends, so it follows what is heard rather than what was decoded.
+     */
+    Status getStatus();
 
 private:
     /**
@@ -70,14 +322,31 @@ private:
 public:
 
     /**
-     * Player cycle.
+     * Begins player cycle.
+     */
+    bool prepare() override;
+    /**
+     * Runs one iteration of player cycle.
+     */
+    CycleResult process() override;
+    /**
+     * Ends player cycle.
      */
-    void run();
+    void finish() override;
 
     /**
      * Sets audio track.
      */
-    void setTrack(QString filepath);
+    void setTrack(const std::string &filepath);
+
+    /**
+     * Opens audio track on caller thread and hands it to player cycle, which crossfades into it if it is
+     * playing (paused player just switches to it). Player that is not running takes it when started.
+     * Errors are reported by player.
+     *
+     * @return false if track could not be opened (current one is kept)
+     */
+    bool offerTrack(const std::string &filepath);
 
     /**
      * Removes current audio track.
@@ -90,6 +359,32 @@ public:
     void setVolume(float volume);
 
     /**
+     * Sets loudness normalization gain and audible part of current track. They are applied on next playback
+     * request, so level never jumps in the middle of playback. Playback starts at first audible sample and
+     * fades out into last one.
+     *
+     * @param start first audible sample
+     * @param end sample after last audible one (negative plays until end of track)
+     */
+    void setClip(float gain, int64_t start, int64_t end);
+
+    /**
+     * Sets region of current track chosen by user. It is applied on next playback request. Loop is decoded
+     * into memory in background, so it repeats sample-accurately without seeking.
+     */
+    void setRegion(const Region &region);
+
+    /**
+     * Sets prefetched start of current track. Playback that starts where it starts writes it right away
+     * while decoder continues after it.
+     *
+     * @param head decoded start of track (nullptr if there is none)
+     */
+    void setHead(std::shared_ptr<const CachedClip> head);
+
+    /**
+     * Schedules new state. Requesting playback of stopped player prepares it for player cycle.
+     * 
      * @param state planned player state
      */
     void scheduleState(State state);
@@ -98,8 +393,14 @@ public:
      * @param seconds time in seconds (must be < duration)
      */
     void scheduleTime(double seconds);
-    
-signals:
+
+    /**
+     * Remembers time of playback request and applies pending normalization gain and audible part. Delay until
+     * its first audio is queued will be measured.
+     */
+    void markTrigger();
+
+private:
     /**
      * Signals to update player state.
      */
@@ -109,7 +410,117 @@ signals:
      */
     void signalDuration(double seconds);
     /**
-     * Signals to update time slider.
+     * Publishes playback for getStatus().
+     *
+     * @param time track timestamp at end of written audio in seconds
+     * @param queued audio queued ahead of device (including written one) in seconds
+     * @param peak peak level of written audio
+     * @param rms RMS level of written audio
+     */
+    void publishStatus(double time, double queued, float peak, float rms);
+    /**
+     * Signals measured trigger latency.
+     */
+    void signalLatency(double seconds);
+    /**
+     * Signals track change.
+     */
+    void signalTrack(const std::string &filepath);
+
+    /**
+     * Measures trigger latency if playback was requested.
+     * 
+     * @param queued audio queued in device stream before written data in samples
+     * @param sampleRate audio sample rate
+     */
+    void measureTriggerLatency(int queued, int sampleRate);
+    /**
+     * Records delay between seek request and first write after it.
+     */
+    void measureSeekLatency();
+
+    /**
+     * Takes over normalization gain, audible part and region of current track (audio thread).
+     */
+    void takeOverClip();
+
+    /**
+     * Replaces closed track with track offered in background, closing it as well (player is not running).
+     */
+    void adoptIncomingTrack();
+
+    /**
+     * Switches running player cycle to offered track, fading out rest of current one over its start.
+     */
+    void swapTrack(AudioTrackContext *incoming);
+
+    /**
+     * Decodes continuation of playing track for fade out of swap (worker pool).
+     *
+     * @return continuation (nullptr if track is not playing or it fails to decode)
+     */
+    SwapTail* renderSwapTail();
+
+    /**
+     * Collects next frames of current track (or its loop) into fadeOut with fade out applied. Audio past
+     * what was decoded by player cycle is taken from tail, audio that tail does not cover is silence.
+     */
+    void renderFadeOut(int64_t frames, const SwapTail *tail);
+
+    /**
+     * Mixes rest of replaced track into audio that is about to be written.
+     */
+    void mixFadeOut(float *data, int samples);
+
+    /**
+     * Deletes replaced track on worker pool (closing it takes a while).
+     */
+    void retireTrack(AudioTrackContext *retired);
+
+    /**
+     * Turns taken over clip and region into sample bounds and requests loop buffer if loop has changed
+     * (track must be open).
+     */
+    void updateBounds();
+
+    /**
+     * Decodes loop region into buffer (job body).
+     */
+    static void decodeLoop(std::shared_ptr<LoopBuffer> loop);
+
+    /**
+     * Decodes next audio data and cuts it to bounds.
+     */
+    void readSamples();
+
+    /**
+     * Cuts decoded audio data at loop wrap or at end of playback, fading out its last milliseconds.
+     *
+     * @return number of samples to play
+     */
+    int trimToBounds();
+
+    /**
+     * Writes audio to every route and publishes it (scaled to normalization gain of its track if sinks still
+     * play audio of previous one).
+     *
+     * @param time track timestamp at end of written audio in seconds
+     * @param owner keeps immutable audio alive while sinks reference it (nullptr copies audio into sinks)
+     */
+    void writeAudio(const float *data, int samples, double time, std::shared_ptr<const void> owner = nullptr);
+
+    /**
+     * Writes next part of loop buffer.
+     */
+    CycleResult playLoop();
+
+    /**
+     * Serves playback from head if it starts at sample, otherwise positions decoder there.
+     */
+    void startAt(int64_t sample);
+
+    /**
+     * Writes next part of head.
      */
-    void signalTime(double seconds);
-};
\ No newline at end of file
+    CycleResult playHead();
+};
@@ -1,72 +1,131 @@
 #include <AudioPlayers/MicrophonePlayer.hpp>
 
 
-MicrophonePlayer::MicrophonePlayer(QTabWidget const* devices) : AudioPlayer(devices) {}
+// Size of microphone chunk in samples
+#define AUDIO_BUFFER_SIZE 1024
 
 
-void MicrophonePlayer::run()
+void MicrophonePlayer::setInputDevice(SDL_AudioDeviceID device)
 {
-    isRunning = true;
+    inputDevice = device;
+    mustUpdateDevices = true;
+}
+
+
+bool MicrophonePlayer::prepare()
+{
+    return isRunning;
+}
+
 
+AudioPlayer::CycleResult MicrophonePlayer::process()
+{
     try
     {
-        // Player cycle
-        while (isRunning)
+        if (!isRunning)
         {
-            // Update streams if needed
-            if (mustUpdateDevices)
+            // Flush for correct audio ending
+            if (shouldFlush)
             {
-                audioSource = restartAudioStream(&audioSource, (DeviceTab*)devices->widget(0));
-                audioVCableSink = restartAudioStream(&audioVCableSink, (DeviceTab*)devices->widget(1), audioSource->format());
-                mustUpdateDevices = false;
+                flushSinks();
+                shouldFlush = false;
             }
 
-            #define AUDIO_BUFFER_SIZE 1024 
+            // Wait for audio data to end
+            return isSinksEmpty() ? FINISHED : IDLE;
+        }
 
-            // Read microphone input
-            float buffer[AUDIO_BUFFER_SIZE * SDL_AUDIO_FRAMESIZE(audioSource->format())];
-            // Read samples
-            if (shouldReadSamples)
-            {
-                audioSource->read(buffer, AUDIO_BUFFER_SIZE);
-                shouldReadSamples = false;
-            }
+        // Request input on selected device (opened in background), routes are taken over with it
+        if (mustUpdateDevices)
+        {
+            audioSource.open(inputDevice, nullptr);
+            mustUpdateSinks = true;
+            mustUpdateDevices = false;
+        }
+
+        // Switch to opened input (chunk read from old input is dropped)
+        if (updateDeviceSlot(audioSource, 0))
+        {
+            buffer.resize(AUDIO_BUFFER_SIZE * SDL_AUDIO_FRAMESIZE(audioSource.stream()->format()));
+            bufferedSamples = 0;
+            shouldReadSamples = true;
+            holdSinks();
+            mustUpdateSinks = true;
+        }
+
+        // Sinks take format of input
+        if (mustUpdateSinks && audioSource.isOpen())
+        {
+            SDL_AudioSpec format = audioSource.stream()->format();
+            mustUpdateSinks = !openSinks(&format);
+        }
+        updateSinks();
 
-            // Write data if enough space is available
-            if (!shouldReadSamples && audioVCableSink->isReadyForWrite(AUDIO_BUFFER_SIZE))
+        // Nothing to read from or write to yet
+        if (!audioSource.isOpen() || !isSinksOpen())
+            return IDLE;
+
+        CycleResult result = IDLE;
+
+        // Read samples
+        if (shouldReadSamples)
+        {
+            bufferedSamples = audioSource.stream()->read(buffer.data(), AUDIO_BUFFER_SIZE);
+            if (bufferedSamples > 0)
             {
-                audioVCableSink->write(buffer, AUDIO_BUFFER_SIZE);
-                shouldReadSamples = true;
+                stats.framesDecoded += bufferedSamples;
+                shouldReadSamples = false;
+                result = BUSY;
             }
-
-            #undef AUDIO_BUFFER_SIZE
         }
 
-        // Flush for correct audio ending
-        if (shouldFlush)
+        // Write data if enough space is available
+        if (!shouldReadSamples && isSinksReadyForWrite())
         {
-            audioVCableSink->flush();
-            shouldFlush = false;
+            writeSinks(reinterpret_cast<const float*>(buffer.data()), bufferedSamples);
+            shouldReadSamples = true;
+            result = BUSY;
         }
 
-        // Wait for audio data to end
-        while(!audioVCableSink->isEmpty()) {}
+        return result;
     }
     catch(const std::exception& e)
     {
-        emit signalError(e.what());
+        // Error: player is stopped
+        isRunning = false;
+        signalError(e.what());
+        return FINISHED;
     }
+}
+
 
+void MicrophonePlayer::finish()
+{
     // Stop streams
-    stopAudioStream(&audioSource);
-    stopAudioStream(&audioVCableSink);
-    
+    audioSource.close();
+    closeSinks();
+    mustUpdateSinks = false;
+    bufferedSamples = 0;
+
     // Reset player
     reset();
 }
 
 
+void MicrophonePlayer::setWorkers(WorkerPool *workers)
+{
+    AudioPlayer::setWorkers(workers);
+    audioSource.setWorkers(workers);
+}
+
+
+void MicrophonePlayer::start()
+{
+    isRunning = true;
+}
+
+
 void MicrophonePlayer::stop()
 {
     isRunning = false;
-}
\ No newline at end of file
+}
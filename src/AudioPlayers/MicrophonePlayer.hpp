@@ -1,32 +1,37 @@
 #pragma once
 
 
+// Containers
+#include <vector>
 // Audio player
 #include <AudioPlayers/AudioPlayer.hpp>
 
 
 /**
- * Player that reroutes microphone input to selected output.
+ * Player that reroutes microphone input to its routes.
  */
 class MicrophonePlayer : public AudioPlayer
 {
-    // Mandatory for QWidget stuff to work
-    Q_OBJECT
-
     // Player state.
-    bool isRunning = false;
+    std::atomic<bool> isRunning = false;
 
+    // Input device selected by user.
+    std::atomic<SDL_AudioDeviceID> inputDevice = SDL_AUDIO_DEVICE_DEFAULT_RECORDING;
     // Audio input.
-    DeviceStream *audioSource = nullptr;
+    DeviceSlot audioSource;
+    // Whether sinks must follow format of input.
+    bool mustUpdateSinks = false;
+    // Samples read from input and not yet written.
+    std::vector<char> buffer;
+    // Number of samples in buffer.
+    int bufferedSamples = 0;
 
 public:
 
     /**
-     * Constructor.
-     * 
-     * @param devices tab widget that describes avaliavle devices
+     * Sets input device (safe to call from any thread, running player switches to it).
      */
-    explicit MicrophonePlayer(QTabWidget const *devices);
+    void setInputDevice(SDL_AudioDeviceID device);
 
     /**
      * @return player state
@@ -34,11 +39,29 @@ public:
     bool getState() { return isRunning; }
 
     /**
-     * Player cycle.
+     * Begins player cycle.
+     */
+    bool prepare() override;
+    /**
+     * Runs one iteration of player cycle.
+     */
+    CycleResult process() override;
+    /**
+     * Ends player cycle.
+     */
+    void finish() override;
+
+    /**
+     * @param workers pool that opens and closes device streams in background
+     */
+    void setWorkers(WorkerPool *workers) override;
+
+    /**
+     * Marks player as running. Must be called before player cycle is run.
      */
-    void run() override;
+    void start();
     /**
      * Stops the player if it is running.
      */
     void stop();
-};
\ No newline at end of file
+};
@@ -0,0 +1,495 @@
+#include <Control/ControlServer.hpp>
+
+
+// Exceptions
+#include <stdexcept>
+// Time measurement
+#include <chrono>
+// Min/max
+#include <algorithm>
+// String streams
+#include <sstream>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+// Pipeline spans
+#include <Engine/Tracer.hpp>
+// POSIX sockets
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+
+// Maximum size of unfinished command line
+#define MAX_COMMAND_SIZE 4096
+// Capacity of latency notification queue
+#define LATENCY_QUEUE_SIZE 256
+// Period of checks for latency notifications while some voice was triggered by client (milliseconds)
+#define LATENCY_POLL_INTERVAL 5
+// Client stops waiting for latency notification of trigger after this time (milliseconds)
+#define LATENCY_WAIT_TIME 2000
+
+
+ControlServer::ControlServer(AudioEngine *engine, const std::string &socketPath) : latencyEvents(LATENCY_QUEUE_SIZE)
+{
+    this->engine = engine;
+    this->socketPath = socketPath;
+    voiceClients.assign(engine->getVoiceCount(), -1);
+    voiceDeadlines.resize(engine->getVoiceCount());
+}
+
+
+ControlServer::~ControlServer()
+{
+    stop();
+}
+
+
+std::string ControlServer::defaultSocketPath()
+{
+    const char *runtime_dir = std::getenv("XDG_RUNTIME_DIR");
+    if (runtime_dir && *runtime_dir)
+        return std::string(runtime_dir) + "/opensoundboard.sock";
+    return "/tmp/opensoundboard-" + std::to_string(getuid()) + ".sock";
+}
+
+
+void ControlServer::start()
+{
+    if (isRunning)
+        return;
+
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path))
+        throw std::runtime_error("Control socket: path is too long");
+    std::strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+
+    // Socket file of running instance is kept, stale one left by crashed instance refuses connections
+    int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (probe < 0)
+        throw std::runtime_error("Control socket: unable to create socket");
+    bool is_used = connect(probe, (sockaddr*)&address, sizeof(address)) == 0;
+    bool is_stale = !is_used && (errno == ECONNREFUSED);
+    close(probe);
+    if (is_used)
+        throw std::runtime_error("Control socket: another instance listens on " + socketPath);
+    if (is_stale)
+        unlink(socketPath.c_str());
+
+    // Create socket
+    listenSocket = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listenSocket < 0)
+        throw std::runtime_error("Control socket: unable to create socket");
+    if ((bind(listenSocket, (sockaddr*)&address, sizeof(address)) < 0) || (listen(listenSocket, 8) < 0))
+    {
+        close(listenSocket);
+        listenSocket = -1;
+        throw std::runtime_error("Control socket: unable to bind " + socketPath);
+    }
+    // Only current user may control the board
+    chmod(socketPath.c_str(), S_IRUSR | S_IWUSR);
+
+    if (pipe2(wakePipe, O_CLOEXEC | O_NONBLOCK) < 0)
+    {
+        close(listenSocket);
+        listenSocket = -1;
+        unlink(socketPath.c_str());
+        throw std::runtime_error("Control socket: unable to create wake pipe");
+    }
+
+    // Receive trigger latency measurements
+    engine->setLatencyCallback([this](int voice, double seconds) { notifyLatency(voice, seconds); });
+
+    isRunning = true;
+    thread = std::thread(&ControlServer::run, this);
+}
+
+
+void ControlServer::stop()
+{
+    if (!isRunning)
+        return;
+
+    // Wake and join server thread
+    isRunning = false;
+    char byte = 0;
+    (void)!write(wakePipe[1], &byte, 1);
+    thread.join();
+    engine->setLatencyCallback(nullptr);
+
+    // Close everything
+    for (auto &client : clients)
+        close(client.first);
+    clients.clear();
+    close(listenSocket);
+    listenSocket = -1;
+    close(wakePipe[0]);
+    close(wakePipe[1]);
+    wakePipe[0] = wakePipe[1] = -1;
+    unlink(socketPath.c_str());
+}
+
+
+void ControlServer::run()
+{
+    std::vector<pollfd> fds;
+
+    while (isRunning)
+    {
+        // Poll listening socket, wake pipe and all clients
+        fds.clear();
+        fds.push_back({listenSocket, POLLIN, 0});
+        fds.push_back({wakePipe[0], POLLIN, 0});
+        for (auto &client : clients)
+            fds.push_back({client.first, POLLIN, 0});
+
+        // Audio thread does not wake server, so latency queue is checked periodically while someone waits for it
+        bool is_waiting = std::any_of(voiceClients.begin(), voiceClients.end(), [](int client) { return client >= 0; });
+        int poll_result = poll(fds.data(), fds.size(), is_waiting ? LATENCY_POLL_INTERVAL : -1);
+        sendEvents();
+        if (poll_result <= 0)
+            continue;
+
+        // Drain wake pipe
+        if (fds[1].revents & POLLIN)
+        {
+            char buffer[64];
+            while (read(wakePipe[0], buffer, sizeof(buffer)) > 0) {}
+        }
+
+        // Serve clients
+        for (size_t i = 2; i < fds.size(); i++)
+        {
+            if (fds[i].revents & (POLLIN | POLLHUP | POLLERR))
+            {
+                if (!readClient(fds[i].fd))
+                    closeClient(fds[i].fd);
+            }
+        }
+
+        // Accept new clients
+        if (fds[0].revents & POLLIN)
+            acceptClient();
+    }
+}
+
+
+void ControlServer::acceptClient()
+{
+    int client = accept4(listenSocket, NULL, NULL, SOCK_CLOEXEC);
+    if (client >= 0)
+        clients[client] = "";
+}
+
+
+void ControlServer::closeClient(int client)
+{
+    close(client);
+    clients.erase(client);
+
+    // Forget voices triggered by this client
+    for (int &voice_client : voiceClients)
+    {
+        if (voice_client == client)
+            voice_client = -1;
+    }
+}
+
+
+bool ControlServer::readClient(int client)
+{
+    char buffer[MAX_COMMAND_SIZE];
+    ssize_t size = recv(client, buffer, sizeof(buffer), 0);
+    if (size <= 0)
+        return false;
+
+    std::string &input = clients[client];
+    input.append(buffer, size);
+
+    // Execute every complete line (and every ';' separated command in it) as one batch
+    std::string replies;
+    size_t line_end;
+    while ((line_end = input.find('\n')) != std::string::npos)
+    {
+        std::string line = input.substr(0, line_end);
+        input.erase(0, line_end + 1);
+
+        std::istringstream commands(line);
+        std::string command;
+        while (std::getline(commands, command, ';'))
+        {
+            // Skip empty commands
+            if (command.find_first_not_of(" \t\r") == std::string::npos)
+                continue;
+            replies += execute(client, command) + "\n";
+        }
+    }
+
+    // Refuse clients that never finish their lines
+    if (input.size() > MAX_COMMAND_SIZE)
+        return false;
+
+    if (!replies.empty())
+        return send(client, replies.data(), replies.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(replies.size());
+    return true;
+}
+
+
+std::string ControlServer::execute(int client, const std::string &command)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    std::istringstream stream(command);
+    std::string name;
+    stream >> name;
+
+    std::string fields;
+    try
+    {
+        // Commands without voice
+        if (name == "ping")
+        {
+        }
+        else if (name == "stats")
+        {
+            AudioEngine::AudioThreadStats audio = engine->getAudioThreadStats();
+            fields = " audio_policy=" + audio.scheduling.policy + " audio_priority=" + std::to_string(audio.scheduling.priority)
+                   + " audio_cpu=" + std::to_string(audio.scheduling.cpu) + " audio_mlock=" + (audio.scheduling.memoryLocked ? "1" : "0")
+                   + " audio_preempted=" + std::to_string(audio.involuntarySwitches)
+                   + " wakeup_ms=" + std::to_string(audio.averageWakeupLatency * 1000)
+                   + " max_wakeup_ms=" + std::to_string(audio.maxWakeupLatency * 1000);
+
+            static const char *priorities[] = {"high", "normal", "low"};
+            WorkerPool::Stats stats = engine->getWorkers()->getStats();
+            fields += " workers=" + std::to_string(stats.threads) + " running=" + std::to_string(stats.running);
+            for (int i = 0; i < WorkerPool::PRIORITY_COUNT; i++)
+            {
+                std::string prefix = std::string(" ") + priorities[i] + "_";
+                fields += prefix + "queued=" + std::to_string(stats.queued[i])
+                        + prefix + "done=" + std::to_string(stats.completed[i])
+                        + prefix + "wait_ms=" + std::to_string(stats.averageLatency[i] * 1000)
+                        + prefix + "max_wait_ms=" + std::to_string(stats.maxLatency[i] * 1000);
+            }
+
+            ClipCache::Stats cache = engine->getCache()->getStats();
+            fields += " cache_budget=" + std::to_string(cache.budget) + " cache_bytes=" + std::to_string(cache.residentBytes)
+                    + " cache_packed_bytes=" + std::to_string(cache.packedBytes) + " cache_clips=" + std::to_string(cache.clips)
+                    + " cache_packed=" + std::to_string(cache.packedClips) + " cache_pinned=" + std::to_string(cache.pinnedClips)
+                    + " cache_hits=" + std::to_string(cache.hits) + " cache_packed_hits=" + std::to_string(cache.packedHits)
+                    + " cache_misses=" + std::to_string(cache.misses) + " cache_evictions=" + std::to_string(cache.evictions);
+        }
+        else if (name == "trace")
+        {
+            std::string value;
+            stream >> value;
+            if (value == "on")
+                Tracer::start();
+            else if (value == "off")
+                Tracer::stop();
+            else if (value == "dump")
+            {
+                std::string filepath;
+                std::getline(stream >> std::ws, filepath);
+                if (filepath.empty())
+                    throw std::runtime_error("expected file path");
+                Tracer::dump(filepath);
+            }
+            else
+                throw std::runtime_error("expected on/off/dump");
+        }
+        else if (name == "mic")
+        {
+            std::string value;
+            stream >> value;
+            if (value == "on")
+                engine->startMicrophone();
+            else if (value == "off")
+                engine->stopMicrophone();
+            else
+                throw std::runtime_error("expected on/off");
+        }
+        else if (name == "pin")
+        {
+            std::string value, filepath;
+            stream >> value;
+            std::getline(stream >> std::ws, filepath);
+            if (filepath.empty())
+                throw std::runtime_error("expected file path");
+            if (value == "on")
+                engine->getCache()->pin(filepath);
+            else if (value == "off")
+                engine->getCache()->unpin(filepath);
+            else
+                throw std::runtime_error("expected on/off");
+        }
+        else if (name == "route")
+        {
+            // Source is voice index or microphone, route is removed by "off" instead of gain
+            std::string source_name, value;
+            SDL_AudioDeviceID device;
+            if (!(stream >> source_name >> device >> value))
+                throw std::runtime_error("expected source, device and gain");
+            int source = AudioEngine::MICROPHONE_SOURCE;
+            if ((source_name != "mic") && !(std::istringstream(source_name) >> source))
+                throw std::runtime_error("expected voice index or mic");
+            if (value == "off")
+                engine->removeRoute(source, device);
+            else
+            {
+                float gain;
+                if (!(std::istringstream(value) >> gain) || gain < 0)
+                    throw std::runtime_error("expected gain");
+                std::string mute;
+                stream >> mute;
+                engine->setRoute(source, device, gain, mute == "mute");
+            }
+        }
+        // Voice commands
+        else
+        {
+            int voice;
+            if (!(stream >> voice))
+                throw std::runtime_error("expected voice index");
+
+            if (name == "load")
+            {
+                std::string filepath;
+                std::getline(stream >> std::ws, filepath);
+                if (filepath.empty())
+                    throw std::runtime_error("expected file path");
+                // File is opened by worker pool, commands for voice that follow wait for it
+                engine->loadAsync(voice, filepath);
+            }
+            else if (name == "swap")
+            {
+                std::string filepath;
+                std::getline(stream >> std::ws, filepath);
+                if (filepath.empty())
+                    throw std::runtime_error("expected file path");
+                engine->swap(voice, filepath);
+            }
+            else if (name == "unload")
+                engine->unload(voice);
+            else if ((name == "trigger") || (name == "play"))
+            {
+                // Remember who should receive latency notification
+                if (voice >= 0 && voice < static_cast<int>(voiceClients.size()))
+                {
+                    voiceClients[voice] = client;
+                    voiceDeadlines[voice] = std::chrono::steady_clock::now() + std::chrono::milliseconds(LATENCY_WAIT_TIME);
+                }
+                if (name == "trigger")
+                    engine->trigger(voice);
+                else
+                    engine->play(voice);
+            }
+            else if (name == "pause")
+                engine->pause(voice);
+            else if (name == "stop")
+                engine->stop(voice);
+            else if (name == "seek")
+            {
+                double seconds;
+                if (!(stream >> seconds) || seconds < 0)
+                    throw std::runtime_error("expected time in seconds");
+                engine->seek(voice, seconds);
+            }
+            else if (name == "gain")
+            {
+                float gain;
+                if (!(stream >> gain) || gain < 0)
+                    throw std::runtime_error("expected gain");
+                engine->setGain(voice, gain);
+            }
+            else if (name == "region")
+            {
+                // Negative times are not set, loop and crossfade are optional
+                MediaFilesPlayer::Region region;
+                if (!(stream >> region.in >> region.out))
+                    throw std::runtime_error("expected in and out points");
+                double loop_start, loop_end, crossfade;
+                if (stream >> loop_start)
+                {
+                    if (!(stream >> loop_end))
+                        throw std::runtime_error("expected loop end");
+                    region.loopStart = loop_start;
+                    region.loopEnd = loop_end;
+                    if (stream >> crossfade)
+                        region.crossfade = std::max(0.0, crossfade);
+                }
+                std::string filepath = engine->getFilepath(voice);
+                if (filepath.empty())
+                    throw std::runtime_error("no track loaded");
+                engine->setClipRegion(filepath, region);
+            }
+            else if (name == "status")
+            {
+                static const char *states[] = {"stopped", "playing", "paused"};
+                MediaFilesPlayer *player = engine->getVoice(voice);
+                // Slowest route decides when audio is heard
+                double target = 0;
+                for (int d = 1; d < MAX_PLAYER_ROUTES + 1; d++)
+                {
+                    DeviceStats &output = player->getStats().devices[d];
+                    if ((output.device != 0) && (output.sampleRate > 0))
+                        target = std::max(target, static_cast<double>(output.targetSize) / output.sampleRate);
+                }
+                MediaFilesPlayer::Status status = player->getStatus();
+                fields = std::string(" state=") + states[status.state]
+                       + " position=" + std::to_string(status.position)
+                       + " peak=" + std::to_string(status.peak)
+                       + " latency_ms=" + std::to_string(player->getTriggerLatency() * 1000)
+                       + " target_ms=" + std::to_string(target * 1000);
+            }
+            else
+                throw std::runtime_error("unknown command");
+        }
+    }
+    catch(const std::exception& e)
+    {
+        return "err " + name + " " + e.what();
+    }
+
+    auto handling_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    return "ok " + name + fields + " us=" + std::to_string(handling_time.count());
+}
+
+
+void ControlServer::notifyLatency(int voice, double seconds)
+{
+    LatencyEvent event;
+    event.voice = voice;
+    event.seconds = seconds;
+    latencyEvents.push(event);
+}
+
+
+void ControlServer::sendEvents()
+{
+    LatencyEvent event;
+    while (latencyEvents.pop(event))
+    {
+        if ((event.voice < 0) || (event.voice >= static_cast<int>(voiceClients.size())))
+            continue;
+        int client = voiceClients[event.voice];
+        if (client < 0)
+            continue;
+
+        std::string text = "started " + std::to_string(event.voice) + " latency_ms=" + std::to_string(event.seconds * 1000) + "\n";
+        send(client, text.data(), text.size(), MSG_NOSIGNAL);
+        voiceClients[event.voice] = -1;
+    }
+
+    // Triggers that never reach device (no track, voice stopped before) do not keep server polling
+    auto now = std::chrono::steady_clock::now();
+    for (size_t voice = 0; voice < voiceClients.size(); voice++)
+    {
+        if ((voiceClients[voice] >= 0) && (now >= voiceDeadlines[voice]))
+            voiceClients[voice] = -1;
+    }
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+
+// Strings
+#include <string>
+// Containers
+#include <vector>
+#include <map>
+// Threads
+#include <thread>
+#include <atomic>
+// Time measurement
+#include <chrono>
+// Audio engine
+#include <Engine/AudioEngine.hpp>
+// Lock-free queue
+#include <Engine/CommandQueue.hpp>
+
+
+/**
+ * Local control surface. Listens on Unix domain socket and executes line commands on audio engine.
+ *
+ * Each line is one command, several commands may be sent in one write (or separated by ';') and are
+ * answered by one write. Commands:
+ *   load <voice> <path>    unload <voice>    trigger <voice>    play <voice>    pause <voice>
+ *   stop <voice>           seek <voice> <s>  gain <voice> <g>   status <voice>  mic <on|off>    ping
+ *   stats (audio thread scheduling and wakeup latency, worker pool queue depth and job latency, clip cache)
+ *   pin <on|off> <path> (keeps decoded start of file in memory as floats)
+ *   swap <voice> <path> (playing voice crossfades into file opened in background, reply does not wait)
+ *   region <voice> <in> <out> [<loop start> <loop end> [<crossfade>]] (seconds, negative ones are not set)
+ *   route <voice|mic> <device> <gain> [mute] (sends source to playback device), route <voice|mic> <device> off
+ * Load replies before file is opened (commands for voice wait for it, failure goes to player errors).
+ * Replies are "ok <command> [fields] us=<handling time>" or "err <command> <message>". When triggered audio
+ * reaches device, client that triggered it receives "started <voice> latency_ms=<trigger-to-audio latency>".
+ */
+class ControlServer
+{
+    /**
+     * Trigger latency measured by audio thread.
+     */
+    struct LatencyEvent
+    {
+        // Voice index.
+        int voice = 0;
+        // Trigger-to-audio latency in seconds.
+        double seconds = 0;
+    };
+
+    // Controlled engine.
+    AudioEngine *engine = nullptr;
+    // Socket file path.
+    std::string socketPath;
+
+    // Listening socket.
+    int listenSocket = -1;
+    // Pipe that wakes server thread (read end, write end).
+    int wakePipe[2] = {-1, -1};
+    // Connected clients and their unfinished input.
+    std::map<int, std::string> clients;
+
+    // Server thread.
+    std::thread thread;
+    // Whether server thread should run.
+    std::atomic<bool> isRunning = false;
+
+    // Client that waits for latency notification of each voice (-1 if there is none, server thread only).
+    std::vector<int> voiceClients;
+    // Time when client stops waiting for latency notification of each voice (server thread only).
+    std::vector<std::chrono::steady_clock::time_point> voiceDeadlines;
+    // Latency measurements queued by audio thread (server thread formats and sends them).
+    CommandQueue<LatencyEvent> latencyEvents;
+
+public:
+
+    /**
+     * Constructor.
+     *
+     * @param engine audio engine to control
+     * @param socketPath socket file path
+     */
+    ControlServer(AudioEngine *engine, const std::string &socketPath);
+    /**
+     * Destructor. Stops server.
+     */
+    ~ControlServer();
+
+    /**
+     * @return default socket path ($XDG_RUNTIME_DIR/opensoundboard.sock or /tmp/opensoundboard-<uid>.sock)
+     */
+    static std::string defaultSocketPath();
+
+    /**
+     * Binds socket and starts server thread.
+     *
+     * @throws Runtime Error if socket can not be created.
+     */
+    void start();
+    /**
+     * Stops server thread and removes socket.
+     */
+    void stop();
+
+private:
+
+    /**
+     * Server cycle.
+     */
+    void run();
+
+    /**
+     * Accepts new client.
+     */
+    void acceptClient();
+    /**
+     * Reads and executes client commands.
+     *
+     * @return false if client has disconnected
+     */
+    bool readClient(int client);
+    /**
+     * Disconnects client.
+     */
+    void closeClient(int client);
+
+    /**
+     * Executes single command.
+     *
+     * @return reply line
+     */
+    std::string execute(int client, const std::string &command);
+
+    /**
+     * Queues trigger latency measurement (audio thread, never blocks, dropped if queue is full).
+     */
+    void notifyLatency(int voice, double seconds);
+    /**
+     * Sends queued latency notifications to clients that triggered voices (each trigger is answered once,
+     * triggers whose audio does not arrive in time are forgotten).
+     */
+    void sendEvents();
+};
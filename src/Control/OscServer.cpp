@@ -0,0 +1,456 @@
+#include <Control/OscServer.hpp>
+
+
+// Exceptions
+#include <stdexcept>
+// Time conversion
+#include <chrono>
+// String utilities
+#include <cstring>
+// Console output
+#include <cstdio>
+// POSIX sockets
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+
+// Maximum size of UDP datagram
+#define MAX_PACKET_SIZE 65536
+// Maximum nesting of bundles
+#define MAX_BUNDLE_DEPTH 8
+// Seconds between NTP epoch (1900) and Unix epoch (1970)
+#define NTP_UNIX_OFFSET 2208988800ULL
+
+
+/**
+ * Reads big endian 32-bit value.
+ */
+static uint32_t readUint32(const char *data)
+{
+    const unsigned char *bytes = (const unsigned char*)data;
+    return (uint32_t(bytes[0]) << 24) | (uint32_t(bytes[1]) << 16) | (uint32_t(bytes[2]) << 8) | uint32_t(bytes[3]);
+}
+
+
+/**
+ * Reads big endian 64-bit value.
+ */
+static uint64_t readUint64(const char *data)
+{
+    return (uint64_t(readUint32(data)) << 32) | readUint32(data + 4);
+}
+
+
+/**
+ * Reads OSC string (null terminated, padded to 4 bytes).
+ *
+ * @return size of string with padding or 0 if string is malformed
+ */
+static size_t readString(const char *data, size_t size, std::string &text)
+{
+    const char *end = (const char*)std::memchr(data, '\0', size);
+    if (!end)
+        return 0;
+
+    text.assign(data, end);
+    size_t padded = ((end - data) / 4 + 1) * 4;
+    return (padded <= size) ? padded : 0;
+}
+
+
+OscServer::OscServer(AudioEngine *engine, int port)
+{
+    this->engine = engine;
+    this->port = port;
+}
+
+
+OscServer::~OscServer()
+{
+    stop();
+}
+
+
+void OscServer::start()
+{
+    if (isRunning)
+        return;
+
+    // Only local show control software may talk to us
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    udpSocket = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (udpSocket < 0)
+        throw std::runtime_error("OSC server: unable to create socket");
+    if (bind(udpSocket, (sockaddr*)&address, sizeof(address)) < 0)
+    {
+        close(udpSocket);
+        udpSocket = -1;
+        throw std::runtime_error("OSC server: unable to bind port " + std::to_string(port));
+    }
+
+    if (pipe2(wakePipe, O_CLOEXEC | O_NONBLOCK) < 0)
+    {
+        close(udpSocket);
+        udpSocket = -1;
+        throw std::runtime_error("OSC server: unable to create wake pipe");
+    }
+
+    isRunning = true;
+    thread = std::thread(&OscServer::run, this);
+}
+
+
+void OscServer::stop()
+{
+    if (!isRunning)
+        return;
+
+    // Wake and join server thread
+    isRunning = false;
+    char byte = 0;
+    (void)!write(wakePipe[1], &byte, 1);
+    thread.join();
+
+    close(udpSocket);
+    udpSocket = -1;
+    close(wakePipe[0]);
+    close(wakePipe[1]);
+    wakePipe[0] = wakePipe[1] = -1;
+}
+
+
+void OscServer::run()
+{
+    std::vector<char> buffer(MAX_PACKET_SIZE);
+    pollfd fds[2] = {{udpSocket, POLLIN, 0}, {wakePipe[0], POLLIN, 0}};
+
+    while (isRunning)
+    {
+        if (poll(fds, 2, -1) <= 0)
+            continue;
+
+        // Handle all pending datagrams
+        if (fds[0].revents & POLLIN)
+        {
+            ssize_t size;
+            while ((size = recv(udpSocket, buffer.data(), buffer.size(), MSG_DONTWAIT)) > 0)
+            {
+                #ifdef DEBUG
+                    if (!parsePacket(buffer.data(), size, 0))
+                        printf("OSC server: malformed packet\n");
+                #else
+                    parsePacket(buffer.data(), size, 0);
+                #endif
+            }
+        }
+    }
+}
+
+
+bool OscServer::parsePacket(const char *data, size_t size, Uint64 time, int depth)
+{
+    // OSC packets are always aligned to 4 bytes
+    if ((size == 0) || (size % 4 != 0))
+        return false;
+
+    // Message
+    if (data[0] == '/')
+        return parseMessage(data, size, time);
+
+    // Bundle: "#bundle", time tag, elements (size + content)
+    if ((size < 16) || (std::memcmp(data, "#bundle", 8) != 0) || (depth >= MAX_BUNDLE_DEPTH))
+        return false;
+    Uint64 bundle_time = convertTimeTag(readUint64(data + 8));
+    // Nested bundles can not be executed earlier than enclosing one
+    if (bundle_time < time)
+        bundle_time = time;
+
+    bool is_valid = true;
+    size_t offset = 16;
+    while (is_valid && (offset + 4 <= size))
+    {
+        uint32_t element_size = readUint32(data + offset);
+        offset += 4;
+        if (element_size > size - offset)
+        {
+            is_valid = false;
+            break;
+        }
+        is_valid = parsePacket(data + offset, element_size, bundle_time, depth + 1);
+        offset += element_size;
+    }
+    return is_valid;
+}
+
+
+bool OscServer::parseMessage(const char *data, size_t size, Uint64 time)
+{
+    // Address
+    std::string address;
+    size_t offset = readString(data, size, address);
+    if (offset == 0)
+        return false;
+
+    // Type tags (may be missing in very old implementations)
+    std::string types = ",";
+    if (offset < size)
+    {
+        size_t types_size = readString(data + offset, size - offset, types);
+        if ((types_size == 0) || (types.empty()) || (types[0] != ','))
+            return false;
+        offset += types_size;
+    }
+
+    // Arguments
+    std::vector<Argument> arguments;
+    for (size_t i = 1; i < types.size(); i++)
+    {
+        Argument argument = {types[i], 0, ""};
+        switch (types[i])
+        {
+            case 'i':
+            case 'f':
+            {
+                if (offset + 4 > size)
+                    return false;
+                uint32_t value = readUint32(data + offset);
+                if (types[i] == 'i')
+                    argument.number = static_cast<int32_t>(value);
+                else
+                {
+                    float number;
+                    std::memcpy(&number, &value, sizeof(number));
+                    argument.number = number;
+                }
+                offset += 4;
+                break;
+            }
+            case 'h':
+            case 'd':
+            case 't':
+            {
+                if (offset + 8 > size)
+                    return false;
+                uint64_t value = readUint64(data + offset);
+                if (types[i] == 'd')
+                {
+                    double number;
+                    std::memcpy(&number, &value, sizeof(number));
+                    argument.number = number;
+                }
+                else
+                    argument.number = static_cast<double>(static_cast<int64_t>(value));
+                offset += 8;
+                break;
+            }
+            case 's':
+            case 'S':
+            {
+                size_t string_size = readString(data + offset, size - offset, argument.text);
+                if (string_size == 0)
+                    return false;
+                offset += string_size;
+                break;
+            }
+            case 'b':
+            {
+                // Blobs are not used by any address, skip them
+                if (offset + 4 > size)
+                    return false;
+                size_t blob_size = (size_t(readUint32(data + offset)) + 3) / 4 * 4;
+                if (blob_size > size - offset - 4)
+                    return false;
+                offset += 4 + blob_size;
+                break;
+            }
+            case 'T':
+                argument.number = 1;
+                break;
+            case 'F':
+            case 'N':
+            case 'I':
+                break;
+            default:
+                return false;
+        }
+        arguments.push_back(argument);
+    }
+
+    handleMessage(address, arguments, time);
+    return true;
+}
+
+
+void OscServer::handleMessage(const std::string &address, const std::vector<Argument> &arguments, Uint64 time)
+{
+    // Split address into parts
+    std::vector<std::string> parts;
+    size_t start = 1;
+    while (start <= address.size())
+    {
+        size_t end = address.find('/', start);
+        if (end == std::string::npos)
+            end = address.size();
+        parts.push_back(address.substr(start, end - start));
+        start = end + 1;
+    }
+
+    // Controllers send 0 on button release
+    bool is_release = (arguments.size() == 1) && (arguments[0].type != 's') && (arguments[0].number == 0);
+    // Numeric value of first argument
+    double value = (!arguments.empty()) ? arguments[0].number : 0;
+
+    EngineCommand command;
+    command.time = time;
+
+    try
+    {
+        // Microphone
+        if ((parts.size() == 2) && (parts[0] == "mic"))
+        {
+            if (parts[1] == "start")
+                command.type = EngineCommand::MICROPHONE_START;
+            else if (parts[1] == "stop")
+                command.type = EngineCommand::MICROPHONE_STOP;
+            else
+                return;
+            engine->submit(command);
+            return;
+        }
+
+        if (parts.size() != 3)
+            return;
+        int id = std::stoi(parts[1]);
+        const std::string &action = parts[2];
+
+        // Players
+        if (parts[0] == "player")
+        {
+            command.voice = id;
+            if (action == "load")
+            {
+                // Loading opens file so it is done by worker pool and not on audio or network thread, commands
+                // for player that follow it wait for it in engine
+                if (!arguments.empty() && (arguments[0].type == 's'))
+                    engine->loadAsync(id, arguments[0].text);
+                return;
+            }
+            else if ((action == "trigger") || (action == "play"))
+            {
+                if (is_release)
+                    return;
+                command.type = (action == "trigger") ? EngineCommand::TRIGGER : EngineCommand::PLAY;
+            }
+            else if (action == "pause")
+                command.type = EngineCommand::PAUSE;
+            else if (action == "stop")
+                command.type = EngineCommand::STOP;
+            else if ((action == "seek") && !arguments.empty())
+            {
+                command.type = EngineCommand::SEEK;
+                command.value = value;
+            }
+            else if ((action == "gain") && !arguments.empty())
+            {
+                command.type = EngineCommand::GAIN;
+                command.value = value;
+            }
+            else
+                return;
+            engine->submit(command);
+        }
+        // Clips
+        else if (parts[0] == "clip")
+        {
+            if (action == "load")
+            {
+                if (!arguments.empty() && (arguments[0].type == 's'))
+                    clips[id] = arguments[0].text;
+            }
+            else if ((action == "play") && !is_release && clips.count(id))
+            {
+                command.type = EngineCommand::TRIGGER;
+                triggerClip(clips[id], command);
+            }
+        }
+    }
+    catch(const std::exception& e)
+    {
+        // Bad addresses and player errors are not reported back over UDP
+        #ifdef DEBUG
+            printf("OSC server: %s (%s)\n", e.what(), address.c_str());
+        #endif
+    }
+}
+
+
+void OscServer::triggerClip(const std::string &filepath, EngineCommand command)
+{
+    int stopped_voice = -1;
+    int holding_voice = -1;
+
+    // Voices being loaded look stopped (several clips of one bundle would be loaded into same voice)
+    for (int i = 0; i < engine->getVoiceCount(); i++)
+    {
+        if (engine->isLoadPending(i))
+            continue;
+        bool is_stopped = engine->getVoice(i)->getState() == MediaFilesPlayer::STOPPED;
+        bool is_holding = engine->getFilepath(i) == filepath;
+
+        // Best case: clip is loaded and idle
+        if (is_stopped && is_holding)
+        {
+            stopped_voice = -1;
+            holding_voice = i;
+            break;
+        }
+        if (is_stopped && (stopped_voice < 0))
+            stopped_voice = i;
+        if (is_holding && (holding_voice < 0))
+            holding_voice = i;
+    }
+
+    // Every voice is busy: retrigger voice that plays this clip
+    if (stopped_voice < 0)
+    {
+        command.voice = holding_voice;
+        if (command.voice >= 0)
+            engine->submit(command);
+        return;
+    }
+
+    // Loading opens file, so clip is loaded into idle voice by worker pool and trigger waits for it
+    command.voice = stopped_voice;
+    engine->loadAsync(stopped_voice, filepath);
+    engine->submit(command);
+}
+
+
+Uint64 OscServer::convertTimeTag(uint64_t timetag)
+{
+    // Special value 1 means "immediately"
+    if (timetag <= 1)
+        return 0;
+
+    // Time tag to nanoseconds since Unix epoch
+    uint64_t seconds = timetag >> 32;
+    if (seconds < NTP_UNIX_OFFSET)
+        return 0;
+    uint64_t nanoseconds = ((seconds - NTP_UNIX_OFFSET) * 1000000000ULL) + (((timetag & 0xFFFFFFFFULL) * 1000000000ULL) >> 32);
+
+    // Shift current SDL ticks by distance between time tag and current time
+    int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    int64_t delay = static_cast<int64_t>(nanoseconds) - now;
+    if (delay <= 0)
+        return 0;
+    return SDL_GetTicksNS() + delay;
+}
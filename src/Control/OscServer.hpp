@@ -0,0 +1,129 @@
+#pragma once
+
+
+// Strings
+#include <string>
+// Containers
+#include <vector>
+#include <map>
+// Threads
+#include <thread>
+#include <atomic>
+// Audio engine
+#include <Engine/AudioEngine.hpp>
+
+
+/**
+ * Open Sound Control server bound to localhost (UDP). Packets are parsed on server thread and
+ * forwarded to audio engine through its lock-free command queue, bundle time tags are honored.
+ *
+ * Addresses:
+ *   /player/<n>/trigger|play|pause|stop    /player/<n>/seek <seconds>    /player/<n>/gain <gain>
+ *   /player/<n>/load <path>                /clip/<id>/load <path>        /clip/<id>/play
+ *   /mic/start                             /mic/stop
+ * Trigger-like messages with single zero argument (button release) are ignored.
+ */
+class OscServer
+{
+public:
+
+    /**
+     * Describes OSC message argument.
+     */
+    struct Argument
+    {
+        // Type tag.
+        char type;
+        // Numeric value (int, float, double, boolean).
+        double number;
+        // String value.
+        std::string text;
+    };
+
+private:
+
+    // Controlled engine.
+    AudioEngine *engine = nullptr;
+    // UDP port.
+    int port;
+
+    // UDP socket.
+    int udpSocket = -1;
+    // Pipe that wakes server thread (read end, write end).
+    int wakePipe[2] = {-1, -1};
+
+    // Server thread.
+    std::thread thread;
+    // Whether server thread should run.
+    std::atomic<bool> isRunning = false;
+
+    // Media files assigned to clip ids.
+    std::map<int, std::string> clips;
+
+public:
+
+    /**
+     * Constructor.
+     *
+     * @param engine audio engine to control
+     * @param port UDP port on localhost
+     */
+    OscServer(AudioEngine *engine, int port);
+    /**
+     * Destructor. Stops server.
+     */
+    ~OscServer();
+
+    /**
+     * Binds socket and starts server thread.
+     *
+     * @throws Runtime Error if socket can not be created.
+     */
+    void start();
+    /**
+     * Stops server thread.
+     */
+    void stop();
+
+private:
+
+    /**
+     * Server cycle.
+     */
+    void run();
+
+    /**
+     * Parses OSC packet (message or bundle).
+     *
+     * @param time time of execution in SDL nanosecond ticks (0 means immediately)
+     * @param depth nesting depth of bundle
+     *
+     * @return false if packet is malformed
+     */
+    bool parsePacket(const char *data, size_t size, Uint64 time, int depth = 0);
+    /**
+     * Parses OSC message and executes it.
+     *
+     * @return false if message is malformed
+     */
+    bool parseMessage(const char *data, size_t size, Uint64 time);
+
+    /**
+     * Maps message to engine command.
+     */
+    void handleMessage(const std::string &address, const std::vector<Argument> &arguments, Uint64 time);
+
+    /**
+     * Finds voice for clip (voice that already has it loaded, any stopped voice or voice holding it) and
+     * triggers it. Clip is loaded into stopped voice by worker pool and engine holds trigger back until it
+     * is loaded (later than its time if loading takes longer), voice is not claimed again meanwhile.
+     *
+     * @param command trigger command (voice is filled in)
+     */
+    void triggerClip(const std::string &filepath, EngineCommand command);
+
+    /**
+     * Converts OSC (NTP) time tag to SDL nanosecond ticks.
+     */
+    static Uint64 convertTimeTag(uint64_t timetag);
+};
@@ -5,10 +5,22 @@
 #include <stdexcept>
 
 
+/**
+ * @return device description for combobox tooltip
+ */
+static QString describeFormat(const DeviceInfo &info)
+{
+    QString text = QString("%1 Hz, %2 channels").arg(info.format.freq).arg(info.format.channels);
+    if (info.bufferFrames > 0)
+        text += QString(", %1 frames buffer").arg(info.bufferFrames);
+    return text;
+}
+
+
 DeviceTab::DeviceTab(DevicesList::DeviceType device_type, QComboBox *combobox_devices, QWidget *parent) : QWidget(parent)
 {
-    // Init devices list
-    devices = new DevicesList(device_type);
+    // Devices are filled in by registry
+    this->device_type = device_type;
 
     // Widget layout
     QVBoxLayout *layout = new QVBoxLayout();
@@ -16,22 +28,14 @@ DeviceTab::DeviceTab(DevicesList::DeviceType device_type, QComboBox *combobox_de
     // Combobox
     this->combobox_devices = combobox_devices;
     layout->addWidget(this->combobox_devices);
-
-    // Load devices
-    refreshDevices();
+    // Selection is tracked before anyone else hears about it
+    connect(this->combobox_devices, &QComboBox::currentIndexChanged, this, &DeviceTab::onSelectionChanged);
 
     // Set layout
     setLayout(layout);
 }
 
 
-DeviceTab::~DeviceTab()
-{
-    // Clear devices list
-    delete devices;
-}
-
-
 void DeviceTab::paintEvent(QPaintEvent *)
 {
     QStyleOption opt;
@@ -44,32 +48,53 @@ void DeviceTab::paintEvent(QPaintEvent *)
 SDL_AudioDeviceID DeviceTab::getDevice() const
 {
     // Throw exception if there are no devices
-    if (devices->count() < 1)
+    SDL_AudioDeviceID device = selectedDevice;
+    if (device == 0)
         throw std::runtime_error("Audio devices: nothing is avaliable");
 
-    // Return audio device ID corresponding to selected device in combobox
-    return devices->get(combobox_devices->currentIndex());
+    return device;
 }
 
 
-void DeviceTab::refreshDevices()
+void DeviceTab::changeDevice(DeviceRegistry::ChangeType type, const DeviceInfo &info)
 {
-    // Block any signals from combobox (editing combobox will not cause any updates)
-    combobox_devices->blockSignals(true);
+    if (info.isRecording != (device_type == DevicesList::INPUT))
+        return;
 
-    // Clear combobox
-    if (combobox_devices->count() != 0)
-    {
-        combobox_devices->clear();
-    }
-    // Refresh devices list
-    devices->refresh();
-    // Fill combobox
-    for (int i=0; i < devices->count(); i++)
+    int index = combobox_devices->findData(static_cast<uint>(info.id));
+    switch (type)
     {
-        combobox_devices->addItem(SDL_GetAudioDeviceName(devices->get(i)));
+        case DeviceRegistry::ADDED:
+        {
+            if (index < 0)
+            {
+                combobox_devices->addItem(QString::fromStdString(info.name), static_cast<uint>(info.id));
+                index = combobox_devices->count() - 1;
+            }
+            combobox_devices->setItemData(index, describeFormat(info), Qt::ToolTipRole);
+            break;
+        }
+        case DeviceRegistry::CHANGED:
+        {
+            if (index >= 0)
+            {
+                combobox_devices->setItemText(index, QString::fromStdString(info.name));
+                combobox_devices->setItemData(index, describeFormat(info), Qt::ToolTipRole);
+            }
+            break;
+        }
+        case DeviceRegistry::REMOVED:
+        {
+            // Removing selected device selects another one and players follow
+            if (index >= 0)
+                combobox_devices->removeItem(index);
+            break;
+        }
     }
+}
+
 
-    // Release combobox
-    combobox_devices->blockSignals(false);
+void DeviceTab::onSelectionChanged(int index)
+{
+    selectedDevice = (index < 0) ? 0 : combobox_devices->itemData(index).toUInt();
 }
\ No newline at end of file
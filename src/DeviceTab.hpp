@@ -10,8 +10,12 @@
 #include <QtWidgets/QWidget>
 #include <QtWidgets/QVBoxLayout>
 #include <QtWidgets/QComboBox>
+// Atomics
+#include <atomic>
 // SDL3 devices list
-#include <SDL/DevicesList.cpp>
+#include <SDL/DevicesList.hpp>
+// Shared device registry
+#include <SDL/DeviceRegistry.hpp>
 
 
 /**
@@ -22,10 +26,12 @@ class DeviceTab: public QWidget
     // Mandatory for QWidget stuff to work
     Q_OBJECT
 
-    // Stores info about devices, available for this tab.
-    DevicesList *devices;
-    // Combobox with devices.
+    // Type of devices shown in this tab.
+    DevicesList::DeviceType device_type;
+    // Combobox with devices (item data holds device ID).
     QComboBox *combobox_devices = nullptr;
+    // Device selected in combobox (read by audio thread).
+    std::atomic<SDL_AudioDeviceID> selectedDevice = 0;
 
 public:
 
@@ -36,10 +42,6 @@ public:
      * @param combobox_devices combobox with devices
      */
     explicit DeviceTab(DevicesList::DeviceType device_type, QComboBox *combobox_devices, QWidget *parent = nullptr);
-    /**
-     * Destructor.
-     */
-    ~DeviceTab();
 
     /**
      * Reimplemented to allow usage of QSS.
@@ -47,12 +49,19 @@ public:
     void paintEvent(QPaintEvent *) override;
 
     /**
-     * Updates list of audio devices.
+     * Applies change reported by device registry (devices of other type are ignored).
      */
-    void refreshDevices();
+    void changeDevice(DeviceRegistry::ChangeType type, const DeviceInfo &info);
     
     /**
-     * @return id of selected audio device.
+     * @return id of selected audio device (safe to call from any thread).
      */
     SDL_AudioDeviceID getDevice() const;
+
+private:
+
+    /**
+     * Remembers device selected in combobox.
+     */
+    void onSelectionChanged(int index);
 };
\ No newline at end of file
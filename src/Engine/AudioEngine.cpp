@@ -0,0 +1,876 @@
+#include <Engine/AudioEngine.hpp>
+
+
+// Exceptions
+#include <stdexcept>
+// Heap
+#include <algorithm>
+// Console output
+#include <cstdio>
+// Decibels
+#include <cmath>
+// Trace thread names
+#include <Engine/Tracer.hpp>
+
+
+// Capacity of command queue
+#define COMMAND_QUEUE_SIZE 1024
+// Audio thread does not trust sleeps shorter than this (nanoseconds) and yields instead
+#define DISPATCHER_SPIN_TIME 1000000
+// Audio thread sleep while active players have nothing to do (nanoseconds)
+#define AUDIO_THREAD_IDLE_TIME 1000000
+// Audio thread sleep while no player is active (nanoseconds)
+#define AUDIO_THREAD_SLEEP_TIME 100000000
+// Loudness clips are normalized to (LUFS)
+#define NORMALIZATION_TARGET -16.0
+// Highest true peak normalized clip may reach (dBTP)
+#define TRUE_PEAK_CEILING -1.0
+// Largest boost of quiet clip (dB)
+#define MAX_NORMALIZATION_BOOST 12.0
+
+
+/**
+ * Orders commands by time in heap (earliest on top).
+ */
+static bool isLater(const EngineCommand &a, const EngineCommand &b)
+{
+    return a.time > b.time;
+}
+
+
+AudioEngine::AudioEngine(int voiceCount, const RealtimeConfig &realtime) : commands(COMMAND_QUEUE_SIZE)
+{
+    realtimeConfig = realtime;
+
+    // Players open their devices in background
+    workers = new WorkerPool();
+
+    // Voices holding prefetched file start it from memory
+    cache = new ClipCache(workers);
+    cache->setClipCallback([this](std::shared_ptr<const CachedClip> clip)
+    {
+        for (Voice *v : voices)
+        {
+            std::lock_guard<std::mutex> lock(v->mutex);
+            if (v->player->getFilepath() == clip->filepath)
+                v->player->setHead(clip);
+        }
+    });
+
+    // Create players
+    for (int i = 0; i < voiceCount; i++)
+    {
+        Voice *voice = new Voice();
+        voice->player = new MediaFilesPlayer();
+        voice->player->setWorkers(workers);
+        voice->player->setLatencyCallback([this, i](double seconds) { signalLatency(i, seconds); });
+        voices.push_back(voice);
+    }
+    microphone = new MicrophonePlayer();
+    microphone->setWorkers(workers);
+    routes.resize(voiceCount + 1);
+    activePlayers.reserve(voiceCount + 1);
+
+    SDL_AddEventWatch(onDeviceEvent, this);
+
+    // Wait until audio thread has its scheduling (status is read without locks afterwards)
+    std::promise<void> started;
+    std::future<void> is_started = started.get_future();
+    audioThread = std::thread(&AudioEngine::process, this, &started);
+    is_started.wait();
+}
+
+
+AudioEngine::~AudioEngine()
+{
+    SDL_RemoveEventWatch(onDeviceEvent, this);
+
+    // Stop audio thread (it ends all player cycles and closes their devices)
+    {
+        std::lock_guard<std::mutex> lock(audioMutex);
+        isProcessing = false;
+    }
+    audioCondition.notify_one();
+    audioThread.join();
+
+    // Finish background jobs (loads wait for stopped players, streams are deleted)
+    delete workers;
+    delete cache;
+
+    // Delete players
+    delete latencyCallback.load();
+    delete microphone;
+    for (Voice *voice : voices)
+    {
+        delete voice->player;
+        delete voice;
+    }
+}
+
+
+AudioEngine::Voice* AudioEngine::voiceAt(int voice)
+{
+    if ((voice < 0) || (voice >= getVoiceCount()))
+        throw std::runtime_error("Audio engine: no voice " + std::to_string(voice));
+    return voices[voice];
+}
+
+
+MediaFilesPlayer* AudioEngine::getVoice(int voice)
+{
+    return voiceAt(voice)->player;
+}
+
+
+void AudioEngine::setLatencyCallback(LatencyCallback callback)
+{
+    LatencyCallback *previous = latencyCallback.exchange(callback ? new LatencyCallback(callback) : nullptr);
+
+    // Audio thread may still run previous callback
+    while (latencyCallers > 0)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    delete previous;
+}
+
+
+void AudioEngine::signalLatency(int voice, double seconds)
+{
+    // Callers are counted before callback is taken, so replaced callback is deleted only after it returns
+    latencyCallers++;
+    LatencyCallback *callback = latencyCallback;
+    if (callback)
+        (*callback)(voice, seconds);
+    latencyCallers--;
+}
+
+
+std::string AudioEngine::getFilepath(int voice)
+{
+    Voice *v = voiceAt(voice);
+    std::lock_guard<std::mutex> lock(v->mutex);
+    return v->player->getFilepath();
+}
+
+
+bool AudioEngine::submit(const EngineCommand &command)
+{
+    // Voice that is being loaded takes its commands after load (checked again under lock, load may end meanwhile)
+    bool is_voice_command = (command.type != EngineCommand::MICROPHONE_START) &&
+                            (command.type != EngineCommand::MICROPHONE_STOP);
+    if (is_voice_command && (command.voice >= 0) && (command.voice < static_cast<int>(voices.size())))
+    {
+        Voice *v = voices[command.voice];
+        if (v->pendingLoads > 0)
+        {
+            std::lock_guard<std::mutex> lock(v->deferredMutex);
+            if (v->pendingLoads > 0)
+            {
+                v->deferredCommands.push_back(command);
+                return true;
+            }
+        }
+    }
+    return enqueue(command);
+}
+
+
+bool AudioEngine::enqueue(const EngineCommand &command)
+{
+    if (!commands.push(command))
+        return false;
+
+    // Wake audio thread
+    hasNewCommands = true;
+    {
+        std::lock_guard<std::mutex> lock(audioMutex);
+    }
+    audioCondition.notify_one();
+    return true;
+}
+
+
+void AudioEngine::submitNow(EngineCommand::Type type, int voice, double value)
+{
+    EngineCommand command;
+    command.type = type;
+    command.voice = voice;
+    command.value = value;
+    if (!submit(command))
+        throw std::runtime_error("Audio engine: command queue is full");
+}
+
+
+AudioPlayer::Routes& AudioEngine::routesOf(int source)
+{
+    if (source == MICROPHONE_SOURCE)
+        return routes.back();
+    voiceAt(source);
+    return routes[source];
+}
+
+
+AudioPlayer* AudioEngine::playerOf(int source)
+{
+    if (source == MICROPHONE_SOURCE)
+        return microphone;
+    return voiceAt(source)->player;
+}
+
+
+bool AudioEngine::isRemoved(SDL_AudioDeviceID device)
+{
+    std::lock_guard<std::mutex> lock(removedDevicesMutex);
+    return std::find(removedDevices.begin(), removedDevices.end(), device) != removedDevices.end();
+}
+
+
+void AudioEngine::forgetRemovedDevices()
+{
+    // Device IDs are not reused, so device is not needed once sources are routed elsewhere
+    std::lock_guard<std::mutex> lock(removedDevicesMutex);
+    removedDevices.erase(std::remove_if(removedDevices.begin(), removedDevices.end(), [this](SDL_AudioDeviceID device)
+    {
+        if (device == inputDevice)
+            return false;
+        for (const AudioPlayer::Routes &source_routes : routes)
+        {
+            for (const AudioPlayer::Route &route : source_routes)
+            {
+                if (route.device == device)
+                    return false;
+            }
+        }
+        return true;
+    }), removedDevices.end());
+}
+
+
+void AudioEngine::offerRoutes(int source)
+{
+    AudioPlayer::Routes offered;
+    for (AudioPlayer::Route route : routesOf(source))
+    {
+        if (isRemoved(route.device))
+            route.device = SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK;
+
+        // Several unplugged devices fall back to same default one, first route wins
+        bool is_taken = std::any_of(offered.begin(), offered.end(), [&route](const AudioPlayer::Route &other)
+        {
+            return other.device == route.device;
+        });
+        if (!is_taken)
+            offered.push_back(route);
+    }
+    playerOf(source)->setRoutes(offered);
+}
+
+
+void AudioEngine::offerInput()
+{
+    microphone->setInputDevice(isRemoved(inputDevice) ? SDL_AUDIO_DEVICE_DEFAULT_RECORDING : inputDevice);
+}
+
+
+void AudioEngine::setInputDevice(SDL_AudioDeviceID device)
+{
+    std::lock_guard<std::mutex> lock(routesMutex);
+    inputDevice = device;
+    offerInput();
+    forgetRemovedDevices();
+}
+
+
+void AudioEngine::setRoute(int source, SDL_AudioDeviceID device, float gain, bool isMuted)
+{
+    std::lock_guard<std::mutex> lock(routesMutex);
+    AudioPlayer::Routes &source_routes = routesOf(source);
+
+    auto route = std::find_if(source_routes.begin(), source_routes.end(), [device](const AudioPlayer::Route &route)
+    {
+        return route.device == device;
+    });
+    if (route == source_routes.end())
+    {
+        if (source_routes.size() >= MAX_PLAYER_ROUTES)
+            throw std::runtime_error("Audio engine: source has " + std::to_string(MAX_PLAYER_ROUTES) + " routes already");
+        source_routes.emplace_back();
+        route = source_routes.end() - 1;
+    }
+    route->device = device;
+    route->gain = gain;
+    route->isMuted = isMuted;
+    offerRoutes(source);
+    forgetRemovedDevices();
+}
+
+
+void AudioEngine::removeRoute(int source, SDL_AudioDeviceID device)
+{
+    std::lock_guard<std::mutex> lock(routesMutex);
+    AudioPlayer::Routes &source_routes = routesOf(source);
+    source_routes.erase(std::remove_if(source_routes.begin(), source_routes.end(), [device](const AudioPlayer::Route &route)
+    {
+        return route.device == device;
+    }), source_routes.end());
+    offerRoutes(source);
+    forgetRemovedDevices();
+}
+
+
+AudioPlayer::Routes AudioEngine::getRoutes(int source)
+{
+    std::lock_guard<std::mutex> lock(routesMutex);
+    return routesOf(source);
+}
+
+
+bool SDLCALL AudioEngine::onDeviceEvent(void *userdata, SDL_Event *event)
+{
+    if (event->type != SDL_EVENT_AUDIO_DEVICE_REMOVED)
+        return true;
+
+    AudioEngine *engine = static_cast<AudioEngine*>(userdata);
+    {
+        std::lock_guard<std::mutex> lock(engine->removedDevicesMutex);
+        engine->removedDevices.push_back(event->adevice.which);
+    }
+
+    // Players reopen their devices on next iteration
+    engine->updateAudioDevices();
+    return true;
+}
+
+
+void AudioEngine::waitForPlayer(AudioPlayer *player)
+{
+    while (player->isActive())
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+
+AudioEngine::AudioThreadStats AudioEngine::getAudioThreadStats() const
+{
+    AudioThreadStats stats;
+    stats.scheduling = realtimeStatus;
+    stats.involuntarySwitches = involuntarySwitches;
+    uint64_t count = wakeupCount;
+    if (count > 0)
+        stats.averageWakeupLatency = totalWakeupLatency / 1e9 / count;
+    stats.maxWakeupLatency = maxWakeupLatency / 1e9;
+    stats.iterations = iterations;
+    return stats;
+}
+
+
+void AudioEngine::process(std::promise<void> *started)
+{
+    realtimeStatus = RealtimeThread::apply(realtimeConfig);
+    Tracer::setThreadName("audio");
+    started->set_value();
+
+    while (isProcessing)
+    {
+        // Take new commands (immediate ones are executed in order of submission)
+        EngineCommand command;
+        Uint64 now = SDL_GetTicksNS();
+        while (commands.pop(command))
+        {
+            if (command.time <= now)
+            {
+                execute(command);
+                continue;
+            }
+            scheduledCommands.push_back(command);
+            std::push_heap(scheduledCommands.begin(), scheduledCommands.end(), isLater);
+        }
+
+        // Execute commands whose time has come
+        now = SDL_GetTicksNS();
+        while (!scheduledCommands.empty() && (scheduledCommands.front().time <= now))
+        {
+            std::pop_heap(scheduledCommands.begin(), scheduledCommands.end(), isLater);
+            execute(scheduledCommands.back());
+            scheduledCommands.pop_back();
+        }
+
+        // Run one iteration of every player cycle
+        iterations.fetch_add(1, std::memory_order_relaxed);
+        bool is_busy = false;
+        for (size_t i = 0; i < activePlayers.size();)
+        {
+            AudioPlayer *player = activePlayers[i];
+            player->getStats().iterations.fetch_add(1, std::memory_order_relaxed);
+            AudioPlayer::CycleResult result = player->process();
+            if (result == AudioPlayer::FINISHED)
+            {
+                player->finish();
+                player->setActive(false);
+                activePlayers[i] = activePlayers.back();
+                activePlayers.pop_back();
+                continue;
+            }
+            is_busy |= (result == AudioPlayer::BUSY);
+            i++;
+        }
+        if (is_busy)
+            continue;
+
+        // Sleep until players need data, next command time (last moments are spent yielding for accuracy) or new command
+        Uint64 timeout = activePlayers.empty() ? AUDIO_THREAD_SLEEP_TIME : AUDIO_THREAD_IDLE_TIME;
+        if (!scheduledCommands.empty())
+        {
+            Uint64 delay = scheduledCommands.front().time - now;
+            if (delay < DISPATCHER_SPIN_TIME)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            timeout = std::min<Uint64>(timeout, delay - DISPATCHER_SPIN_TIME);
+        }
+
+        sleep(timeout);
+    }
+
+    // End remaining player cycles
+    for (AudioPlayer *player : activePlayers)
+    {
+        player->finish();
+        player->setActive(false);
+    }
+    activePlayers.clear();
+}
+
+
+void AudioEngine::sleep(Uint64 timeout)
+{
+    Uint64 deadline = SDL_GetTicksNS() + timeout;
+    bool is_woken;
+    {
+        std::unique_lock<std::mutex> lock(audioMutex);
+        is_woken = audioCondition.wait_for(lock, std::chrono::nanoseconds(timeout), [this]() { return hasNewCommands.exchange(false) || !isProcessing; });
+    }
+
+    // Only timed wakeups tell how late scheduler lets us run
+    if (!is_woken)
+    {
+        Uint64 now = SDL_GetTicksNS();
+        uint64_t latency = (now > deadline) ? now - deadline : 0;
+        wakeupCount++;
+        totalWakeupLatency += latency;
+        if (latency > maxWakeupLatency)
+            maxWakeupLatency = latency;
+    }
+    involuntarySwitches = RealtimeThread::involuntaryContextSwitches();
+}
+
+
+void AudioEngine::execute(const EngineCommand &command)
+{
+    try
+    {
+        if (command.type == EngineCommand::MICROPHONE_START)
+        {
+            microphone->start();
+            if (!microphone->isActive())
+                activate(microphone);
+            return;
+        }
+        if (command.type == EngineCommand::MICROPHONE_STOP)
+        {
+            microphone->stop();
+            return;
+        }
+
+        Voice *v = voiceAt(command.voice);
+        MediaFilesPlayer *player = v->player;
+        switch (command.type)
+        {
+            case EngineCommand::TRIGGER:
+                if (!player->isActive())
+                    startVoice(v);
+                else
+                {
+                    // Rewind running player
+                    player->markTrigger();
+                    player->scheduleTime(0);
+                    player->scheduleState(MediaFilesPlayer::PLAYING);
+                }
+                break;
+            case EngineCommand::PLAY:
+                if (!player->isActive())
+                    startVoice(v);
+                else if (player->getState() == MediaFilesPlayer::PAUSED)
+                {
+                    player->markTrigger();
+                    player->scheduleState(MediaFilesPlayer::PLAYING);
+                }
+                break;
+            case EngineCommand::PAUSE:
+                if (player->isActive() && (player->getState() == MediaFilesPlayer::PLAYING))
+                    player->scheduleState(MediaFilesPlayer::PAUSED);
+                break;
+            case EngineCommand::STOP:
+                if (player->isActive())
+                    player->scheduleState(MediaFilesPlayer::STOPPED);
+                break;
+            case EngineCommand::SEEK:
+                player->markTrigger();
+                player->scheduleTime(command.value);
+                break;
+            case EngineCommand::GAIN:
+                player->setVolume(command.value);
+                break;
+            default:
+                break;
+        }
+    }
+    catch(const std::exception& e)
+    {
+        // Commands come from remote sources, invalid ones are just dropped
+        #ifdef DEBUG
+            printf("Engine command dropped: %s\n", e.what());
+        #endif
+    }
+}
+
+
+void AudioEngine::startVoice(Voice *voice)
+{
+    // Claim player before checking for track change (track changer checks in reverse order)
+    voice->player->setActive(true);
+    if (voice->isLoading)
+    {
+        voice->player->setActive(false);
+        return;
+    }
+
+    voice->player->markTrigger();
+    voice->player->scheduleState(MediaFilesPlayer::PLAYING);
+    activate(voice->player);
+}
+
+
+void AudioEngine::activate(AudioPlayer *player)
+{
+    player->setActive(true);
+    if (player->prepare())
+    {
+        activePlayers.push_back(player);
+    }
+    else
+    {
+        // Nothing to play
+        player->finish();
+        player->setActive(false);
+    }
+}
+
+
+void AudioEngine::load(int voice, const std::string &filepath)
+{
+    Voice *v = voiceAt(voice);
+    std::lock_guard<std::mutex> lock(v->mutex);
+
+    // Keep audio thread away from player while track is changed
+    v->isLoading = true;
+    try
+    {
+        halt(v, voice);
+    }
+    catch(...)
+    {
+        v->isLoading = false;
+        throw;
+    }
+    std::string previous = v->player->getFilepath();
+    v->player->setTrack(filepath);
+    applyClip(v->player, clipOf(filepath));
+    v->player->setRegion(getClipRegion(filepath));
+    v->player->setHead(cache->find(filepath));
+    repin(previous, v->player->getFilepath());
+    v->isLoading = false;
+
+    // Start is decoded before voice is triggered
+    prefetch(filepath);
+}
+
+
+void AudioEngine::prefetch(const std::string &filepath)
+{
+    cache->prefetch(filepath, clipOf(filepath).audibleStart, getClipRegion(filepath).in);
+}
+
+
+void AudioEngine::repin(const std::string &previous, const std::string &filepath)
+{
+    // Pin new file first, so clip of file that stays is never unpinned in between
+    if (!filepath.empty())
+        cache->pin(filepath);
+    if (!previous.empty())
+        cache->unpin(previous);
+}
+
+
+void AudioEngine::setClipAnalysis(const std::string &filepath, const ClipAnalysis &analysis)
+{
+    {
+        std::lock_guard<std::mutex> lock(clipsMutex);
+        if (analysis.isMeasured())
+            clips[filepath] = analysis;
+        else
+            clips.erase(filepath);
+    }
+
+    // Voices that already hold the file apply it on next trigger (their start is decoded again from new bounds)
+    bool is_loaded = false;
+    for (Voice *v : voices)
+    {
+        std::lock_guard<std::mutex> lock(v->mutex);
+        if (v->player->getFilepath() == filepath)
+        {
+            applyClip(v->player, analysis);
+            is_loaded = true;
+        }
+    }
+    if (is_loaded)
+        prefetch(filepath);
+}
+
+
+void AudioEngine::setClipRegion(const std::string &filepath, const MediaFilesPlayer::Region &region)
+{
+    // Loop is held in memory by every voice that plays it
+    if (region.hasLoop() && (region.loopEnd - region.loopStart > MAX_LOOP_TIME))
+        throw std::runtime_error("Audio engine: loop is longer than " + std::to_string(MAX_LOOP_TIME) + " s");
+
+    {
+        std::lock_guard<std::mutex> lock(clipsMutex);
+        if (!region.isEmpty())
+            regions[filepath] = region;
+        else
+            regions.erase(filepath);
+    }
+
+    // Voices that already hold the file apply it on next trigger (their start is decoded again from new bounds)
+    bool is_loaded = false;
+    for (Voice *v : voices)
+    {
+        std::lock_guard<std::mutex> lock(v->mutex);
+        if (v->player->getFilepath() == filepath)
+        {
+            v->player->setRegion(region);
+            is_loaded = true;
+        }
+    }
+    if (is_loaded)
+        prefetch(filepath);
+}
+
+
+MediaFilesPlayer::Region AudioEngine::getClipRegion(const std::string &filepath)
+{
+    std::lock_guard<std::mutex> lock(clipsMutex);
+    auto region = regions.find(filepath);
+    return (region != regions.end()) ? region->second : MediaFilesPlayer::Region();
+}
+
+
+float AudioEngine::normalizationGain(double loudness, double truePeak)
+{
+    if (!std::isfinite(loudness))
+        return 1;
+
+    double gain = std::min(NORMALIZATION_TARGET - loudness, MAX_NORMALIZATION_BOOST);
+    if (std::isfinite(truePeak))
+        gain = std::min(gain, TRUE_PEAK_CEILING - truePeak);
+    return static_cast<float>(std::pow(10.0, gain / 20));
+}
+
+
+ClipAnalysis AudioEngine::clipOf(const std::string &filepath)
+{
+    std::lock_guard<std::mutex> lock(clipsMutex);
+    auto clip = clips.find(filepath);
+    return (clip != clips.end()) ? clip->second : ClipAnalysis();
+}
+
+
+void AudioEngine::applyClip(MediaFilesPlayer *player, const ClipAnalysis &analysis)
+{
+    player->setClip(normalizationGain(analysis.loudness, analysis.truePeak), analysis.audibleStart, analysis.audibleEnd);
+}
+
+
+void AudioEngine::loadAsync(int voice, const std::string &filepath)
+{
+    Voice *v = voiceAt(voice);
+    v->pendingLoads++;
+    workers->submit([this, v, voice, filepath]()
+    {
+        // Failure is reported like failure to open file, voice is released either way
+        try
+        {
+            load(voice, filepath);
+        }
+        catch(const std::exception& e)
+        {
+            v->player->signalError(e.what());
+        }
+        catch(...)
+        {
+            v->player->signalError("Unable to load " + filepath);
+        }
+
+        // Commands held back by last queued load follow it
+        std::lock_guard<std::mutex> lock(v->deferredMutex);
+        if (--v->pendingLoads > 0)
+            return;
+        for (const EngineCommand &command : v->deferredCommands)
+        {
+            if (!enqueue(command))
+                v->player->signalError("Audio engine: command queue is full");
+        }
+        v->deferredCommands.clear();
+    }, WorkerPool::HIGH);
+}
+
+
+bool AudioEngine::isLoadPending(int voice)
+{
+    return voiceAt(voice)->pendingLoads > 0;
+}
+
+
+void AudioEngine::swap(int voice, const std::string &filepath)
+{
+    voiceAt(voice);
+    workers->submit([this, voice, filepath]()
+    {
+        Voice *v = voices[voice];
+        {
+            std::lock_guard<std::mutex> lock(v->mutex);
+            if (v->player->isActive())
+            {
+                // Running player takes new track with its clip and region (player that stops meanwhile takes
+                // it when started)
+                std::string current = v->player->getFilepath();
+                applyClip(v->player, clipOf(filepath));
+                v->player->setRegion(getClipRegion(filepath));
+                v->player->setHead(cache->find(filepath));
+                if (!v->player->offerTrack(filepath))
+                {
+                    applyClip(v->player, clipOf(current));
+                    v->player->setRegion(getClipRegion(current));
+                    v->player->setHead(cache->find(current));
+                }
+                repin(current, v->player->getFilepath());
+                return;
+            }
+        }
+        load(voice, filepath);
+    }, WorkerPool::HIGH);
+}
+
+
+void AudioEngine::unload(int voice)
+{
+    Voice *v = voiceAt(voice);
+    std::lock_guard<std::mutex> lock(v->mutex);
+
+    v->isLoading = true;
+    try
+    {
+        halt(v, voice);
+    }
+    catch(...)
+    {
+        v->isLoading = false;
+        throw;
+    }
+    std::string previous = v->player->getFilepath();
+    v->player->removeTrack();
+    repin(previous, "");
+    v->isLoading = false;
+}
+
+
+void AudioEngine::play(int voice)
+{
+    voiceAt(voice);
+    submitNow(EngineCommand::PLAY, voice);
+}
+
+
+void AudioEngine::pause(int voice)
+{
+    voiceAt(voice);
+    submitNow(EngineCommand::PAUSE, voice);
+}
+
+
+void AudioEngine::trigger(int voice)
+{
+    voiceAt(voice);
+    submitNow(EngineCommand::TRIGGER, voice);
+}
+
+
+void AudioEngine::stop(int voice, bool wait)
+{
+    Voice *v = voiceAt(voice);
+    submitNow(EngineCommand::STOP, voice);
+    if (wait)
+        waitForPlayer(v->player);
+}
+
+
+void AudioEngine::halt(Voice *voice, int index)
+{
+    EngineCommand command;
+    command.type = EngineCommand::STOP;
+    command.voice = index;
+    if (!enqueue(command))
+        throw std::runtime_error("Audio engine: command queue is full");
+    waitForPlayer(voice->player);
+}
+
+
+void AudioEngine::seek(int voice, double seconds)
+{
+    voiceAt(voice);
+    submitNow(EngineCommand::SEEK, voice, seconds);
+}
+
+
+void AudioEngine::setGain(int voice, float gain)
+{
+    voiceAt(voice);
+    submitNow(EngineCommand::GAIN, voice, gain);
+}
+
+
+void AudioEngine::startMicrophone()
+{
+    // Report running state right away, audio thread starts player cycle
+    microphone->start();
+    submitNow(EngineCommand::MICROPHONE_START);
+}
+
+
+void AudioEngine::stopMicrophone()
+{
+    microphone->stop();
+    submitNow(EngineCommand::MICROPHONE_STOP);
+    waitForPlayer(microphone);
+}
+
+
+void AudioEngine::updateAudioDevices()
+{
+    // Players keep streams of devices that did not change and reopen the rest
+    std::lock_guard<std::mutex> lock(routesMutex);
+    offerInput();
+    for (int source = MICROPHONE_SOURCE; source < getVoiceCount(); source++)
+        offerRoutes(source);
+    forgetRemovedDevices();
+}
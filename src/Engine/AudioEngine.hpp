@@ -0,0 +1,464 @@
+#pragma once
+
+
+// Strings
+#include <string>
+// Containers
+#include <vector>
+#include <unordered_map>
+// Threads
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+// Media files player
+#include <AudioPlayers/MediaFilesPlayer.hpp>
+// Microphone rerouter
+#include <AudioPlayers/MicrophonePlayer.hpp>
+// Engine commands
+#include <Engine/EngineCommand.hpp>
+#include <Engine/CommandQueue.hpp>
+// Background jobs
+#include <Engine/WorkerPool.hpp>
+// Prefetched starts of tracks
+#include <Engine/ClipCache.hpp>
+// Audio thread scheduling
+#include <Engine/RealtimeThread.hpp>
+// Clip loudness and silence
+#include <Library/ClipAnalysis.hpp>
+
+
+/**
+ * Owns players, audio thread they run on and worker pool for background jobs. Single entry point for
+ * every control surface (GUI, CLI, sockets).
+ *
+ * Playback control is asynchronous: commands are queued lock-free and executed by audio thread, which
+ * runs cycles of all active players. Audio thread never blocks on control surfaces, file opening and
+ * other slow work is done by callers or by worker pool.
+ */
+class AudioEngine
+{
+public:
+
+    // Source index of microphone rerouter in routing matrix (voices are sources 0 .. voice count - 1).
+    static const int MICROPHONE_SOURCE = -1;
+
+    /**
+     * Receives voice index and measured trigger latency in seconds.
+     */
+    typedef std::function<void(int, double)> LatencyCallback;
+
+    /**
+     * Audio thread statistics.
+     */
+    struct AudioThreadStats
+    {
+        // Scheduling achieved by audio thread.
+        RealtimeStatus scheduling;
+        // Number of times audio thread was preempted (negative if unknown).
+        long involuntarySwitches = -1;
+        // Average delay between planned and actual wakeup in seconds.
+        double averageWakeupLatency = 0;
+        // Longest delay between planned and actual wakeup in seconds.
+        double maxWakeupLatency = 0;
+        // Number of audio thread cycle iterations.
+        uint64_t iterations = 0;
+    };
+
+private:
+
+    /**
+     * Media files player with its control state.
+     */
+    struct Voice
+    {
+        // Player.
+        MediaFilesPlayer *player = nullptr;
+        // Serializes track changes.
+        std::mutex mutex;
+        // Raised while track is being changed (audio thread must not start player).
+        std::atomic<bool> isLoading = false;
+        // Number of loads queued on worker pool.
+        std::atomic<int> pendingLoads = 0;
+        // Commands submitted while loads were queued, submitted in order once last one is done.
+        std::vector<EngineCommand> deferredCommands;
+        // Guards deferredCommands (never held while track is changed).
+        std::mutex deferredMutex;
+    };
+
+    // Media files players.
+    std::vector<Voice*> voices;
+
+    // Microphone rerouter.
+    MicrophonePlayer *microphone = nullptr;
+
+    // Notified about trigger latency of all voices (replaced while audio thread may call it).
+    std::atomic<LatencyCallback*> latencyCallback = nullptr;
+    // Number of threads running latency callback right now.
+    std::atomic<int> latencyCallers = 0;
+
+    // Analysis of each measured media file.
+    std::unordered_map<std::string, ClipAnalysis> clips;
+    // Region of each media file chosen by user.
+    std::unordered_map<std::string, MediaFilesPlayer::Region> regions;
+    // Guards clips and regions.
+    std::mutex clipsMutex;
+
+    // Background jobs.
+    WorkerPool *workers = nullptr;
+    // Decoded starts of tracks user is likely to play.
+    ClipCache *cache = nullptr;
+
+    // Outputs chosen by user for each source (voices, then microphone).
+    std::vector<AudioPlayer::Routes> routes;
+    // Recording device chosen by user.
+    SDL_AudioDeviceID inputDevice = SDL_AUDIO_DEVICE_DEFAULT_RECORDING;
+    // Guards routes and inputDevice.
+    std::mutex routesMutex;
+
+    // Unplugged devices that routes or input still point to (players fall back to default devices).
+    std::vector<SDL_AudioDeviceID> removedDevices;
+    std::mutex removedDevicesMutex;
+
+    // Commands submitted by control surfaces.
+    CommandQueue<EngineCommand> commands;
+    // Commands waiting for their time (heap ordered by time, used only by audio thread).
+    std::vector<EngineCommand> scheduledCommands;
+    // Players whose cycles are run (used only by audio thread).
+    std::vector<AudioPlayer*> activePlayers;
+    // Thread that executes commands and runs player cycles.
+    std::thread audioThread;
+    // Whether audio thread should run.
+    std::atomic<bool> isProcessing = true;
+    // Raised when new command is submitted.
+    std::atomic<bool> hasNewCommands = false;
+    // Used to sleep until players need data or new command arrives.
+    std::mutex audioMutex;
+    std::condition_variable audioCondition;
+
+    // Requested audio thread scheduling.
+    RealtimeConfig realtimeConfig;
+    // Achieved audio thread scheduling (written once before audio thread cycle starts).
+    RealtimeStatus realtimeStatus;
+    // Number of times audio thread was preempted.
+    std::atomic<long> involuntarySwitches = -1;
+    // Number of timed wakeups of audio thread.
+    std::atomic<uint64_t> wakeupCount = 0;
+    // Sum of wakeup delays in nanoseconds.
+    std::atomic<uint64_t> totalWakeupLatency = 0;
+    // Longest wakeup delay in nanoseconds.
+    std::atomic<uint64_t> maxWakeupLatency = 0;
+    // Number of audio thread cycle iterations.
+    std::atomic<uint64_t> iterations = 0;
+
+public:
+
+    /**
+     * Constructor. Sources have no output routes until they are set.
+     * 
+     * @param voiceCount number of media files players
+     * @param realtime scheduling requested for audio thread
+     */
+    explicit AudioEngine(int voiceCount, const RealtimeConfig &realtime = RealtimeConfig());
+    /**
+     * Destructor. Stops all players.
+     */
+    ~AudioEngine();
+
+    /**
+     * @return number of media files players
+     */
+    int getVoiceCount() const { return static_cast<int>(voices.size()); }
+
+    /**
+     * @return media files player (to attach callbacks)
+     * 
+     * @throws Runtime Error if there is no such voice.
+     */
+    MediaFilesPlayer* getVoice(int voice);
+
+    /**
+     * @return microphone rerouter (to attach callbacks)
+     */
+    MicrophonePlayer* getMicrophone() { return microphone; }
+
+    /**
+     * @return pool for background jobs
+     */
+    WorkerPool* getWorkers() { return workers; }
+
+    /**
+     * @return decoded starts of tracks (to pin favorites, change budget and read statistics)
+     */
+    ClipCache* getCache() { return cache; }
+
+    /**
+     * @return audio thread scheduling, preemption and wakeup latency
+     */
+    AudioThreadStats getAudioThreadStats() const;
+
+    /**
+     * Replaces latency callback (safe while voices play, returns once previous callback no longer runs).
+     *
+     * @param callback function that will receive trigger latency measurements of all voices (called from
+     *        audio thread, must not block)
+     */
+    void setLatencyCallback(LatencyCallback callback);
+
+    /**
+     * @return media file path loaded into voice (empty if there is none)
+     */
+    std::string getFilepath(int voice);
+
+    /**
+     * Remembers analysis of media file. Voices that load it play only its audible part at normalized level
+     * (both are applied when playback is requested, never in the middle of it).
+     *
+     * @param analysis measurements of media file (unmeasured one forgets file)
+     */
+    void setClipAnalysis(const std::string &filepath, const ClipAnalysis &analysis);
+
+    /**
+     * Remembers in/out points and loop of media file. Voices that load it apply them when playback is
+     * requested.
+     *
+     * @param region region of media file (empty one forgets file)
+     *
+     * @throws Runtime Error if loop is longer than MAX_LOOP_TIME.
+     */
+    void setClipRegion(const std::string &filepath, const MediaFilesPlayer::Region &region);
+
+    /**
+     * @return region of media file (empty if there is none)
+     */
+    MediaFilesPlayer::Region getClipRegion(const std::string &filepath);
+
+    /**
+     * @return linear gain that brings clip to target loudness without pushing its true peak over ceiling
+     *         (1 for silence)
+     */
+    static float normalizationGain(double loudness, double truePeak);
+
+    /**
+     * Submits command without blocking. Commands are executed in order of their time (or immediately),
+     * commands for voice that is being loaded by worker pool wait until it is loaded.
+     * 
+     * @return false if command queue is full
+     */
+    bool submit(const EngineCommand &command);
+
+    /**
+     * Decodes start of media file in background (user is likely to play it soon). Voices play it from
+     * memory once they load it.
+     */
+    void prefetch(const std::string &filepath);
+
+    /**
+     * Stops voice and loads media file into it.
+     */
+    void load(int voice, const std::string &filepath);
+    /**
+     * Loads media file into voice on worker pool. Errors are reported by player, commands submitted for
+     * voice meanwhile follow load.
+     */
+    void loadAsync(int voice, const std::string &filepath);
+    /**
+     * @return whether voice has load queued on worker pool
+     */
+    bool isLoadPending(int voice);
+    /**
+     * Replaces media file of voice without blocking caller. File is opened on worker pool, running voice
+     * crossfades into it on audio thread, other voices just load it. Errors are reported by player.
+     */
+    void swap(int voice, const std::string &filepath);
+    /**
+     * Stops voice and removes its media file.
+     */
+    void unload(int voice);
+
+    /**
+     * Starts voice if it is stopped or resumes it if it is paused.
+     *
+     * @throws Runtime Error if there is no such voice or command queue is full.
+     */
+    void play(int voice);
+    /**
+     * Pauses voice if it is playing.
+     */
+    void pause(int voice);
+    /**
+     * Plays voice from the beginning (restarts it if it is already playing).
+     */
+    void trigger(int voice);
+    /**
+     * Stops voice.
+     * 
+     * @param wait whether to wait until player cycle ends
+     */
+    void stop(int voice, bool wait = false);
+    /**
+     * Changes voice timestamp.
+     */
+    void seek(int voice, double seconds);
+    /**
+     * Changes voice volume.
+     */
+    void setGain(int voice, float gain);
+
+    /**
+     * Starts microphone rerouter.
+     */
+    void startMicrophone();
+    /**
+     * Stops microphone rerouter and waits for it to end.
+     */
+    void stopMicrophone();
+
+    /**
+     * Changes recording device of microphone rerouter.
+     */
+    void setInputDevice(SDL_AudioDeviceID device);
+
+    /**
+     * Sends source to playback device or changes gain and mute of its existing route. Every device is
+     * opened once however many sources are routed to it, and each source is decoded once however many
+     * devices it is routed to.
+     *
+     * @param source voice index or MICROPHONE_SOURCE
+     * @param gain linear gain of route
+     * @param isMuted whether route is silenced (its stream stays open)
+     *
+     * @throws Runtime Error if there is no such source or it already has MAX_PLAYER_ROUTES routes.
+     */
+    void setRoute(int source, SDL_AudioDeviceID device, float gain, bool isMuted = false);
+    /**
+     * Stops sending source to playback device.
+     */
+    void removeRoute(int source, SDL_AudioDeviceID device);
+    /**
+     * @return outputs chosen for source
+     */
+    AudioPlayer::Routes getRoutes(int source);
+
+    /**
+     * Offers routes and input device again, so players move off unplugged devices.
+     */
+    void updateAudioDevices();
+
+private:
+
+    /**
+     * @return voice by index
+     * 
+     * @throws Runtime Error if there is no such voice.
+     */
+    Voice* voiceAt(int voice);
+
+    /**
+     * @return analysis of media file (unmeasured if there is none)
+     */
+    ClipAnalysis clipOf(const std::string &filepath);
+
+    /**
+     * Moves pin of voice from previous media file to new one (tracks held by voices are never dropped from
+     * cache).
+     */
+    void repin(const std::string &previous, const std::string &filepath);
+
+    /**
+     * Passes analysis to player of voice.
+     */
+    static void applyClip(MediaFilesPlayer *player, const ClipAnalysis &analysis);
+
+    /**
+     * Submits command that must be executed immediately.
+     *
+     * @throws Runtime Error if command queue is full.
+     */
+    void submitNow(EngineCommand::Type type, int voice = 0, double value = 0);
+    /**
+     * Pushes command to audio thread and wakes it (commands of voices being loaded are not held back).
+     *
+     * @return false if command queue is full
+     */
+    bool enqueue(const EngineCommand &command);
+    /**
+     * Stops voice and waits until audio thread leaves it (track changers hold voice mutex).
+     *
+     * @throws Runtime Error if command queue is full.
+     */
+    void halt(Voice *voice, int index);
+
+    /**
+     * @return routes of source
+     *
+     * @throws Runtime Error if there is no such source.
+     */
+    AudioPlayer::Routes& routesOf(int source);
+
+    /**
+     * @return player of source
+     */
+    AudioPlayer* playerOf(int source);
+
+    /**
+     * @return whether device was unplugged
+     */
+    bool isRemoved(SDL_AudioDeviceID device);
+
+    /**
+     * Passes routes of source to its player, unplugged devices are replaced by default one (routesMutex
+     * must be held).
+     */
+    void offerRoutes(int source);
+
+    /**
+     * Passes input device to microphone rerouter, default one if it was unplugged (routesMutex must be
+     * held).
+     */
+    void offerInput();
+
+    /**
+     * Forgets unplugged devices no route or input points to anymore (routesMutex must be held).
+     */
+    void forgetRemovedDevices();
+
+    /**
+     * Moves players off unplugged devices (called from SDL event thread).
+     */
+    static bool SDLCALL onDeviceEvent(void *userdata, SDL_Event *event);
+
+    /**
+     * Passes trigger latency of voice to latency callback (audio thread).
+     */
+    void signalLatency(int voice, double seconds);
+
+    /**
+     * Waits until audio thread stops running player cycle.
+     */
+    void waitForPlayer(AudioPlayer *player);
+
+    /**
+     * Audio thread cycle. Executes submitted commands when their time comes and runs player cycles.
+     *
+     * @param started fulfilled once scheduling is applied
+     */
+    void process(std::promise<void> *started);
+    /**
+     * Sleeps until timeout or new command and measures wakeup latency (audio thread).
+     */
+    void sleep(Uint64 timeout);
+    /**
+     * Executes single command (audio thread).
+     */
+    void execute(const EngineCommand &command);
+
+    /**
+     * Starts player cycle of voice from requested state (audio thread).
+     */
+    void startVoice(Voice *voice);
+    /**
+     * Starts player cycle (audio thread).
+     */
+    void activate(AudioPlayer *player);
+};
@@ -0,0 +1,360 @@
+#include <Engine/ClipCache.hpp>
+
+
+// Rounding
+#include <cmath>
+// Min/max
+#include <algorithm>
+// FFMPEG media files reader
+#include <FFMPEG/AudioTrackReader.hpp>
+// SIMD
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define CLIPS_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define CLIPS_NEON
+#endif
+
+
+// Length of decoded start of media file (seconds)
+#define PREFETCH_TIME 0.5
+// Default memory budget (bytes)
+#define CLIP_CACHE_BUDGET (64 * 1024 * 1024)
+// Scale of 16-bit samples
+#define PACKED_SCALE 32767.0f
+
+
+/**
+ * Converts float samples to 16-bit ones (clipped to [-1, 1]).
+ */
+static void packSamples(const float *source, int16_t *destination, size_t count)
+{
+    size_t i = 0;
+#if defined(CLIPS_SSE2)
+    const __m128 low = _mm_set1_ps(-1.0f), high = _mm_set1_ps(1.0f), scale = _mm_set1_ps(PACKED_SCALE);
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128 first = _mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(source + i), low), high), scale);
+        __m128 second = _mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(source + i + 4), low), high), scale);
+        __m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(first), _mm_cvtps_epi32(second));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i), packed);
+    }
+#elif defined(CLIPS_NEON)
+    const float32x4_t low = vdupq_n_f32(-1.0f), high = vdupq_n_f32(1.0f), scale = vdupq_n_f32(PACKED_SCALE);
+    for (; i + 8 <= count; i += 8)
+    {
+        float32x4_t first = vmulq_f32(vminq_f32(vmaxq_f32(vld1q_f32(source + i), low), high), scale);
+        float32x4_t second = vmulq_f32(vminq_f32(vmaxq_f32(vld1q_f32(source + i + 4), low), high), scale);
+        int16x8_t packed = vcombine_s16(vqmovn_s32(vcvtnq_s32_f32(first)), vqmovn_s32(vcvtnq_s32_f32(second)));
+        vst1q_s16(destination + i, packed);
+    }
+#endif
+    // Tail (and everything without SIMD)
+    for (; i < count; i++)
+        destination[i] = static_cast<int16_t>(std::lrint(std::clamp(source[i], -1.0f, 1.0f) * PACKED_SCALE));
+}
+
+
+/**
+ * Converts 16-bit samples to float ones.
+ */
+static void unpackSamples(const int16_t *source, float *destination, size_t count)
+{
+    size_t i = 0;
+#if defined(CLIPS_SSE2)
+    const __m128 scale = _mm_set1_ps(1.0f / PACKED_SCALE);
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+        // Sign extend by moving each sample into upper half of 32-bit lane and shifting it back
+        __m128i first = _mm_srai_epi32(_mm_unpacklo_epi16(packed, packed), 16);
+        __m128i second = _mm_srai_epi32(_mm_unpackhi_epi16(packed, packed), 16);
+        _mm_storeu_ps(destination + i, _mm_mul_ps(_mm_cvtepi32_ps(first), scale));
+        _mm_storeu_ps(destination + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(second), scale));
+    }
+#elif defined(CLIPS_NEON)
+    const float32x4_t scale = vdupq_n_f32(1.0f / PACKED_SCALE);
+    for (; i + 8 <= count; i += 8)
+    {
+        int16x8_t packed = vld1q_s16(source + i);
+        vst1q_f32(destination + i, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(packed))), scale));
+        vst1q_f32(destination + i + 4, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(packed))), scale));
+    }
+#endif
+    // Tail (and everything without SIMD)
+    for (; i < count; i++)
+        destination[i] = source[i] * (1.0f / PACKED_SCALE);
+}
+
+
+ClipCache::ClipCache(WorkerPool *workers)
+{
+    this->workers = workers;
+    budget = CLIP_CACHE_BUDGET;
+}
+
+
+void ClipCache::setClipCallback(ClipCallback callback)
+{
+    clipCallback = callback;
+}
+
+
+void ClipCache::setBudget(size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    budget = bytes;
+    enforceBudget();
+}
+
+
+void ClipCache::pin(const std::string &filepath)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (pins[filepath]++ > 0)
+        return;
+
+    // Pinned clips are kept as floats
+    auto entry = entries.find(filepath);
+    if (entry == entries.end())
+        return;
+    entry->second.isPinned = true;
+    if (!entry->second.clip)
+    {
+        unpack(filepath, entry->second);
+        enforceBudget();
+    }
+}
+
+
+void ClipCache::unpin(const std::string &filepath)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto pin = pins.find(filepath);
+    if ((pin == pins.end()) || (--pin->second > 0))
+        return;
+    pins.erase(pin);
+
+    auto entry = entries.find(filepath);
+    if (entry == entries.end())
+        return;
+    entry->second.isPinned = false;
+    enforceBudget();
+}
+
+
+void ClipCache::prefetch(const std::string &filepath, int64_t start, double inPoint)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto entry = entries.find(filepath);
+        if ((entry != entries.end()) &&
+            (entry->second.start == ((inPoint >= 0) ? std::llround(inPoint * entry->second.sampleRate) : start)))
+        {
+            entry->second.lastUse = ++useClock;
+            return;
+        }
+        if (!pending.insert(filepath).second)
+            return;
+    }
+
+    workers->submit([this, filepath, start, inPoint]()
+    {
+        std::shared_ptr<CachedClip> clip;
+        try
+        {
+            clip = decode(filepath, start, inPoint);
+        }
+        catch(const std::exception&)
+        {
+            // Player reports broken file once it opens it
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending.erase(filepath);
+        }
+        if (!clip)
+            return;
+
+        store(clip);
+        if (clipCallback)
+            clipCallback(clip);
+    }, WorkerPool::LOW);
+}
+
+
+std::shared_ptr<const CachedClip> ClipCache::find(const std::string &filepath)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto entry = entries.find(filepath);
+    if (entry == entries.end())
+    {
+        misses++;
+        return nullptr;
+    }
+
+    entry->second.lastUse = ++useClock;
+    if (entry->second.clip)
+    {
+        hits++;
+        return entry->second.clip;
+    }
+
+    packedHits++;
+    unpack(filepath, entry->second);
+    // Keep clip even if unpacking it pushed cache over budget (caller is about to play it)
+    std::shared_ptr<const CachedClip> clip = entry->second.clip;
+    enforceBudget();
+    return clip;
+}
+
+
+ClipCache::Stats ClipCache::getStats()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Stats stats;
+    stats.budget = budget;
+    stats.residentBytes = residentBytes;
+    stats.clips = entries.size();
+    for (const auto &[filepath, entry] : entries)
+    {
+        if (!entry.clip)
+        {
+            stats.packedBytes += entry.bytes();
+            stats.packedClips++;
+        }
+        if (entry.isPinned)
+            stats.pinnedClips++;
+    }
+    stats.hits = hits;
+    stats.packedHits = packedHits;
+    stats.misses = misses;
+    stats.evictions = evictions;
+    return stats;
+}
+
+
+std::shared_ptr<CachedClip> ClipCache::decode(const std::string &filepath, int64_t start, double inPoint)
+{
+    AudioTrackContext track(filepath);
+    track.init();
+
+    std::shared_ptr<CachedClip> clip = std::make_shared<CachedClip>();
+    clip->filepath = filepath;
+    clip->channels = track.getChannelCount();
+    clip->sampleRate = track.getSampleRate();
+    clip->start = (inPoint >= 0) ? std::llround(inPoint * clip->sampleRate) : start;
+
+    // Decode exactly from where playback starts
+    int64_t end = clip->start + std::llround(PREFETCH_TIME * clip->sampleRate);
+    clip->samples.reserve(static_cast<size_t>(end - clip->start) * clip->channels);
+    track.setSample(clip->start);
+    while (true)
+    {
+        track.read();
+        int64_t count = std::min<int64_t>(track.getAudioDataSamplesCount(), end - track.getSamplePosition());
+        if (count <= 0)
+            break;
+        const float *data = reinterpret_cast<const float*>(track.getAudioData()[0]);
+        clip->samples.insert(clip->samples.end(), data, data + count * clip->channels);
+    }
+    return clip->samples.empty() ? nullptr : clip;
+}
+
+
+void ClipCache::store(std::shared_ptr<CachedClip> clip)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Entry &entry = entries[clip->filepath];
+    residentBytes -= entry.bytes();
+
+    // Trigger count belongs to file, not to its latest clip
+    if (!entry.triggers)
+        entry.triggers = std::make_shared<std::atomic<uint32_t>>(0);
+    clip->triggers = entry.triggers;
+
+    entry.clip = clip;
+    entry.channels = clip->channels;
+    entry.sampleRate = clip->sampleRate;
+    entry.start = clip->start;
+    entry.packed.clear();
+    entry.packed.shrink_to_fit();
+    entry.lastUse = ++useClock;
+    entry.isPinned = pins.count(clip->filepath) > 0;
+    residentBytes += entry.bytes();
+    enforceBudget();
+}
+
+
+double ClipCache::scoreOf(const Entry &entry) const
+{
+    double triggers = entry.triggers ? entry.triggers->load(std::memory_order_relaxed) : 0;
+    return (1 + triggers) / static_cast<double>(1 + useClock - entry.lastUse);
+}
+
+
+void ClipCache::pack(Entry &entry)
+{
+    residentBytes -= entry.bytes();
+    entry.packed.resize(entry.clip->samples.size());
+    packSamples(entry.clip->samples.data(), entry.packed.data(), entry.packed.size());
+    // Players that hold float clip keep it until they are done with it
+    entry.clip = nullptr;
+    residentBytes += entry.bytes();
+}
+
+
+void ClipCache::unpack(const std::string &filepath, Entry &entry)
+{
+    std::shared_ptr<CachedClip> clip = std::make_shared<CachedClip>();
+    clip->filepath = filepath;
+    clip->channels = entry.channels;
+    clip->sampleRate = entry.sampleRate;
+    clip->start = entry.start;
+    clip->triggers = entry.triggers;
+    clip->samples.resize(entry.packed.size());
+    unpackSamples(entry.packed.data(), clip->samples.data(), clip->samples.size());
+
+    residentBytes -= entry.bytes();
+    entry.clip = clip;
+    entry.packed.clear();
+    entry.packed.shrink_to_fit();
+    residentBytes += entry.bytes();
+}
+
+
+void ClipCache::enforceBudget()
+{
+    // Pack float clips worth least first, then drop packed clips worth least
+    for (bool isPacking : {true, false})
+    {
+        while (residentBytes > budget)
+        {
+            auto victim = entries.end();
+            double victimScore = 0;
+            for (auto entry = entries.begin(); entry != entries.end(); entry++)
+            {
+                if (entry->second.isPinned || (static_cast<bool>(entry->second.clip) != isPacking))
+                    continue;
+                double score = scoreOf(entry->second);
+                if ((victim == entries.end()) || (score < victimScore))
+                {
+                    victim = entry;
+                    victimScore = score;
+                }
+            }
+            if (victim == entries.end())
+                break;
+
+            if (isPacking)
+                pack(victim->second);
+            else
+            {
+                residentBytes -= victim->second.bytes();
+                entries.erase(victim);
+                evictions++;
+            }
+        }
+    }
+}
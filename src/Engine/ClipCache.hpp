@@ -0,0 +1,227 @@
+#pragma once
+
+
+// Strings
+#include <string>
+// Containers
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+// Shared clips
+#include <memory>
+// Callbacks
+#include <functional>
+// Threads
+#include <mutex>
+#include <atomic>
+// Fixed width integers
+#include <cstdint>
+// Background jobs
+#include <Engine/WorkerPool.hpp>
+
+
+/**
+ * Decoded start of media file. Immutable once it is cached, so players read it without locks.
+ */
+struct CachedClip
+{
+    // Media file.
+    std::string filepath;
+    // Track format.
+    int channels = 0;
+    int sampleRate = 0;
+    // First sample (counted in track sample rate from timestamp 0).
+    int64_t start = 0;
+    // Interleaved samples.
+    std::vector<float> samples;
+    // Number of times playback started from clip (shared by every copy of clip, counted by audio thread).
+    std::shared_ptr<std::atomic<uint32_t>> triggers;
+
+    /**
+     * @return number of frames
+     */
+    int64_t getFrameCount() const { return (channels > 0) ? static_cast<int64_t>(samples.size()) / channels : 0; }
+};
+
+
+/**
+ * Keeps decoded starts of media files user is likely to play next, so their first audio is written
+ * without waiting for decoder. Clips are prefetched on worker pool at low priority, which also brings
+ * container headers into system file cache before player opens the file.
+ *
+ * Cache stays within memory budget. Over budget, clips that were used least recently and triggered least
+ * often are first packed into 16-bit samples (half the size, unpacked to float with SIMD when they are
+ * needed again), then dropped. Pinned clips (favorites) are always kept as floats.
+ *
+ * Budget covers cached starts only. Loop buffers and swap tails are owned by players and bounded per voice
+ * instead (one loop of at most MAX_LOOP_TIME and one tail of a few hundred milliseconds each).
+ */
+class ClipCache
+{
+public:
+
+    /**
+     * Receives clip that was just cached (worker thread).
+     */
+    typedef std::function<void(std::shared_ptr<const CachedClip>)> ClipCallback;
+
+    /**
+     * Cache statistics.
+     */
+    struct Stats
+    {
+        // Memory budget in bytes.
+        size_t budget = 0;
+        // Bytes of samples held by cache.
+        size_t residentBytes = 0;
+        // Bytes of packed samples.
+        size_t packedBytes = 0;
+        // Number of clips.
+        size_t clips = 0;
+        // Number of packed clips.
+        size_t packedClips = 0;
+        // Number of pinned clips.
+        size_t pinnedClips = 0;
+        // Lookups that found float clip.
+        uint64_t hits = 0;
+        // Lookups that found packed clip.
+        uint64_t packedHits = 0;
+        // Lookups that found nothing.
+        uint64_t misses = 0;
+        // Clips dropped to stay within budget.
+        uint64_t evictions = 0;
+    };
+
+private:
+
+    /**
+     * Cached clip.
+     */
+    struct Entry
+    {
+        // Float samples (nullptr while clip is packed).
+        std::shared_ptr<const CachedClip> clip;
+        // Format and position of clip (kept while it is packed).
+        int channels = 0;
+        int sampleRate = 0;
+        int64_t start = 0;
+        // 16-bit samples of packed clip.
+        std::vector<int16_t> packed;
+        // Number of times playback started from clip.
+        std::shared_ptr<std::atomic<uint32_t>> triggers;
+        // Use clock at latest use.
+        uint64_t lastUse = 0;
+        // Whether clip is pinned.
+        bool isPinned = false;
+
+        /**
+         * @return bytes of samples
+         */
+        size_t bytes() const { return clip ? clip->samples.size() * sizeof(float) : packed.size() * sizeof(int16_t); }
+    };
+
+    // Decodes clips.
+    WorkerPool *workers = nullptr;
+    // Cached clips by media file.
+    std::unordered_map<std::string, Entry> entries;
+    // Media files being decoded.
+    std::unordered_set<std::string> pending;
+    // Number of pins of each pinned media file (cached or not).
+    std::unordered_map<std::string, int> pins;
+    // Memory budget in bytes.
+    size_t budget;
+    // Bytes of samples held by cache.
+    size_t residentBytes = 0;
+    // Advances with every use of cache.
+    uint64_t useClock = 0;
+    // Counters.
+    uint64_t hits = 0;
+    uint64_t packedHits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    // Guards everything above.
+    std::mutex mutex;
+    // Notified about cached clips.
+    ClipCallback clipCallback;
+
+public:
+
+    /**
+     * Constructor.
+     *
+     * @param workers pool that decodes clips (must outlive jobs it runs)
+     */
+    explicit ClipCache(WorkerPool *workers);
+
+    /**
+     * @param callback function that will receive cached clips
+     */
+    void setClipCallback(ClipCallback callback);
+
+    /**
+     * Sets memory budget, packing and dropping clips over it.
+     *
+     * @param bytes budget in bytes
+     */
+    void setBudget(size_t bytes);
+
+    /**
+     * Pins media file, so its clip is never packed or dropped (works before clip is cached as well). Pins
+     * are counted, file stays pinned until each of them is removed.
+     */
+    void pin(const std::string &filepath);
+    /**
+     * Removes pin of media file.
+     */
+    void unpin(const std::string &filepath);
+
+    /**
+     * Decodes start of media file in background unless it is cached or being decoded already.
+     *
+     * @param start first audible sample
+     * @param inPoint time playback starts at in seconds (negative starts at first audible sample)
+     */
+    void prefetch(const std::string &filepath, int64_t start, double inPoint);
+
+    /**
+     * @return cached start of media file as floats (nullptr if there is none)
+     */
+    std::shared_ptr<const CachedClip> find(const std::string &filepath);
+
+    /**
+     * @return cache statistics
+     */
+    Stats getStats();
+
+private:
+
+    /**
+     * Decodes start of media file (job body).
+     */
+    static std::shared_ptr<CachedClip> decode(const std::string &filepath, int64_t start, double inPoint);
+
+    /**
+     * Caches decoded clip (replacing older clip of same file) and keeps cache within budget.
+     */
+    void store(std::shared_ptr<CachedClip> clip);
+
+    /**
+     * @return how much clip is worth keeping (recent and often triggered clips are worth more)
+     */
+    double scoreOf(const Entry &entry) const;
+
+    /**
+     * Packs float samples of clip into 16-bit ones.
+     */
+    void pack(Entry &entry);
+
+    /**
+     * Unpacks 16-bit samples of clip into floats.
+     */
+    void unpack(const std::string &filepath, Entry &entry);
+
+    /**
+     * Packs and then drops clips worth least until cache fits budget (mutex must be held).
+     */
+    void enforceBudget();
+};
@@ -0,0 +1,124 @@
+#pragma once
+
+
+// Sizes
+#include <cstddef>
+#include <cstdint>
+// Atomics
+#include <atomic>
+// Containers
+#include <vector>
+
+
+/**
+ * Bounded lock-free queue (multiple producers, multiple consumers). Every cell carries sequence number
+ * that tells producers and consumers whether cell is free or filled, so neither side ever blocks.
+ */
+template<typename T>
+class CommandQueue
+{
+    /**
+     * Queue cell.
+     */
+    struct Cell
+    {
+        // Sequence number of cell.
+        std::atomic<size_t> sequence;
+        // Stored value.
+        T value;
+    };
+
+    // Cells (count is power of two).
+    std::vector<Cell> cells;
+    // Index mask.
+    size_t mask;
+    // Next position to write (own cache line to avoid false sharing with readers).
+    alignas(64) std::atomic<size_t> writePosition = 0;
+    // Next position to read.
+    alignas(64) std::atomic<size_t> readPosition = 0;
+
+public:
+
+    /**
+     * Constructor.
+     * 
+     * @param capacity queue capacity (rounded up to power of two)
+     */
+    explicit CommandQueue(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity)
+            size *= 2;
+
+        cells = std::vector<Cell>(size);
+        for (size_t i = 0; i < size; i++)
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        mask = size - 1;
+    }
+
+    /**
+     * Adds value to queue.
+     * 
+     * @return false if queue is full
+     */
+    bool push(const T &value)
+    {
+        size_t position = writePosition.load(std::memory_order_relaxed);
+        while (true)
+        {
+            Cell &cell = cells[position & mask];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+
+            // Cell is free: try to claim it
+            if (difference == 0)
+            {
+                if (writePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    cell.value = value;
+                    cell.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            // Queue is full
+            else if (difference < 0)
+                return false;
+            // Other producer was faster
+            else
+                position = writePosition.load(std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * Takes value from queue.
+     * 
+     * @return false if queue is empty
+     */
+    bool pop(T &value)
+    {
+        size_t position = readPosition.load(std::memory_order_relaxed);
+        while (true)
+        {
+            Cell &cell = cells[position & mask];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+
+            // Cell is filled: try to claim it
+            if (difference == 0)
+            {
+                if (readPosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    value = cell.value;
+                    cell.sequence.store(position + mask + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            // Queue is empty
+            else if (difference < 0)
+                return false;
+            // Other consumer was faster
+            else
+                position = readPosition.load(std::memory_order_relaxed);
+        }
+    }
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+
+// SDL3 (time type)
+#include <SDL3/SDL.h>
+
+
+/**
+ * Command for audio engine that can be queued without allocations.
+ */
+struct EngineCommand
+{
+    /**
+     * Describes command type.
+     */
+    enum Type
+    {
+        TRIGGER,
+        PLAY,
+        PAUSE,
+        STOP,
+        SEEK,
+        GAIN,
+        MICROPHONE_START,
+        MICROPHONE_STOP
+    };
+
+    // Command type.
+    Type type = STOP;
+    // Voice index (ignored by microphone commands).
+    int voice = 0;
+    // Command argument (seconds for SEEK, gain for GAIN).
+    double value = 0;
+    // Time when command must be executed in SDL nanosecond ticks (0 means immediately).
+    Uint64 time = 0;
+};
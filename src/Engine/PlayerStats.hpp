@@ -0,0 +1,147 @@
+#pragma once
+
+
+// Atomics
+#include <atomic>
+// Fixed size integers
+#include <cstdint>
+// Rounding
+#include <cmath>
+// Min/max
+#include <algorithm>
+
+
+// Number of histogram buckets per power of two
+#define HISTOGRAM_SUBBUCKETS 4
+// Number of powers of two covered by histogram (1 ns .. ~17 s)
+#define HISTOGRAM_OCTAVES 34
+// Number of output routes of one player
+#define MAX_PLAYER_ROUTES 8
+
+
+/**
+ * Log-scale histogram of durations. Written by audio thread without locks, read by anyone.
+ */
+class DurationHistogram
+{
+public:
+
+    // Number of buckets.
+    static const int BUCKET_COUNT = HISTOGRAM_OCTAVES * HISTOGRAM_SUBBUCKETS;
+
+private:
+
+    // Number of durations per bucket.
+    std::atomic<uint64_t> buckets[BUCKET_COUNT] = {};
+
+public:
+
+    /**
+     * Records duration.
+     */
+    void record(uint64_t nanoseconds)
+    {
+        buckets[bucketOf(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * Copies bucket counts.
+     */
+    void read(uint64_t *counts) const
+    {
+        for (int i = 0; i < BUCKET_COUNT; i++)
+            counts[i] = buckets[i].load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @param counts bucket counts (may be difference of two reads)
+     * @param quantile quantile in 0..1
+     *
+     * @return duration in seconds below which given part of durations lies (0 if there are none)
+     */
+    static double quantile(const uint64_t *counts, double quantile)
+    {
+        uint64_t total = 0;
+        for (int i = 0; i < BUCKET_COUNT; i++)
+            total += counts[i];
+        if (total == 0)
+            return 0;
+
+        uint64_t target = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(quantile * total)));
+        uint64_t count = 0;
+        for (int i = 0; i < BUCKET_COUNT; i++)
+        {
+            count += counts[i];
+            if (count >= target)
+                return upperBoundOf(i) / 1e9;
+        }
+        return upperBoundOf(BUCKET_COUNT - 1) / 1e9;
+    }
+
+private:
+
+    /**
+     * @return bucket index of duration (power of two and its quarter)
+     */
+    static int bucketOf(uint64_t nanoseconds)
+    {
+        if (nanoseconds < HISTOGRAM_SUBBUCKETS)
+            return 0;
+        int octave = 63 - __builtin_clzll(nanoseconds);
+        int subbucket = (nanoseconds >> (octave - 2)) & (HISTOGRAM_SUBBUCKETS - 1);
+        return std::min(octave * HISTOGRAM_SUBBUCKETS + subbucket, BUCKET_COUNT - 1);
+    }
+
+    /**
+     * @return largest duration that falls into bucket in nanoseconds
+     */
+    static double upperBoundOf(int bucket)
+    {
+        int octave = bucket / HISTOGRAM_SUBBUCKETS;
+        int subbucket = bucket % HISTOGRAM_SUBBUCKETS;
+        double base = std::ldexp(1.0, octave);
+        return base + (subbucket + 1) * base / HISTOGRAM_SUBBUCKETS;
+    }
+};
+
+
+/**
+ * Counters of one audio device stream of player.
+ */
+struct DeviceStats
+{
+    // SDL audio device ID (0 if stream is not open).
+    std::atomic<uint32_t> device = 0;
+    // Sample rate of device stream.
+    std::atomic<int> sampleRate = 0;
+    // Audio queued in device stream at last write in bytes.
+    std::atomic<int> queuedBytes = 0;
+    // Amount of audio device stream keeps queued in samples.
+    std::atomic<int> targetSize = 0;
+    // Number of times device streams ran dry during playback.
+    std::atomic<uint64_t> underruns = 0;
+    // Underruns of current device stream already added to underruns (audio thread only).
+    uint64_t streamUnderruns = 0;
+    // Sample frames written.
+    std::atomic<uint64_t> framesWritten = 0;
+};
+
+
+/**
+ * Counters of one player, updated by audio thread.
+ */
+struct PlayerStats
+{
+    // Number of player cycle iterations.
+    std::atomic<uint64_t> iterations = 0;
+    // Sample frames decoded (captured for microphone).
+    std::atomic<uint64_t> framesDecoded = 0;
+    // Time spent decoding one frame.
+    DurationHistogram decodeTime;
+    // Number of seeks.
+    std::atomic<uint64_t> seeks = 0;
+    // Delay between seek request and first audio written after it.
+    DurationHistogram seekLatency;
+    // Device streams (microphone input, then one per output route).
+    DeviceStats devices[MAX_PLAYER_ROUTES + 1];
+};
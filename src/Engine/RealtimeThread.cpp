@@ -0,0 +1,98 @@
+#include <Engine/RealtimeThread.hpp>
+
+
+// Min/max
+#include <algorithm>
+// SDL3
+#include <SDL3/SDL.h>
+// POSIX threads and scheduling
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#endif
+
+
+// Thread stack locked in RAM (bytes)
+#define LOCKED_STACK_SIZE 256*1024
+
+
+#ifdef __linux__
+/**
+ * Touches and locks top of calling thread stack so that audio thread never page faults on it.
+ */
+static bool lockStack()
+{
+    volatile char stack[LOCKED_STACK_SIZE];
+    for (size_t i = 0; i < sizeof(stack); i += 4096)
+        stack[i] = 0;
+    return mlock((const void*)stack, sizeof(stack)) == 0;
+}
+#endif
+
+
+RealtimeStatus RealtimeThread::apply(const RealtimeConfig &config)
+{
+    RealtimeStatus status;
+
+#ifdef __linux__
+    // Pin to core
+    if ((config.cpu >= 0) && (config.cpu < CPU_SETSIZE))
+    {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(config.cpu, &cpus);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0)
+            status.cpu = config.cpu;
+    }
+
+    // Real-time policy (needs CAP_SYS_NICE or RLIMIT_RTPRIO)
+    if (config.priority > 0)
+    {
+        bool is_realtime = false;
+        for (int policy : {SCHED_FIFO, SCHED_RR})
+        {
+            sched_param param;
+            param.sched_priority = std::clamp(config.priority, sched_get_priority_min(policy), sched_get_priority_max(policy));
+            if (pthread_setschedparam(pthread_self(), policy, &param) == 0)
+            {
+                is_realtime = true;
+                break;
+            }
+        }
+        // Unprivileged: ask SDL (goes through RealtimeKit when it is available)
+        if (!is_realtime)
+            SDL_SetCurrentThreadPriority(SDL_THREAD_PRIORITY_TIME_CRITICAL);
+    }
+
+    // Report what was actually achieved
+    int policy;
+    sched_param param;
+    if (pthread_getschedparam(pthread_self(), &policy, &param) == 0)
+    {
+        status.policy = (policy == SCHED_FIFO) ? "SCHED_FIFO" : (policy == SCHED_RR) ? "SCHED_RR" : "SCHED_OTHER";
+        status.priority = param.sched_priority;
+    }
+
+    // Lock memory (needs RLIMIT_MEMLOCK), future allocations stay unlocked so that they never fail
+    if (config.lockMemory)
+        status.memoryLocked = lockStack() && (mlockall(MCL_CURRENT) == 0);
+#else
+    if (config.priority > 0 && SDL_SetCurrentThreadPriority(SDL_THREAD_PRIORITY_TIME_CRITICAL))
+        status.policy = "time critical";
+#endif
+
+    return status;
+}
+
+
+long RealtimeThread::involuntaryContextSwitches()
+{
+#ifdef __linux__
+    rusage usage;
+    if (getrusage(RUSAGE_THREAD, &usage) == 0)
+        return usage.ru_nivcsw;
+#endif
+    return -1;
+}
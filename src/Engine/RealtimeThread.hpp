@@ -0,0 +1,57 @@
+#pragma once
+
+
+// Strings
+#include <string>
+
+
+/**
+ * Scheduling requested for audio thread.
+ */
+struct RealtimeConfig
+{
+    // Real-time priority (SCHED_FIFO/SCHED_RR, 1..99), 0 keeps default scheduling.
+    int priority = 10;
+    // Core to pin thread to (negative means any core).
+    int cpu = -1;
+    // Whether thread stack and current process memory should be locked in RAM.
+    bool lockMemory = false;
+};
+
+
+/**
+ * Scheduling achieved by audio thread.
+ */
+struct RealtimeStatus
+{
+    // Scheduling policy name (SCHED_FIFO, SCHED_RR, SCHED_OTHER or SDL priority name).
+    std::string policy = "default";
+    // Achieved real-time priority (0 if thread is not real-time).
+    int priority = 0;
+    // Core thread is pinned to (negative if it is not pinned).
+    int cpu = -1;
+    // Whether memory was locked.
+    bool memoryLocked = false;
+};
+
+
+/**
+ * Applies real-time scheduling to calling thread. Every step falls back gracefully: SCHED_FIFO, then
+ * SCHED_RR, then SDL time critical priority (RealtimeKit on Linux desktops), then default scheduling.
+ */
+class RealtimeThread
+{
+public:
+
+    /**
+     * Applies scheduling to calling thread.
+     *
+     * @return scheduling actually achieved
+     */
+    static RealtimeStatus apply(const RealtimeConfig &config);
+
+    /**
+     * @return number of times calling thread was preempted (negative if unknown on this platform)
+     */
+    static long involuntaryContextSwitches();
+};
@@ -0,0 +1,266 @@
+#include <Engine/StatsCollector.hpp>
+
+
+// Time
+#include <chrono>
+// String streams
+#include <sstream>
+
+
+// Names of worker pool priorities (indexed by WorkerPool::Priority)
+static const char *PRIORITY_NAMES[] = {"high", "normal", "low"};
+
+
+StatsCollector::StatsCollector(AudioEngine *engine)
+{
+    this->engine = engine;
+    // Voices and microphone
+    previous.resize(engine->getVoiceCount() + 1);
+    previousTicks = SDL_GetTicksNS();
+}
+
+
+StatsCollector::Report StatsCollector::collect()
+{
+    Report report;
+
+    Uint64 now = SDL_GetTicksNS();
+    report.interval = (now - previousTicks) / 1e9;
+    previousTicks = now;
+    report.time = std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+    // Audio thread and workers
+    report.audio = engine->getAudioThreadStats();
+    if (report.interval > 0)
+        report.audioIterationsPerSecond = (report.audio.iterations - previousIterations) / report.interval;
+    previousIterations = report.audio.iterations;
+    report.workers = engine->getWorkers()->getStats();
+    report.cache = engine->getCache()->getStats();
+
+    // Players
+    report.players.resize(engine->getVoiceCount() + 1);
+    for (int i = 0; i < engine->getVoiceCount(); i++)
+    {
+        report.players[i].name = "voice" + std::to_string(i);
+        collectPlayer(report.players[i], engine->getVoice(i), previous[i], report.interval, engine->getVoice(i)->isActive());
+    }
+    report.players.back().name = "microphone";
+    collectPlayer(report.players.back(), engine->getMicrophone(), previous.back(), report.interval, engine->getMicrophone()->isActive());
+
+    return report;
+}
+
+
+void StatsCollector::collectPlayer(PlayerReport &report, AudioPlayer *player, PreviousCounters &previous, double interval, bool active)
+{
+    PlayerStats &stats = player->getStats();
+    report.active = active;
+
+    // Counters
+    report.framesDecoded = stats.framesDecoded;
+    report.seeks = stats.seeks;
+    uint64_t iterations = stats.iterations;
+    if (interval > 0)
+        report.iterationsPerSecond = (iterations - previous.iterations) / interval;
+    previous.iterations = iterations;
+
+    // Percentiles of what happened since previous report
+    uint64_t counts[DurationHistogram::BUCKET_COUNT];
+    uint64_t window[DurationHistogram::BUCKET_COUNT];
+
+    stats.decodeTime.read(counts);
+    for (int i = 0; i < DurationHistogram::BUCKET_COUNT; i++)
+        window[i] = counts[i] - previous.decodeTime[i];
+    report.decodeP50 = DurationHistogram::quantile(window, 0.5);
+    report.decodeP99 = DurationHistogram::quantile(window, 0.99);
+    std::copy(counts, counts + DurationHistogram::BUCKET_COUNT, previous.decodeTime);
+
+    stats.seekLatency.read(counts);
+    for (int i = 0; i < DurationHistogram::BUCKET_COUNT; i++)
+        window[i] = counts[i] - previous.seekLatency[i];
+    report.seekP50 = DurationHistogram::quantile(window, 0.5);
+    report.seekP99 = DurationHistogram::quantile(window, 0.99);
+    std::copy(counts, counts + DurationHistogram::BUCKET_COUNT, previous.seekLatency);
+
+    // Opened devices (microphone input, then output routes)
+    for (int d = 0; d < MAX_PLAYER_ROUTES + 1; d++)
+    {
+        DeviceStats &device = stats.devices[d];
+        if (device.device == 0)
+            continue;
+
+        DeviceReport device_report;
+        device_report.role = (d == 0) ? "input" : "output";
+        device_report.device = device.device;
+        device_report.queuedBytes = device.queuedBytes;
+        device_report.targetSize = device.targetSize;
+        if (device.sampleRate > 0)
+            device_report.targetLatency = static_cast<double>(device_report.targetSize) / device.sampleRate;
+        device_report.underruns = device.underruns;
+        device_report.framesWritten = device.framesWritten;
+        report.devices.push_back(device_report);
+    }
+}
+
+
+std::string StatsCollector::formatJson(const Report &report)
+{
+    std::ostringstream json;
+
+    json << "{\"time\":" << std::to_string(report.time) << ",\"interval\":" << report.interval;
+
+    // Audio thread
+    const AudioEngine::AudioThreadStats &audio = report.audio;
+    json << ",\"audio\":{\"policy\":\"" << audio.scheduling.policy << "\",\"priority\":" << audio.scheduling.priority
+         << ",\"cpu\":" << audio.scheduling.cpu << ",\"mlock\":" << (audio.scheduling.memoryLocked ? "true" : "false")
+         << ",\"preempted\":" << audio.involuntarySwitches
+         << ",\"wakeup_avg_ms\":" << audio.averageWakeupLatency * 1000 << ",\"wakeup_max_ms\":" << audio.maxWakeupLatency * 1000
+         << ",\"iterations_per_s\":" << report.audioIterationsPerSecond << "}";
+
+    // Workers
+    const WorkerPool::Stats &workers = report.workers;
+    json << ",\"workers\":{\"threads\":" << workers.threads << ",\"running\":" << workers.running;
+    for (int p = 0; p < WorkerPool::PRIORITY_COUNT; p++)
+    {
+        json << ",\"" << PRIORITY_NAMES[p] << "\":{\"queued\":" << workers.queued[p] << ",\"done\":" << workers.completed[p]
+             << ",\"wait_avg_ms\":" << workers.averageLatency[p] * 1000 << ",\"wait_max_ms\":" << workers.maxLatency[p] * 1000 << "}";
+    }
+    json << "}";
+
+    // Clip cache
+    const ClipCache::Stats &cache = report.cache;
+    json << ",\"cache\":{\"budget_bytes\":" << cache.budget << ",\"resident_bytes\":" << cache.residentBytes
+         << ",\"packed_bytes\":" << cache.packedBytes << ",\"clips\":" << cache.clips << ",\"packed\":" << cache.packedClips
+         << ",\"pinned\":" << cache.pinnedClips << ",\"hits\":" << cache.hits << ",\"packed_hits\":" << cache.packedHits
+         << ",\"misses\":" << cache.misses << ",\"evictions\":" << cache.evictions << "}";
+
+    // Players
+    json << ",\"players\":[";
+    for (size_t i = 0; i < report.players.size(); i++)
+    {
+        const PlayerReport &player = report.players[i];
+        json << (i ? "," : "") << "{\"name\":\"" << player.name << "\",\"active\":" << (player.active ? "true" : "false")
+             << ",\"frames_decoded\":" << player.framesDecoded
+             << ",\"decode_p50_us\":" << player.decodeP50 * 1e6 << ",\"decode_p99_us\":" << player.decodeP99 * 1e6
+             << ",\"seeks\":" << player.seeks
+             << ",\"seek_p50_ms\":" << player.seekP50 * 1000 << ",\"seek_p99_ms\":" << player.seekP99 * 1000
+             << ",\"iterations_per_s\":" << player.iterationsPerSecond << ",\"devices\":[";
+        for (size_t d = 0; d < player.devices.size(); d++)
+        {
+            const DeviceReport &device = player.devices[d];
+            json << (d ? "," : "") << "{\"role\":\"" << device.role << "\",\"device\":" << device.device
+                 << ",\"queued_bytes\":" << device.queuedBytes
+                 << ",\"target_samples\":" << device.targetSize << ",\"target_ms\":" << device.targetLatency * 1000
+                 << ",\"underruns\":" << device.underruns
+                 << ",\"frames_written\":" << device.framesWritten << "}";
+        }
+        json << "]}";
+    }
+    json << "]}";
+
+    return json.str();
+}
+
+
+/**
+ * Writes Prometheus metric header.
+ */
+static void writeHeader(std::ostringstream &text, const char *name, const char *type, const char *help)
+{
+    text << "# HELP opensoundboard_" << name << " " << help << "\n"
+         << "# TYPE opensoundboard_" << name << " " << type << "\n";
+}
+
+
+std::string StatsCollector::formatPrometheus(const Report &report)
+{
+    std::ostringstream text;
+
+    // Audio thread
+    const AudioEngine::AudioThreadStats &audio = report.audio;
+    writeHeader(text, "audio_thread_priority", "gauge", "Real-time priority achieved by audio thread (0 if not real-time).");
+    text << "opensoundboard_audio_thread_priority{policy=\"" << audio.scheduling.policy << "\"} " << audio.scheduling.priority << "\n";
+    if (audio.involuntarySwitches >= 0)
+    {
+        writeHeader(text, "audio_thread_preemptions_total", "counter", "Involuntary context switches of audio thread.");
+        text << "opensoundboard_audio_thread_preemptions_total " << audio.involuntarySwitches << "\n";
+    }
+    writeHeader(text, "audio_thread_wakeup_latency_seconds", "gauge", "Delay between planned and actual wakeup of audio thread.");
+    text << "opensoundboard_audio_thread_wakeup_latency_seconds{stat=\"avg\"} " << audio.averageWakeupLatency << "\n"
+         << "opensoundboard_audio_thread_wakeup_latency_seconds{stat=\"max\"} " << audio.maxWakeupLatency << "\n";
+    writeHeader(text, "audio_thread_iterations_per_second", "gauge", "Audio thread cycle iterations per second.");
+    text << "opensoundboard_audio_thread_iterations_per_second " << report.audioIterationsPerSecond << "\n";
+
+    // Workers
+    const WorkerPool::Stats &workers = report.workers;
+    writeHeader(text, "worker_queue_depth", "gauge", "Jobs waiting in worker pool.");
+    for (int p = 0; p < WorkerPool::PRIORITY_COUNT; p++)
+        text << "opensoundboard_worker_queue_depth{priority=\"" << PRIORITY_NAMES[p] << "\"} " << workers.queued[p] << "\n";
+    writeHeader(text, "worker_jobs_total", "counter", "Jobs executed by worker pool.");
+    for (int p = 0; p < WorkerPool::PRIORITY_COUNT; p++)
+        text << "opensoundboard_worker_jobs_total{priority=\"" << PRIORITY_NAMES[p] << "\"} " << workers.completed[p] << "\n";
+    writeHeader(text, "worker_wait_seconds", "gauge", "Average time jobs spent in worker pool queue.");
+    for (int p = 0; p < WorkerPool::PRIORITY_COUNT; p++)
+        text << "opensoundboard_worker_wait_seconds{priority=\"" << PRIORITY_NAMES[p] << "\"} " << workers.averageLatency[p] << "\n";
+
+    // Clip cache
+    const ClipCache::Stats &cache = report.cache;
+    writeHeader(text, "clip_cache_budget_bytes", "gauge", "Memory budget of decoded track starts.");
+    text << "opensoundboard_clip_cache_budget_bytes " << cache.budget << "\n";
+    writeHeader(text, "clip_cache_resident_bytes", "gauge", "Memory held by decoded track starts.");
+    text << "opensoundboard_clip_cache_resident_bytes{storage=\"float\"} " << cache.residentBytes - cache.packedBytes << "\n"
+         << "opensoundboard_clip_cache_resident_bytes{storage=\"packed\"} " << cache.packedBytes << "\n";
+    writeHeader(text, "clip_cache_clips", "gauge", "Decoded track starts held by cache.");
+    text << "opensoundboard_clip_cache_clips{storage=\"float\"} " << cache.clips - cache.packedClips << "\n"
+         << "opensoundboard_clip_cache_clips{storage=\"packed\"} " << cache.packedClips << "\n";
+    writeHeader(text, "clip_cache_pinned_clips", "gauge", "Decoded track starts that are never packed or dropped.");
+    text << "opensoundboard_clip_cache_pinned_clips " << cache.pinnedClips << "\n";
+    writeHeader(text, "clip_cache_lookups_total", "counter", "Lookups of decoded track starts by result.");
+    text << "opensoundboard_clip_cache_lookups_total{result=\"hit\"} " << cache.hits << "\n"
+         << "opensoundboard_clip_cache_lookups_total{result=\"packed_hit\"} " << cache.packedHits << "\n"
+         << "opensoundboard_clip_cache_lookups_total{result=\"miss\"} " << cache.misses << "\n";
+    writeHeader(text, "clip_cache_evictions_total", "counter", "Decoded track starts dropped to stay within budget.");
+    text << "opensoundboard_clip_cache_evictions_total " << cache.evictions << "\n";
+
+    // Players
+    writeHeader(text, "player_active", "gauge", "Whether player cycle is running.");
+    for (const PlayerReport &player : report.players)
+        text << "opensoundboard_player_active{player=\"" << player.name << "\"} " << (player.active ? 1 : 0) << "\n";
+    writeHeader(text, "frames_decoded_total", "counter", "Sample frames decoded (captured for microphone).");
+    for (const PlayerReport &player : report.players)
+        text << "opensoundboard_frames_decoded_total{player=\"" << player.name << "\"} " << player.framesDecoded << "\n";
+    writeHeader(text, "decode_seconds", "summary", "Time spent decoding one frame since previous export.");
+    for (const PlayerReport &player : report.players)
+        text << "opensoundboard_decode_seconds{player=\"" << player.name << "\",quantile=\"0.5\"} " << player.decodeP50 << "\n"
+             << "opensoundboard_decode_seconds{player=\"" << player.name << "\",quantile=\"0.99\"} " << player.decodeP99 << "\n";
+    writeHeader(text, "seeks_total", "counter", "Seeks served by player.");
+    for (const PlayerReport &player : report.players)
+        text << "opensoundboard_seeks_total{player=\"" << player.name << "\"} " << player.seeks << "\n";
+    writeHeader(text, "seek_latency_seconds", "summary", "Delay between seek request and first audio after it since previous export.");
+    for (const PlayerReport &player : report.players)
+        text << "opensoundboard_seek_latency_seconds{player=\"" << player.name << "\",quantile=\"0.5\"} " << player.seekP50 << "\n"
+             << "opensoundboard_seek_latency_seconds{player=\"" << player.name << "\",quantile=\"0.99\"} " << player.seekP99 << "\n";
+    writeHeader(text, "player_iterations_per_second", "gauge", "Player cycle iterations per second.");
+    for (const PlayerReport &player : report.players)
+        text << "opensoundboard_player_iterations_per_second{player=\"" << player.name << "\"} " << player.iterationsPerSecond << "\n";
+
+    // Devices
+    writeHeader(text, "device_queued_bytes", "gauge", "Audio queued in device stream.");
+    for (const PlayerReport &player : report.players)
+        for (const DeviceReport &device : player.devices)
+            text << "opensoundboard_device_queued_bytes{player=\"" << player.name << "\",role=\"" << device.role << "\",device=\"" << device.device << "\"} " << device.queuedBytes << "\n";
+    writeHeader(text, "device_buffer_target_seconds", "gauge", "Amount of audio device stream keeps queued (adapts to underruns).");
+    for (const PlayerReport &player : report.players)
+        for (const DeviceReport &device : player.devices)
+            text << "opensoundboard_device_buffer_target_seconds{player=\"" << player.name << "\",role=\"" << device.role << "\",device=\"" << device.device << "\"} " << device.targetLatency << "\n";
+    writeHeader(text, "device_underruns_total", "counter", "Times device stream ran dry during playback.");
+    for (const PlayerReport &player : report.players)
+        for (const DeviceReport &device : player.devices)
+            text << "opensoundboard_device_underruns_total{player=\"" << player.name << "\",role=\"" << device.role << "\",device=\"" << device.device << "\"} " << device.underruns << "\n";
+    writeHeader(text, "device_frames_written_total", "counter", "Sample frames written to device stream.");
+    for (const PlayerReport &player : report.players)
+        for (const DeviceReport &device : player.devices)
+            text << "opensoundboard_device_frames_written_total{player=\"" << player.name << "\",role=\"" << device.role << "\",device=\"" << device.device << "\"} " << device.framesWritten << "\n";
+
+    return text.str();
+}
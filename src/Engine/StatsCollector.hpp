@@ -0,0 +1,139 @@
+#pragma once
+
+
+// Strings
+#include <string>
+// Containers
+#include <vector>
+// Audio engine
+#include <Engine/AudioEngine.hpp>
+
+
+/**
+ * Turns engine counters into reports. Rates and percentiles cover time since previous report, so every
+ * consumer (stats view, exporter) owns its collector.
+ */
+class StatsCollector
+{
+public:
+
+    /**
+     * Device stream of player.
+     */
+    struct DeviceReport
+    {
+        // Device role name (input, output).
+        std::string role;
+        // SDL audio device ID.
+        uint32_t device = 0;
+        // Audio queued in device stream in bytes.
+        int queuedBytes = 0;
+        // Amount of audio device stream keeps queued in samples and seconds.
+        int targetSize = 0;
+        double targetLatency = 0;
+        // Number of times device stream ran dry.
+        uint64_t underruns = 0;
+        // Sample frames written.
+        uint64_t framesWritten = 0;
+    };
+
+    /**
+     * Player.
+     */
+    struct PlayerReport
+    {
+        // Player name (voice<N> or microphone).
+        std::string name;
+        // Whether player cycle is running.
+        bool active = false;
+        // Sample frames decoded (captured for microphone).
+        uint64_t framesDecoded = 0;
+        // Median and 99th percentile of frame decode time in seconds.
+        double decodeP50 = 0;
+        double decodeP99 = 0;
+        // Number of seeks.
+        uint64_t seeks = 0;
+        // Median and 99th percentile of seek latency in seconds.
+        double seekP50 = 0;
+        double seekP99 = 0;
+        // Player cycle iterations per second.
+        double iterationsPerSecond = 0;
+        // Opened device streams.
+        std::vector<DeviceReport> devices;
+    };
+
+    /**
+     * Whole engine.
+     */
+    struct Report
+    {
+        // Unix time of report in seconds.
+        double time = 0;
+        // Seconds covered by rates and percentiles.
+        double interval = 0;
+        // Audio thread state.
+        AudioEngine::AudioThreadStats audio;
+        // Audio thread cycle iterations per second.
+        double audioIterationsPerSecond = 0;
+        // Worker pool state.
+        WorkerPool::Stats workers;
+        // Clip cache state.
+        ClipCache::Stats cache;
+        // Players (voices, then microphone).
+        std::vector<PlayerReport> players;
+    };
+
+private:
+
+    /**
+     * Counters of player at previous report.
+     */
+    struct PreviousCounters
+    {
+        // Player cycle iterations.
+        uint64_t iterations = 0;
+        // Decode time histogram.
+        uint64_t decodeTime[DurationHistogram::BUCKET_COUNT] = {};
+        // Seek latency histogram.
+        uint64_t seekLatency[DurationHistogram::BUCKET_COUNT] = {};
+    };
+
+    // Observed engine.
+    AudioEngine *engine = nullptr;
+    // Player counters at previous report.
+    std::vector<PreviousCounters> previous;
+    // Audio thread iterations at previous report.
+    uint64_t previousIterations = 0;
+    // Time of previous report in SDL nanosecond ticks.
+    Uint64 previousTicks = 0;
+
+public:
+
+    /**
+     * Constructor.
+     *
+     * @param engine observed engine
+     */
+    explicit StatsCollector(AudioEngine *engine);
+
+    /**
+     * @return report covering time since previous call (or since construction)
+     */
+    Report collect();
+
+    /**
+     * @return report as single line of JSON (without line break)
+     */
+    static std::string formatJson(const Report &report);
+    /**
+     * @return report in Prometheus text exposition format
+     */
+    static std::string formatPrometheus(const Report &report);
+
+private:
+
+    /**
+     * Fills player report from its counters.
+     */
+    void collectPlayer(PlayerReport &report, AudioPlayer *player, PreviousCounters &previous, double interval, bool active);
+};
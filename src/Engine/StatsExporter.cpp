@@ -0,0 +1,91 @@
+#include <Engine/StatsExporter.hpp>
+
+
+// Exceptions
+#include <stdexcept>
+// Files
+#include <fstream>
+#include <cstdio>
+// Time
+#include <chrono>
+
+
+StatsExporter::StatsExporter(AudioEngine *engine, const std::string &filepath, Format format, double interval) : collector(engine)
+{
+    if (interval <= 0)
+        throw std::runtime_error("Stats exporter: interval must be positive");
+
+    this->filepath = filepath;
+    this->format = format;
+    this->interval = interval;
+
+    thread = std::thread(&StatsExporter::process, this);
+}
+
+
+StatsExporter::~StatsExporter()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        isRunning = false;
+    }
+    condition.notify_one();
+    thread.join();
+}
+
+
+StatsExporter::Format StatsExporter::formatOf(const std::string &name)
+{
+    if (name == "json")
+        return JSON_LINES;
+    if (name == "prometheus")
+        return PROMETHEUS;
+    throw std::runtime_error("Stats exporter: unknown format " + name);
+}
+
+
+void StatsExporter::process()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (isRunning)
+    {
+        condition.wait_for(lock, std::chrono::duration<double>(interval), [this]{ return !isRunning; });
+
+        lock.unlock();
+        write();
+        lock.lock();
+    }
+}
+
+
+void StatsExporter::write()
+{
+    StatsCollector::Report report = collector.collect();
+
+    if (format == JSON_LINES)
+    {
+        std::ofstream file(filepath, std::ios::app);
+        file << StatsCollector::formatJson(report) << '\n';
+        #ifdef DEBUG
+        if (!file)
+            printf("Stats exporter: unable to write %s\n", filepath.c_str());
+        #endif
+    }
+    else
+    {
+        // Scrapers must never see half-written file
+        std::string temporary_path = filepath + ".tmp";
+        {
+            std::ofstream file(temporary_path, std::ios::trunc);
+            file << StatsCollector::formatPrometheus(report);
+            if (!file)
+            {
+                #ifdef DEBUG
+                printf("Stats exporter: unable to write %s\n", temporary_path.c_str());
+                #endif
+                return;
+            }
+        }
+        std::rename(temporary_path.c_str(), filepath.c_str());
+    }
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+
+// Strings
+#include <string>
+// Threads
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+// Stats reports
+#include <Engine/StatsCollector.hpp>
+
+
+/**
+ * Periodically writes engine stats to file from its own thread.
+ */
+class StatsExporter
+{
+public:
+
+    /**
+     * Describes file format.
+     */
+    enum Format
+    {
+        // Report per line appended to file.
+        JSON_LINES,
+        // File replaced with latest report (for node_exporter textfile collector).
+        PROMETHEUS
+    };
+
+private:
+
+    // Source of reports.
+    StatsCollector collector;
+    // Output file.
+    std::string filepath;
+    // Output format.
+    Format format;
+    // Seconds between reports.
+    double interval;
+
+    // Exporter thread.
+    std::thread thread;
+    // Whether thread should keep exporting.
+    bool isRunning = true;
+    // Guards isRunning.
+    std::mutex mutex;
+    // Wakes thread up on destruction.
+    std::condition_variable condition;
+
+public:
+
+    /**
+     * Constructor. Starts exporting right away.
+     *
+     * @param engine observed engine
+     * @param filepath output file
+     * @param format output format
+     * @param interval seconds between reports
+     */
+    StatsExporter(AudioEngine *engine, const std::string &filepath, Format format, double interval);
+    /**
+     * Destructor. Writes final report.
+     */
+    ~StatsExporter();
+
+    /**
+     * @return format by name (json or prometheus)
+     */
+    static Format formatOf(const std::string &name);
+
+private:
+
+    /**
+     * Exporter thread body.
+     */
+    void process();
+    /**
+     * Writes one report.
+     */
+    void write();
+};
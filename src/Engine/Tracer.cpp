@@ -0,0 +1,159 @@
+#include <Engine/Tracer.hpp>
+
+
+// Exceptions
+#include <stdexcept>
+// Files
+#include <fstream>
+// Output formatting
+#include <iomanip>
+// Min/max
+#include <algorithm>
+
+
+// Number of latest events kept per thread
+#define TRACE_BUFFER_SIZE 65536
+
+
+std::atomic<bool> Tracer::enabled = false;
+std::atomic<Uint64> Tracer::startTicks = 0;
+std::mutex Tracer::mutex;
+std::vector<std::unique_ptr<Tracer::ThreadBuffer>> Tracer::buffers;
+thread_local Tracer::ThreadBuffer *Tracer::currentBuffer = nullptr;
+thread_local std::string Tracer::currentThreadName;
+
+
+/**
+ * Copy of event taken by dump.
+ */
+struct RecordedSpan
+{
+    // Span name.
+    const char *name;
+    // Span start in SDL nanosecond ticks.
+    Uint64 start;
+    // Span end in SDL nanosecond ticks.
+    Uint64 end;
+};
+
+
+void Tracer::start()
+{
+    startTicks = SDL_GetTicksNS();
+    enabled = true;
+}
+
+
+void Tracer::stop()
+{
+    enabled = false;
+}
+
+
+void Tracer::setThreadName(const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    currentThreadName = name;
+    if (currentBuffer)
+        currentBuffer->name = name;
+}
+
+
+Tracer::ThreadBuffer* Tracer::threadBuffer()
+{
+    if (!currentBuffer)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ThreadBuffer *buffer = new ThreadBuffer();
+        buffer->thread = static_cast<int>(buffers.size()) + 1;
+        buffer->name = currentThreadName.empty() ? "thread " + std::to_string(buffer->thread) : currentThreadName;
+        buffer->events.reset(new Event[TRACE_BUFFER_SIZE]);
+        buffers.emplace_back(buffer);
+        currentBuffer = buffer;
+    }
+    return currentBuffer;
+}
+
+
+void Tracer::record(const char *name, Uint64 start, Uint64 end)
+{
+    ThreadBuffer *buffer = threadBuffer();
+
+    // Only this thread moves head
+    uint64_t head = buffer->head.load(std::memory_order_relaxed);
+    Event &event = buffer->events[head % TRACE_BUFFER_SIZE];
+    event.name.store(name, std::memory_order_relaxed);
+    event.start.store(start, std::memory_order_relaxed);
+    event.end.store(end, std::memory_order_relaxed);
+    buffer->head.store(head + 1, std::memory_order_release);
+}
+
+
+/**
+ * Writes string as JSON string literal.
+ */
+static void writeString(std::ofstream &file, const std::string &value)
+{
+    file << '"';
+    for (char c : value)
+    {
+        if (c == '"' || c == '\\')
+            file << '\\';
+        file << c;
+    }
+    file << '"';
+}
+
+
+void Tracer::dump(const std::string &filepath)
+{
+    std::ofstream file(filepath, std::ios::trunc);
+    if (!file)
+        throw std::runtime_error("Tracer: unable to create " + filepath);
+
+    Uint64 start_ticks = startTicks;
+    file << std::fixed << std::setprecision(3) << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool is_first = true;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const std::unique_ptr<ThreadBuffer> &buffer : buffers)
+    {
+        // Thread name
+        file << (is_first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->thread
+             << ",\"args\":{\"name\":";
+        writeString(file, buffer->name);
+        file << "}}";
+        is_first = false;
+
+        // Copy latest events
+        uint64_t head = buffer->head.load(std::memory_order_acquire);
+        uint64_t first = (head > TRACE_BUFFER_SIZE) ? head - TRACE_BUFFER_SIZE : 0;
+        std::vector<RecordedSpan> events;
+        events.reserve(head - first);
+        for (uint64_t i = first; i < head; i++)
+        {
+            const Event &event = buffer->events[i % TRACE_BUFFER_SIZE];
+            events.push_back({event.name.load(std::memory_order_relaxed),
+                              event.start.load(std::memory_order_relaxed), event.end.load(std::memory_order_relaxed)});
+        }
+
+        // Events overwritten while copying are garbage (writer may already fill slot of new head before
+        // publishing it)
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t new_head = buffer->head.load(std::memory_order_relaxed);
+        uint64_t valid = (new_head + 1 > TRACE_BUFFER_SIZE) ? new_head + 1 - TRACE_BUFFER_SIZE : 0;
+
+        for (uint64_t i = std::max(first, valid); i < head; i++)
+        {
+            const RecordedSpan &event = events[i - first];
+            if (event.start < start_ticks)
+                continue;
+            file << ",\n{\"name\":\"" << event.name << "\",\"cat\":\"audio\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->thread
+                 << ",\"ts\":" << event.start / 1e3 << ",\"dur\":" << (event.end - event.start) / 1e3 << "}";
+        }
+    }
+
+    file << "\n]}\n";
+    if (!file)
+        throw std::runtime_error("Tracer: unable to write " + filepath);
+}
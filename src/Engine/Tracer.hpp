@@ -0,0 +1,144 @@
+#pragma once
+
+
+// Strings
+#include <string>
+// Containers
+#include <vector>
+#include <memory>
+// Threads
+#include <mutex>
+#include <atomic>
+// SDL3
+#include <SDL3/SDL.h>
+
+
+/**
+ * Opt-in recorder of audio pipeline spans. Every thread writes into its own ring of latest events without
+ * locks, so recording costs two clock reads and a few relaxed stores. Recorded spans are dumped as Chrome
+ * trace-event JSON (opens in Perfetto and chrome://tracing).
+ */
+class Tracer
+{
+    /**
+     * Recorded span. Fields are atomic because dump may read event that is being overwritten
+     * (such events are detected and discarded).
+     */
+    struct Event
+    {
+        // Span name (string literal).
+        std::atomic<const char*> name;
+        // Span start in SDL nanosecond ticks.
+        std::atomic<Uint64> start;
+        // Span end in SDL nanosecond ticks.
+        std::atomic<Uint64> end;
+    };
+
+    /**
+     * Events of one thread.
+     */
+    struct ThreadBuffer
+    {
+        // Trace thread ID.
+        int thread = 0;
+        // Thread name (guarded by registry mutex).
+        std::string name;
+        // Number of events ever written (next event goes to head % buffer size).
+        std::atomic<uint64_t> head = 0;
+        // Ring of latest events.
+        std::unique_ptr<Event[]> events;
+    };
+
+    // Whether spans are recorded.
+    static std::atomic<bool> enabled;
+    // Spans started before this time (SDL nanosecond ticks) are not dumped.
+    static std::atomic<Uint64> startTicks;
+    // Guards buffers list and thread names.
+    static std::mutex mutex;
+    // Buffers of all threads that have ever recorded (kept after thread exit).
+    static std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    // Buffer of current thread.
+    static thread_local ThreadBuffer *currentBuffer;
+    // Name given to current thread before it recorded anything.
+    static thread_local std::string currentThreadName;
+
+public:
+
+    /**
+     * Starts recording (spans recorded earlier are not dumped anymore).
+     */
+    static void start();
+    /**
+     * Stops recording. Recorded spans can still be dumped.
+     */
+    static void stop();
+    /**
+     * @return whether spans are recorded
+     */
+    static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+    /**
+     * Names calling thread in trace.
+     */
+    static void setThreadName(const std::string &name);
+
+    /**
+     * Records span of calling thread.
+     *
+     * @param name span name (must be string literal or otherwise outlive tracer)
+     * @param start span start in SDL nanosecond ticks
+     * @param end span end in SDL nanosecond ticks
+     */
+    static void record(const char *name, Uint64 start, Uint64 end);
+
+    /**
+     * Writes recorded spans as Chrome trace-event JSON. Safe while threads keep recording.
+     *
+     * @throws Runtime Error if file can not be written.
+     */
+    static void dump(const std::string &filepath);
+
+private:
+
+    /**
+     * @return buffer of calling thread (created on first use)
+     */
+    static ThreadBuffer* threadBuffer();
+};
+
+
+/**
+ * Records scope as span if tracer is enabled when scope is entered.
+ */
+class TraceSpan
+{
+    // Span name.
+    const char *name;
+    // Span start in SDL nanosecond ticks (0 if span is not recorded).
+    Uint64 start = 0;
+
+public:
+
+    /**
+     * Constructor.
+     *
+     * @param name span name (string literal)
+     */
+    explicit TraceSpan(const char *name) : name(name)
+    {
+        if (Tracer::isEnabled())
+            start = SDL_GetTicksNS();
+    }
+
+    /**
+     * Destructor.
+     */
+    ~TraceSpan()
+    {
+        if (start)
+            Tracer::record(name, start, SDL_GetTicksNS());
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+};
@@ -0,0 +1,217 @@
+#include <Engine/WorkerPool.hpp>
+
+
+// Min/max
+#include <algorithm>
+// Console output
+#include <cstdio>
+// Trace thread names
+#include <Engine/Tracer.hpp>
+
+
+// Pool that current thread works for (nullptr outside of workers).
+static thread_local const WorkerPool *currentPool = nullptr;
+// Index of current worker.
+static thread_local int currentWorker = -1;
+
+
+WorkerPool::WorkerPool(int threadCount)
+{
+    // Scale with cores, one core stays for audio thread
+    if (threadCount <= 0)
+        threadCount = std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 1);
+
+    for (int i = 0; i < threadCount; i++)
+        workers.push_back(new Worker());
+    // Start after all workers exist, they steal from each other
+    for (int i = 0; i < threadCount; i++)
+        workers[i]->thread = std::thread(&WorkerPool::work, this, i);
+}
+
+
+WorkerPool::~WorkerPool()
+{
+    // Wake and join workers
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        isRunning = false;
+    }
+    sleepCondition.notify_all();
+    for (Worker *worker : workers)
+        worker->thread.join();
+
+    // Objects handed over for deletion must not leak, other jobs are dropped (cleanup may queue more)
+    while (queuedCount() > 0)
+    {
+        for (Worker *worker : workers)
+        {
+            for (int p = HIGH; p < PRIORITY_COUNT; p++)
+            {
+                while (!worker->queues[p].empty())
+                {
+                    QueuedJob job = std::move(worker->queues[p].front());
+                    worker->queues[p].pop_front();
+                    queued[p]--;
+                    if (!job.isCleanup)
+                        continue;
+                    try
+                    {
+                        job.job();
+                    }
+                    catch(const std::exception& e)
+                    {
+                        #ifdef DEBUG
+                            printf("Worker job failed: %s\n", e.what());
+                        #endif
+                    }
+                }
+            }
+        }
+    }
+
+    for (Worker *worker : workers)
+        delete worker;
+}
+
+
+void WorkerPool::submit(Job job, Priority priority)
+{
+    enqueue(std::move(job), priority, false);
+}
+
+
+void WorkerPool::retire(Job job, Priority priority)
+{
+    enqueue(std::move(job), priority, true);
+}
+
+
+void WorkerPool::enqueue(Job job, Priority priority, bool isCleanup)
+{
+    // Jobs spawned by worker stay with it (their data is likely in its cache)
+    size_t index;
+    if (currentPool == this)
+        index = currentWorker;
+    else
+        index = nextWorker++ % workers.size();
+
+    Worker *worker = workers[index];
+    {
+        std::lock_guard<std::mutex> lock(worker->mutex);
+        worker->queues[priority].push_back({std::move(job), std::chrono::steady_clock::now(), isCleanup});
+        queued[priority]++;
+    }
+
+    // Wake one sleeping worker
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    sleepCondition.notify_one();
+}
+
+
+WorkerPool::Stats WorkerPool::getStats() const
+{
+    Stats stats;
+    stats.threads = getThreadCount();
+    stats.running = running;
+    for (int i = 0; i < PRIORITY_COUNT; i++)
+    {
+        stats.queued[i] = queued[i];
+        stats.completed[i] = completed[i];
+        if (stats.completed[i] > 0)
+            stats.averageLatency[i] = totalLatency[i] / 1e9 / stats.completed[i];
+        stats.maxLatency[i] = maxLatency[i] / 1e9;
+    }
+    return stats;
+}
+
+
+size_t WorkerPool::queuedCount() const
+{
+    size_t count = 0;
+    for (int i = 0; i < PRIORITY_COUNT; i++)
+        count += queued[i];
+    return count;
+}
+
+
+bool WorkerPool::takeJob(int index, QueuedJob &job, Priority &priority)
+{
+    for (int p = HIGH; p < PRIORITY_COUNT; p++)
+    {
+        if (queued[p] == 0)
+            continue;
+
+        // Own queue: newest job
+        {
+            Worker *worker = workers[index];
+            std::lock_guard<std::mutex> lock(worker->mutex);
+            if (!worker->queues[p].empty())
+            {
+                job = std::move(worker->queues[p].back());
+                worker->queues[p].pop_back();
+                queued[p]--;
+                priority = static_cast<Priority>(p);
+                return true;
+            }
+        }
+
+        // Other queues: oldest job
+        for (size_t i = 1; i < workers.size(); i++)
+        {
+            Worker *victim = workers[(index + i) % workers.size()];
+            std::lock_guard<std::mutex> lock(victim->mutex);
+            if (!victim->queues[p].empty())
+            {
+                job = std::move(victim->queues[p].front());
+                victim->queues[p].pop_front();
+                queued[p]--;
+                priority = static_cast<Priority>(p);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+
+void WorkerPool::work(int index)
+{
+    currentPool = this;
+    currentWorker = index;
+    Tracer::setThreadName("worker " + std::to_string(index));
+
+    while (isRunning)
+    {
+        QueuedJob job;
+        Priority priority;
+        if (!takeJob(index, job, priority))
+        {
+            // Sleep until something is submitted
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            sleepCondition.wait(lock, [this]() { return (queuedCount() > 0) || !isRunning; });
+            continue;
+        }
+
+        // Time spent in queue
+        uint64_t latency = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - job.time).count();
+        totalLatency[priority] += latency;
+        uint64_t max_latency = maxLatency[priority];
+        while ((latency > max_latency) && !maxLatency[priority].compare_exchange_weak(max_latency, latency)) {}
+
+        running++;
+        try
+        {
+            job.job();
+        }
+        catch(const std::exception& e)
+        {
+            #ifdef DEBUG
+                printf("Worker job failed: %s\n", e.what());
+            #endif
+        }
+        running--;
+        completed[priority]++;
+    }
+}
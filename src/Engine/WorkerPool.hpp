@@ -0,0 +1,174 @@
+#pragma once
+
+
+// Containers
+#include <vector>
+#include <deque>
+// Callbacks
+#include <functional>
+// Threads
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+// Time measurement
+#include <chrono>
+// Fixed size integers
+#include <cstdint>
+
+
+/**
+ * Engine-wide pool for non-real-time jobs (probing, pre-decoding, analysis). Every worker owns queues
+ * of jobs it has submitted and steals from other workers when its own are empty. Jobs of higher
+ * priority are always taken first, no matter whose queue they are in.
+ */
+class WorkerPool
+{
+public:
+
+    /**
+     * Describes job priority.
+     */
+    enum Priority
+    {
+        // Work user is waiting for (loading, decoding of triggered clip).
+        HIGH,
+        // Regular background work.
+        NORMAL,
+        // Work nobody is waiting for (indexing, analysis).
+        LOW,
+        PRIORITY_COUNT
+    };
+
+    /**
+     * Job to run.
+     */
+    typedef std::function<void()> Job;
+
+    /**
+     * Pool statistics.
+     */
+    struct Stats
+    {
+        // Number of worker threads.
+        int threads = 0;
+        // Jobs waiting in queues per priority.
+        size_t queued[PRIORITY_COUNT] = {};
+        // Jobs being executed right now.
+        size_t running = 0;
+        // Jobs executed per priority.
+        uint64_t completed[PRIORITY_COUNT] = {};
+        // Average time jobs spent in queue per priority in seconds.
+        double averageLatency[PRIORITY_COUNT] = {};
+        // Longest time job spent in queue per priority in seconds.
+        double maxLatency[PRIORITY_COUNT] = {};
+    };
+
+private:
+
+    /**
+     * Job waiting in queue.
+     */
+    struct QueuedJob
+    {
+        // Job.
+        Job job;
+        // Time of submission.
+        std::chrono::steady_clock::time_point time;
+        // Whether job frees resources (it runs even if pool is destroyed first).
+        bool isCleanup = false;
+    };
+
+    /**
+     * Worker thread with its queues.
+     */
+    struct Worker
+    {
+        // Jobs per priority (owner takes newest, thieves take oldest).
+        std::deque<QueuedJob> queues[PRIORITY_COUNT];
+        // Guards queues.
+        std::mutex mutex;
+        // Worker thread.
+        std::thread thread;
+    };
+
+    // Workers.
+    std::vector<Worker*> workers;
+    // Next worker to receive job submitted from outside of pool.
+    std::atomic<size_t> nextWorker = 0;
+
+    // Jobs waiting in queues per priority.
+    std::atomic<size_t> queued[PRIORITY_COUNT] = {};
+    // Jobs being executed.
+    std::atomic<size_t> running = 0;
+    // Jobs executed per priority.
+    std::atomic<uint64_t> completed[PRIORITY_COUNT] = {};
+    // Sum of queue times per priority in nanoseconds.
+    std::atomic<uint64_t> totalLatency[PRIORITY_COUNT] = {};
+    // Longest queue time per priority in nanoseconds.
+    std::atomic<uint64_t> maxLatency[PRIORITY_COUNT] = {};
+
+    // Whether workers should run.
+    std::atomic<bool> isRunning = true;
+    // Used to sleep while there are no jobs.
+    std::mutex sleepMutex;
+    std::condition_variable sleepCondition;
+
+public:
+
+    /**
+     * Constructor. Starts workers.
+     *
+     * @param threadCount number of workers (0 means one per core, leaving one core to audio thread)
+     */
+    explicit WorkerPool(int threadCount = 0);
+    /**
+     * Destructor. Waits for running jobs, runs queued cleanup jobs and drops the rest.
+     */
+    ~WorkerPool();
+
+    /**
+     * @return number of workers
+     */
+    int getThreadCount() const { return static_cast<int>(workers.size()); }
+
+    /**
+     * Queues job. Jobs submitted by worker go to its own queue, others are spread across workers.
+     * Exceptions thrown by jobs are dropped, jobs must report their errors themselves.
+     */
+    void submit(Job job, Priority priority = NORMAL);
+    /**
+     * Queues cleanup job (deletion of objects that are slow to free). Unlike other jobs it is never dropped,
+     * jobs left in queues when pool is destroyed run on destroying thread.
+     */
+    void retire(Job job, Priority priority = LOW);
+
+    /**
+     * @return queue depth and job latency statistics
+     */
+    Stats getStats() const;
+
+private:
+
+    /**
+     * Queues job (see submit and retire).
+     */
+    void enqueue(Job job, Priority priority, bool isCleanup);
+
+    /**
+     * Worker cycle.
+     */
+    void work(int index);
+
+    /**
+     * Takes job of highest priority: own newest first, then oldest of other workers.
+     *
+     * @return false if there are no jobs
+     */
+    bool takeJob(int index, QueuedJob &job, Priority &priority);
+
+    /**
+     * @return total number of queued jobs
+     */
+    size_t queuedCount() const;
+};
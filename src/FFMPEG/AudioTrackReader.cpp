@@ -1,524 +1,442 @@
-#ifndef AUDIO_TRACK_CONTEXT
-#define AUDIO_TRACK_CONTEXT
+#include <FFMPEG/AudioTrackReader.hpp>
 
 
-// Strings
-#include <string>
 // Min/max
 #include <algorithm>
 // Exceptions
 #include <stdexcept>
-// FFMPEG
-extern "C"
-{
-#include <libavutil/opt.h>
-#include <libavcodec/avcodec.h>
-#include <libavformat/avformat.h>
-#include <libswresample/swresample.h>
-#define __STDC_CONSTANT_MACROS
-}
-
+// Memory moving
+#include <cstring>
+// Rounding
+#include <cmath>
+// Pipeline spans
+#include <Engine/Tracer.hpp>
 
 
-/**
- *  Describes FFPEG media file context. Can read samples from media file.
- */
-class AudioTrackContext
-{
-    // Media file path
-    std::string filepath;
-
-    // Media file format context
-    AVFormatContext *format_ctx = nullptr;
-    // Audio stream index
-    int audio_stream_index;
-    // Media file codec
-    const AVCodec *decoder = nullptr;
-
-    // Media file codec contex
-    AVCodecContext *decoder_ctx = nullptr;
-    // Media file packet
-    AVPacket *packet = nullptr;
-    // Media file frame
-    AVFrame *frame = nullptr;
-
-    // Media resampling context
-    SwrContext *swr_ctx = nullptr;
-    // Media data desired sample format
-    AVSampleFormat sample_format = AV_SAMPLE_FMT_FLT;
-    // Initial sample count for converter
-    int swr_nb_samples = 1024;
-    // Audio data
-    uint8_t **swr_data = nullptr;
-    // How many samples are located in swr_data
-    int swr_data_samples_count = 0;
-
-    // Last frame timestamp in seconds
-    double frame_time = 0;
-    // Target timestamp in ticks. Only frames with timestamp greater than it are considered valid.
-    int64_t target_pts = 0;
-
-    
-public:
-
-    /**
-     *  Constructor.
-     * 
-     *  @param filepath media file path.
-     */
-    explicit AudioTrackContext(std::string filepath)
-    {
-        // Save file path
-        this->filepath = filepath;
-    }
-
-
-    /** 
-     * Destructor.
-     */
-    ~AudioTrackContext()
-    {
-        close();
-    }
+// Skips forward up to this long are decoded through instead of seeking (seconds, few decoder frames, read()
+// runs on audio thread)
+#define SEEK_DECODE_LIMIT 0.1
 
 
-    /**
-     * @return audio track sample rate.
-     */
-    int getSampleRate() const
-    {
-        return (decoder_ctx) ? decoder_ctx->sample_rate : 0;
-    }
-
-
-    /**
-     * @return audio track number of channels.
-     */
-    int getChannelCount() const
-    {
-        return (decoder_ctx) ? decoder_ctx->ch_layout.nb_channels : 0;
-    }
-
-
-    /**
-     * @return audio track total duration in seconda.
-     */
-    double getDuration()
-    {
-        // Itit format context if needed
-        if (!format_ctx)
-            initFormatContext();
+AudioTrackContext::AudioTrackContext(std::string filepath)
+{
+    // Save file path
+    this->filepath = filepath;
+}
 
-        // Convert ticks (first multiplier) to seconds
-        double duration = format_ctx->streams[audio_stream_index]->duration * av_q2d(format_ctx->streams[audio_stream_index]->time_base);
 
-        // Close format context if needed
-        if (format_ctx)
-            closeFormatContext();
+AudioTrackContext::~AudioTrackContext()
+{
+    close();
+}
 
-        return duration;
-    }
 
+double AudioTrackContext::getDuration()
+{
+    // Itit format context if needed
+    if (!format_ctx)
+        initFormatContext();
 
-    /**
-     * @return audio data samples count.
-     */
-    int getAudioDataSamplesCount() const
-    {
-        return swr_data_samples_count;
-    }
+    // Convert ticks (first multiplier) to seconds
+    double duration = format_ctx->streams[audio_stream_index]->duration * av_q2d(format_ctx->streams[audio_stream_index]->time_base);
 
+    // Close format context if needed
+    if (format_ctx)
+        closeFormatContext();
 
-    /**
-     * @return audio data.
-     */
-    uint8_t** getAudioData() const
-    {
-        return swr_data;
-    }
+    return duration;
+}
 
 
-    /**
-     * @return current audio track timestamp in seconds.
-     */
-    double getTime()
-    {
-        return frame_time;
-    }
+void AudioTrackContext::setTime(double seconds)
+{
+    setSample(std::llround(seconds * getSampleRate()));
+}
 
 
-    /**
-     * Set audio track time (will update reading of samples).
-     * 
-     * @param seconds time in seconds.
-     */
-    void setTime(double seconds)
+void AudioTrackContext::setSample(int64_t sample)
+{
+    // If has active context
+    if (format_ctx && decoder_ctx)
     {
-        // If has active context
-        if (format_ctx && decoder_ctx)
-        {
-            // Minimun timestamp is 1 second before requested and always > 0
-            int64_t min_pts = std::min(int64_t(0),
-                                       av_rescale_q((seconds - 1) * AV_TIME_BASE, AV_TIME_BASE_Q, format_ctx->streams[audio_stream_index]->time_base));
-            // Convert seconds to audio format ticks
-            target_pts = av_rescale_q(seconds * AV_TIME_BASE, AV_TIME_BASE_Q, format_ctx->streams[audio_stream_index]->time_base);
-            // Try to seek in stream
-            if (avformat_seek_file(format_ctx, audio_stream_index, min_pts, target_pts, target_pts, 0) >= 0) {
-                // Flush decoder
-                avcodec_flush_buffers(decoder_ctx);
-
-                // Flush frame and packet
-                if (frame)
-                    av_frame_unref(frame);
-                if (packet)
-                    av_packet_unref(packet);
-            }
+        // Frames up to target are dropped while reading
+        target_sample = sample;
+        // Decoding little further is cheaper than seeking
+        if ((sample >= next_sample) && (sample - next_sample <= std::llround(SEEK_DECODE_LIMIT * getSampleRate())))
+            return;
+
+        TraceSpan span("seek");
+
+        double seconds = static_cast<double>(sample) / getSampleRate();
+        // Minimun timestamp is 1 second before requested and always > 0
+        int64_t min_pts = std::min(int64_t(0),
+                                   av_rescale_q((seconds - 1) * AV_TIME_BASE, AV_TIME_BASE_Q, format_ctx->streams[audio_stream_index]->time_base));
+        // Convert samples to audio format ticks
+        int64_t target_pts = av_rescale_q(sample, AVRational{1, getSampleRate()}, format_ctx->streams[audio_stream_index]->time_base);
+        // Try to seek in stream
+        if (avformat_seek_file(format_ctx, audio_stream_index, min_pts, target_pts, target_pts, 0) >= 0) {
+            // Flush decoder
+            avcodec_flush_buffers(decoder_ctx);
+
+            // Flush frame and packet
+            if (frame)
+                av_frame_unref(frame);
+            if (packet)
+                av_packet_unref(packet);
+
+            // Decoder continues from some earlier frame
+            next_sample = INT64_MAX;
         }
     }
+}
 
 
-private:
-
-    /**
-     * Creates FFMPEG format context.
-     */
-    void initFormatContext()
+void AudioTrackContext::initFormatContext()
+{
+    try
     {
-        try
+        // Open file
         {
-            // Open file
+            TraceSpan span("open");
             if (avformat_open_input(&format_ctx, filepath.c_str(), NULL, NULL) < 0)
             {
                 throw std::runtime_error("Unable to open media file");
             }
-            
-            // Get info about media streams in file
+        }
+        
+        // Get info about media streams in file
+        {
+            TraceSpan span("find_stream_info");
             if (avformat_find_stream_info(format_ctx, NULL) < 0)
             {
                 throw std::runtime_error("Unable to find media streams in file");
             }
-
-            // Find index of the audio stream
-            audio_stream_index = av_find_best_stream(format_ctx, AVMEDIA_TYPE_AUDIO, -1, -1, &decoder, 0);
-            if (audio_stream_index < 0)
-            {
-                throw std::runtime_error("Unable to find an audio stream in file");
-            }
         }
-        catch(const std::exception& e)
+
+        // Find index of the audio stream
+        audio_stream_index = av_find_best_stream(format_ctx, AVMEDIA_TYPE_AUDIO, -1, -1, &decoder, 0);
+        if (audio_stream_index < 0)
         {
-            // Clear data on exception and rethrow
-            close();
-            throw;
+            throw std::runtime_error("Unable to find an audio stream in file");
         }
     }
+    catch(const std::exception& e)
+    {
+        // Clear data on exception and rethrow
+        close();
+        throw;
+    }
+}
 
 
-    /**
-     * Disposes FFMPEG format context.
-     */
-    void closeFormatContext()
+void AudioTrackContext::closeFormatContext()
+{
+    if (format_ctx)
     {
-        if (format_ctx)
-        {
-            avformat_close_input(&format_ctx);
-            format_ctx = nullptr;
-        }
+        avformat_close_input(&format_ctx);
+        format_ctx = nullptr;
     }
+}
 
 
-    /**
-     * Creates FFMPEG decoder context.
-     */
-    void initDecoderContext()
+void AudioTrackContext::initDecoderContext()
+{
+    try
     {
-        try
+        // Allocate decoder context
+        decoder_ctx = avcodec_alloc_context3(decoder);
+        if (!decoder_ctx)
         {
-            // Allocate decoder context
-            decoder_ctx = avcodec_alloc_context3(decoder);
-            if (!decoder_ctx)
-            {
-                throw std::runtime_error("Unable to create audio decoder context");
-            }
-
-            // Init decoder context
-            if (avcodec_parameters_to_context(decoder_ctx, format_ctx->streams[audio_stream_index]->codecpar))
-            {
-                throw std::runtime_error("Unable to init audio decoder context");
-            }
-
-            // Open file with decoder context
-            if (avcodec_open2(decoder_ctx, decoder, NULL) < 0)
-            {
-                throw std::runtime_error("Unable to open file with decoder context");
-            }
-
-            // DEBUG
-            #ifdef DEBUG
-                printf("============ Track info ============\n");
-                printf("%s\n", decoder->name);
-                printf("channels: %d\n", decoder_ctx->ch_layout.nb_channels);
-                printf("sample format: %d\n", decoder_ctx->sample_fmt);
-                printf("sample rate: %d\n", decoder_ctx->sample_rate);
-                printf("====================================\n");
-            #endif
-
-            // Allocate media data packet
-            packet = av_packet_alloc();
-            if (!packet)
-            {
-                throw std::runtime_error("Unable to allocate media data packet");
-            }
-
-            // Allocate media data frame
-            frame = av_frame_alloc();
-            if (!frame)
-            {
-                throw std::runtime_error("Unable to allocate media data frame");
-            }
+            throw std::runtime_error("Unable to create audio decoder context");
         }
-        catch(const std::exception& e)
+
+        // Init decoder context
+        if (avcodec_parameters_to_context(decoder_ctx, format_ctx->streams[audio_stream_index]->codecpar))
         {
-            // Clear data on exception and rethrow
-            close();
-            throw;
+            throw std::runtime_error("Unable to init audio decoder context");
         }
-    }
 
-
-    /**
-     * Disposes FFMPEG decoder context.
-     */
-    void closeDecoderContext()
-    {
-        // Free frame
-        if (frame)
+        // Open file with decoder context
+        if (avcodec_open2(decoder_ctx, decoder, NULL) < 0)
         {
-            av_frame_free(&frame);
-            frame = nullptr;
+            throw std::runtime_error("Unable to open file with decoder context");
         }
-        // Free packet
-        if (packet)
+
+        // DEBUG
+        #ifdef DEBUG
+            printf("============ Track info ============\n");
+            printf("%s\n", decoder->name);
+            printf("channels: %d\n", decoder_ctx->ch_layout.nb_channels);
+            printf("sample format: %d\n", decoder_ctx->sample_fmt);
+            printf("sample rate: %d\n", decoder_ctx->sample_rate);
+            printf("====================================\n");
+        #endif
+
+        // Allocate media data packet
+        packet = av_packet_alloc();
+        if (!packet)
         {
-            av_packet_free(&packet);
-            packet = nullptr;
+            throw std::runtime_error("Unable to allocate media data packet");
         }
-        // Free codec contex
-        if (decoder_ctx)
+
+        // Allocate media data frame
+        frame = av_frame_alloc();
+        if (!frame)
         {
-            avcodec_free_context(&decoder_ctx);
-            decoder_ctx = nullptr;
+            throw std::runtime_error("Unable to allocate media data frame");
         }
     }
+    catch(const std::exception& e)
+    {
+        // Clear data on exception and rethrow
+        close();
+        throw;
+    }
+}
 
 
-    /**
-     * Creates FFMPEG audio resampler.
-     */
-    void initResamplerContext()
+void AudioTrackContext::closeDecoderContext()
+{
+    // Free frame
+    if (frame)
     {
-        try
-        {
-            // Allocate resampler context
-            swr_ctx = swr_alloc();
-            if (!swr_ctx)
-            {
-                throw std::runtime_error("Unable to allocate resampler context");
-            }
+        av_frame_free(&frame);
+        frame = nullptr;
+    }
+    // Free packet
+    if (packet)
+    {
+        av_packet_free(&packet);
+        packet = nullptr;
+    }
+    // Free codec contex
+    if (decoder_ctx)
+    {
+        avcodec_free_context(&decoder_ctx);
+        decoder_ctx = nullptr;
+    }
+}
 
-            // Set resampler input parameters
-            av_opt_set_chlayout(swr_ctx,   "in_chlayout",    &decoder_ctx->ch_layout, 0);
-            av_opt_set_int(swr_ctx,        "in_sample_rate", decoder_ctx->sample_rate, 0);
-            av_opt_set_sample_fmt(swr_ctx, "in_sample_fmt",  decoder_ctx->sample_fmt, 0);
-            // Set resampler output parameters
-            av_opt_set_chlayout(swr_ctx,   "out_chlayout",    &decoder_ctx->ch_layout, 0);
-            av_opt_set_int(swr_ctx,        "out_sample_rate", decoder_ctx->sample_rate, 0);
-            av_opt_set_sample_fmt(swr_ctx, "out_sample_fmt",  sample_format, 0);
-
-            // Init resampler context
-            if (swr_init(swr_ctx) < 0)
-            {
-                throw std::runtime_error("Unable to init resampling context");
-            }
 
-            // Allocate resempler buffer (will be used wiyh no alignment)
-            int swr_linesize;
-            if (av_samples_alloc_array_and_samples(&swr_data, &swr_linesize, decoder_ctx->ch_layout.nb_channels, swr_nb_samples, sample_format, 0) < 0)
-            {
-                throw std::runtime_error("Could not allocate destination samples");
-            }
-        }
-        catch(const std::exception& e)
+void AudioTrackContext::initResamplerContext()
+{
+    try
+    {
+        // Allocate resampler context
+        swr_ctx = swr_alloc();
+        if (!swr_ctx)
         {
-            // Clear data on exception and rethrow
-            close();
-            throw;
+            throw std::runtime_error("Unable to allocate resampler context");
         }
-    }
-
 
-    /**
-     * Disposes FFMPEG audio resampler.
-     */
-    void closeResamplerContext()
-    {
-        // Free audio data
-        if (swr_data)
+        // Set resampler input parameters
+        av_opt_set_chlayout(swr_ctx,   "in_chlayout",    &decoder_ctx->ch_layout, 0);
+        av_opt_set_int(swr_ctx,        "in_sample_rate", decoder_ctx->sample_rate, 0);
+        av_opt_set_sample_fmt(swr_ctx, "in_sample_fmt",  decoder_ctx->sample_fmt, 0);
+        // Set resampler output parameters
+        av_opt_set_chlayout(swr_ctx,   "out_chlayout",    &decoder_ctx->ch_layout, 0);
+        av_opt_set_int(swr_ctx,        "out_sample_rate", decoder_ctx->sample_rate, 0);
+        av_opt_set_sample_fmt(swr_ctx, "out_sample_fmt",  sample_format, 0);
+
+        // Init resampler context
+        if (swr_init(swr_ctx) < 0)
         {
-            av_freep(&swr_data[0]);
-            av_freep(&swr_data);
-            swr_data = nullptr;
-            // Reset samples count
-            swr_data_samples_count = 0;
+            throw std::runtime_error("Unable to init resampling context");
         }
-        // Free resampling complex
-        if (swr_ctx)
+
+        // Allocate resempler buffer (will be used wiyh no alignment)
+        int swr_linesize;
+        if (av_samples_alloc_array_and_samples(&swr_data, &swr_linesize, decoder_ctx->ch_layout.nb_channels, swr_nb_samples, sample_format, 0) < 0)
         {
-            swr_free(&swr_ctx);
-            swr_ctx = nullptr;
+            throw std::runtime_error("Could not allocate destination samples");
         }
     }
+    catch(const std::exception& e)
+    {
+        // Clear data on exception and rethrow
+        close();
+        throw;
+    }
+}
 
 
-public:
-
-    /**
-     * Creates FFMPEG context.
-     */
-    void init()
+void AudioTrackContext::closeResamplerContext()
+{
+    // Free audio data
+    if (swr_data)
     {
-        // Init format, decoder and resampler contexts
-        initFormatContext();
-        initDecoderContext();
-        initResamplerContext();
+        av_freep(&swr_data[0]);
+        av_freep(&swr_data);
+        swr_data = nullptr;
+        // Reset samples count
+        swr_data_samples_count = 0;
     }
+    // Free resampling complex
+    if (swr_ctx)
+    {
+        swr_free(&swr_ctx);
+        swr_ctx = nullptr;
+    }
+}
 
 
-    /**
-     * Disposes FFMPEG context.
-     */
-    void close()
-    {
-        // Free contexs
-        closeResamplerContext();
-        closeDecoderContext();
-        closeFormatContext();
+void AudioTrackContext::init()
+{
+    // Init format, decoder and resampler contexts
+    initFormatContext();
+    initDecoderContext();
+    initResamplerContext();
+
+    // Decoder starts at beginning of stream
+    AVStream *stream = format_ctx->streams[audio_stream_index];
+    next_sample = (stream->start_time != AV_NOPTS_VALUE) ?
+                  av_rescale_q(stream->start_time, stream->time_base, AVRational{1, getSampleRate()}) : 0;
+}
 
-        // Reset frame timestamp
-        frame_time = 0;
-        // Reset time pts
-        target_pts = 0;
-    }
+
+void AudioTrackContext::close()
+{
+    // Free contexs
+    closeResamplerContext();
+    closeDecoderContext();
+    closeFormatContext();
+
+    // Reset frame timestamp
+    frame_time = 0;
+    // Reset sample positions
+    target_sample = 0;
+    data_sample = 0;
+    next_sample = 0;
+}
 
 
-    /**
-     *  Reads next audio data samples.
-     */
-    void read()
+void AudioTrackContext::read()
+{
+    // Try to find new frame
+    TraceSpan decode_span("decode");
+    AVRational sample_base = {1, getSampleRate()};
+    int64_t frame_sample;
+    while(1)
     {
-        // Try to find new frame
-        while(1)
+        // Try to read frame
+        int res = avcodec_receive_frame(decoder_ctx, frame);
+        // No packet or packet has ended
+        if (res == AVERROR(EAGAIN) || res == AVERROR_EOF)
         {
-            // Try to read frame
-            int res = avcodec_receive_frame(decoder_ctx, frame);
-            // No packet or packet has ended
-            if (res == AVERROR(EAGAIN) || res == AVERROR_EOF)
+            // If we previously had any packet we should dispose it
+            if (packet)
             {
-                // If we previously had any packet we should dispose it
-                if (packet)
-                {
-                    av_packet_unref(packet);
-                }
+                av_packet_unref(packet);
+            }
 
-                // Try to read new packet
-                if (av_read_frame(format_ctx, packet) < 0)
-                {
-                    // End of file
-                    swr_data_samples_count = 0;
-                    return;
-                }
+            // Try to read new packet
+            if (av_read_frame(format_ctx, packet) < 0)
+            {
+                // End of file
+                swr_data_samples_count = 0;
+                return;
+            }
 
-                // Check packet stream id (packet can represent video)
-                if (packet->stream_index == audio_stream_index)
+            // Check packet stream id (packet can represent video)
+            if (packet->stream_index == audio_stream_index)
+            {
+                // Send packet to decoder
+                switch (avcodec_send_packet(decoder_ctx, packet))
                 {
-                    // Send packet to decoder
-                    switch (avcodec_send_packet(decoder_ctx, packet))
-                    {
-                        case AVERROR(EAGAIN):
-                            close();
-                            throw std::runtime_error("Error while sending a packet to the decoder v1");
-                            break;
-                        case AVERROR_EOF:
-                            close();
-                            throw std::runtime_error("Error while sending a packet to the decoder v2");
-                            break;
-                        case AVERROR(EINVAL):
-                            close();
-                            throw std::runtime_error("Error while sending a packet to the decoder v3");
-                            break;
-                        case AVERROR(ENOMEM):
+                    case AVERROR(EAGAIN):
+                        close();
+                        throw std::runtime_error("Error while sending a packet to the decoder v1");
+                        break;
+                    case AVERROR_EOF:
+                        close();
+                        throw std::runtime_error("Error while sending a packet to the decoder v2");
+                        break;
+                    case AVERROR(EINVAL):
+                        close();
+                        throw std::runtime_error("Error while sending a packet to the decoder v3");
+                        break;
+                    case AVERROR(ENOMEM):
+                        close();
+                        throw std::runtime_error("Error while sending a packet to the decoder v4");
+                        break;
+                    default:
+                        if (packet==NULL)
+                        {
                             close();
-                            throw std::runtime_error("Error while sending a packet to the decoder v4");
-                            break;
-                        default:
-                            if (packet==NULL)
-                            {
-                                close();
-                                throw std::runtime_error("Error while sending a packet to the decoder");
-                            }
-                            break;
-                    }
-                }
-                else
-                {
-                    // If this packet is not audio dispose it
-                    av_packet_unref(packet);
+                            throw std::runtime_error("Error while sending a packet to the decoder");
+                        }
+                        break;
                 }
             }
-            // Success
-            else if (res == 0)
-            {
-                // If frame has correct timestamp
-                if (frame->pts >= target_pts)
-                    break;
-            }
-            // Other errors
             else
             {
-                close();
-                throw std::runtime_error("Error while receiving a frame from the decoder");
+                // If this packet is not audio dispose it
+                av_packet_unref(packet);
             }
         }
+        // Success
+        else if (res == 0)
+        {
+            // Frames without timestamp follow previous one
+            if (frame->pts != AV_NOPTS_VALUE)
+                frame_sample = av_rescale_q(frame->pts, format_ctx->streams[audio_stream_index]->time_base, sample_base);
+            else
+                frame_sample = (next_sample != INT64_MAX) ? next_sample : target_sample;
+            next_sample = frame_sample + frame->nb_samples;
 
-        // Set current timestamp
-        frame_time = frame->pts * av_q2d(format_ctx->streams[audio_stream_index]->time_base);
-
-        // Some reallocation might be required for resampler
-        if (swr_nb_samples != frame->nb_samples)
+            // If frame reaches target
+            if (next_sample > target_sample)
+                break;
+        }
+        // Other errors
+        else
         {
-            // Realloc
-            av_freep(&swr_data[0]);
-            int swr_linesize;
-            if (av_samples_alloc(swr_data, &swr_linesize, decoder_ctx->ch_layout.nb_channels, frame->nb_samples, sample_format, 1) < 0)
-            {
-                close();
-                throw std::runtime_error("Error reallocating memory for converted samples");
-            }
-            swr_nb_samples = frame->nb_samples;
+            close();
+            throw std::runtime_error("Error while receiving a frame from the decoder");
         }
+    }
 
-        // Convert samples
-        swr_data_samples_count = swr_convert(swr_ctx, swr_data, swr_nb_samples, (const uint8_t **)frame->extended_data, frame->nb_samples);
-        if (swr_data_samples_count < 0)
+    // Frame holding target starts exactly at it
+    int skip = static_cast<int>(std::clamp<int64_t>(target_sample - frame_sample, 0, frame->nb_samples));
+    data_sample = frame_sample + skip;
+
+    // Set current timestamp
+    frame_time = static_cast<double>(data_sample) / sample_base.den;
+
+    // Some reallocation might be required for resampler
+    if (swr_nb_samples != frame->nb_samples)
+    {
+        // Realloc
+        av_freep(&swr_data[0]);
+        int swr_linesize;
+        if (av_samples_alloc(swr_data, &swr_linesize, decoder_ctx->ch_layout.nb_channels, frame->nb_samples, sample_format, 1) < 0)
         {
             close();
-            throw std::runtime_error("Error while converting samples");
+            throw std::runtime_error("Error reallocating memory for converted samples");
         }
+        swr_nb_samples = frame->nb_samples;
+    }
 
-        // Do not forget to dispose processed frame
-        av_frame_unref(frame);
+    // Convert samples
+    {
+        TraceSpan span("swr_convert");
+        swr_data_samples_count = swr_convert(swr_ctx, swr_data, swr_nb_samples, (const uint8_t **)frame->extended_data, frame->nb_samples);
+    }
+    if (swr_data_samples_count < 0)
+    {
+        close();
+        throw std::runtime_error("Error while converting samples");
     }
-};
 
+    // Converted samples are interleaved, so cutting them is one move
+    skip = std::min(skip, swr_data_samples_count);
+    if (skip > 0)
+    {
+        size_t frame_size = static_cast<size_t>(decoder_ctx->ch_layout.nb_channels) * av_get_bytes_per_sample(sample_format);
+        std::memmove(swr_data[0], swr_data[0] + skip * frame_size, (swr_data_samples_count - skip) * frame_size);
+        swr_data_samples_count -= skip;
+    }
 
-#endif // AUDIO_TRACK_CONTEXT
\ No newline at end of file
+    // Do not forget to dispose processed frame
+    av_frame_unref(frame);
+}
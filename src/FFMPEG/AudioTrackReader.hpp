@@ -0,0 +1,200 @@
+#pragma once
+
+
+// Strings
+#include <string>
+// Fixed width integers
+#include <cstdint>
+// FFMPEG
+extern "C"
+{
+#include <libavutil/opt.h>
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libswresample/swresample.h>
+#define __STDC_CONSTANT_MACROS
+}
+
+
+
+/**
+ *  Describes FFPEG media file context. Can read samples from media file.
+ */
+class AudioTrackContext
+{
+    // Media file path
+    std::string filepath;
+
+    // Media file format context
+    AVFormatContext *format_ctx = nullptr;
+    // Audio stream index
+    int audio_stream_index;
+    // Media file codec
+    const AVCodec *decoder = nullptr;
+
+    // Media file codec contex
+    AVCodecContext *decoder_ctx = nullptr;
+    // Media file packet
+    AVPacket *packet = nullptr;
+    // Media file frame
+    AVFrame *frame = nullptr;
+
+    // Media resampling context
+    SwrContext *swr_ctx = nullptr;
+    // Media data desired sample format
+    AVSampleFormat sample_format = AV_SAMPLE_FMT_FLT;
+    // Initial sample count for converter
+    int swr_nb_samples = 1024;
+    // Audio data
+    uint8_t **swr_data = nullptr;
+    // How many samples are located in swr_data
+    int swr_data_samples_count = 0;
+
+    // Last frame timestamp in seconds
+    double frame_time = 0;
+    // Target sample. Frames before it are dropped, frame that holds it is cut to start exactly there.
+    int64_t target_sample = 0;
+    // First sample of audio data (counted in track sample rate from timestamp 0)
+    int64_t data_sample = 0;
+    // Sample decoder continues with (unknown after seeking)
+    int64_t next_sample = 0;
+
+    
+public:
+
+    /**
+     *  Constructor.
+     * 
+     *  @param filepath media file path.
+     */
+    explicit AudioTrackContext(std::string filepath);
+
+    /** 
+     * Destructor.
+     */
+    ~AudioTrackContext();
+
+    /**
+     * @return media file path.
+     */
+    const std::string& getFilepath() const
+    {
+        return filepath;
+    }
+
+    /**
+     * @return audio track sample rate.
+     */
+    int getSampleRate() const
+    {
+        return (decoder_ctx) ? decoder_ctx->sample_rate : 0;
+    }
+
+    /**
+     * @return audio track number of channels.
+     */
+    int getChannelCount() const
+    {
+        return (decoder_ctx) ? decoder_ctx->ch_layout.nb_channels : 0;
+    }
+
+    /**
+     * @return audio track total duration in seconda.
+     */
+    double getDuration();
+
+    /**
+     * @return audio data samples count.
+     */
+    int getAudioDataSamplesCount() const
+    {
+        return swr_data_samples_count;
+    }
+
+    /**
+     * @return audio data.
+     */
+    uint8_t** getAudioData() const
+    {
+        return swr_data;
+    }
+
+    /**
+     * @return current audio track timestamp in seconds.
+     */
+    double getTime()
+    {
+        return frame_time;
+    }
+
+    /**
+     * @return first sample of audio data (counted in track sample rate from timestamp 0).
+     */
+    int64_t getSamplePosition() const
+    {
+        return data_sample;
+    }
+
+    /**
+     * Set audio track time (will update reading of samples).
+     * 
+     * @param seconds time in seconds.
+     */
+    void setTime(double seconds);
+
+    /**
+     * Sets exact position of next audio data. Short skips forward are decoded through instead of seeking.
+     * 
+     * @param sample sample counted in track sample rate from timestamp 0.
+     */
+    void setSample(int64_t sample);
+
+private:
+
+    /**
+     * Creates FFMPEG format context.
+     */
+    void initFormatContext();
+
+    /**
+     * Disposes FFMPEG format context.
+     */
+    void closeFormatContext();
+
+    /**
+     * Creates FFMPEG decoder context.
+     */
+    void initDecoderContext();
+
+    /**
+     * Disposes FFMPEG decoder context.
+     */
+    void closeDecoderContext();
+
+    /**
+     * Creates FFMPEG audio resampler.
+     */
+    void initResamplerContext();
+
+    /**
+     * Disposes FFMPEG audio resampler.
+     */
+    void closeResamplerContext();
+
+public:
+
+    /**
+     * Creates FFMPEG context.
+     */
+    void init();
+
+    /**
+     * Disposes FFMPEG context.
+     */
+    void close();
+
+    /**
+     *  Reads next audio data samples.
+     */
+    void read();
+};
@@ -0,0 +1,33 @@
+#pragma once
+
+
+// Fixed width integers
+#include <cstdint>
+// Silence as -infinity
+#include <cmath>
+
+
+// Samples quieter than this are silence around clip by default (dBFS)
+#define DEFAULT_SILENCE_THRESHOLD -60.0
+
+
+/**
+ * Measurements of media file that change how it is played. Samples are counted in track sample rate from
+ * timestamp 0, the way AudioTrackContext positions them.
+ */
+struct ClipAnalysis
+{
+    // Integrated loudness in LUFS (-infinity for silence or until measured).
+    double loudness = -INFINITY;
+    // True peak in dBTP (-infinity for silence or until measured).
+    double truePeak = -INFINITY;
+    // First audible sample.
+    int64_t audibleStart = 0;
+    // Sample after last audible one (negative if track is silent or was not measured).
+    int64_t audibleEnd = -1;
+
+    /**
+     * @return whether anything was measured
+     */
+    bool isMeasured() const { return std::isfinite(loudness) || (audibleEnd >= 0); }
+};
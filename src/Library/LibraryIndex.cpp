@@ -0,0 +1,389 @@
+#include <Library/LibraryIndex.hpp>
+
+
+// Exceptions
+#include <stdexcept>
+// Memory copying
+#include <cstring>
+// Files
+#include <fstream>
+#include <filesystem>
+// Interning
+#include <unordered_map>
+// Console output
+#include <cstdio>
+#ifndef _WIN32
+// Memory mapping
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+// File signature
+#define INDEX_MAGIC "OSBLIDX"
+// Format version (changes whenever layout does)
+#define INDEX_VERSION 4
+// Alignment of string pool and arrays in bytes
+#define INDEX_ALIGNMENT 8
+
+
+/**
+ * Index arrays in file order.
+ */
+enum IndexColumn
+{
+    DIRECTORY_COLUMN,
+    NAME_COLUMN,
+    SIZE_COLUMN,
+    MODIFIED_COLUMN,
+    DURATION_COLUMN,
+    LOUDNESS_COLUMN,
+    TRUE_PEAK_COLUMN,
+    AUDIBLE_START_COLUMN,
+    AUDIBLE_END_COLUMN,
+    PEAKS_COLUMN,
+    COLUMN_COUNT
+};
+
+
+/**
+ * Start of index file.
+ */
+struct IndexHeader
+{
+    // File signature (zero-terminated).
+    char magic[8];
+    // Format version.
+    uint32_t version;
+    // Number of records.
+    uint32_t count;
+    // Waveform buckets per record.
+    uint32_t peaksSize;
+    // Root directory (string pool offset).
+    uint32_t root;
+    // File offset of string pool.
+    uint64_t stringsOffset;
+    // Size of string pool.
+    uint64_t stringsSize;
+    // Level audible bounds were measured at (dBFS).
+    double silenceThreshold;
+    // File offset of each array.
+    uint64_t columns[COLUMN_COUNT];
+};
+
+
+/**
+ * @return size of one array element
+ */
+static uint64_t elementSize(int column)
+{
+    switch (column)
+    {
+        case DIRECTORY_COLUMN:
+        case NAME_COLUMN:
+            return sizeof(uint32_t);
+        case SIZE_COLUMN:
+            return sizeof(uint64_t);
+        case MODIFIED_COLUMN:
+        case AUDIBLE_START_COLUMN:
+        case AUDIBLE_END_COLUMN:
+            return sizeof(int64_t);
+        case DURATION_COLUMN:
+        case LOUDNESS_COLUMN:
+        case TRUE_PEAK_COLUMN:
+            return sizeof(float);
+        default:
+            return PeakPyramid::BUCKET_COUNT * sizeof(PeakBucket);
+    }
+}
+
+
+/**
+ * @return offset rounded up to alignment
+ */
+static uint64_t align(uint64_t offset)
+{
+    return (offset + INDEX_ALIGNMENT - 1) / INDEX_ALIGNMENT * INDEX_ALIGNMENT;
+}
+
+
+LibraryIndex::~LibraryIndex()
+{
+    close();
+}
+
+
+bool LibraryIndex::open(const std::string &path)
+{
+    close();
+
+#ifndef _WIN32
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+    struct stat status;
+    if ((fstat(fd, &status) != 0) || (status.st_size < static_cast<off_t>(sizeof(IndexHeader))))
+    {
+        ::close(fd);
+        return false;
+    }
+    // Pages are read on first touch, only header and arrays are walked on load
+    void *mapping = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED)
+        return false;
+    data = static_cast<const char*>(mapping);
+    dataSize = status.st_size;
+    isMapped = true;
+#else
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file)
+        return false;
+    std::streamsize file_size = file.tellg();
+    if (file_size < static_cast<std::streamsize>(sizeof(IndexHeader)))
+        return false;
+    char *buffer = new char[file_size];
+    file.seekg(0);
+    if (!file.read(buffer, file_size))
+    {
+        delete[] buffer;
+        return false;
+    }
+    data = buffer;
+    dataSize = file_size;
+    isMapped = false;
+#endif
+
+    if (!parse())
+    {
+        #ifdef DEBUG
+        printf("Library index: %s is not valid index\n", path.c_str());
+        #endif
+        close();
+        return false;
+    }
+    return true;
+}
+
+
+void LibraryIndex::close()
+{
+    if (data)
+    {
+#ifndef _WIN32
+        if (isMapped)
+            munmap(const_cast<char*>(data), dataSize);
+        else
+#endif
+            delete[] data;
+    }
+
+    data = nullptr;
+    dataSize = 0;
+    count = 0;
+    strings = nullptr;
+    stringsSize = 0;
+    root.clear();
+    silenceThreshold = 0;
+}
+
+
+bool LibraryIndex::parse()
+{
+    const IndexHeader *header = reinterpret_cast<const IndexHeader*>(data);
+    if ((std::memcmp(header->magic, INDEX_MAGIC, sizeof(header->magic)) != 0) || (header->version != INDEX_VERSION))
+        return false;
+    // Waveforms of other pyramid shape are measured again
+    if (header->peaksSize != PeakPyramid::BUCKET_COUNT)
+        return false;
+
+    // String pool and every array must lie inside file
+    if ((header->stringsSize == 0) || (header->stringsOffset > dataSize) ||
+        (header->stringsSize > dataSize - header->stringsOffset))
+        return false;
+    for (int column = 0; column < COLUMN_COUNT; column++)
+    {
+        uint64_t offset = header->columns[column];
+        if ((offset % INDEX_ALIGNMENT != 0) || (offset > dataSize) ||
+            (elementSize(column) * header->count > dataSize - offset))
+            return false;
+    }
+
+    strings = data + header->stringsOffset;
+    stringsSize = header->stringsSize;
+    if ((strings[stringsSize - 1] != '\0') || (header->root >= stringsSize))
+        return false;
+    directories = reinterpret_cast<const uint32_t*>(data + header->columns[DIRECTORY_COLUMN]);
+    names = reinterpret_cast<const uint32_t*>(data + header->columns[NAME_COLUMN]);
+    sizes = reinterpret_cast<const uint64_t*>(data + header->columns[SIZE_COLUMN]);
+    modifiedTimes = reinterpret_cast<const int64_t*>(data + header->columns[MODIFIED_COLUMN]);
+    durations = reinterpret_cast<const float*>(data + header->columns[DURATION_COLUMN]);
+    loudnesses = reinterpret_cast<const float*>(data + header->columns[LOUDNESS_COLUMN]);
+    truePeaks = reinterpret_cast<const float*>(data + header->columns[TRUE_PEAK_COLUMN]);
+    audibleStarts = reinterpret_cast<const int64_t*>(data + header->columns[AUDIBLE_START_COLUMN]);
+    audibleEnds = reinterpret_cast<const int64_t*>(data + header->columns[AUDIBLE_END_COLUMN]);
+    peaks = reinterpret_cast<const PeakBucket*>(data + header->columns[PEAKS_COLUMN]);
+
+    // Strings are read without further checks later
+    for (uint32_t record = 0; record < header->count; record++)
+    {
+        if ((directories[record] >= stringsSize) || (names[record] >= stringsSize))
+            return false;
+    }
+
+    count = header->count;
+    root = strings + header->root;
+    silenceThreshold = header->silenceThreshold;
+    return true;
+}
+
+
+std::string LibraryIndex::getFilepath(size_t record) const
+{
+    std::string filepath = strings + directories[record];
+    filepath += '/';
+    filepath += strings + names[record];
+    return filepath;
+}
+
+
+const PeakBucket* LibraryIndex::getPeaks(size_t record) const
+{
+    if (durations[record] < 0)
+        return nullptr;
+    return peaks + record * PeakPyramid::BUCKET_COUNT;
+}
+
+
+std::vector<LibraryRecord> LibraryIndex::getRecords() const
+{
+    std::vector<LibraryRecord> records(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        LibraryRecord &record = records[i];
+        record.filepath = getFilepath(i);
+        record.size = sizes[i];
+        record.modified = modifiedTimes[i];
+        record.duration = durations[i];
+        record.loudness = loudnesses[i];
+        record.truePeak = truePeaks[i];
+        record.audibleStart = audibleStarts[i];
+        record.audibleEnd = audibleEnds[i];
+        record.peaks = getPeaks(i);
+    }
+    return records;
+}
+
+
+void LibraryIndex::write(const std::string &path, const std::string &root, const std::vector<LibraryRecord> &records,
+                         double silenceThreshold)
+{
+    // Directories are shared by their files, so each one is stored once
+    std::string pool;
+    std::unordered_map<std::string, uint32_t> interned;
+    auto intern = [&pool, &interned](const std::string &string)
+    {
+        auto known = interned.find(string);
+        if (known != interned.end())
+            return known->second;
+        uint32_t offset = static_cast<uint32_t>(pool.size());
+        pool.append(string).push_back('\0');
+        interned.emplace(string, offset);
+        return offset;
+    };
+
+    IndexHeader header = {};
+    std::memcpy(header.magic, INDEX_MAGIC, sizeof(header.magic));
+    header.version = INDEX_VERSION;
+    header.count = static_cast<uint32_t>(records.size());
+    header.peaksSize = PeakPyramid::BUCKET_COUNT;
+    header.root = intern(root);
+    header.silenceThreshold = silenceThreshold;
+
+    std::vector<uint32_t> directories(records.size());
+    std::vector<uint32_t> names(records.size());
+    std::vector<uint64_t> sizes(records.size());
+    std::vector<int64_t> modified_times(records.size());
+    std::vector<float> durations(records.size());
+    std::vector<float> loudnesses(records.size());
+    std::vector<float> true_peaks(records.size());
+    std::vector<int64_t> audible_starts(records.size());
+    std::vector<int64_t> audible_ends(records.size());
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        const LibraryRecord &record = records[i];
+        size_t slash = record.filepath.rfind('/');
+        if (slash == std::string::npos)
+            throw std::runtime_error("Library index: path is not absolute: " + record.filepath);
+        directories[i] = intern(record.filepath.substr(0, slash));
+        names[i] = intern(record.filepath.substr(slash + 1));
+        sizes[i] = record.size;
+        modified_times[i] = record.modified;
+        durations[i] = record.duration;
+        loudnesses[i] = record.loudness;
+        true_peaks[i] = record.truePeak;
+        audible_starts[i] = record.audibleStart;
+        audible_ends[i] = record.audibleEnd;
+    }
+    if (pool.size() > UINT32_MAX)
+        throw std::runtime_error("Library index: too many paths");
+
+    // Layout: header, string pool, arrays (each aligned)
+    const char *columns[COLUMN_COUNT] = {reinterpret_cast<const char*>(directories.data()),
+                                         reinterpret_cast<const char*>(names.data()),
+                                         reinterpret_cast<const char*>(sizes.data()),
+                                         reinterpret_cast<const char*>(modified_times.data()),
+                                         reinterpret_cast<const char*>(durations.data()),
+                                         reinterpret_cast<const char*>(loudnesses.data()),
+                                         reinterpret_cast<const char*>(true_peaks.data()),
+                                         reinterpret_cast<const char*>(audible_starts.data()),
+                                         reinterpret_cast<const char*>(audible_ends.data()),
+                                         nullptr};
+    header.stringsOffset = align(sizeof(IndexHeader));
+    header.stringsSize = pool.size();
+    uint64_t offset = align(header.stringsOffset + header.stringsSize);
+    for (int column = 0; column < COLUMN_COUNT; column++)
+    {
+        header.columns[column] = offset;
+        offset = align(offset + elementSize(column) * header.count);
+    }
+
+    // Old index stays intact until new one is complete
+    std::string temporary_path = path + ".tmp";
+    {
+        std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+        if (!file)
+            throw std::runtime_error("Library index: unable to write " + temporary_path);
+        auto pad = [&file](uint64_t offset)
+        {
+            static const char zeros[INDEX_ALIGNMENT] = {};
+            file.write(zeros, static_cast<std::streamsize>(offset - static_cast<uint64_t>(file.tellp())));
+        };
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        pad(header.stringsOffset);
+        file.write(pool.data(), static_cast<std::streamsize>(pool.size()));
+        for (int column = 0; column < COLUMN_COUNT; column++)
+        {
+            pad(header.columns[column]);
+            if (columns[column])
+                file.write(columns[column], static_cast<std::streamsize>(elementSize(column) * header.count));
+        }
+        // Waveforms (last array) are large, so they go straight from records (unmeasured ones are zeros)
+        static const PeakBucket silence[PeakPyramid::BUCKET_COUNT] = {};
+        for (const LibraryRecord &record : records)
+        {
+            const PeakBucket *peaks = record.peaks ? record.peaks : silence;
+            file.write(reinterpret_cast<const char*>(peaks), static_cast<std::streamsize>(elementSize(PEAKS_COLUMN)));
+        }
+        pad(offset);
+        if (!file)
+            throw std::runtime_error("Library index: unable to write " + temporary_path);
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporary_path, path, error);
+    if (error)
+        throw std::runtime_error("Library index: unable to replace " + path + ": " + error.message());
+}
@@ -0,0 +1,195 @@
+#pragma once
+
+
+// Fixed width integers
+#include <cstdint>
+// Sizes
+#include <cstddef>
+// Strings
+#include <string>
+// Containers
+#include <vector>
+// Silence as -infinity
+#include <cmath>
+// Waveforms
+#include <Library/PeakPyramid.hpp>
+
+
+/**
+ * Library track as it is written to index.
+ */
+struct LibraryRecord
+{
+    // Media file path.
+    std::string filepath;
+    // File size in bytes.
+    uint64_t size = 0;
+    // File modification time (filesystem clock ticks).
+    int64_t modified = 0;
+    // Duration in seconds (negative until measured).
+    float duration = -1;
+    // Integrated loudness in LUFS (-infinity for silence or until measured).
+    float loudness = -INFINITY;
+    // True peak in dBTP (-infinity for silence or until measured).
+    float truePeak = -INFINITY;
+    // First audible sample.
+    int64_t audibleStart = 0;
+    // Sample after last audible one (negative for silence or until measured).
+    int64_t audibleEnd = -1;
+    // PeakPyramid::BUCKET_COUNT waveform buckets (nullptr until measured, owner keeps them alive while record
+    // is used).
+    const PeakBucket *peaks = nullptr;
+};
+
+
+/**
+ * Library saved between launches. File holds string pool with interned directory and file names followed by
+ * one array per record field (fixed-size records in struct-of-arrays form), so it is mapped into memory as is
+ * and read without parsing. Byte order is native, file written elsewhere is rejected by its header.
+ */
+class LibraryIndex
+{
+    // Whole file (mapped or read).
+    const char *data = nullptr;
+    // Size of whole file.
+    size_t dataSize = 0;
+    // Whether data is memory mapping (otherwise it is heap buffer).
+    bool isMapped = false;
+
+    // Number of records.
+    uint32_t count = 0;
+    // Interned strings (zero-terminated).
+    const char *strings = nullptr;
+    // Size of string pool.
+    uint64_t stringsSize = 0;
+    // Root directory of library.
+    std::string root;
+    // Level audible bounds were measured at (dBFS).
+    double silenceThreshold = 0;
+
+    // Directory of each record (string pool offset).
+    const uint32_t *directories = nullptr;
+    // File name of each record (string pool offset).
+    const uint32_t *names = nullptr;
+    // File size of each record.
+    const uint64_t *sizes = nullptr;
+    // Modification time of each record.
+    const int64_t *modifiedTimes = nullptr;
+    // Duration of each record.
+    const float *durations = nullptr;
+    // Loudness of each record.
+    const float *loudnesses = nullptr;
+    // True peak of each record.
+    const float *truePeaks = nullptr;
+    // First audible sample of each record.
+    const int64_t *audibleStarts = nullptr;
+    // End of audible part of each record.
+    const int64_t *audibleEnds = nullptr;
+    // Waveform pyramids of all records (PeakPyramid::BUCKET_COUNT buckets each).
+    const PeakBucket *peaks = nullptr;
+
+public:
+
+    /**
+     * Constructor. Index is empty until it is opened.
+     */
+    LibraryIndex() = default;
+    /**
+     * Destructor. Unmaps file.
+     */
+    ~LibraryIndex();
+
+    LibraryIndex(const LibraryIndex&) = delete;
+    LibraryIndex& operator=(const LibraryIndex&) = delete;
+
+    /**
+     * Maps index file into memory.
+     *
+     * @return whether file exists and is valid index (index stays empty otherwise)
+     */
+    bool open(const std::string &path);
+
+    /**
+     * Unmaps file, index becomes empty.
+     */
+    void close();
+
+    /**
+     * @return number of records
+     */
+    size_t size() const { return count; }
+
+    /**
+     * @return root directory of library
+     */
+    const std::string& getRoot() const { return root; }
+
+    /**
+     * @return level audible bounds of records were measured at (dBFS)
+     */
+    double getSilenceThreshold() const { return silenceThreshold; }
+
+    /**
+     * @return media file path of record
+     */
+    std::string getFilepath(size_t record) const;
+    /**
+     * @return file size of record in bytes
+     */
+    uint64_t getSize(size_t record) const { return sizes[record]; }
+    /**
+     * @return file modification time of record
+     */
+    int64_t getModified(size_t record) const { return modifiedTimes[record]; }
+    /**
+     * @return duration of record in seconds (negative if it was not measured)
+     */
+    float getDuration(size_t record) const { return durations[record]; }
+    /**
+     * @return integrated loudness of record in LUFS (-infinity for silence or if it was not measured)
+     */
+    float getLoudness(size_t record) const { return loudnesses[record]; }
+    /**
+     * @return true peak of record in dBTP (-infinity for silence or if it was not measured)
+     */
+    float getTruePeak(size_t record) const { return truePeaks[record]; }
+    /**
+     * @return first audible sample of record
+     */
+    int64_t getAudibleStart(size_t record) const { return audibleStarts[record]; }
+    /**
+     * @return sample after last audible one of record (negative for silence or if it was not measured)
+     */
+    int64_t getAudibleEnd(size_t record) const { return audibleEnds[record]; }
+    /**
+     * @return waveform pyramid of record straight from file (nullptr if it was not measured)
+     */
+    const PeakBucket* getPeaks(size_t record) const;
+
+    /**
+     * @return all records (their waveforms point into index and are valid while it stays open)
+     */
+    std::vector<LibraryRecord> getRecords() const;
+
+    /**
+     * Writes index file (replaces old one atomically, so mapped old file stays readable).
+     *
+     * @param path index file path
+     * @param root root directory of library
+     * @param records library tracks
+     * @param silenceThreshold level audible bounds of records were measured at (dBFS)
+     *
+     * @throws Runtime Error if file cannot be written.
+     */
+    static void write(const std::string &path, const std::string &root, const std::vector<LibraryRecord> &records,
+                      double silenceThreshold);
+
+private:
+
+    /**
+     * Checks header and layout of loaded file and sets up arrays.
+     *
+     * @return whether file is valid index
+     */
+    bool parse();
+};
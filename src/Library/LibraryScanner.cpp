@@ -0,0 +1,452 @@
+#include <Library/LibraryScanner.hpp>
+
+
+// Directory listing
+#include <filesystem>
+// Console output
+#include <cstdio>
+// Content recognition
+#include <Library/MediaProbe.hpp>
+// Pipeline spans
+#include <Engine/Tracer.hpp>
+#ifdef LIBRARY_WATCH
+// inotify
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#endif
+
+
+// Changes reported at once while directory is listed
+#define SCAN_BATCH_SIZE 256
+// Size of inotify read buffer
+#define WATCH_BUFFER_SIZE 65536
+
+
+/**
+ * @return whether path is directory or lies inside it
+ */
+static bool isInside(const std::string &path, const std::string &directory)
+{
+    return (path.compare(0, directory.size(), directory) == 0) &&
+           ((path.size() == directory.size()) || (path[directory.size()] == '/'));
+}
+
+
+FileStamp FileStamp::of(const std::string &filepath)
+{
+    FileStamp stamp;
+    std::error_code error;
+    uintmax_t size = std::filesystem::file_size(filepath, error);
+    if (!error)
+        stamp.size = size;
+    std::filesystem::file_time_type modified = std::filesystem::last_write_time(filepath, error);
+    if (!error)
+        stamp.modified = modified.time_since_epoch().count();
+    return stamp;
+}
+
+
+LibraryScanner::Scan::~Scan()
+{
+#ifdef LIBRARY_WATCH
+    if (watchFd >= 0)
+        close(watchFd);
+#endif
+}
+
+
+LibraryScanner::LibraryScanner(WorkerPool *workers)
+{
+    scan = std::make_shared<Scan>();
+    scan->workers = workers;
+}
+
+
+LibraryScanner::~LibraryScanner()
+{
+    // Jobs still in queue end without reporting anything
+    {
+        std::lock_guard<std::mutex> lock(scan->changesMutex);
+        scan->isCancelled = true;
+    }
+
+#ifdef LIBRARY_WATCH
+    if (watcher.joinable())
+    {
+        char byte = 0;
+        (void)!write(wakePipe[1], &byte, 1);
+        watcher.join();
+        close(wakePipe[0]);
+        close(wakePipe[1]);
+    }
+#endif
+}
+
+
+void LibraryScanner::setChangesCallback(ChangesCallback callback)
+{
+    scan->changesCallback = callback;
+}
+
+
+void LibraryScanner::start(const std::string &directory, std::unordered_map<std::string, FileStamp> known)
+{
+    scan->known = std::move(known);
+
+#ifdef LIBRARY_WATCH
+    // Scanning still works if tree cannot be watched
+    scan->watchFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if ((scan->watchFd >= 0) && (pipe2(wakePipe, O_CLOEXEC | O_NONBLOCK) == 0))
+        watcher = std::thread(&LibraryScanner::watch, this);
+    #ifdef DEBUG
+    else
+        printf("Library scanner: unable to watch %s\n", directory.c_str());
+    #endif
+#endif
+
+    submitDirectory(scan, directory);
+}
+
+
+void LibraryScanner::submitDirectory(std::shared_ptr<Scan> scan, const std::string &directory)
+{
+    scan->pendingDirectories++;
+    scan->workers->submit([scan, directory]()
+    {
+        scanDirectory(scan, directory);
+        if (--scan->pendingDirectories == 0)
+            finishScan(*scan);
+    }, WorkerPool::LOW);
+}
+
+
+void LibraryScanner::finishScan(Scan &scan)
+{
+    std::vector<LibraryChange> changes;
+    {
+        std::lock_guard<std::mutex> lock(scan.filesMutex);
+        if (scan.isCancelled)
+            return;
+        for (const auto &file : scan.known)
+            changes.push_back({LibraryChange::REMOVED, file.first, "", false});
+        scan.known.clear();
+    }
+    signalChanges(scan, changes);
+}
+
+
+void LibraryScanner::scanDirectory(std::shared_ptr<Scan> scan, const std::string &directory)
+{
+    if (scan->isCancelled)
+        return;
+    TraceSpan span("library scan");
+
+    // Watch first so files created while listing are not missed
+    addWatch(*scan, directory);
+
+    std::vector<LibraryChange> changes;
+    std::error_code error;
+    std::filesystem::directory_iterator entry(directory, std::filesystem::directory_options::skip_permission_denied, error);
+    for (; !error && (entry != std::filesystem::directory_iterator()); entry.increment(error))
+    {
+        if (scan->isCancelled)
+            return;
+
+        // Symbolic links to directories are not followed (they may form loops)
+        std::error_code status_error;
+        std::filesystem::file_status status = entry->symlink_status(status_error);
+        if (std::filesystem::is_directory(status))
+        {
+            submitDirectory(scan, entry->path().string());
+            continue;
+        }
+        if (!entry->is_regular_file(status_error))
+            continue;
+
+        checkFile(*scan, entry->path().string(), false, changes);
+        if (changes.size() >= SCAN_BATCH_SIZE)
+        {
+            signalChanges(*scan, changes);
+            changes.clear();
+        }
+    }
+
+    signalChanges(*scan, changes);
+}
+
+
+void LibraryScanner::checkFile(Scan &scan, const std::string &filepath, bool isWritten, std::vector<LibraryChange> &changes)
+{
+    FileStamp stamp = FileStamp::of(filepath);
+
+    // Indexed file keeps its measurements unless it changed since
+    FileStamp indexed;
+    if (takeKnown(scan, filepath, indexed))
+    {
+        if (stamp != indexed)
+            changes.push_back({LibraryChange::CHANGED, filepath, "", false, stamp.size, stamp.modified});
+        return;
+    }
+
+    if (addFile(scan, filepath))
+    {
+        changes.push_back({LibraryChange::ADDED, filepath, "", false, stamp.size, stamp.modified});
+        return;
+    }
+
+    // Library file was overwritten
+    if (isWritten)
+    {
+        std::lock_guard<std::mutex> lock(scan.filesMutex);
+        if (scan.files.count(filepath))
+            changes.push_back({LibraryChange::CHANGED, filepath, "", false, stamp.size, stamp.modified});
+    }
+}
+
+
+bool LibraryScanner::takeKnown(Scan &scan, const std::string &filepath, FileStamp &stamp)
+{
+    std::lock_guard<std::mutex> lock(scan.filesMutex);
+    auto file = scan.known.find(filepath);
+    if (file == scan.known.end())
+        return false;
+
+    stamp = file->second;
+    scan.known.erase(file);
+    scan.files.insert(filepath);
+    return true;
+}
+
+
+bool LibraryScanner::addFile(Scan &scan, const std::string &filepath)
+{
+    {
+        std::lock_guard<std::mutex> lock(scan.filesMutex);
+        if (scan.files.count(filepath))
+            return false;
+    }
+
+    if (!MediaProbe::isMedia(filepath))
+        return false;
+
+    std::lock_guard<std::mutex> lock(scan.filesMutex);
+    return scan.files.insert(filepath).second;
+}
+
+
+void LibraryScanner::remove(Scan &scan, const std::string &path, bool isDirectory, std::vector<LibraryChange> &changes)
+{
+    bool is_known = false;
+    {
+        std::lock_guard<std::mutex> lock(scan.filesMutex);
+        if (isDirectory)
+        {
+            for (auto file = scan.files.begin(); file != scan.files.end();)
+            {
+                if (isInside(*file, path))
+                {
+                    file = scan.files.erase(file);
+                    is_known = true;
+                }
+                else
+                    file++;
+            }
+        }
+        else
+            is_known = scan.files.erase(path) > 0;
+    }
+
+    if (is_known)
+        changes.push_back({LibraryChange::REMOVED, path, "", isDirectory});
+}
+
+
+void LibraryScanner::rename(std::shared_ptr<Scan> scan, const std::string &from, const std::string &to, bool isDirectory,
+                            std::vector<LibraryChange> &changes)
+{
+    if (isDirectory)
+    {
+        // Files (including indexed ones not found yet) and watches of directory move with it
+        {
+            std::lock_guard<std::mutex> lock(scan->filesMutex);
+            std::vector<std::string> moved;
+            for (auto file = scan->files.begin(); file != scan->files.end();)
+            {
+                if (isInside(*file, from))
+                {
+                    moved.push_back(to + file->substr(from.size()));
+                    file = scan->files.erase(file);
+                }
+                else
+                    file++;
+            }
+            scan->files.insert(moved.begin(), moved.end());
+
+            std::vector<std::pair<std::string, FileStamp>> moved_known;
+            for (auto file = scan->known.begin(); file != scan->known.end();)
+            {
+                if (isInside(file->first, from))
+                {
+                    moved_known.push_back({to + file->first.substr(from.size()), file->second});
+                    file = scan->known.erase(file);
+                }
+                else
+                    file++;
+            }
+            scan->known.insert(moved_known.begin(), moved_known.end());
+        }
+        {
+            std::lock_guard<std::mutex> lock(scan->watchesMutex);
+            for (auto &watch : scan->watches)
+            {
+                if (isInside(watch.second, from))
+                    watch.second = to + watch.second.substr(from.size());
+            }
+        }
+        changes.push_back({LibraryChange::RENAMED, to, from, true});
+        return;
+    }
+
+    bool is_known;
+    {
+        std::lock_guard<std::mutex> lock(scan->filesMutex);
+        is_known = (scan->files.erase(from) > 0) || (scan->known.erase(from) > 0);
+        if (is_known)
+            scan->files.insert(to);
+    }
+    if (is_known)
+        changes.push_back({LibraryChange::RENAMED, to, from, false});
+    else if (addFile(*scan, to))
+        changes.push_back({LibraryChange::ADDED, to, "", false});
+}
+
+
+void LibraryScanner::signalChanges(Scan &scan, const std::vector<LibraryChange> &changes)
+{
+    if (changes.empty())
+        return;
+
+    std::lock_guard<std::mutex> lock(scan.changesMutex);
+    if (!scan.isCancelled && scan.changesCallback)
+        scan.changesCallback(changes);
+}
+
+
+void LibraryScanner::addWatch(Scan &scan, const std::string &directory)
+{
+#ifdef LIBRARY_WATCH
+    if (scan.watchFd < 0)
+        return;
+
+    int watch = inotify_add_watch(scan.watchFd, directory.c_str(), IN_CREATE | IN_CLOSE_WRITE | IN_DELETE | IN_MOVED_FROM |
+                                                                     IN_MOVED_TO | IN_ONLYDIR | IN_DONT_FOLLOW);
+    if (watch < 0)
+    {
+        // Usually fs.inotify.max_user_watches is exceeded
+        #ifdef DEBUG
+        printf("Library scanner: unable to watch %s\n", directory.c_str());
+        #endif
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(scan.watchesMutex);
+    scan.watches[watch] = directory;
+#else
+    (void)scan;
+    (void)directory;
+#endif
+}
+
+
+void LibraryScanner::watch()
+{
+#ifdef LIBRARY_WATCH
+    Tracer::setThreadName("library watcher");
+
+    /**
+     * Half of rename waiting for its other half.
+     */
+    struct MovedFrom
+    {
+        // Old path.
+        std::string path;
+        // Whether directory was moved.
+        bool isDirectory;
+    };
+
+    std::vector<char> buffer(WATCH_BUFFER_SIZE);
+    std::unordered_map<uint32_t, MovedFrom> moved;
+    std::vector<LibraryChange> changes;
+    while (true)
+    {
+        pollfd fds[2] = {{scan->watchFd, POLLIN, 0}, {wakePipe[0], POLLIN, 0}};
+        if (poll(fds, 2, -1) < 0)
+            continue;
+        if (fds[1].revents & POLLIN)
+            return;
+
+        ssize_t size = read(scan->watchFd, buffer.data(), buffer.size());
+        if (size <= 0)
+            continue;
+
+        // Both halves of rename arrive in same read
+        for (ssize_t offset = 0; offset < size;)
+        {
+            const inotify_event *event = reinterpret_cast<const inotify_event*>(buffer.data() + offset);
+            offset += sizeof(inotify_event) + event->len;
+
+            std::string directory;
+            {
+                std::lock_guard<std::mutex> lock(scan->watchesMutex);
+                auto watch = scan->watches.find(event->wd);
+                if (watch == scan->watches.end())
+                    continue;
+                if (event->mask & IN_IGNORED)
+                {
+                    scan->watches.erase(watch);
+                    continue;
+                }
+                directory = watch->second;
+            }
+            if (event->len == 0)
+                continue;
+
+            std::string path = directory + "/" + event->name;
+            bool is_directory = event->mask & IN_ISDIR;
+            if (event->mask & IN_MOVED_FROM)
+                moved[event->cookie] = {path, is_directory};
+            else if (event->mask & IN_MOVED_TO)
+            {
+                auto from = moved.find(event->cookie);
+                if (from != moved.end())
+                {
+                    rename(scan, from->second.path, path, is_directory, changes);
+                    moved.erase(from);
+                }
+                // Moved in from outside of tree
+                else if (is_directory)
+                    submitDirectory(scan, path);
+                else
+                    checkFile(*scan, path, true, changes);
+            }
+            else if ((event->mask & IN_CREATE) && is_directory)
+                submitDirectory(scan, path);
+            // Files are probed once they are written
+            else if (event->mask & IN_CLOSE_WRITE)
+                checkFile(*scan, path, true, changes);
+            else if (event->mask & IN_DELETE)
+                remove(*scan, path, is_directory, changes);
+        }
+
+        // Moved out of tree
+        for (const auto &from : moved)
+            remove(*scan, from.second.path, from.second.isDirectory, changes);
+        moved.clear();
+
+        signalChanges(*scan, changes);
+        changes.clear();
+    }
+#endif
+}
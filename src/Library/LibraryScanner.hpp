@@ -0,0 +1,227 @@
+#pragma once
+
+
+// Fixed width integers
+#include <cstdint>
+// Strings
+#include <string>
+// Containers
+#include <vector>
+#include <unordered_set>
+#include <unordered_map>
+// Smart pointers
+#include <memory>
+// Callbacks
+#include <functional>
+// Threads
+#include <thread>
+#include <mutex>
+#include <atomic>
+// Background jobs
+#include <Engine/WorkerPool.hpp>
+
+
+/**
+ * Change of library contents.
+ */
+struct LibraryChange
+{
+    /**
+     * Describes change.
+     */
+    enum Type
+    {
+        ADDED,
+        REMOVED,
+        RENAMED,
+        CHANGED
+    };
+
+    // Change type.
+    Type type;
+    // Media file path (or directory path of removed and renamed directories).
+    std::string path;
+    // Previous path of renamed file or directory.
+    std::string oldPath;
+    // Whether change concerns whole directory.
+    bool isDirectory = false;
+    // Size of added or changed file in bytes.
+    uint64_t size = 0;
+    // Modification time of added or changed file (filesystem clock ticks).
+    int64_t modified = 0;
+};
+
+
+/**
+ * Size and modification time of file, which tell whether file changed since it was indexed.
+ */
+struct FileStamp
+{
+    // File size in bytes.
+    uint64_t size = 0;
+    // Modification time (filesystem clock ticks).
+    int64_t modified = 0;
+
+    bool operator==(const FileStamp &other) const { return (size == other.size) && (modified == other.modified); }
+    bool operator!=(const FileStamp &other) const { return !(*this == other); }
+
+    /**
+     * @return stamp of file (zero if file cannot be read)
+     */
+    static FileStamp of(const std::string &filepath);
+};
+
+
+/**
+ * Finds media files in directory tree and keeps following it. Directories are listed in parallel on
+ * worker pool and files are recognized by content. On Linux tree is then watched with inotify and only
+ * changes are reported. Files already known from library index are not probed again, scan only reports
+ * those that changed, disappeared or are new.
+ */
+class LibraryScanner
+{
+public:
+
+    /**
+     * Receives batch of changes (called from worker and watcher threads, one batch at a time).
+     */
+    typedef std::function<void(const std::vector<LibraryChange>&)> ChangesCallback;
+
+private:
+
+    /**
+     * State shared with jobs, which may outlive scanner.
+     */
+    struct Scan
+    {
+        // Lists directories.
+        WorkerPool *workers = nullptr;
+        // Raised when scanner is destroyed (jobs end early).
+        std::atomic<bool> isCancelled = false;
+        // Number of directories being listed.
+        std::atomic<int> pendingDirectories = 0;
+
+        // Notified about changes.
+        ChangesCallback changesCallback;
+        // Serializes notifications and cancellation.
+        std::mutex changesMutex;
+
+        // Media files in library.
+        std::unordered_set<std::string> files;
+        // Files from library index that initial scan has not found yet.
+        std::unordered_map<std::string, FileStamp> known;
+        // Guards files and known files.
+        std::mutex filesMutex;
+
+        // inotify instance (-1 if tree is not watched).
+        int watchFd = -1;
+        // Watched directories by watch descriptor.
+        std::unordered_map<int, std::string> watches;
+        // Guards watches.
+        std::mutex watchesMutex;
+
+        /**
+         * Destructor. Closes inotify instance.
+         */
+        ~Scan();
+    };
+
+    // Shared state.
+    std::shared_ptr<Scan> scan;
+
+    // Thread that reads inotify events.
+    std::thread watcher;
+    // Wakes watcher on destruction.
+    int wakePipe[2] = {-1, -1};
+
+public:
+
+    /**
+     * Constructor.
+     *
+     * @param workers pool that lists directories
+     */
+    explicit LibraryScanner(WorkerPool *workers);
+    /**
+     * Destructor. Stops watching, no changes are reported after it returns.
+     */
+    ~LibraryScanner();
+
+    /**
+     * @param callback function that will receive changes (must be set before start)
+     */
+    void setChangesCallback(ChangesCallback callback);
+
+    /**
+     * Starts scanning directory tree and watching it.
+     *
+     * @param directory root directory of library
+     * @param known files library already has (from index), they are reported only if they differ
+     */
+    void start(const std::string &directory, std::unordered_map<std::string, FileStamp> known = {});
+
+    /**
+     * @return whether initial scan (or scan of added directory) is still running
+     */
+    bool isScanning() const { return scan->pendingDirectories > 0; }
+
+private:
+
+    /**
+     * Queues listing of directory.
+     */
+    static void submitDirectory(std::shared_ptr<Scan> scan, const std::string &directory);
+    /**
+     * Lists directory, reports its media files and queues its subdirectories (job body).
+     */
+    static void scanDirectory(std::shared_ptr<Scan> scan, const std::string &directory);
+
+    /**
+     * Reports known files that initial scan did not find as removed.
+     */
+    static void finishScan(Scan &scan);
+
+    /**
+     * Adds file found on disk to library or reports that it changed.
+     *
+     * @param isWritten whether file was just written (known file is then reported as changed)
+     */
+    static void checkFile(Scan &scan, const std::string &filepath, bool isWritten, std::vector<LibraryChange> &changes);
+    /**
+     * Moves file from known files into library.
+     *
+     * @param stamp receives stamp file had when it was indexed
+     *
+     * @return whether file was known
+     */
+    static bool takeKnown(Scan &scan, const std::string &filepath, FileStamp &stamp);
+    /**
+     * Adds media file to library unless it is already there.
+     *
+     * @return whether file was added
+     */
+    static bool addFile(Scan &scan, const std::string &filepath);
+    /**
+     * Removes file or directory from library and reports it if anything was there.
+     */
+    static void remove(Scan &scan, const std::string &path, bool isDirectory, std::vector<LibraryChange> &changes);
+    /**
+     * Moves file or directory within library and reports it (unknown file is probed as new one).
+     */
+    static void rename(std::shared_ptr<Scan> scan, const std::string &from, const std::string &to, bool isDirectory,
+                       std::vector<LibraryChange> &changes);
+    /**
+     * Reports changes.
+     */
+    static void signalChanges(Scan &scan, const std::vector<LibraryChange> &changes);
+
+    /**
+     * Starts watching directory (if tree is watched).
+     */
+    static void addWatch(Scan &scan, const std::string &directory);
+
+    /**
+     * Watcher thread body.
+     */
+    void watch();
+};
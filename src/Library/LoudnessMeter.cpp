@@ -0,0 +1,381 @@
+#include <Library/LoudnessMeter.hpp>
+
+
+// Min/max
+#include <algorithm>
+// Logarithms and filter design
+#include <cmath>
+// SIMD sample reduction
+#include <Library/PeakPyramid.hpp>
+// SIMD
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define LOUDNESS_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define LOUDNESS_NEON
+#endif
+
+
+// Gating block is four 100 ms steps (75% overlap)
+#define BLOCK_STEPS 4
+// Blocks quieter than this are ignored (LUFS)
+#define ABSOLUTE_GATE -70.0
+// Blocks quieter than this relative to ungated loudness are ignored (LU)
+#define RELATIVE_GATE -10.0
+// Oversampling of true peak
+#define PEAK_PHASES 4
+// Interpolation filter taps per phase
+#define PEAK_PHASE_TAPS 12
+// Frames whose level is checked before they are oversampled
+#define PEAK_BLOCK_FRAMES 64
+// Pi (PI is not standard)
+#define PI 3.14159265358979323846
+
+
+/**
+ * @return loudness of weighted mean square in LUFS
+ */
+static double loudnessOf(double energy)
+{
+    return (energy > 0) ? -0.691 + 10 * std::log10(energy) : -INFINITY;
+}
+
+
+/**
+ * @return weighted mean square of loudness in LUFS
+ */
+static double energyOf(double loudness)
+{
+    return std::pow(10.0, (loudness + 0.691) / 10);
+}
+
+
+LoudnessMeter::LoudnessMeter(int sampleRate, int channels)
+{
+    this->channels = std::max(1, channels);
+    stepFrames = std::max(1, sampleRate / 10);
+
+    // Surround channels of 5.1 weigh more, LFE is left out
+    weights.assign(this->channels, 1.0);
+    if (this->channels == 6)
+    {
+        weights[3] = 0;
+        weights[4] = 1.41;
+        weights[5] = 1.41;
+    }
+
+    // K-weighting stages designed for sample rate (BS.1770 coefficients are given for 48 kHz only)
+    double rate = std::max(1, sampleRate);
+    double k = std::tan(PI * 1681.974450955533 / rate);
+    double q = 0.7071752369554196;
+    double vh = std::pow(10.0, 3.999843853973347 / 20);
+    double vb = std::pow(vh, 0.4996667741545416);
+    double a0 = 1 + k / q + k * k;
+    shelf = {(vh + vb * k / q + k * k) / a0, 2 * (k * k - vh) / a0, (vh - vb * k / q + k * k) / a0,
+             2 * (k * k - 1) / a0, (1 - k / q + k * k) / a0};
+    k = std::tan(PI * 38.13547087602444 / rate);
+    q = 0.5003270373238773;
+    a0 = 1 + k / q + k * k;
+    highPass = {1, -2, 1, 2 * (k * k - 1) / a0, (1 - k / q + k * k) / a0};
+
+    // Channels are filtered in pairs (odd one is paired with silence)
+    int lanes = (this->channels + 1) / 2 * 2;
+    state.assign(lanes * 4, 0);
+    stepSums.assign(lanes, 0);
+
+    // Windowed sinc, each phase normalized to unity gain
+    interpolation.resize(PEAK_PHASES * PEAK_PHASE_TAPS);
+    const int taps = PEAK_PHASES * PEAK_PHASE_TAPS;
+    for (int phase = 0; phase < PEAK_PHASES; phase++)
+    {
+        float sum = 0;
+        for (int tap = 0; tap < PEAK_PHASE_TAPS; tap++)
+        {
+            int n = phase + tap * PEAK_PHASES;
+            double t = (n - (taps - 1) / 2.0) / PEAK_PHASES;
+            double sinc = (t == 0) ? 1 : std::sin(PI * t) / (PI * t);
+            double window = 0.5 - 0.5 * std::cos(2 * PI * (n + 0.5) / taps);
+            interpolation[phase * PEAK_PHASE_TAPS + tap] = static_cast<float>(sinc * window);
+            sum += interpolation[phase * PEAK_PHASE_TAPS + tap];
+        }
+        float gain = 0;
+        for (int tap = 0; tap < PEAK_PHASE_TAPS; tap++)
+        {
+            interpolation[phase * PEAK_PHASE_TAPS + tap] /= sum;
+            gain += std::fabs(interpolation[phase * PEAK_PHASE_TAPS + tap]);
+        }
+        interpolationGain = std::max(interpolationGain, gain);
+    }
+    history.assign(this->channels * (PEAK_PHASE_TAPS - 1), 0);
+}
+
+
+void LoudnessMeter::add(const float *samples, int frames)
+{
+    measurePeak(samples, frames);
+
+    // Steps are closed exactly every 100 ms
+    while (frames > 0)
+    {
+        int run = std::min(frames, stepFrames - stepFrame);
+        filter(samples, run);
+        stepFrame += run;
+        if (stepFrame == stepFrames)
+            finishStep();
+        samples += static_cast<size_t>(run) * channels;
+        frames -= run;
+    }
+}
+
+
+double LoudnessMeter::getLoudness() const
+{
+    // Unfinished step counts only for tracks shorter than one block
+    if (steps.size() < BLOCK_STEPS)
+    {
+        double sum = totalSum;
+        for (int channel = 0; channel < channels; channel++)
+            sum += weights[channel] * stepSums[channel];
+        uint64_t frames = totalFrames + stepFrame;
+        double loudness = frames ? loudnessOf(sum / frames) : -INFINITY;
+        return (loudness > ABSOLUTE_GATE) ? loudness : -INFINITY;
+    }
+
+    std::vector<double> blocks;
+    blocks.reserve(steps.size() - BLOCK_STEPS + 1);
+    double sum = 0;
+    for (size_t step = 0; step < steps.size(); step++)
+    {
+        sum += steps[step];
+        if (step >= BLOCK_STEPS)
+            sum -= steps[step - BLOCK_STEPS];
+        if (step + 1 >= BLOCK_STEPS)
+            blocks.push_back(std::max(0.0, sum) / BLOCK_STEPS);
+    }
+
+    // Absolute gate, then relative gate below its result
+    double threshold = energyOf(ABSOLUTE_GATE);
+    double gated_sum = 0;
+    size_t gated_count = 0;
+    for (double block : blocks)
+    {
+        if (block > threshold)
+        {
+            gated_sum += block;
+            gated_count++;
+        }
+    }
+    if (gated_count == 0)
+        return -INFINITY;
+
+    threshold = std::max(threshold, gated_sum / gated_count * energyOf(RELATIVE_GATE) / energyOf(0));
+    gated_sum = 0;
+    gated_count = 0;
+    for (double block : blocks)
+    {
+        if (block > threshold)
+        {
+            gated_sum += block;
+            gated_count++;
+        }
+    }
+    return gated_count ? loudnessOf(gated_sum / gated_count) : -INFINITY;
+}
+
+
+double LoudnessMeter::getTruePeak() const
+{
+    float peak = std::max(samplePeak, truePeak);
+    return (peak > 0) ? 20 * std::log10(peak) : -INFINITY;
+}
+
+
+void LoudnessMeter::filter(const float *samples, int frames)
+{
+    for (int first = 0; first < channels; first += 2)
+    {
+        bool is_pair = first + 1 < channels;
+        double *z = &state[first * 4];
+        const float *frame = samples + first;
+
+#if defined(LOUDNESS_SSE2)
+        __m128d sb0 = _mm_set1_pd(shelf.b0), sb1 = _mm_set1_pd(shelf.b1), sb2 = _mm_set1_pd(shelf.b2);
+        __m128d sa1 = _mm_set1_pd(shelf.a1), sa2 = _mm_set1_pd(shelf.a2);
+        __m128d hb0 = _mm_set1_pd(highPass.b0), hb1 = _mm_set1_pd(highPass.b1), hb2 = _mm_set1_pd(highPass.b2);
+        __m128d ha1 = _mm_set1_pd(highPass.a1), ha2 = _mm_set1_pd(highPass.a2);
+        __m128d s1 = _mm_loadu_pd(z), s2 = _mm_loadu_pd(z + 2), h1 = _mm_loadu_pd(z + 4), h2 = _mm_loadu_pd(z + 6);
+        __m128d sums = _mm_setzero_pd();
+        for (int i = 0; i < frames; i++, frame += channels)
+        {
+            // Transposed direct form II, both stages
+            __m128d x = _mm_set_pd(is_pair ? frame[1] : 0.0, frame[0]);
+            __m128d y = _mm_add_pd(_mm_mul_pd(sb0, x), s1);
+            s1 = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(sb1, x), _mm_mul_pd(sa1, y)), s2);
+            s2 = _mm_sub_pd(_mm_mul_pd(sb2, x), _mm_mul_pd(sa2, y));
+            __m128d v = _mm_add_pd(_mm_mul_pd(hb0, y), h1);
+            h1 = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(hb1, y), _mm_mul_pd(ha1, v)), h2);
+            h2 = _mm_sub_pd(_mm_mul_pd(hb2, y), _mm_mul_pd(ha2, v));
+            sums = _mm_add_pd(sums, _mm_mul_pd(v, v));
+        }
+        _mm_storeu_pd(z, s1);
+        _mm_storeu_pd(z + 2, s2);
+        _mm_storeu_pd(z + 4, h1);
+        _mm_storeu_pd(z + 6, h2);
+        double lanes[2];
+        _mm_storeu_pd(lanes, sums);
+        stepSums[first] += lanes[0];
+        stepSums[first + 1] += lanes[1];
+#elif defined(LOUDNESS_NEON)
+        float64x2_t sb0 = vdupq_n_f64(shelf.b0), sb1 = vdupq_n_f64(shelf.b1), sb2 = vdupq_n_f64(shelf.b2);
+        float64x2_t sa1 = vdupq_n_f64(shelf.a1), sa2 = vdupq_n_f64(shelf.a2);
+        float64x2_t hb0 = vdupq_n_f64(highPass.b0), hb1 = vdupq_n_f64(highPass.b1), hb2 = vdupq_n_f64(highPass.b2);
+        float64x2_t ha1 = vdupq_n_f64(highPass.a1), ha2 = vdupq_n_f64(highPass.a2);
+        float64x2_t s1 = vld1q_f64(z), s2 = vld1q_f64(z + 2), h1 = vld1q_f64(z + 4), h2 = vld1q_f64(z + 6);
+        float64x2_t sums = vdupq_n_f64(0);
+        for (int i = 0; i < frames; i++, frame += channels)
+        {
+            double pair[2] = {frame[0], is_pair ? frame[1] : 0.0};
+            float64x2_t x = vld1q_f64(pair);
+            float64x2_t y = vaddq_f64(vmulq_f64(sb0, x), s1);
+            s1 = vaddq_f64(vsubq_f64(vmulq_f64(sb1, x), vmulq_f64(sa1, y)), s2);
+            s2 = vsubq_f64(vmulq_f64(sb2, x), vmulq_f64(sa2, y));
+            float64x2_t v = vaddq_f64(vmulq_f64(hb0, y), h1);
+            h1 = vaddq_f64(vsubq_f64(vmulq_f64(hb1, y), vmulq_f64(ha1, v)), h2);
+            h2 = vsubq_f64(vmulq_f64(hb2, y), vmulq_f64(ha2, v));
+            sums = vaddq_f64(sums, vmulq_f64(v, v));
+        }
+        vst1q_f64(z, s1);
+        vst1q_f64(z + 2, s2);
+        vst1q_f64(z + 4, h1);
+        vst1q_f64(z + 6, h2);
+        stepSums[first] += vgetq_lane_f64(sums, 0);
+        stepSums[first + 1] += vgetq_lane_f64(sums, 1);
+#else
+        // Same lane layout as SIMD variants
+        for (int lane = 0; lane < (is_pair ? 2 : 1); lane++)
+        {
+            double s1 = z[lane], s2 = z[2 + lane], h1 = z[4 + lane], h2 = z[6 + lane];
+            double sum = 0;
+            const float *sample = frame + lane;
+            for (int i = 0; i < frames; i++, sample += channels)
+            {
+                double x = *sample;
+                double y = shelf.b0 * x + s1;
+                s1 = shelf.b1 * x - shelf.a1 * y + s2;
+                s2 = shelf.b2 * x - shelf.a2 * y;
+                double v = highPass.b0 * y + h1;
+                h1 = highPass.b1 * y - highPass.a1 * v + h2;
+                h2 = highPass.b2 * y - highPass.a2 * v;
+                sum += v * v;
+            }
+            z[lane] = s1;
+            z[2 + lane] = s2;
+            z[4 + lane] = h1;
+            z[6 + lane] = h2;
+            stepSums[first + lane] += sum;
+        }
+#endif
+    }
+}
+
+
+float LoudnessMeter::interpolatedPeak(const float *input, int frames) const
+{
+    // Four consecutive outputs of phase are computed at once
+    float peak = 0;
+    int i = 0;
+#if defined(LOUDNESS_SSE2)
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    __m128 peaks = _mm_setzero_ps();
+    for (; i + 4 <= frames; i += 4)
+    {
+        for (int phase = 0; phase < PEAK_PHASES; phase++)
+        {
+            const float *coefficients = &interpolation[phase * PEAK_PHASE_TAPS];
+            __m128 sums = _mm_setzero_ps();
+            for (int tap = 0; tap < PEAK_PHASE_TAPS; tap++)
+                sums = _mm_add_ps(sums, _mm_mul_ps(_mm_set1_ps(coefficients[tap]), _mm_loadu_ps(input + i - tap)));
+            peaks = _mm_max_ps(peaks, _mm_andnot_ps(sign, sums));
+        }
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, peaks);
+    peak = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+#elif defined(LOUDNESS_NEON)
+    float32x4_t peaks = vdupq_n_f32(0);
+    for (; i + 4 <= frames; i += 4)
+    {
+        for (int phase = 0; phase < PEAK_PHASES; phase++)
+        {
+            const float *coefficients = &interpolation[phase * PEAK_PHASE_TAPS];
+            float32x4_t sums = vdupq_n_f32(0);
+            for (int tap = 0; tap < PEAK_PHASE_TAPS; tap++)
+                sums = vmlaq_n_f32(sums, vld1q_f32(input + i - tap), coefficients[tap]);
+            peaks = vmaxq_f32(peaks, vabsq_f32(sums));
+        }
+    }
+    peak = vmaxvq_f32(peaks);
+#endif
+
+    // Tail (and everything without SIMD)
+    for (; i < frames; i++)
+    {
+        for (int phase = 0; phase < PEAK_PHASES; phase++)
+        {
+            const float *coefficients = &interpolation[phase * PEAK_PHASE_TAPS];
+            float sum = 0;
+            for (int tap = 0; tap < PEAK_PHASE_TAPS; tap++)
+                sum += coefficients[tap] * input[i - tap];
+            peak = std::max(peak, std::fabs(sum));
+        }
+    }
+    return peak;
+}
+
+
+void LoudnessMeter::finishStep()
+{
+    double sum = 0;
+    for (int channel = 0; channel < channels; channel++)
+        sum += weights[channel] * stepSums[channel];
+    steps.push_back(sum / stepFrame);
+    totalSum += sum;
+    totalFrames += stepFrame;
+    std::fill(stepSums.begin(), stepSums.end(), 0.0);
+    stepFrame = 0;
+}
+
+
+void LoudnessMeter::measurePeak(const float *samples, int frames)
+{
+    float minimum = 0;
+    float maximum = 0;
+    double squares = 0;
+    PeakBuilder::reduce(samples, static_cast<size_t>(frames) * channels, minimum, maximum, squares);
+    float peak = std::max(-minimum, maximum);
+    samplePeak = std::max(samplePeak, peak);
+
+    // Interpolated level cannot exceed window peak times filter gain, so only parts loud enough are oversampled
+    const int history_size = PEAK_PHASE_TAPS - 1;
+    for (int channel = 0; channel < channels; channel++)
+    {
+        float *channel_history = &history[channel * history_size];
+        window.assign(channel_history, channel_history + history_size);
+        for (int i = 0; i < frames; i++)
+            window.push_back(samples[static_cast<size_t>(i) * channels + channel]);
+
+        for (int start = 0; start < frames; start += PEAK_BLOCK_FRAMES)
+        {
+            int count = std::min(PEAK_BLOCK_FRAMES, frames - start);
+            const float *input = &window[history_size + start];
+            float window_peak = 0;
+            for (int i = -history_size; i < count; i++)
+                window_peak = std::max(window_peak, std::fabs(input[i]));
+            if (window_peak * interpolationGain > truePeak)
+                truePeak = std::max(truePeak, interpolatedPeak(input, count));
+        }
+
+        std::copy(window.end() - history_size, window.end(), channel_history);
+    }
+}
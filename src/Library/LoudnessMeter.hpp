@@ -0,0 +1,109 @@
+#pragma once
+
+
+// Fixed width integers
+#include <cstdint>
+// Containers
+#include <vector>
+
+
+/**
+ * Measures integrated loudness and true peak of decoded track (ITU-R BS.1770 / EBU R128). Samples are
+ * K-weighted (channel pairs are filtered together with SIMD), mean squares are kept per 100 ms and gated
+ * over 400 ms blocks at the end. True peak is searched in 4x oversampled signal, only in chunks loud enough
+ * to raise it.
+ */
+class LoudnessMeter
+{
+    /**
+     * Biquad coefficients (a0 is 1).
+     */
+    struct Biquad
+    {
+        double b0, b1, b2, a1, a2;
+    };
+
+    // Number of interleaved channels.
+    int channels;
+    // Frames per 100 ms step.
+    int stepFrames;
+    // Weight of each channel (0 for LFE, 1.41 for surround).
+    std::vector<double> weights;
+
+    // High shelf (head) and high pass (RLB) stages of K-weighting.
+    Biquad shelf, highPass;
+    // Filter state of each channel (two per stage).
+    std::vector<double> state;
+    // Sum of squared filtered samples of each channel in current step.
+    std::vector<double> stepSums;
+    // Frames of current step.
+    int stepFrame = 0;
+    // Weighted mean square of every finished step.
+    std::vector<double> steps;
+    // Weighted sum of squares of whole track (measures tracks shorter than one block).
+    double totalSum = 0;
+    // Number of frames seen.
+    uint64_t totalFrames = 0;
+
+    // Interpolation filter of true peak (phases one after another).
+    std::vector<float> interpolation;
+    // Largest sum of absolute coefficients of one phase (bounds interpolated level).
+    float interpolationGain = 0;
+    // Last input frames of each channel (interpolation filter history).
+    std::vector<float> history;
+    // Channel being interpolated with its history (scratch).
+    std::vector<float> window;
+    // Highest absolute sample.
+    float samplePeak = 0;
+    // Highest absolute interpolated sample.
+    float truePeak = 0;
+
+public:
+
+    /**
+     * Constructor.
+     *
+     * @param sampleRate track sample rate
+     * @param channels number of interleaved channels
+     */
+    LoudnessMeter(int sampleRate, int channels);
+
+    /**
+     * Adds interleaved float frames.
+     */
+    void add(const float *samples, int frames);
+
+    /**
+     * @return integrated loudness in LUFS (-infinity for silence)
+     */
+    double getLoudness() const;
+
+    /**
+     * @return true peak in dBTP (-infinity for silence)
+     */
+    double getTruePeak() const;
+
+private:
+
+    /**
+     * K-weights frames and adds their squares to current step.
+     */
+    void filter(const float *samples, int frames);
+
+    /**
+     * Closes current step.
+     */
+    void finishStep();
+
+    /**
+     * Raises true peak with oversampled frames.
+     */
+    void measurePeak(const float *samples, int frames);
+
+    /**
+     * @param input samples of one channel preceded by filter history
+     *
+     * @return highest absolute interpolated sample
+     */
+    float interpolatedPeak(const float *input, int frames) const;
+};
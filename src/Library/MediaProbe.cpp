@@ -0,0 +1,68 @@
+#include <Library/MediaProbe.hpp>
+
+
+// Files
+#include <cstdio>
+// Memory comparison
+#include <cstring>
+
+
+// Bytes read from file start (enough for every signature below)
+#define PROBE_SIZE 16
+
+
+/**
+ * @return whether header has given bytes at given offset
+ */
+static bool hasSignature(const unsigned char *header, size_t size, size_t offset, const char *signature)
+{
+    size_t length = std::strlen(signature);
+    return (size >= offset + length) && (std::memcmp(header + offset, signature, length) == 0);
+}
+
+
+bool MediaProbe::isMedia(const std::string &filepath)
+{
+    FILE *file = std::fopen(filepath.c_str(), "rb");
+    if (!file)
+        return false;
+
+    unsigned char header[PROBE_SIZE];
+    size_t size = std::fread(header, 1, sizeof(header), file);
+    std::fclose(file);
+
+    return isMedia(header, size);
+}
+
+
+bool MediaProbe::isMedia(const unsigned char *header, size_t size)
+{
+    // FLAC, Ogg (Vorbis, Opus, FLAC), MP3 with ID3 tag, APE, WavPack, AMR
+    if (hasSignature(header, size, 0, "fLaC") || hasSignature(header, size, 0, "OggS") ||
+        hasSignature(header, size, 0, "ID3") || hasSignature(header, size, 0, "MAC ") ||
+        hasSignature(header, size, 0, "wvpk") || hasSignature(header, size, 0, "#!AMR"))
+        return true;
+
+    // WAV, AIFF
+    if ((hasSignature(header, size, 0, "RIFF") && hasSignature(header, size, 8, "WAVE")) ||
+        (hasSignature(header, size, 0, "FORM") && (hasSignature(header, size, 8, "AIFF") || hasSignature(header, size, 8, "AIFC"))))
+        return true;
+
+    // MP4 family (M4A, MP4, 3GP, MOV)
+    if (hasSignature(header, size, 4, "ftyp"))
+        return true;
+
+    // Matroska and WebM
+    if (hasSignature(header, size, 0, "\x1A\x45\xDF\xA3"))
+        return true;
+
+    // MPEG audio or ADTS AAC frame without tag (starts with frame sync bits)
+    if ((size >= 2) && (header[0] == 0xFF) && ((header[1] & 0xE0) == 0xE0))
+    {
+        bool is_mpeg_audio = (header[1] & 0x06) != 0;
+        bool is_adts = (header[1] & 0xF6) == 0xF0;
+        return is_mpeg_audio || is_adts;
+    }
+
+    return false;
+}
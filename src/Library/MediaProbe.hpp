@@ -0,0 +1,29 @@
+#pragma once
+
+
+// Strings
+#include <string>
+// Sizes
+#include <cstddef>
+
+
+/**
+ * Recognizes media files by their content rather than by extension.
+ */
+class MediaProbe
+{
+public:
+
+    /**
+     * @return whether file starts like audio container or stream FFMPEG can play
+     */
+    static bool isMedia(const std::string &filepath);
+
+    /**
+     * @param header first bytes of file
+     * @param size number of bytes
+     *
+     * @return whether header belongs to audio container or stream
+     */
+    static bool isMedia(const unsigned char *header, size_t size);
+};
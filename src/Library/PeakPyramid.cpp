@@ -0,0 +1,179 @@
+#include <Library/PeakPyramid.hpp>
+
+
+// Min/max
+#include <algorithm>
+// Square root
+#include <cmath>
+// SIMD
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define PEAKS_SSE2
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define PEAKS_NEON
+#endif
+
+
+/**
+ * @return sample scaled to -127..127
+ */
+static int8_t quantizeSample(float sample)
+{
+    return static_cast<int8_t>(std::lround(std::clamp(sample, -1.0f, 1.0f) * 127));
+}
+
+
+PeakLevel PeakPyramid::levelFor(const PeakBucket *pyramid, int width)
+{
+    PeakLevel level;
+    if (!pyramid)
+        return level;
+
+    // Levels are stored finest first, coarser ones follow
+    int offset = 0;
+    int size = BASE_SIZE;
+    for (int i = 1; (i < LEVEL_COUNT) && (size / 2 >= width); i++)
+    {
+        offset += size;
+        size /= 2;
+    }
+    level.buckets = pyramid + offset;
+    level.size = size;
+    return level;
+}
+
+
+PeakBuilder::PeakBuilder(double totalFrames, int channels)
+{
+    this->totalFrames = std::max(1.0, totalFrames);
+    this->channels = std::max(1, channels);
+    minimums.assign(PeakPyramid::BASE_SIZE, 0);
+    maximums.assign(PeakPyramid::BASE_SIZE, 0);
+    squares.assign(PeakPyramid::BASE_SIZE, 0);
+    counts.assign(PeakPyramid::BASE_SIZE, 0);
+}
+
+
+void PeakBuilder::add(const float *samples, int frames)
+{
+    // Frames are split at bucket boundaries, each run is reduced at once
+    while (frames > 0)
+    {
+        int bucket = std::min(PeakPyramid::BASE_SIZE - 1, static_cast<int>(frame * PeakPyramid::BASE_SIZE / totalFrames));
+        int run = frames;
+        if (bucket < PeakPyramid::BASE_SIZE - 1)
+        {
+            uint64_t bucket_end = static_cast<uint64_t>(std::ceil((bucket + 1) * totalFrames / PeakPyramid::BASE_SIZE));
+            run = (bucket_end > frame) ? static_cast<int>(std::min<uint64_t>(bucket_end - frame, frames)) : 1;
+        }
+
+        float minimum = minimums[bucket];
+        float maximum = maximums[bucket];
+        reduce(samples, static_cast<size_t>(run) * channels, minimum, maximum, squares[bucket]);
+        minimums[bucket] = minimum;
+        maximums[bucket] = maximum;
+        counts[bucket] += static_cast<uint64_t>(run) * channels;
+
+        samples += static_cast<size_t>(run) * channels;
+        frames -= run;
+        frame += run;
+    }
+}
+
+
+PeakPyramid PeakBuilder::finish() const
+{
+    PeakPyramid pyramid;
+    pyramid.buckets.reserve(PeakPyramid::BUCKET_COUNT);
+
+    // Coarser levels merge pairs of finer buckets
+    std::vector<float> level_minimums = minimums;
+    std::vector<float> level_maximums = maximums;
+    std::vector<double> level_squares = squares;
+    std::vector<uint64_t> level_counts = counts;
+    for (int level = 0; level < PeakPyramid::LEVEL_COUNT; level++)
+    {
+        for (size_t i = 0; i < level_minimums.size(); i++)
+        {
+            double rms = level_counts[i] ? std::sqrt(level_squares[i] / level_counts[i]) : 0.0;
+            pyramid.buckets.push_back({quantizeSample(level_minimums[i]), quantizeSample(level_maximums[i]),
+                                       static_cast<uint8_t>(std::lround(std::min(rms, 1.0) * 255))});
+        }
+
+        size_t size = level_minimums.size() / 2;
+        for (size_t i = 0; i < size; i++)
+        {
+            level_minimums[i] = std::min(level_minimums[2 * i], level_minimums[2 * i + 1]);
+            level_maximums[i] = std::max(level_maximums[2 * i], level_maximums[2 * i + 1]);
+            level_squares[i] = level_squares[2 * i] + level_squares[2 * i + 1];
+            level_counts[i] = level_counts[2 * i] + level_counts[2 * i + 1];
+        }
+        level_minimums.resize(size);
+        level_maximums.resize(size);
+        level_squares.resize(size);
+        level_counts.resize(size);
+    }
+
+    return pyramid;
+}
+
+
+void PeakBuilder::reduce(const float *samples, size_t count, float &minimum, float &maximum, double &squares)
+{
+    size_t i = 0;
+    float sum = 0;
+
+#if defined(PEAKS_SSE2)
+    if (count >= 4)
+    {
+        __m128 minimums = _mm_set1_ps(minimum);
+        __m128 maximums = _mm_set1_ps(maximum);
+        __m128 sums = _mm_setzero_ps();
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128 values = _mm_loadu_ps(samples + i);
+            minimums = _mm_min_ps(minimums, values);
+            maximums = _mm_max_ps(maximums, values);
+            sums = _mm_add_ps(sums, _mm_mul_ps(values, values));
+        }
+        float lanes[4];
+        _mm_storeu_ps(lanes, minimums);
+        minimum = std::min(std::min(lanes[0], lanes[1]), std::min(lanes[2], lanes[3]));
+        _mm_storeu_ps(lanes, maximums);
+        maximum = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+        _mm_storeu_ps(lanes, sums);
+        sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    }
+#elif defined(PEAKS_NEON)
+    if (count >= 4)
+    {
+        float32x4_t minimums = vdupq_n_f32(minimum);
+        float32x4_t maximums = vdupq_n_f32(maximum);
+        float32x4_t sums = vdupq_n_f32(0);
+        for (; i + 4 <= count; i += 4)
+        {
+            float32x4_t values = vld1q_f32(samples + i);
+            minimums = vminq_f32(minimums, values);
+            maximums = vmaxq_f32(maximums, values);
+            sums = vmlaq_f32(sums, values, values);
+        }
+        float lanes[4];
+        vst1q_f32(lanes, minimums);
+        minimum = std::min(std::min(lanes[0], lanes[1]), std::min(lanes[2], lanes[3]));
+        vst1q_f32(lanes, maximums);
+        maximum = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+        vst1q_f32(lanes, sums);
+        sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    }
+#endif
+
+    // Tail (and everything without SIMD)
+    for (; i < count; i++)
+    {
+        minimum = std::min(minimum, samples[i]);
+        maximum = std::max(maximum, samples[i]);
+        sum += samples[i] * samples[i];
+    }
+    squares += sum;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+
+// Fixed width integers
+#include <cstdint>
+// Sizes
+#include <cstddef>
+// Containers
+#include <vector>
+
+
+/**
+ * Levels of one part of track.
+ */
+struct PeakBucket
+{
+    // Lowest sample scaled to -127..127.
+    int8_t min;
+    // Highest sample scaled to -127..127.
+    int8_t max;
+    // RMS level scaled to 0..255.
+    uint8_t rms;
+};
+
+
+/**
+ * Part of pyramid with given number of buckets.
+ */
+struct PeakLevel
+{
+    // Buckets of level (nullptr if there are none).
+    const PeakBucket *buckets = nullptr;
+    // Number of buckets.
+    int size = 0;
+};
+
+
+/**
+ * Waveform of track at several zoom levels. Finest level splits track into BASE_SIZE equal parts, each next
+ * level halves it. Number of buckets does not depend on duration, so every pyramid has same size and is stored
+ * in library index as fixed-size record field.
+ */
+struct PeakPyramid
+{
+    // Buckets of finest level.
+    static constexpr int BASE_SIZE = 512;
+    // Number of levels (coarsest one has BASE_SIZE >> (LEVEL_COUNT - 1) buckets).
+    static constexpr int LEVEL_COUNT = 6;
+    // Buckets of all levels.
+    static constexpr int BUCKET_COUNT = 2 * BASE_SIZE - (BASE_SIZE >> (LEVEL_COUNT - 1));
+
+    // Buckets of all levels, finest first.
+    std::vector<PeakBucket> buckets;
+
+    /**
+     * Picks level for drawing (coarsest one that still has bucket for every pixel).
+     *
+     * @param pyramid BUCKET_COUNT buckets (nullptr gives empty level)
+     * @param width drawn width in pixels
+     */
+    static PeakLevel levelFor(const PeakBucket *pyramid, int width);
+};
+
+
+/**
+ * Builds pyramid from decoded samples as they come. Each part of track is reduced with SIMD min/max and
+ * sum of squares.
+ */
+class PeakBuilder
+{
+    // Expected number of frames (frames past it go to last bucket).
+    double totalFrames;
+    // Number of interleaved channels.
+    int channels;
+    // Frames added so far.
+    uint64_t frame = 0;
+
+    // Lowest sample of each finest bucket.
+    std::vector<float> minimums;
+    // Highest sample of each finest bucket.
+    std::vector<float> maximums;
+    // Sum of squared samples of each finest bucket.
+    std::vector<double> squares;
+    // Number of samples of each finest bucket.
+    std::vector<uint64_t> counts;
+
+public:
+
+    /**
+     * Constructor.
+     *
+     * @param totalFrames expected number of frames
+     * @param channels number of interleaved channels
+     */
+    PeakBuilder(double totalFrames, int channels);
+
+    /**
+     * Adds interleaved float frames.
+     */
+    void add(const float *samples, int frames);
+
+    /**
+     * @return pyramid of everything added
+     */
+    PeakPyramid finish() const;
+
+    /**
+     * Finds lowest and highest sample and adds up squares (SIMD where available).
+     */
+    static void reduce(const float *samples, size_t count, float &minimum, float &maximum, double &squares);
+};
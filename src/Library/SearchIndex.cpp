@@ -0,0 +1,293 @@
+#include <Library/SearchIndex.hpp>
+
+
+// Sorting
+#include <algorithm>
+// String search
+#include <cstring>
+
+
+// Number of best results delivered before the rest is sorted
+#define FIRST_BATCH_SIZE 256
+// Number of results in each following batch
+#define RESULTS_BATCH_SIZE 4096
+// Percentage of query trigrams that entry without exact match must contain
+#define FUZZY_MATCH_PERCENT 60
+// Removed entries tolerated before postings are rebuilt
+#define COMPACTION_THRESHOLD 4096
+// Characters treated as word separators
+#define SEPARATORS " /\\_-.,;:()[]{}'\"!?&+#~"
+
+
+void SearchIndex::add(uint32_t id, const std::string &text)
+{
+    if (slots.count(id))
+        remove(id);
+
+    uint32_t slot = static_cast<uint32_t>(entries.size());
+    entries.push_back({id, normalize(text), true});
+    slots[id] = slot;
+    insert(slot);
+}
+
+
+void SearchIndex::remove(uint32_t id)
+{
+    auto slot = slots.find(id);
+    if (slot == slots.end())
+        return;
+
+    // Postings keep pointing at entry until compaction, searches skip it
+    Entry &entry = entries[slot->second];
+    entry.isAlive = false;
+    std::string().swap(entry.text);
+    slots.erase(slot);
+    removedCount++;
+
+    if ((removedCount > COMPACTION_THRESHOLD) && (removedCount > entries.size() / 2))
+        compact();
+}
+
+
+void SearchIndex::clear()
+{
+    entries.clear();
+    slots.clear();
+    postings.clear();
+    hits.clear();
+    removedCount = 0;
+}
+
+
+void SearchIndex::find(const std::string &query, ResultsCallback callback)
+{
+    // Words of query
+    std::string normalized = normalize(query);
+    std::vector<std::string> words;
+    for (size_t start = 0; start < normalized.size();)
+    {
+        size_t end = normalized.find(' ', start);
+        if (end == std::string::npos)
+            end = normalized.size();
+        words.push_back(normalized.substr(start, end - start));
+        start = end + 1;
+    }
+    if (words.empty())
+        return;
+
+    std::vector<uint32_t> trigrams;
+    for (const std::string &word : words)
+    {
+        std::vector<uint32_t> word_trigrams = trigramsOf(word);
+        trigrams.insert(trigrams.end(), word_trigrams.begin(), word_trigrams.end());
+    }
+    std::sort(trigrams.begin(), trigrams.end());
+    trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+
+    // Count query trigrams of every entry that has any
+    hits.resize(entries.size(), 0);
+    std::vector<uint32_t> touched;
+    for (uint32_t trigram : trigrams)
+    {
+        auto posting = postings.find(trigram);
+        if (posting == postings.end())
+            continue;
+        for (uint32_t slot : posting->second)
+        {
+            if (hits[slot]++ == 0)
+                touched.push_back(slot);
+        }
+    }
+
+    // Query of short words only has no trigrams, every entry is then checked for them
+    std::vector<uint32_t> candidates;
+    size_t total = trigrams.size();
+    if (total > 0)
+    {
+        size_t required = std::max<size_t>(1, (total * FUZZY_MATCH_PERCENT + 99) / 100);
+        for (uint32_t slot : touched)
+        {
+            if (hits[slot] >= required)
+                candidates.push_back(slot);
+        }
+    }
+    else
+    {
+        candidates.reserve(entries.size());
+        for (uint32_t slot = 0; slot < entries.size(); slot++)
+            candidates.push_back(slot);
+    }
+
+    /**
+     * Candidate with its rank.
+     */
+    struct Match
+    {
+        // Higher is better.
+        uint32_t score;
+        // Text length (shorter wins ties).
+        uint32_t length;
+        // Entry.
+        uint32_t slot;
+    };
+    std::vector<Match> matches;
+    for (uint32_t slot : candidates)
+    {
+        const Entry &entry = entries[slot];
+        if (!entry.isAlive)
+            continue;
+
+        // Exact words rank first, words found at word start rank higher
+        bool is_exact = true;
+        uint32_t word_starts = 0;
+        for (const std::string &word : words)
+        {
+            size_t position = entry.text.find(word);
+            if (position == std::string::npos)
+            {
+                is_exact = false;
+                continue;
+            }
+            if ((position == 0) || (entry.text.find(" " + word) != std::string::npos))
+                word_starts++;
+        }
+        if (!is_exact && (total == 0))
+            continue;
+
+        uint32_t score = (is_exact ? 100000 : 0) + word_starts * 1000 + ((total > 0) ? hits[slot] * 1000 / total : 0);
+        matches.push_back({score, static_cast<uint32_t>(entry.text.size()), slot});
+    }
+
+    // Scratch stays zeroed for next query
+    for (uint32_t slot : touched)
+        hits[slot] = 0;
+
+    // Abbreviations (letters of each word in order) are tried only when nothing else matched
+    if (matches.empty())
+    {
+        for (uint32_t slot = 0; slot < entries.size(); slot++)
+        {
+            const Entry &entry = entries[slot];
+            bool is_match = entry.isAlive;
+            for (size_t i = 0; is_match && (i < words.size()); i++)
+                is_match = isSubsequence(words[i], entry.text);
+            if (is_match)
+                matches.push_back({0, static_cast<uint32_t>(entry.text.size()), slot});
+        }
+    }
+    if (matches.empty())
+        return;
+    auto is_better = [](const Match &first, const Match &second)
+    {
+        if (first.score != second.score)
+            return first.score > second.score;
+        if (first.length != second.length)
+            return first.length < second.length;
+        return first.slot < second.slot;
+    };
+
+    // Best results go out right away, rest is sorted only if it is still wanted
+    size_t first_batch = std::min<size_t>(FIRST_BATCH_SIZE, matches.size());
+    std::partial_sort(matches.begin(), matches.begin() + first_batch, matches.end(), is_better);
+    std::vector<uint32_t> ids;
+    for (size_t i = 0; i < first_batch; i++)
+        ids.push_back(entries[matches[i].slot].id);
+    if (!callback(ids) || (first_batch == matches.size()))
+        return;
+
+    std::sort(matches.begin() + first_batch, matches.end(), is_better);
+    for (size_t start = first_batch; start < matches.size(); start += RESULTS_BATCH_SIZE)
+    {
+        ids.clear();
+        size_t end = std::min<size_t>(start + RESULTS_BATCH_SIZE, matches.size());
+        for (size_t i = start; i < end; i++)
+            ids.push_back(entries[matches[i].slot].id);
+        if (!callback(ids))
+            return;
+    }
+}
+
+
+std::string SearchIndex::normalize(const std::string &text)
+{
+    std::string normalized;
+    normalized.reserve(text.size());
+    for (char character : text)
+    {
+        // Bytes of multibyte characters are kept as they are
+        unsigned char byte = static_cast<unsigned char>(character);
+        if ((byte < 0x20) || std::strchr(SEPARATORS, character))
+        {
+            if (!normalized.empty() && (normalized.back() != ' '))
+                normalized.push_back(' ');
+        }
+        else if ((character >= 'A') && (character <= 'Z'))
+            normalized.push_back(character - 'A' + 'a');
+        else
+            normalized.push_back(character);
+    }
+    if (!normalized.empty() && (normalized.back() == ' '))
+        normalized.pop_back();
+    return normalized;
+}
+
+
+bool SearchIndex::isSubsequence(const std::string &word, const std::string &text)
+{
+    size_t position = 0;
+    for (char character : word)
+    {
+        position = text.find(character, position);
+        if (position == std::string::npos)
+            return false;
+        position++;
+    }
+    return true;
+}
+
+
+std::vector<uint32_t> SearchIndex::trigramsOf(const std::string &text)
+{
+    std::vector<uint32_t> trigrams;
+    for (size_t i = 0; i + 3 <= text.size(); i++)
+    {
+        if ((text[i] == ' ') || (text[i + 1] == ' ') || (text[i + 2] == ' '))
+            continue;
+        trigrams.push_back((static_cast<uint32_t>(static_cast<unsigned char>(text[i])) << 16) |
+                           (static_cast<uint32_t>(static_cast<unsigned char>(text[i + 1])) << 8) |
+                           static_cast<uint32_t>(static_cast<unsigned char>(text[i + 2])));
+    }
+    std::sort(trigrams.begin(), trigrams.end());
+    trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+    return trigrams;
+}
+
+
+void SearchIndex::insert(uint32_t slot)
+{
+    for (uint32_t trigram : trigramsOf(entries[slot].text))
+        postings[trigram].push_back(slot);
+}
+
+
+void SearchIndex::compact()
+{
+    std::vector<Entry> alive;
+    alive.reserve(slots.size());
+    for (Entry &entry : entries)
+    {
+        if (entry.isAlive)
+            alive.push_back(std::move(entry));
+    }
+
+    entries.swap(alive);
+    slots.clear();
+    postings.clear();
+    hits.clear();
+    removedCount = 0;
+    for (uint32_t slot = 0; slot < entries.size(); slot++)
+    {
+        slots[entries[slot].id] = slot;
+        insert(slot);
+    }
+}
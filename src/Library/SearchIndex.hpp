@@ -0,0 +1,116 @@
+#pragma once
+
+
+// Fixed width integers
+#include <cstdint>
+// Strings
+#include <string>
+// Containers
+#include <vector>
+#include <unordered_map>
+// Callbacks
+#include <functional>
+
+
+/**
+ * Trigram index over short texts (track paths) for incremental search. Every query word of three or more
+ * characters narrows candidates down to entries sharing its trigrams, so typing stays cheap on large
+ * libraries. Entries that contain all query words rank first, entries that share most trigrams with them
+ * follow (tolerates typos). If nothing matches that way, words are matched as abbreviations (their letters
+ * in order). Not thread-safe, owner serializes access.
+ */
+class SearchIndex
+{
+public:
+
+    /**
+     * Receives batch of matching entry IDs, best first.
+     *
+     * @return whether more results are wanted
+     */
+    typedef std::function<bool(const std::vector<uint32_t>&)> ResultsCallback;
+
+private:
+
+    /**
+     * Searched text.
+     */
+    struct Entry
+    {
+        // Caller ID.
+        uint32_t id;
+        // Normalized text.
+        std::string text;
+        // Whether entry was not removed.
+        bool isAlive;
+    };
+
+    // Entries in insertion order (removed ones stay until compaction).
+    std::vector<Entry> entries;
+    // Entry of each ID.
+    std::unordered_map<uint32_t, uint32_t> slots;
+    // Entries containing each trigram (ascending).
+    std::unordered_map<uint32_t, std::vector<uint32_t>> postings;
+    // Number of removed entries.
+    size_t removedCount = 0;
+
+    // Matched trigrams of each entry (query scratch, zero between queries).
+    std::vector<uint16_t> hits;
+
+public:
+
+    /**
+     * Adds entry (replaces text of known ID).
+     */
+    void add(uint32_t id, const std::string &text);
+
+    /**
+     * Removes entry.
+     */
+    void remove(uint32_t id);
+
+    /**
+     * Removes all entries.
+     */
+    void clear();
+
+    /**
+     * @return number of entries
+     */
+    size_t size() const { return slots.size(); }
+
+    /**
+     * Finds entries matching query. First batch holds best results and is delivered before the rest is sorted.
+     *
+     * @param query words separated by spaces (case does not matter)
+     * @param callback receives results in batches (not called if nothing matches)
+     */
+    void find(const std::string &query, ResultsCallback callback);
+
+    /**
+     * @return text in form it is indexed and searched (lower case, punctuation and path separators as spaces)
+     */
+    static std::string normalize(const std::string &text);
+
+private:
+
+    /**
+     * @return whether letters of word appear in text in same order
+     */
+    static bool isSubsequence(const std::string &word, const std::string &text);
+
+    /**
+     * @return distinct trigrams of normalized text (windows with spaces are skipped)
+     */
+    static std::vector<uint32_t> trigramsOf(const std::string &text);
+
+    /**
+     * Indexes entry.
+     */
+    void insert(uint32_t slot);
+
+    /**
+     * Rebuilds postings without removed entries.
+     */
+    void compact();
+};
@@ -0,0 +1,130 @@
+#include <Library/TrackSearch.hpp>
+
+
+// Pipeline spans
+#include <Engine/Tracer.hpp>
+
+
+TrackSearch::~TrackSearch()
+{
+    if (!thread.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        isRunning = false;
+    }
+    // Running query stops at next batch
+    latestQuery++;
+    condition.notify_one();
+    thread.join();
+}
+
+
+void TrackSearch::setResultsCallback(ResultsCallback callback)
+{
+    resultsCallback = callback;
+}
+
+
+void TrackSearch::start()
+{
+    isRunning = true;
+    thread = std::thread(&TrackSearch::process, this);
+}
+
+
+void TrackSearch::add(uint32_t id, const std::string &text)
+{
+    queue({Update::ADD, id, text});
+}
+
+
+void TrackSearch::remove(uint32_t id)
+{
+    queue({Update::REMOVE, id, ""});
+}
+
+
+void TrackSearch::clear()
+{
+    queue({Update::CLEAR, 0, ""});
+}
+
+
+uint64_t TrackSearch::search(const std::string &text)
+{
+    uint64_t query;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queryText = text;
+        query = ++latestQuery;
+    }
+    condition.notify_one();
+    return query;
+}
+
+
+void TrackSearch::queue(Update update)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        // Earlier changes are pointless once index is cleared
+        if (update.type == Update::CLEAR)
+            updates.clear();
+        updates.push_back(std::move(update));
+    }
+    condition.notify_one();
+}
+
+
+void TrackSearch::process()
+{
+    Tracer::setThreadName("library search");
+
+    std::vector<Update> received;
+    while (true)
+    {
+        std::string text;
+        uint64_t query;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this]() { return !isRunning || !updates.empty() || (latestQuery != finishedQuery); });
+            if (!isRunning)
+                return;
+            received.swap(updates);
+            text = queryText;
+            query = latestQuery;
+        }
+
+        // Query sees every change queued before it
+        for (Update &update : received)
+        {
+            if (update.type == Update::ADD)
+                index.add(update.id, update.text);
+            else if (update.type == Update::REMOVE)
+                index.remove(update.id);
+            else
+                index.clear();
+        }
+        received.clear();
+
+        if (query == finishedQuery)
+            continue;
+        finishedQuery = query;
+
+        TraceSpan span("library search");
+        bool is_first = true;
+        index.find(text, [this, query, &is_first](const std::vector<uint32_t> &ids)
+        {
+            // Newer query is waiting
+            if (latestQuery != query)
+                return false;
+            resultsCallback(query, ids, is_first);
+            is_first = false;
+            return true;
+        });
+        if (is_first && (latestQuery == query))
+            resultsCallback(query, std::vector<uint32_t>(), true);
+    }
+}
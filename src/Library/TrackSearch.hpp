@@ -0,0 +1,138 @@
+#pragma once
+
+
+// Fixed width integers
+#include <cstdint>
+// Strings
+#include <string>
+// Containers
+#include <vector>
+// Callbacks
+#include <functional>
+// Threads
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+// Trigram index
+#include <Library/SearchIndex.hpp>
+
+
+/**
+ * Searches library tracks on its own thread. Index updates and queries are queued in order, only the latest
+ * query runs (older ones are dropped or stopped between result batches) and its results are streamed back,
+ * best first.
+ */
+class TrackSearch
+{
+public:
+
+    /**
+     * Receives batch of matching track IDs (called from search thread).
+     *
+     * @param query number of query returned by search()
+     * @param isFirst whether batch starts results of query (empty first batch means nothing matched)
+     */
+    typedef std::function<void(uint64_t query, const std::vector<uint32_t> &ids, bool isFirst)> ResultsCallback;
+
+private:
+
+    /**
+     * Index change waiting to be applied.
+     */
+    struct Update
+    {
+        /**
+         * Describes update.
+         */
+        enum Type
+        {
+            ADD,
+            REMOVE,
+            CLEAR
+        };
+
+        // Update type.
+        Type type;
+        // Track ID.
+        uint32_t id;
+        // Searched text of added track.
+        std::string text;
+    };
+
+    // Index (search thread only).
+    SearchIndex index;
+
+    // Notified about results.
+    ResultsCallback resultsCallback;
+
+    // Search thread.
+    std::thread thread;
+    // Whether thread should run.
+    bool isRunning = false;
+    // Index changes not applied yet.
+    std::vector<Update> updates;
+    // Latest query text.
+    std::string queryText;
+    // Number of latest query (0 before first one).
+    std::atomic<uint64_t> latestQuery = 0;
+    // Number of query thread has run last.
+    uint64_t finishedQuery = 0;
+    // Guards isRunning, updates and queryText.
+    std::mutex mutex;
+    // Wakes thread up.
+    std::condition_variable condition;
+
+public:
+
+    /**
+     * Destructor. Stops search thread, no results are reported after it returns.
+     */
+    ~TrackSearch();
+
+    /**
+     * @param callback function that will receive results (must be set before start)
+     */
+    void setResultsCallback(ResultsCallback callback);
+
+    /**
+     * Starts search thread.
+     */
+    void start();
+
+    /**
+     * Adds track to index (replaces text of known track).
+     *
+     * @param text file path and other searched words of track
+     */
+    void add(uint32_t id, const std::string &text);
+
+    /**
+     * Removes track from index.
+     */
+    void remove(uint32_t id);
+
+    /**
+     * Removes all tracks from index.
+     */
+    void clear();
+
+    /**
+     * Queues query (replaces previous one that has not finished).
+     *
+     * @return query number results are reported with
+     */
+    uint64_t search(const std::string &text);
+
+private:
+
+    /**
+     * Queues index change.
+     */
+    void queue(Update update);
+
+    /**
+     * Search thread body.
+     */
+    void process();
+};
@@ -0,0 +1,70 @@
+#include <Library/TrackSummary.hpp>
+
+
+// FFMPEG media files reader
+#include <FFMPEG/AudioTrackReader.hpp>
+// Loudness
+#include <Library/LoudnessMeter.hpp>
+
+
+/**
+ * @return first (or last) frame with sample at least as loud as level (-1 if there is none)
+ */
+static int findAudible(const float *samples, int frames, int channels, float level, bool isBackward)
+{
+    for (int i = 0; i < frames; i++)
+    {
+        int frame = isBackward ? frames - 1 - i : i;
+        const float *sample = samples + static_cast<size_t>(frame) * channels;
+        for (int channel = 0; channel < channels; channel++)
+        {
+            if (std::fabs(sample[channel]) >= level)
+                return frame;
+        }
+    }
+    return -1;
+}
+
+
+TrackSummary TrackSummary::of(const std::string &filepath, double silenceThreshold)
+{
+    TrackSummary summary;
+
+    AudioTrackContext track(filepath);
+    summary.duration = track.getDuration();
+    track.init();
+
+    // Frames of each bucket follow from duration (frames past it go to last bucket)
+    PeakBuilder peaks(summary.duration * track.getSampleRate(), track.getChannelCount());
+    LoudnessMeter loudness(track.getSampleRate(), track.getChannelCount());
+    // Whole chunks are scanned only until first audible sample and from their end back to last one
+    float level = static_cast<float>(std::pow(10.0, silenceThreshold / 20));
+    bool is_audible = false;
+    while (true)
+    {
+        track.read();
+        int count = track.getAudioDataSamplesCount();
+        if (count <= 0)
+            break;
+        const float *data = reinterpret_cast<const float*>(track.getAudioData()[0]);
+        peaks.add(data, count);
+        loudness.add(data, count);
+
+        int last = findAudible(data, count, track.getChannelCount(), level, true);
+        if (last < 0)
+            continue;
+        if (!is_audible)
+        {
+            summary.analysis.audibleStart = track.getSamplePosition() +
+                                            findAudible(data, count, track.getChannelCount(), level, false);
+            is_audible = true;
+        }
+        summary.analysis.audibleEnd = track.getSamplePosition() + last + 1;
+    }
+    track.close();
+
+    summary.peaks = peaks.finish();
+    summary.analysis.loudness = loudness.getLoudness();
+    summary.analysis.truePeak = loudness.getTruePeak();
+    return summary;
+}
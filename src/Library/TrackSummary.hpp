@@ -0,0 +1,33 @@
+#pragma once
+
+
+// Strings
+#include <string>
+// Waveform
+#include <Library/PeakPyramid.hpp>
+// Loudness and silence
+#include <Library/ClipAnalysis.hpp>
+
+
+/**
+ * Overview of media file shown in track library.
+ */
+struct TrackSummary
+{
+    // Duration in seconds.
+    double duration = 0;
+    // Waveform at several zoom levels.
+    PeakPyramid peaks;
+    // Loudness and silence around clip.
+    ClipAnalysis analysis;
+
+    /**
+     * Decodes whole media file and measures it.
+     *
+     * @param filepath media file path
+     * @param silenceThreshold level below which samples are silence (dBFS)
+     *
+     * @throws Runtime Error if file cannot be decoded.
+     */
+    static TrackSummary of(const std::string &filepath, double silenceThreshold = DEFAULT_SILENCE_THRESHOLD);
+};
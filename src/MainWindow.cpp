@@ -5,6 +5,16 @@
 #include <SDL3/SDL.h>
 // Strings
 #include <string>
+// Environment
+#include <cstdlib>
+
+
+// Seconds between stats file reports
+#define STATS_EXPORT_INTERVAL 10
+// Milliseconds between checks for audio device hotplug
+#define DEVICE_EVENTS_INTERVAL 200
+// Library index file name (inside application data directory)
+#define LIBRARY_INDEX_FILE "library.idx"
 
 
 // Constructor
@@ -61,26 +71,6 @@ MainWindow::MainWindow(const QApplication *app, QWidget *parent, Qt::WindowFlags
     toolbar->addAction(button_refresh_devices);
     addToolBar(toolbar);
 
-    /*
-    // Tracks table:
-    */
-    tracks = new QTableWidget();
-    // Table header should streach to the and of table
-    tracks->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
-    // Disable horisontal scroll bar
-    tracks->setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
-    // Table headers
-    tracks->setColumnCount(1);
-    tracks->setHorizontalHeaderLabels(QStringList() << "Tracks");
-    tracks->verticalHeader()->setVisible(false);
-    tracks->horizontalHeader()->setDisabled(true);
-    // Disable selection
-    tracks->setEditTriggers(QAbstractItemView::NoEditTriggers);
-    tracks->setFocusPolicy(Qt::NoFocus);
-    tracks->setSelectionMode(QAbstractItemView::NoSelection);
-    // Add to layout
-    left_vertbox->addWidget(tracks);
-
     /*
     // Devices tabs on the right:
     */
@@ -89,35 +79,158 @@ MainWindow::MainWindow(const QApplication *app, QWidget *parent, Qt::WindowFlags
     /* Input device */
     QComboBox *combobox_devices = new QComboBox();
     void (QComboBox:: *indexChangedSignal)(int) = &QComboBox::currentIndexChanged;
-    devices->addTab(new DeviceTab(DevicesList::INPUT, combobox_devices), "Input Device");
+    inputTab = new DeviceTab(DevicesList::INPUT, combobox_devices);
+    devices->addTab(inputTab, "Input Device");
     // Connect after device tab creation to ensure MainWindow::restartPlayers won't be called inside constructor (causing crash)
     connect(combobox_devices, indexChangedSignal, this, &MainWindow::updateDevices);
-    /* Virtual Output Cable */
-    combobox_devices = new QComboBox();
-    devices->addTab(new DeviceTab(DevicesList::OUTPUT, combobox_devices), "Virtual Output Cable");
-    connect(combobox_devices, indexChangedSignal, this, &MainWindow::updateDevices);
-    /* Output Device */
-    combobox_devices = new QComboBox();
-    devices->addTab(new DeviceTab(DevicesList::OUTPUT, combobox_devices), "Output Device");
-    connect(combobox_devices, indexChangedSignal, this, &MainWindow::updateDevices);
+    /* Devices are enumerated in background and follow hotplug (changes arrive once constructor is done) */
+    deviceRegistry = new DeviceRegistry();
+    deviceRegistry->setChangeCallback([this](DeviceRegistry::ChangeType type, const DeviceInfo &info)
+    {
+        QMetaObject::invokeMethod(this, [this, type, info]() { onDeviceChanged(type, info); }, Qt::QueuedConnection);
+    });
+    deviceRegistry->start();
+
+    // Spans are recorded from start when trace file is requested
+    if (std::getenv("OPENSOUNDBOARD_TRACE_FILE"))
+        Tracer::start();
+
+    /*
+    // Audio engine:
+    */
+    engine = new AudioEngine(2);
+    // Memory budget of decoded track starts can be tuned per machine
+    const char *cache_size = std::getenv("OPENSOUNDBOARD_CLIP_CACHE_MB");
+    if (cache_size && (std::atof(cache_size) >= 0))
+        engine->getCache()->setBudget(static_cast<size_t>(std::atof(cache_size) * 1024 * 1024));
+    /* Routes of players to output devices (any number of virtual cables and monitors) */
+    routingTab = new RoutingTab(engine);
+    devices->addTab(routingTab, "Output Routing");
+
+    /*
+    // Tracks table (visible rows are drawn and measured first, rest of library is analyzed in background):
+    */
+    library = new TrackLibraryModel(engine->getWorkers(), this);
+    // Measured tracks are played at normalized level, without silence around them
+    library->setAnalysisCallback([this](const QString &filepath, const ClipAnalysis &analysis)
+    {
+        engine->setClipAnalysis(filepath.toStdString(), analysis);
+    });
+    tracks = new TrackLibraryView(library);
+    // Tracks user drags, selects or rests cursor on are decoded ahead at low priority
+    tracks->setIntentCallback([this](const QString &filepath)
+    {
+        engine->prefetch(filepath.toStdString());
+    });
+    /* Search box (matching runs in background as user types) */
+    searchBox = new QLineEdit();
+    searchBox->setPlaceholderText("Search tracks");
+    searchBox->setClearButtonEnabled(true);
+    connect(searchBox, &QLineEdit::textChanged, library, &TrackLibraryModel::setFilter);
+    left_vertbox->addWidget(searchBox);
+    left_vertbox->addWidget(tracks);
+    loadLibrary();
+    // SDL detects added and removed devices while events are pumped
+    deviceEventsTimer = new QTimer(this);
+    connect(deviceEventsTimer, &QTimer::timeout, this, []() { SDL_PumpEvents(); });
+    deviceEventsTimer->start(DEVICE_EVENTS_INTERVAL);
 
     /*
     // Player managers:
     */
-    microphonePlayerWidget = new MicrophonePlayerWidget(devices, "Microphone Rerouter");
+    microphonePlayerWidget = new MicrophonePlayerWidget(engine, "Microphone Rerouter");
     right_vertbox->addWidget(microphonePlayerWidget);
-    mediafilesPlayerWidget1 = new MediaFilesPlayerWidget(devices, "Media Files Player");
+    mediafilesPlayerWidget1 = new MediaFilesPlayerWidget(engine, 0, "Media Files Player");
+    mediafilesPlayerWidget1->setLibrary(library);
     right_vertbox->addWidget(mediafilesPlayerWidget1);
-    mediafilesPlayerWidget2 = new MediaFilesPlayerWidget(devices, "Media Files Player");
+    mediafilesPlayerWidget2 = new MediaFilesPlayerWidget(engine, 1, "Media Files Player");
+    mediafilesPlayerWidget2->setLibrary(library);
     right_vertbox->addWidget(mediafilesPlayerWidget2);
     // Add stretch to stick widgets to the top
     right_vertbox->addStretch();
+
+    /*
+    // Stats:
+    */
+    statsDock = new StatsDock(engine);
+    addDockWidget(Qt::BottomDockWidgetArea, statsDock);
+    statsDock->hide();
+    toolbar->addAction(statsDock->toggleViewAction());
+    // Export for monitoring is opt-in
+    const char *stats_file = std::getenv("OPENSOUNDBOARD_STATS_FILE");
+    if (stats_file)
+    {
+        const char *stats_format = std::getenv("OPENSOUNDBOARD_STATS_FORMAT");
+        try
+        {
+            statsExporter = new StatsExporter(engine, stats_file, StatsExporter::formatOf(stats_format ? stats_format : "json"),
+                                              STATS_EXPORT_INTERVAL);
+        }
+        catch(const std::exception& e)
+        {
+            displayWarning(e.what());
+        }
+    }
+
+#ifdef CONTROL_SOCKET
+    /*
+    // Local control socket and OSC server (players can be triggered by automation scripts and show control):
+    */
+    controlServer = new ControlServer(engine, ControlServer::defaultSocketPath());
+    oscServer = new OscServer(engine, 9000);
+    try
+    {
+        controlServer->start();
+        oscServer->start();
+    }
+    catch(const std::exception& e)
+    {
+        displayWarning(e.what());
+    }
+#endif
 }
 
 
 // Destructor
 MainWindow::~MainWindow()
 {
+#ifdef CONTROL_SOCKET
+    // Stop accepting commands
+    delete oscServer;
+    delete controlServer;
+#endif
+    // Stop following library and keep it for next launch
+    delete libraryScanner;
+    saveLibrary();
+    // Stop reporting device changes
+    delete deviceRegistry;
+    // Stats must be gone before engine they observe
+    delete statsExporter;
+    delete statsDock;
+    // Player widgets and routes must be gone before engine that owns their players
+    delete routingTab;
+    delete microphonePlayerWidget;
+    delete mediafilesPlayerWidget1;
+    delete mediafilesPlayerWidget2;
+    delete engine;
+
+    // Write trace
+    const char *trace_file = std::getenv("OPENSOUNDBOARD_TRACE_FILE");
+    if (trace_file)
+    {
+        Tracer::stop();
+        try
+        {
+            Tracer::dump(trace_file);
+        }
+        catch(const std::exception& e)
+        {
+            #ifdef DEBUG
+            printf("%s\n", e.what());
+            #endif
+        }
+    }
+
     // Free SDL resources
     SDL_Quit();
 }
@@ -150,45 +263,138 @@ void MainWindow::selectDirectory()
     // Check if user discarded selection
     if (dir_or_none.count() != 0)
     {
-        // Clear previous table
-        tracks->clearContents();
+        // Clear previous table (old scanner reports nothing after it is deleted, batches it already posted are
+        // dropped by generation)
+        delete libraryScanner;
+        libraryScanner = nullptr;
+        library->clear();
+        library->setRoot(dir_or_none[0]);
+
+        libraryDirectory = dir_or_none[0].toStdString();
+        startLibraryScanner({});
+    }
+}
+
+
+void MainWindow::loadLibrary()
+{
+    const char *silence_threshold = std::getenv("OPENSOUNDBOARD_SILENCE_THRESHOLD");
+    if (silence_threshold)
+        library->setSilenceThreshold(std::atof(silence_threshold));
+
+    const char *index_path = std::getenv("OPENSOUNDBOARD_LIBRARY_INDEX");
+    if (index_path)
+        libraryIndexPath = index_path;
+    else
+    {
+        QString data_directory = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation);
+        if (data_directory.isEmpty() || !QDir().mkpath(data_directory))
+            return;
+        libraryIndexPath = (data_directory + "/" LIBRARY_INDEX_FILE).toStdString();
+    }
+
+    // Index is mapped, so saved tracks show up without listing or probing anything
+    if (!library->load(libraryIndexPath))
+        return;
+    libraryDirectory = library->getRoot().toStdString();
 
-        // Get media files in that directory and prepair new table
-        QDir directory(dir_or_none[0]);
-        QStringList mediafiles = directory.entryList(QStringList() << "*.mp4" << "*.mp3" << "*.wav" << "*.ogg", QDir::Files);
-        tracks->setRowCount(mediafiles.count());
+    // Scan then only reports what changed while application was not running
+    std::vector<LibraryRecord> records = library->getRecords();
+    std::unordered_map<std::string, FileStamp> known;
+    known.reserve(records.size());
+    for (const LibraryRecord &record : records)
+        known.emplace(record.filepath, FileStamp{record.size, record.modified});
+    startLibraryScanner(std::move(known));
+}
+
+
+void MainWindow::saveLibrary()
+{
+    if (libraryIndexPath.empty() || libraryDirectory.empty())
+        return;
+
+    try
+    {
+        LibraryIndex::write(libraryIndexPath, libraryDirectory, library->getRecords(), library->getSilenceThreshold());
+    }
+    catch(const std::exception& e)
+    {
+        #ifdef DEBUG
+        printf("%s\n", e.what());
+        #endif
+    }
+}
 
-        // Add them to list
-        for (int i = 0; i < mediafiles.count(); i++)
+
+void MainWindow::startLibraryScanner(std::unordered_map<std::string, FileStamp> known)
+{
+    // Whole tree is scanned in background, table fills as media files are found and then follows changes
+    int generation = ++scannerGeneration;
+    libraryScanner = new LibraryScanner(engine->getWorkers());
+    libraryScanner->setChangesCallback([this, generation](const std::vector<LibraryChange> &changes)
+    {
+        QMetaObject::invokeMethod(this, [this, generation, changes]() { onLibraryChanges(generation, changes); },
+                                  Qt::QueuedConnection);
+    });
+    libraryScanner->start(libraryDirectory, std::move(known));
+}
+
+
+void MainWindow::onLibraryChanges(int generation, const std::vector<LibraryChange> &changes)
+{
+    // Batches posted by replaced scanner belong to previous tree
+    if (generation != scannerGeneration)
+        return;
+
+    // Added files come in batches
+    std::vector<LibraryChange> added;
+    for (const LibraryChange &change : changes)
+    {
+        if (change.type == LibraryChange::ADDED)
         {
-            // Create sound widget
-            AudioTrack *sound_item = new AudioTrack(directory.path() + "/" + mediafiles[i]);
-            // Create table item and set its size
-            QTableWidgetItem *table_item = new QTableWidgetItem();
-            table_item->setSizeHint(sound_item->sizeHint());
-            // Add item into table
-            tracks->setItem(i, 0, table_item);
-            tracks->setCellWidget(i, 0, sound_item);
+            added.push_back(change);
+            continue;
         }
+        library->append(added);
+        added.clear();
+
+        if (change.type == LibraryChange::REMOVED)
+            library->remove(QString::fromStdString(change.path), change.isDirectory);
+        else if (change.type == LibraryChange::CHANGED)
+            library->invalidate(QString::fromStdString(change.path), change.size, change.modified);
+        else
+            library->rename(QString::fromStdString(change.oldPath), QString::fromStdString(change.path), change.isDirectory);
     }
+    library->append(added);
 }
 
 
 void MainWindow::updateDevices()
 {
-    microphonePlayerWidget->updateDevices();
-    mediafilesPlayerWidget1->updateDevices();
-    mediafilesPlayerWidget2->updateDevices();
+    // Microphone records from default device until devices are listed
+    SDL_AudioDeviceID device = SDL_AUDIO_DEVICE_DEFAULT_RECORDING;
+    try
+    {
+        device = inputTab->getDevice();
+    }
+    catch(const std::exception&)
+    {
+    }
+    engine->setInputDevice(device);
 }
 
 
 void MainWindow::refreshDevices()
 {
-    // Refresh list of devices in each device tab
-    for (int i=0; i<devices->count(); i++)
-    {
-        ((DeviceTab*)devices->widget(i))->refreshDevices();
-    }
+    // Device tabs are updated as registry reports changes
+    deviceRegistry->refresh();
+
+    engine->updateAudioDevices();
+}
 
-    updateDevices();
+
+void MainWindow::onDeviceChanged(DeviceRegistry::ChangeType type, const DeviceInfo &info)
+{
+    inputTab->changeDevice(type, info);
+    routingTab->changeDevice(type, info);
 }
\ No newline at end of file
@@ -5,6 +5,9 @@
 #include <QtCore/Qt>
 #include <QtCore/QRect>
 #include <QtCore/QString>
+#include <QtCore/QTimer>
+#include <QtCore/QDir>
+#include <QtCore/QStandardPaths>
 // Qt GUI
 #include <QtGui/QScreen>
 #include <QtGui/QAction>
@@ -15,20 +18,38 @@
 #include <QtWidgets/QHeaderView>
 #include <QtWidgets/QToolBar>
 #include <QtWidgets/QFileDialog>
-#include <QtWidgets/QTableWidget>
 #include <QtWidgets/QAbstractItemView>
 #include <QtWidgets/QWidget>
 #include <QtWidgets/QTabWidget>
+#include <QtWidgets/QLineEdit>
 // Message boxes
 #include <WidgetMessageBoxing/WidgetWarning.cpp>
 // Device tab widget
 #include <DeviceTab.hpp>
-// Audio track widget
-#include <AudioTrack.hpp>
+// Routing matrix widget
+#include <RoutingTab.hpp>
+// Track library view
+#include <TrackLibrary/TrackLibraryView.hpp>
+// Library directory scanner
+#include <Library/LibraryScanner.hpp>
+// Saved library
+#include <Library/LibraryIndex.hpp>
 // Microphone rerouter widget
 #include <AudioPlayerWidgets/MicrophonePlayerWidget.hpp>
 // Media files player widget
 #include <AudioPlayerWidgets/MediaFilesPlayerWidget.hpp>
+// Audio engine
+#include <Engine/AudioEngine.hpp>
+// Stats
+#include <StatsDock.hpp>
+#include <Engine/StatsExporter.hpp>
+// Pipeline spans
+#include <Engine/Tracer.hpp>
+// Local control socket
+#ifdef CONTROL_SOCKET
+#include <Control/ControlServer.hpp>
+#include <Control/OscServer.hpp>
+#endif
 
 
 /**
@@ -39,10 +60,43 @@ class MainWindow: public QMainWindow, WidgetWarning
     // Mandatory for QWidget stuff to work
     Q_OBJECT
 
+    // Library tracks.
+    TrackLibraryModel *library = nullptr;
     // List of tracks.
-    QTableWidget *tracks = nullptr;
+    TrackLibraryView *tracks = nullptr;
+    // Filters list of tracks.
+    QLineEdit *searchBox = nullptr;
+    // Scans and watches library directory (nullptr until directory is selected).
+    LibraryScanner *libraryScanner = nullptr;
+    // Number of scanners started (changes of older scanners still queued in event loop are dropped).
+    int scannerGeneration = 0;
+    // Root directory of library (empty until directory is selected).
+    std::string libraryDirectory;
+    // File library is saved to between launches.
+    std::string libraryIndexPath;
     // Devices tab.
     QTabWidget *devices = nullptr;
+    // Input device of microphone rerouter.
+    DeviceTab *inputTab = nullptr;
+    // Routes of players to output devices.
+    RoutingTab *routingTab = nullptr;
+    // Audio devices shared by device tabs.
+    DeviceRegistry *deviceRegistry = nullptr;
+
+    // Audio engine that runs all players.
+    AudioEngine *engine = nullptr;
+    // Stats view.
+    StatsDock *statsDock = nullptr;
+    // Stats file writer (if requested by environment).
+    StatsExporter *statsExporter = nullptr;
+    // Delivers audio device hotplug events.
+    QTimer *deviceEventsTimer = nullptr;
+#ifdef CONTROL_SOCKET
+    // Local control socket.
+    ControlServer *controlServer = nullptr;
+    // Local OSC server.
+    OscServer *oscServer = nullptr;
+#endif
 
     // Microphone player manager.
     MicrophonePlayerWidget *microphonePlayerWidget = nullptr;
@@ -77,12 +131,41 @@ protected:
     void selectDirectory();
 
     /**
-     * Updates list of audio devices in media players.
+     * Shows library saved by previous launch and starts checking it against disk.
+     */
+    void loadLibrary();
+
+    /**
+     * Saves library for next launch.
+     */
+    void saveLibrary();
+
+    /**
+     * Starts scanning and watching library directory (replaces previous scanner).
+     *
+     * @param known files library already shows
+     */
+    void startLibraryScanner(std::unordered_map<std::string, FileStamp> known);
+
+    /**
+     * Applies changes found by library scanner.
+     *
+     * @param generation generation of scanner that found changes (changes of replaced scanner are ignored)
+     */
+    void onLibraryChanges(int generation, const std::vector<LibraryChange> &changes);
+
+    /**
+     * Passes input device selected by user to microphone rerouter.
      */
     void updateDevices();
 
     /**
-     * Updates list of audio devices.
+     * Asks device registry to enumerate audio devices again.
      */
     void refreshDevices();
+
+    /**
+     * Shows change of audio devices in device tabs.
+     */
+    void onDeviceChanged(DeviceRegistry::ChangeType type, const DeviceInfo &info);
 };
\ No newline at end of file
@@ -0,0 +1,196 @@
+#include <RoutingTab.hpp>
+
+
+// Exceptions
+#include <stdexcept>
+
+
+// Largest route gain (percent)
+#define MAX_ROUTE_GAIN 200
+
+
+RoutingTab::RoutingTab(AudioEngine *engine, QWidget *parent) : QWidget(parent)
+{
+    this->engine = engine;
+
+    // One column per source
+    QStringList names;
+    sources.push_back(AudioEngine::MICROPHONE_SOURCE);
+    names << "Microphone";
+    for (int i = 0; i < engine->getVoiceCount(); i++)
+    {
+        sources.push_back(i);
+        names << QString("Player %1").arg(i + 1);
+    }
+
+    // Matrix (rows are filled in by registry)
+    table = new QTableWidget();
+    table->setColumnCount(static_cast<int>(sources.size()));
+    table->setHorizontalHeaderLabels(names);
+    table->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+    table->verticalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+    table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    table->setSelectionMode(QAbstractItemView::NoSelection);
+
+    // Widget layout
+    QVBoxLayout *layout = new QVBoxLayout();
+    layout->addWidget(table);
+    setLayout(layout);
+}
+
+
+void RoutingTab::paintEvent(QPaintEvent *)
+{
+    QStyleOption opt;
+    opt.initFrom(this);
+    QPainter p(this);
+    style()->drawPrimitive(QStyle::PE_Widget, &opt, &p, this);
+}
+
+
+void RoutingTab::changeDevice(DeviceRegistry::ChangeType type, const DeviceInfo &info)
+{
+    if (info.isRecording)
+        return;
+
+    int row = rowOf(info.id);
+    switch (type)
+    {
+        case DeviceRegistry::ADDED:
+        {
+            if (row >= 0)
+                break;
+            addDevice(info);
+
+            // First device plays every source (like default selection of device combobox)
+            if (table->rowCount() == 1)
+            {
+                for (size_t column = 0; column < sources.size(); column++)
+                    routeAt(0, static_cast<int>(column))->setChecked(true);
+            }
+            break;
+        }
+        case DeviceRegistry::CHANGED:
+        {
+            if (row >= 0)
+                table->verticalHeaderItem(row)->setText(QString::fromStdString(info.name));
+            break;
+        }
+        case DeviceRegistry::REMOVED:
+        {
+            if (row < 0)
+                break;
+
+            // Unrouting sources lets engine forget device
+            std::vector<int> moved;
+            for (int column = 0; column < table->columnCount(); column++)
+            {
+                QCheckBox *route = routeAt(row, column);
+                if (!route->isChecked())
+                    continue;
+                route->setChecked(false);
+                moved.push_back(column);
+            }
+            table->removeRow(row);
+
+            // Sources left without devices move to first remaining one
+            if (table->rowCount() == 0)
+                break;
+            for (int column : moved)
+            {
+                bool is_routed = false;
+                for (int r = 0; r < table->rowCount(); r++)
+                    is_routed = is_routed || routeAt(r, column)->isChecked();
+                if (!is_routed)
+                    routeAt(0, column)->setChecked(true);
+            }
+            break;
+        }
+    }
+}
+
+
+int RoutingTab::rowOf(SDL_AudioDeviceID device) const
+{
+    for (int row = 0; row < table->rowCount(); row++)
+    {
+        if (table->verticalHeaderItem(row)->data(Qt::UserRole).toUInt() == device)
+            return row;
+    }
+    return -1;
+}
+
+
+void RoutingTab::addDevice(const DeviceInfo &info)
+{
+    int row = table->rowCount();
+    table->insertRow(row);
+
+    QTableWidgetItem *header = new QTableWidgetItem(QString::fromStdString(info.name));
+    header->setData(Qt::UserRole, static_cast<uint>(info.id));
+    table->setVerticalHeaderItem(row, header);
+
+    for (size_t column = 0; column < sources.size(); column++)
+        table->setCellWidget(row, static_cast<int>(column), createCell(info.id, sources[column]));
+}
+
+
+QWidget* RoutingTab::createCell(SDL_AudioDeviceID device, int source)
+{
+    // Route toggle
+    QCheckBox *route = new QCheckBox();
+    route->setToolTip("Send source to device");
+    // Route gain
+    QSpinBox *gain = new QSpinBox();
+    gain->setRange(0, MAX_ROUTE_GAIN);
+    gain->setValue(100);
+    gain->setSuffix("%");
+    // Route mute (stream stays open)
+    QToolButton *mute = new QToolButton();
+    mute->setText("M");
+    mute->setCheckable(true);
+    mute->setToolTip("Mute route");
+
+    // Any change is passed to engine
+    auto apply = [this, device, source, route, gain, mute]() { applyRoute(device, source, route, gain, mute); };
+    connect(route, &QCheckBox::toggled, this, apply);
+    connect(gain, &QSpinBox::valueChanged, this, apply);
+    connect(mute, &QToolButton::toggled, this, apply);
+
+    QWidget *cell = new QWidget();
+    QHBoxLayout *layout = new QHBoxLayout();
+    layout->setContentsMargins(2, 2, 2, 2);
+    layout->addWidget(route);
+    layout->addWidget(gain);
+    layout->addWidget(mute);
+    cell->setLayout(layout);
+    return cell;
+}
+
+
+QCheckBox* RoutingTab::routeAt(int row, int column) const
+{
+    return table->cellWidget(row, column)->findChild<QCheckBox*>();
+}
+
+
+void RoutingTab::applyRoute(SDL_AudioDeviceID device, int source, QCheckBox *route, QSpinBox *gain, QToolButton *mute)
+{
+    if (!route->isChecked())
+    {
+        engine->removeRoute(source, device);
+        return;
+    }
+
+    try
+    {
+        engine->setRoute(source, device, gain->value() / 100.0f, mute->isChecked());
+    }
+    catch(const std::exception& e)
+    {
+        // Source has too many routes
+        QSignalBlocker blocker(route);
+        route->setChecked(false);
+        displayWarning(e.what());
+    }
+}
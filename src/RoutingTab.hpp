@@ -0,0 +1,92 @@
+#pragma once
+
+
+// Qt core
+#include <QtCore/Qt>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+#include <QtCore/QSignalBlocker>
+// Qt GUI
+#include <QtGui/QPainter>
+// Qt widgets
+#include <QtWidgets/QWidget>
+#include <QtWidgets/QVBoxLayout>
+#include <QtWidgets/QHBoxLayout>
+#include <QtWidgets/QTableWidget>
+#include <QtWidgets/QHeaderView>
+#include <QtWidgets/QCheckBox>
+#include <QtWidgets/QSpinBox>
+#include <QtWidgets/QToolButton>
+// Containers
+#include <vector>
+// Message boxes
+#include <WidgetMessageBoxing/WidgetWarning.cpp>
+// Shared device registry
+#include <SDL/DeviceRegistry.hpp>
+// Audio engine
+#include <Engine/AudioEngine.hpp>
+
+
+/**
+ * Routing matrix tab. Rows are output devices, columns are sources (microphone and media files players),
+ * each cell routes source to device with its own gain and mute.
+ */
+class RoutingTab: public QWidget, WidgetWarning
+{
+    // Mandatory for QWidget stuff to work
+    Q_OBJECT
+
+    // Audio engine that owns routes.
+    AudioEngine *engine = nullptr;
+    // Matrix (vertical header items hold device ID).
+    QTableWidget *table = nullptr;
+    // Source of each column.
+    std::vector<int> sources;
+
+public:
+
+    /**
+     * Constructor.
+     *
+     * @param engine audio engine that owns routes
+     */
+    explicit RoutingTab(AudioEngine *engine, QWidget *parent = nullptr);
+
+    /**
+     * Reimplemented to allow usage of QSS.
+     */
+    void paintEvent(QPaintEvent *) override;
+
+    /**
+     * Applies change reported by device registry (recording devices are ignored). Every source is routed
+     * to first device, sources whose last device is removed move to first remaining one.
+     */
+    void changeDevice(DeviceRegistry::ChangeType type, const DeviceInfo &info);
+
+private:
+
+    /**
+     * @return row of device (-1 if there is none)
+     */
+    int rowOf(SDL_AudioDeviceID device) const;
+
+    /**
+     * Appends row of device.
+     */
+    void addDevice(const DeviceInfo &info);
+
+    /**
+     * Creates cell that routes source to device.
+     */
+    QWidget* createCell(SDL_AudioDeviceID device, int source);
+
+    /**
+     * @return route checkbox of cell
+     */
+    QCheckBox* routeAt(int row, int column) const;
+
+    /**
+     * Passes route of cell to engine.
+     */
+    void applyRoute(SDL_AudioDeviceID device, int source, QCheckBox *route, QSpinBox *gain, QToolButton *mute);
+};
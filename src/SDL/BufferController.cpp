@@ -0,0 +1,80 @@
+#include <SDL/BufferController.hpp>
+
+
+// Min/max
+#include <algorithm>
+
+
+// Initial target (seconds)
+#define BUFFER_START_TIME 0.02
+// Lowest target (seconds)
+#define BUFFER_MIN_TIME 0.005
+// Highest target (seconds)
+#define BUFFER_MAX_TIME 0.5
+// Target multiplier on underrun
+#define BUFFER_GROWTH 1.5
+// Target multiplier after stable period
+#define BUFFER_DECAY 0.9
+// Stable period after which target decays (nanoseconds)
+#define BUFFER_DECAY_TIME 5000000000
+
+
+BufferController::BufferController(int sampleRate)
+{
+    this->sampleRate = sampleRate;
+    minimum = std::max(1, static_cast<int>(BUFFER_MIN_TIME * sampleRate));
+    maximum = static_cast<int>(BUFFER_MAX_TIME * sampleRate);
+    target = static_cast<int>(BUFFER_START_TIME * sampleRate);
+    lastChange = SDL_GetTicksNS();
+}
+
+
+void BufferController::onDeviceRequest(int missing, int requested)
+{
+    if (requested > devicePeriod.load(std::memory_order_relaxed))
+        devicePeriod.store(requested, std::memory_order_relaxed);
+
+    if (missing > 0)
+        registerUnderrun();
+}
+
+
+void BufferController::onWrite(int queued)
+{
+    // Queue ran dry before device noticed
+    if (queued == 0)
+        registerUnderrun();
+    isStarving = false;
+    isArmed = true;
+
+    Uint64 now = SDL_GetTicksNS();
+    int current = target.load(std::memory_order_relaxed);
+    // Target below one device request starves on every pull
+    int floor = std::max(minimum, devicePeriod.load(std::memory_order_relaxed));
+
+    uint64_t count = underruns.load(std::memory_order_relaxed);
+    if (count != handledUnderruns)
+    {
+        handledUnderruns = count;
+        target.store(std::min(maximum, std::max(floor, static_cast<int>(current * BUFFER_GROWTH))), std::memory_order_relaxed);
+        lastChange = now;
+    }
+    else if (now - lastChange >= BUFFER_DECAY_TIME)
+    {
+        target.store(std::min(maximum, std::max(floor, static_cast<int>(current * BUFFER_DECAY))), std::memory_order_relaxed);
+        lastChange = now;
+    }
+}
+
+
+void BufferController::hold()
+{
+    isArmed = false;
+}
+
+
+void BufferController::registerUnderrun()
+{
+    if (isArmed && !isStarving.exchange(true))
+        underruns.fetch_add(1, std::memory_order_relaxed);
+}
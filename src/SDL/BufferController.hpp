@@ -0,0 +1,86 @@
+#pragma once
+
+
+// Atomics
+#include <atomic>
+// Fixed size integers
+#include <cstdint>
+// SDL3
+#include <SDL3/SDL.h>
+
+
+/**
+ * Decides how much audio playback stream should keep queued. Starts from low latency target, grows it
+ * on underruns and decays it back while playback is stable.
+ */
+class BufferController
+{
+    // Sample rate of stream.
+    int sampleRate;
+    // Target bounds in samples.
+    int minimum;
+    int maximum;
+    // Current target in samples.
+    std::atomic<int> target;
+    // Largest amount device has requested at once in samples.
+    std::atomic<int> devicePeriod = 0;
+
+    // Whether audio is expected to flow (false until first write and after intended gaps).
+    std::atomic<bool> isArmed = false;
+    // Whether current underrun was already counted (cleared by next write).
+    std::atomic<bool> isStarving = false;
+    // Number of underruns.
+    std::atomic<uint64_t> underruns = 0;
+
+    // Underruns target was already adjusted for (writer thread only).
+    uint64_t handledUnderruns = 0;
+    // Time of last target change in SDL nanosecond ticks (writer thread only).
+    Uint64 lastChange = 0;
+
+public:
+
+    /**
+     * Constructor.
+     *
+     * @param sampleRate sample rate of stream
+     */
+    explicit BufferController(int sampleRate);
+
+    /**
+     * @return current target in samples
+     */
+    int getTarget() const { return target.load(std::memory_order_relaxed); }
+    /**
+     * @return current target in seconds
+     */
+    double getTargetLatency() const { return static_cast<double>(getTarget()) / sampleRate; }
+    /**
+     * @return number of underruns
+     */
+    uint64_t getUnderruns() const { return underruns.load(std::memory_order_relaxed); }
+
+    /**
+     * Called from device thread when device pulls audio.
+     *
+     * @param missing amount device needs that is not queued in samples
+     * @param requested amount device requests in samples
+     */
+    void onDeviceRequest(int missing, int requested);
+    /**
+     * Called by writer before audio is queued. Adjusts target.
+     *
+     * @param queued amount queued before write in samples
+     */
+    void onWrite(int queued);
+    /**
+     * Tells that upcoming gap in audio is intended (pause, seek, end of data).
+     */
+    void hold();
+
+private:
+
+    /**
+     * Counts underrun once per starvation.
+     */
+    void registerUnderrun();
+};
@@ -0,0 +1,234 @@
+#include <SDL/DeviceRegistry.hpp>
+
+
+// Exceptions
+#include <stdexcept>
+// Search
+#include <algorithm>
+// Pipeline spans
+#include <Engine/Tracer.hpp>
+
+
+DeviceRegistry::~DeviceRegistry()
+{
+    if (!thread.joinable())
+        return;
+
+    SDL_RemoveEventWatch(onDeviceEvent, this);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        isRunning = false;
+    }
+    condition.notify_one();
+    thread.join();
+}
+
+
+void DeviceRegistry::setChangeCallback(ChangeCallback callback)
+{
+    changeCallback = callback;
+}
+
+
+void DeviceRegistry::start()
+{
+    isRunning = true;
+    mustRescan = true;
+    thread = std::thread(&DeviceRegistry::process, this);
+    SDL_AddEventWatch(onDeviceEvent, this);
+}
+
+
+void DeviceRegistry::refresh()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        mustRescan = true;
+    }
+    condition.notify_one();
+}
+
+
+std::vector<DeviceInfo> DeviceRegistry::getDevices(bool isRecording) const
+{
+    std::vector<DeviceInfo> result;
+    std::lock_guard<std::mutex> lock(devicesMutex);
+    for (const DeviceInfo &info : devices)
+    {
+        if (info.isRecording == isRecording)
+            result.push_back(info);
+    }
+    return result;
+}
+
+
+DeviceInfo DeviceRegistry::describe(SDL_AudioDeviceID device, bool isRecording)
+{
+    DeviceInfo info;
+    info.id = device;
+    info.isRecording = isRecording;
+
+    const char *name = SDL_GetAudioDeviceName(device);
+    if (!name)
+        throw std::runtime_error("Audio devices: unknown device " + std::to_string(device));
+    info.name = name;
+
+    // Format is still worth showing without buffer size
+    if (!SDL_GetAudioDeviceFormat(device, &info.format, &info.bufferFrames))
+        info.bufferFrames = 0;
+
+    return info;
+}
+
+
+bool SDLCALL DeviceRegistry::onDeviceEvent(void *userdata, SDL_Event *event)
+{
+    if ((event->type != SDL_EVENT_AUDIO_DEVICE_ADDED) && (event->type != SDL_EVENT_AUDIO_DEVICE_REMOVED) &&
+        (event->type != SDL_EVENT_AUDIO_DEVICE_FORMAT_CHANGED))
+        return true;
+
+    DeviceRegistry *registry = static_cast<DeviceRegistry*>(userdata);
+    {
+        std::lock_guard<std::mutex> lock(registry->mutex);
+        registry->events.push_back({event->type, event->adevice.which, event->adevice.recording});
+    }
+    registry->condition.notify_one();
+    return true;
+}
+
+
+void DeviceRegistry::process()
+{
+    Tracer::setThreadName("devices");
+
+    std::vector<PendingEvent> received;
+    while (true)
+    {
+        bool must_rescan;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this]() { return !isRunning || mustRescan || !events.empty(); });
+            if (!isRunning)
+                return;
+            must_rescan = mustRescan;
+            mustRescan = false;
+            received.swap(events);
+        }
+
+        // Full enumeration already covers events received before it
+        if (must_rescan)
+            rescan();
+        else
+        {
+            for (const PendingEvent &event : received)
+                handle(event);
+        }
+        received.clear();
+    }
+}
+
+
+void DeviceRegistry::rescan()
+{
+    TraceSpan span("device scan");
+
+    for (bool is_recording : {false, true})
+    {
+        int count = 0;
+        SDL_AudioDeviceID *ids = is_recording ? SDL_GetAudioRecordingDevices(&count) : SDL_GetAudioPlaybackDevices(&count);
+        std::vector<SDL_AudioDeviceID> present(ids, ids + (ids ? count : 0));
+        SDL_free(ids);
+
+        // Report devices that are gone
+        for (const DeviceInfo &known : getDevices(is_recording))
+        {
+            DeviceInfo info;
+            if ((std::find(present.begin(), present.end(), known.id) == present.end()) && forget(known.id, info))
+                signalChange(REMOVED, info);
+        }
+
+        // Report new devices and known ones whose format has changed
+        for (SDL_AudioDeviceID device : present)
+        {
+            try
+            {
+                DeviceInfo info = describe(device, is_recording);
+                ChangeType type;
+                if (store(info, type))
+                    signalChange(type, info);
+            }
+            catch(const std::exception&)
+            {
+                // Device was removed while being described, its event follows
+            }
+        }
+    }
+}
+
+
+void DeviceRegistry::handle(const PendingEvent &event)
+{
+    if (event.type == SDL_EVENT_AUDIO_DEVICE_REMOVED)
+    {
+        DeviceInfo info;
+        if (forget(event.device, info))
+            signalChange(REMOVED, info);
+        return;
+    }
+
+    try
+    {
+        DeviceInfo info = describe(event.device, event.isRecording);
+        ChangeType type;
+        if (store(info, type))
+            signalChange(type, info);
+    }
+    catch(const std::exception&)
+    {
+        // Device is already gone
+    }
+}
+
+
+bool DeviceRegistry::store(const DeviceInfo &info, ChangeType &type)
+{
+    std::lock_guard<std::mutex> lock(devicesMutex);
+    for (DeviceInfo &known : devices)
+    {
+        if (known.id == info.id)
+        {
+            bool is_changed = (known.name != info.name) || (known.bufferFrames != info.bufferFrames) ||
+                              (known.format.format != info.format.format) || (known.format.channels != info.format.channels) ||
+                              (known.format.freq != info.format.freq);
+            known = info;
+            type = CHANGED;
+            return is_changed;
+        }
+    }
+    devices.push_back(info);
+    type = ADDED;
+    return true;
+}
+
+
+bool DeviceRegistry::forget(SDL_AudioDeviceID device, DeviceInfo &info)
+{
+    std::lock_guard<std::mutex> lock(devicesMutex);
+    for (size_t i = 0; i < devices.size(); i++)
+    {
+        if (devices[i].id == device)
+        {
+            info = devices[i];
+            devices.erase(devices.begin() + i);
+            return true;
+        }
+    }
+    return false;
+}
+
+
+void DeviceRegistry::signalChange(ChangeType type, const DeviceInfo &info)
+{
+    if (changeCallback)
+        changeCallback(type, info);
+}
@@ -0,0 +1,174 @@
+#pragma once
+
+
+// Strings
+#include <string>
+// Containers
+#include <vector>
+// Functions
+#include <functional>
+// Threads
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+// SDL3
+#include <SDL3/SDL.h>
+
+
+/**
+ * Cached info about audio device.
+ */
+struct DeviceInfo
+{
+    // Device ID.
+    SDL_AudioDeviceID id = 0;
+    // Whether device records audio.
+    bool isRecording = false;
+    // Device name.
+    std::string name;
+    // Native format.
+    SDL_AudioSpec format = {};
+    // Preferred buffer size in sample frames (0 if unknown).
+    int bufferFrames = 0;
+};
+
+
+/**
+ * Keeps list of audio devices shared by all device views. Devices are enumerated on registry thread,
+ * which then follows SDL device events (delivered while SDL events are pumped) and reports every change.
+ */
+class DeviceRegistry
+{
+public:
+
+    /**
+     * Describes change of device list.
+     */
+    enum ChangeType
+    {
+        ADDED,
+        REMOVED,
+        // Native format of device has changed.
+        CHANGED
+    };
+
+    /**
+     * Receives change and info about device it concerns (called from registry thread).
+     */
+    typedef std::function<void(ChangeType, const DeviceInfo&)> ChangeCallback;
+
+private:
+
+    /**
+     * Device event waiting to be handled.
+     */
+    struct PendingEvent
+    {
+        // SDL event type.
+        Uint32 type;
+        // Device ID.
+        SDL_AudioDeviceID device;
+        // Whether device records audio.
+        bool isRecording;
+    };
+
+    // Known devices.
+    std::vector<DeviceInfo> devices;
+    // Guards devices.
+    mutable std::mutex devicesMutex;
+
+    // Notified about changes.
+    ChangeCallback changeCallback;
+
+    // Registry thread.
+    std::thread thread;
+    // Whether thread should run.
+    bool isRunning = false;
+    // Whether all devices must be enumerated again.
+    bool mustRescan = false;
+    // Device events received since thread last woke up.
+    std::vector<PendingEvent> events;
+    // Guards isRunning, mustRescan and events.
+    std::mutex mutex;
+    // Wakes thread up.
+    std::condition_variable condition;
+
+public:
+
+    /**
+     * Destructor. Stops registry thread.
+     */
+    ~DeviceRegistry();
+
+    /**
+     * @param callback function that will receive changes (must be set before start)
+     */
+    void setChangeCallback(ChangeCallback callback);
+
+    /**
+     * Starts enumerating devices and following device events in background.
+     */
+    void start();
+
+    /**
+     * Asks registry thread to enumerate all devices again.
+     */
+    void refresh();
+
+    /**
+     * @return known devices of given direction
+     */
+    std::vector<DeviceInfo> getDevices(bool isRecording) const;
+
+    /**
+     * Queries device info from SDL (blocks on audio backend).
+     *
+     * @throws Runtime Error if device is unknown to SDL.
+     */
+    static DeviceInfo describe(SDL_AudioDeviceID device, bool isRecording);
+
+private:
+
+    /**
+     * Collects device events (called from thread that pumps SDL events).
+     */
+    static bool SDLCALL onDeviceEvent(void *userdata, SDL_Event *event);
+
+    /**
+     * Registry thread body.
+     */
+    void process();
+
+    /**
+     * Enumerates devices and reports difference with known ones.
+     */
+    void rescan();
+
+    /**
+     * Updates known devices with device event and reports change.
+     */
+    void handle(const PendingEvent &event);
+
+    /**
+     * Adds device to known ones, or updates it if it is already known.
+     *
+     * @param type receives kind of change
+     *
+     * @return whether anything has changed
+     */
+    bool store(const DeviceInfo &info, ChangeType &type);
+
+    /**
+     * Removes device from known ones.
+     *
+     * @param info receives removed device
+     *
+     * @return whether device was known
+     */
+    bool forget(SDL_AudioDeviceID device, DeviceInfo &info);
+
+    /**
+     * Reports change.
+     */
+    void signalChange(ChangeType type, const DeviceInfo &info);
+};
@@ -1,153 +1,301 @@
-#ifndef DEVICE_STREAM
-#define DEVICE_STREAM
+#include <SDL/DeviceStream.hpp>
 
 
 // Exceptions
 #include <stdexcept>
-// SDL3
-#include <SDL3/SDL.h>
+// Containers
+#include <vector>
+// Threads
+#include <mutex>
+// Pipeline spans
+#include <Engine/Tracer.hpp>
 
 
 /**
- * Stores SDL device stream.
+ * Device opened once for all playback streams of requested device.
  */
-class DeviceStream
-{
-    // Device stream.
-    SDL_AudioStream *audio_stream = nullptr;
-    // Device audio format
-    SDL_AudioSpec audio_format;
-
-public:
-    /**
-     * Constructor. Inits and starts audio stream with native format.
-     */
-    DeviceStream(SDL_AudioDeviceID device_id)
+struct SharedDevice
+{
+    // Device streams were requested on.
+    SDL_AudioDeviceID device;
+    // Opened device streams are bound to.
+    SDL_AudioDeviceID shared;
+    // Number of bound streams.
+    int streams;
+};
+
+// Devices opened for playback streams.
+static std::vector<SharedDevice> sharedDevices;
+// Guards sharedDevices (streams are opened and deleted on worker threads).
+static std::mutex sharedDevicesMutex;
+
+
+DeviceStream::DeviceStream(SDL_AudioDeviceID device_id)
+{
+    // Playback stream joins shared device with its native format
+    if (SDL_IsAudioDevicePlayback(device_id))
     {
-        // Init audio stream with native (for selected device) format
-        audio_stream = SDL_OpenAudioDeviceStream(device_id, NULL, NULL, NULL);
-        // Proceed or throw
-        if (audio_stream)
-        {
-            // Get audio format
-            SDL_GetAudioStreamFormat(audio_stream, NULL, &audio_format);
-            // Start audio stream
-            SDL_ResumeAudioStreamDevice(audio_stream);
-        }
-        else
-        {
-            throw std::runtime_error("Audio device: unable to create stream");
-        }
+        bindToDevice(device_id, nullptr);
+        startBuffering(device_id);
+        return;
     }
 
-    /**
-     * Constructor. Inits and starts audio stream with provided format.
-     */
-    DeviceStream(SDL_AudioDeviceID device_id, SDL_AudioSpec audio_format)
+    // Init audio stream with native (for selected device) format
+    audio_stream = SDL_OpenAudioDeviceStream(device_id, NULL, NULL, NULL);
+    // Proceed or throw
+    if (audio_stream)
     {
-        // Save audio format
-        this->audio_format = audio_format;
-        // Init audio stream with provided format
-        audio_stream = SDL_OpenAudioDeviceStream(device_id, &this->audio_format, NULL, NULL);
-        // Proceed or throw
-        if (audio_stream)
-        {
-            // Start audio stream
-            SDL_ResumeAudioStreamDevice(audio_stream);
-        }
-        else
-        {
-            throw std::runtime_error("Audio device: unable to create stream");
-        }
+        // Get audio format
+        SDL_GetAudioStreamFormat(audio_stream, NULL, &audio_format);
+        // Start audio stream
+        SDL_ResumeAudioStreamDevice(audio_stream);
     }
-
-    /**
-     * Destructor. Closes and frees audio stream.
-     */
-    ~DeviceStream()
+    else
     {
-        // Destroy audio stream
-        SDL_DestroyAudioStream(audio_stream);
+        throw std::runtime_error("Audio device: unable to create stream");
     }
+}
 
-    /**
-     * @return audio stream
-     */
-    SDL_AudioStream* stream()
+
+DeviceStream::DeviceStream(SDL_AudioDeviceID device_id, SDL_AudioSpec audio_format)
+{
+    // Save audio format
+    this->audio_format = audio_format;
+
+    // Playback stream joins shared device
+    if (SDL_IsAudioDevicePlayback(device_id))
     {
-        return audio_stream;
+        bindToDevice(device_id, &this->audio_format);
+        startBuffering(device_id);
+        return;
     }
 
-    /**
-     * @return audio format
-     */
-    SDL_AudioSpec format() const
+    // Init audio stream with provided format
+    audio_stream = SDL_OpenAudioDeviceStream(device_id, &this->audio_format, NULL, NULL);
+    // Proceed or throw
+    if (audio_stream)
+    {
+        // Start audio stream
+        SDL_ResumeAudioStreamDevice(audio_stream);
+    }
+    else
     {
-        return audio_format;
+        throw std::runtime_error("Audio device: unable to create stream");
     }
+}
+
+
+DeviceStream::~DeviceStream()
+{
+    // Destroy audio stream (device callback is gone after that and shared blocks are released)
+    SDL_DestroyAudioStream(audio_stream);
+    if (sharedDevice)
+        releaseDevice(sharedDevice);
+    delete bufferController;
+}
+
+
+bool DeviceStream::isEmpty()
+{
+    return SDL_GetAudioStreamQueued(audio_stream) == 0;
+}
+
+
+int DeviceStream::queued()
+{
+    return SDL_GetAudioStreamQueued(audio_stream) / SDL_AUDIO_FRAMESIZE(audio_format);
+}
+
+
+bool DeviceStream::isReadyForWrite()
+{
+    return !bufferController || (queued() < bufferController->getTarget());
+}
+
+
+int DeviceStream::targetSize() const
+{
+    return bufferController ? bufferController->getTarget() : 0;
+}
+
+
+uint64_t DeviceStream::underruns() const
+{
+    return bufferController ? bufferController->getUnderruns() : 0;
+}
+
+
+void DeviceStream::hold()
+{
+    if (bufferController)
+        bufferController->hold();
+}
+
+
+void DeviceStream::volume(float value)
+{
+    SDL_SetAudioStreamGain(audio_stream, value);
+}
+
 
-    /**
-     * @return whether stream has no audio data in queue
-     */
-    bool isEmpty()
+int DeviceStream::read(void *buffer, int size)
+{
+    int frame_size = SDL_AUDIO_FRAMESIZE(audio_format);
+    // If have enough data
+    if (SDL_GetAudioStreamAvailable(audio_stream) >= size * frame_size)
     {
-        return SDL_GetAudioStreamQueued(audio_stream) == 0;
+        // Read
+        int bytes = SDL_GetAudioStreamData(audio_stream, buffer, size * frame_size);
+        return (bytes > 0) ? bytes / frame_size : 0;
     }
+    return 0;
+}
+
+
+void DeviceStream::write(const void *buffer, int size)
+{
+    // Send data
+    TraceSpan span("device write");
+    if (bufferController)
+        bufferController->onWrite(queued());
+    SDL_PutAudioStreamData(audio_stream, buffer, size * SDL_AUDIO_FRAMESIZE(audio_format));
+}
+
 
-    /**
-     * @return whether stream is ready to recieve audio
-     */
-    bool isReadyForWrite(int size)
+void DeviceStream::writeShared(std::shared_ptr<const void> owner, const void *buffer, int size)
+{
+#if SDL_VERSION_ATLEAST(3, 4, 0)
+    releaseSharedBlocks();
+    if (sharedBlocksHead - sharedBlocksTail < SHARED_BLOCK_COUNT)
     {
-        // Limit size by factor 3 from standard buffer size of 1024
-        # define MAX_AUDIO_BUFFER_SIZE 8*1024
-        return (size * SDL_AUDIO_FRAMESIZE(audio_format)) < (MAX_AUDIO_BUFFER_SIZE * SDL_AUDIO_FRAMESIZE(audio_format) - SDL_GetAudioStreamQueued(audio_stream));
+        TraceSpan span("device write");
+        if (bufferController)
+            bufferController->onWrite(queued());
+
+        // SDL references data until device consumes it
+        int bytes = size * SDL_AUDIO_FRAMESIZE(audio_format);
+        SharedBlock &block = sharedBlocks[sharedBlocksHead % SHARED_BLOCK_COUNT];
+        block.owner = std::move(owner);
+        block.isDone.store(false, std::memory_order_relaxed);
+        sharedBlocksHead++;
+        if (SDL_PutAudioStreamDataNoCopy(audio_stream, buffer, bytes, onSharedBlockDone, &block))
+            return;
+
+        // Block is released with next write, audio is copied instead of being lost
+        block.isDone.store(true, std::memory_order_release);
+        SDL_PutAudioStreamData(audio_stream, buffer, bytes);
+        return;
     }
+#endif
+    write(buffer, size);
+}
+
+
+void DeviceStream::flush()
+{
+    // Stream is expected to run dry now
+    hold();
+    SDL_FlushAudioStream(audio_stream);
+}
+
+
+void DeviceStream::clear()
+{
+    SDL_ClearAudioStream(audio_stream);
+}
+
 
-    /**
-     * Sets current volume of stream
-     */
-    void volume(float value)
+void DeviceStream::bindToDevice(SDL_AudioDeviceID device_id, const SDL_AudioSpec *format)
+{
+    sharedDevice = acquireDevice(device_id);
+
+    // Stream converts written audio to format of device, device mixes all streams bound to it
+    SDL_AudioSpec device_format;
+    if (SDL_GetAudioDeviceFormat(sharedDevice, &device_format, NULL))
     {
-        SDL_SetAudioStreamGain(audio_stream, value);
+        if (!format)
+            audio_format = device_format;
+        audio_stream = SDL_CreateAudioStream(&audio_format, &device_format);
+        if (audio_stream && SDL_BindAudioStream(sharedDevice, audio_stream))
+            return;
     }
 
-    /**
-     * Reads audio data from stream.
-     * 
-     * @param buffer audio data buffer
-     * @param size size of data in samples
-     */
-    void read(void *buffer, int size)
+    SDL_DestroyAudioStream(audio_stream);
+    audio_stream = nullptr;
+    releaseDevice(sharedDevice);
+    sharedDevice = 0;
+    throw std::runtime_error("Audio device: unable to create stream");
+}
+
+
+SDL_AudioDeviceID DeviceStream::acquireDevice(SDL_AudioDeviceID device_id)
+{
+    std::lock_guard<std::mutex> lock(sharedDevicesMutex);
+    for (SharedDevice &device : sharedDevices)
     {
-        // If have enough data
-        if (SDL_GetAudioStreamQueued(audio_stream) >= size)
+        if (device.device == device_id)
         {
-            // Read
-            SDL_GetAudioStreamData(audio_stream, buffer, size * SDL_AUDIO_FRAMESIZE(audio_format));
+            device.streams++;
+            return device.shared;
         }
     }
 
-    /**
-     * Writes audio data to stream.
-     * 
-     * @param buffer audio data buffer
-     * @param size size of data in samples
-     */
-    void write(const void *buffer, int size)
+    SDL_AudioDeviceID shared = SDL_OpenAudioDevice(device_id, NULL);
+    if (!shared)
+        throw std::runtime_error("Audio device: unable to open device");
+    sharedDevices.push_back({device_id, shared, 1});
+    return shared;
+}
+
+
+void DeviceStream::releaseDevice(SDL_AudioDeviceID shared)
+{
+    std::lock_guard<std::mutex> lock(sharedDevicesMutex);
+    for (size_t i = 0; i < sharedDevices.size(); i++)
     {
-        // Send data
-        SDL_PutAudioStreamData(audio_stream, buffer, size * SDL_AUDIO_FRAMESIZE(audio_format));
+        if ((sharedDevices[i].shared != shared) || (--sharedDevices[i].streams > 0))
+            continue;
+
+        SDL_CloseAudioDevice(shared);
+        sharedDevices.erase(sharedDevices.begin() + i);
+        return;
     }
+}
+
 
-    /**
-     * Flushes stream indicating end of data
-     */
-    void flush()
+void DeviceStream::startBuffering(SDL_AudioDeviceID device_id)
+{
+    if (!SDL_IsAudioDevicePlayback(device_id))
+        return;
+
+    bufferController = new BufferController(audio_format.freq);
+    SDL_SetAudioStreamGetCallback(audio_stream, onDeviceRequest, this);
+}
+
+
+void SDLCALL DeviceStream::onDeviceRequest(void *userdata, SDL_AudioStream *, int additional_amount, int total_amount)
+{
+    DeviceStream *self = static_cast<DeviceStream*>(userdata);
+    int frame_size = SDL_AUDIO_FRAMESIZE(self->audio_format);
+    self->bufferController->onDeviceRequest(additional_amount / frame_size, total_amount / frame_size);
+}
+
+
+void DeviceStream::releaseSharedBlocks()
+{
+    // Device consumes blocks in order they were queued
+    while (sharedBlocksTail != sharedBlocksHead)
     {
-        SDL_FlushAudioStream(audio_stream);
+        SharedBlock &block = sharedBlocks[sharedBlocksTail % SHARED_BLOCK_COUNT];
+        if (!block.isDone.load(std::memory_order_acquire))
+            break;
+        block.owner.reset();
+        sharedBlocksTail++;
     }
-};
+}
 
 
-#endif // DEVICE_STREAM
\ No newline at end of file
+void SDLCALL DeviceStream::onSharedBlockDone(void *userdata, const void *, int)
+{
+    static_cast<SharedBlock*>(userdata)->isDone.store(true, std::memory_order_release);
+}
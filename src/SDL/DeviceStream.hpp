@@ -0,0 +1,197 @@
+#pragma once
+
+
+// Fixed size integers
+#include <cstdint>
+// Owners of shared audio data
+#include <memory>
+// Threads
+#include <atomic>
+// SDL3
+#include <SDL3/SDL.h>
+// Adaptive buffering
+#include <SDL/BufferController.hpp>
+
+
+// Number of shared audio blocks stream can reference at once
+#define SHARED_BLOCK_COUNT 64
+
+
+/**
+ * Stores SDL device stream. Playback streams are bound to device that is opened once for all of them
+ * (SDL mixes them), recording streams open their own device.
+ */
+class DeviceStream
+{
+    /**
+     * Audio data queued without copy.
+     */
+    struct SharedBlock
+    {
+        // Keeps data alive while it is queued.
+        std::shared_ptr<const void> owner;
+        // Raised by SDL once data is no longer needed.
+        std::atomic<bool> isDone = true;
+    };
+
+    // Device stream.
+    SDL_AudioStream *audio_stream = nullptr;
+    // Shared device playback stream is bound to (0 for recording stream).
+    SDL_AudioDeviceID sharedDevice = 0;
+    // Device audio format
+    SDL_AudioSpec audio_format;
+    // Queue target of playback stream (nullptr for recording stream).
+    BufferController *bufferController = nullptr;
+    // Shared audio blocks (ring, owners are released by writing thread).
+    SharedBlock sharedBlocks[SHARED_BLOCK_COUNT];
+    // Number of blocks ever queued.
+    uint64_t sharedBlocksHead = 0;
+    // Number of blocks ever released.
+    uint64_t sharedBlocksTail = 0;
+
+public:
+    /**
+     * Constructor. Inits and starts audio stream with native format.
+     */
+    explicit DeviceStream(SDL_AudioDeviceID device_id);
+
+    /**
+     * Constructor. Inits and starts audio stream with provided format.
+     */
+    DeviceStream(SDL_AudioDeviceID device_id, SDL_AudioSpec audio_format);
+
+    /**
+     * Destructor. Closes and frees audio stream.
+     */
+    ~DeviceStream();
+
+    /**
+     * @return audio stream
+     */
+    SDL_AudioStream* stream()
+    {
+        return audio_stream;
+    }
+
+    /**
+     * @return audio format
+     */
+    SDL_AudioSpec format() const
+    {
+        return audio_format;
+    }
+
+    /**
+     * @return whether stream has no audio data in queue
+     */
+    bool isEmpty();
+
+    /**
+     * @return size of audio data in queue in samples
+     */
+    int queued();
+
+    /**
+     * @return whether playback stream has less audio queued than its target
+     */
+    bool isReadyForWrite();
+
+    /**
+     * @return amount of audio playback stream keeps queued in samples (0 for recording stream)
+     */
+    int targetSize() const;
+
+    /**
+     * @return number of times playback stream ran dry while audio was expected
+     */
+    uint64_t underruns() const;
+
+    /**
+     * Tells that upcoming gap in written audio is intended (pause, seek), so it is not counted as underrun.
+     */
+    void hold();
+
+    /**
+     * Sets current volume of stream
+     */
+    void volume(float value);
+
+    /**
+     * Reads audio data from stream.
+     * 
+     * @param buffer audio data buffer
+     * @param size size of data in samples
+     * 
+     * @return number of samples read (0 if stream has less than requested)
+     */
+    int read(void *buffer, int size);
+
+    /**
+     * Writes audio data to stream.
+     * 
+     * @param buffer audio data buffer
+     * @param size size of data in samples
+     */
+    void write(const void *buffer, int size);
+
+    /**
+     * Writes immutable audio data to stream without copying it. Stream keeps owner alive until device has
+     * consumed data. Data is copied when SDL has no such queue (before 3.4) or too many blocks are queued.
+     *
+     * @param owner keeps audio data buffer alive
+     * @param buffer audio data buffer (must not change while owner lives)
+     * @param size size of data in samples
+     */
+    void writeShared(std::shared_ptr<const void> owner, const void *buffer, int size);
+
+    /**
+     * Flushes stream indicating end of data
+     */
+    void flush();
+
+    /**
+     * Drops audio data in queue (stream stays bound to device).
+     */
+    void clear();
+
+private:
+
+    /**
+     * Creates playback stream bound to shared device.
+     *
+     * @param format format of written audio (nullptr for native format of device)
+     */
+    void bindToDevice(SDL_AudioDeviceID device_id, const SDL_AudioSpec *format);
+
+    /**
+     * @return device opened for all playback streams of given device (opens it for first stream)
+     *
+     * @throws Runtime Error if device could not be opened.
+     */
+    static SDL_AudioDeviceID acquireDevice(SDL_AudioDeviceID device_id);
+
+    /**
+     * Closes shared device once its last stream is gone.
+     */
+    static void releaseDevice(SDL_AudioDeviceID shared);
+
+    /**
+     * Creates queue target if stream plays to device.
+     */
+    void startBuffering(SDL_AudioDeviceID device_id);
+
+    /**
+     * Reports device pulls to queue target (called from SDL device thread).
+     */
+    static void SDLCALL onDeviceRequest(void *userdata, SDL_AudioStream *stream, int additional_amount, int total_amount);
+
+    /**
+     * Releases owners of consumed blocks.
+     */
+    void releaseSharedBlocks();
+
+    /**
+     * Marks shared block as consumed (called from SDL device thread, or whoever clears stream).
+     */
+    static void SDLCALL onSharedBlockDone(void *userdata, const void *buffer, int size);
+};
@@ -1,103 +1,41 @@
-#ifndef DEVICES_LIST
-#define DEVICES_LIST
+#include <SDL/DevicesList.hpp>
 
 
-// SDL3
-#include <SDL3/SDL.h>
-
-
-/**
- * Stores SDL devices list.
- */
-class DevicesList
+DevicesList::DevicesList(DeviceType device_type)
 {
-public:
-    /**
-     * Describes audio device type.
-     */ 
-    enum DeviceType
-    {
-        INPUT,
-        OUTPUT
-    };
+    // Save device type
+    this->device_type = device_type;
+}
 
-private:
-    // Device type.
-    DeviceType device_type;
 
-    // Audio devices list
-    SDL_AudioDeviceID* devices = nullptr;
-    // Audio devices count
-    int devices_count = 0;
-
-public:
-    /**
-     * Constructor. Inits SDL devices list.
-     */
-    DevicesList(DeviceType device_type)
-    {
-        // Save device type
-        this->device_type = device_type;
-    }
+DevicesList::~DevicesList()
+{
+    if (devices)
+        SDL_free(devices);
+}
 
-    /**
-     * Destructor. Clears SDL devices list.
-     */
-    ~DevicesList()
-    {
-        if (devices)
-            SDL_free(devices);
-    }
 
-    /**
-     * @return audio devices type
-     */
-    DeviceType type()
+void DevicesList::refresh()
+{
+    // Free old list
+    if (devices)
     {
-        return device_type;
+        devices_count = 0;
+        SDL_free(devices);
     }
 
-    void refresh()
+    // Create new list depending on type
+    switch (device_type)
     {
-        // Free old list
-        if (devices)
+        case INPUT:
         {
-            devices_count = 0;
-            SDL_free(devices);
+            devices = SDL_GetAudioRecordingDevices(&devices_count);
+            break;
         }
-
-        // Create new list depending on type
-        switch (device_type)
+        case OUTPUT:
         {
-            case INPUT:
-            {
-                devices = SDL_GetAudioRecordingDevices(&devices_count);
-                break;
-            }
-            case OUTPUT:
-            {
-                devices = SDL_GetAudioPlaybackDevices(&devices_count);
-                break;
-            }
+            devices = SDL_GetAudioPlaybackDevices(&devices_count);
+            break;
         }
     }
-
-    /**
-     * @return audio devices count
-     */
-    int count() const
-    {
-        return devices_count;
-    }
-
-    /**
-     * @return audio device ID
-     */
-    SDL_AudioDeviceID get(int index)
-    {
-        return devices[index];
-    }
-};
-
-
-#endif // DEVICES_LIST
\ No newline at end of file
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+
+// SDL3
+#include <SDL3/SDL.h>
+
+
+/**
+ * Stores SDL devices list.
+ */
+class DevicesList
+{
+public:
+    /**
+     * Describes audio device type.
+     */ 
+    enum DeviceType
+    {
+        INPUT,
+        OUTPUT
+    };
+
+private:
+    // Device type.
+    DeviceType device_type;
+
+    // Audio devices list
+    SDL_AudioDeviceID* devices = nullptr;
+    // Audio devices count
+    int devices_count = 0;
+
+public:
+    /**
+     * Constructor. Inits SDL devices list.
+     */
+    explicit DevicesList(DeviceType device_type);
+
+    /**
+     * Destructor. Clears SDL devices list.
+     */
+    ~DevicesList();
+
+    /**
+     * @return audio devices type
+     */
+    DeviceType type()
+    {
+        return device_type;
+    }
+
+    /**
+     * Requeries list of devices from SDL.
+     */
+    void refresh();
+
+    /**
+     * @return audio devices count
+     */
+    int count() const
+    {
+        return devices_count;
+    }
+
+    /**
+     * @return audio device ID
+     */
+    SDL_AudioDeviceID get(int index)
+    {
+        return devices[index];
+    }
+};
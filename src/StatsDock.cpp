@@ -0,0 +1,99 @@
+#include <StatsDock.hpp>
+
+
+// Refresh period of stats (milliseconds)
+#define STATS_REFRESH_TIME 1000
+
+
+StatsDock::StatsDock(AudioEngine *engine, QWidget *parent) : QDockWidget("Stats", parent), collector(engine)
+{
+    // Table
+    table = new QTableWidget();
+    table->setColumnCount(2);
+    table->setHorizontalHeaderLabels(QStringList() << "Stat" << "Value");
+    table->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+    table->verticalHeader()->setVisible(false);
+    table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    table->setSelectionMode(QAbstractItemView::NoSelection);
+    setWidget(table);
+
+    // Collecting costs nothing while nobody looks
+    timer = new QTimer(this);
+    timer->setInterval(STATS_REFRESH_TIME);
+    connect(timer, &QTimer::timeout, this, &StatsDock::refresh);
+    connect(this, &QDockWidget::visibilityChanged, this, [this](bool visible)
+    {
+        if (visible)
+        {
+            refresh();
+            timer->start();
+        }
+        else
+            timer->stop();
+    });
+}
+
+
+void StatsDock::refresh()
+{
+    StatsCollector::Report report = collector.collect();
+    table->setRowCount(0);
+
+    // Audio thread
+    const AudioEngine::AudioThreadStats &audio = report.audio;
+    QString scheduling = QString("%1 %2").arg(audio.scheduling.policy.c_str()).arg(audio.scheduling.priority);
+    if (audio.scheduling.cpu >= 0)
+        scheduling += QString(", CPU %1").arg(audio.scheduling.cpu);
+    if (audio.scheduling.memoryLocked)
+        scheduling += ", memory locked";
+    addRow("Audio thread scheduling", scheduling);
+    addRow("Audio thread preemptions", (audio.involuntarySwitches < 0) ? QString("unknown") : QString::number(audio.involuntarySwitches));
+    addRow("Audio thread wakeup latency", QString("avg %1 ms, max %2 ms")
+           .arg(audio.averageWakeupLatency * 1000, 0, 'f', 3).arg(audio.maxWakeupLatency * 1000, 0, 'f', 3));
+    addRow("Audio thread iterations/s", QString::number(report.audioIterationsPerSecond, 'f', 0));
+
+    // Workers
+    const WorkerPool::Stats &workers = report.workers;
+    addRow("Workers", QString("%1 threads, %2 running, queued %3/%4/%5")
+           .arg(workers.threads).arg(workers.running)
+           .arg(workers.queued[WorkerPool::HIGH]).arg(workers.queued[WorkerPool::NORMAL]).arg(workers.queued[WorkerPool::LOW]));
+
+    // Clip cache
+    const ClipCache::Stats &cache = report.cache;
+    uint64_t lookups = cache.hits + cache.packedHits + cache.misses;
+    addRow("Clip cache", QString("%1 / %2 MB, %3 clips (%4 packed, %5 pinned)")
+           .arg(cache.residentBytes / 1048576.0, 0, 'f', 1).arg(cache.budget / 1048576.0, 0, 'f', 0)
+           .arg(cache.clips).arg(cache.packedClips).arg(cache.pinnedClips));
+    addRow("Clip cache lookups", QString("%1 hit, %2 packed, %3 missed (%4% hit rate), %5 evicted")
+           .arg(cache.hits).arg(cache.packedHits).arg(cache.misses)
+           .arg((lookups > 0) ? 100.0 * (cache.hits + cache.packedHits) / lookups : 0.0, 0, 'f', 1).arg(cache.evictions));
+
+    // Players
+    for (const StatsCollector::PlayerReport &player : report.players)
+    {
+        QString name = QString::fromStdString(player.name);
+        addRow(name, QString("%1, %2 iterations/s").arg(player.active ? "active" : "idle").arg(player.iterationsPerSecond, 0, 'f', 0));
+        addRow(name + " frames decoded", QString::number(player.framesDecoded));
+        addRow(name + " decode time", QString("p50 %1 us, p99 %2 us")
+               .arg(player.decodeP50 * 1e6, 0, 'f', 1).arg(player.decodeP99 * 1e6, 0, 'f', 1));
+        addRow(name + " seeks", QString("%1 (p50 %2 ms, p99 %3 ms)")
+               .arg(player.seeks).arg(player.seekP50 * 1000, 0, 'f', 2).arg(player.seekP99 * 1000, 0, 'f', 2));
+
+        // Devices
+        for (const StatsCollector::DeviceReport &device : player.devices)
+        {
+            addRow(QString("%1 %2 (device %3)").arg(name).arg(device.role.c_str()).arg(device.device),
+                   QString("queued %1 bytes, target %2 ms, %3 underruns, %4 frames written")
+                   .arg(device.queuedBytes).arg(device.targetLatency * 1000, 0, 'f', 1).arg(device.underruns).arg(device.framesWritten));
+        }
+    }
+}
+
+
+void StatsDock::addRow(const QString &name, const QString &value)
+{
+    int row = table->rowCount();
+    table->insertRow(row);
+    table->setItem(row, 0, new QTableWidgetItem(name));
+    table->setItem(row, 1, new QTableWidgetItem(value));
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+
+// Qt core
+#include <QtCore/Qt>
+#include <QtCore/QString>
+#include <QtCore/QTimer>
+// Qt widgets
+#include <QtWidgets/QDockWidget>
+#include <QtWidgets/QTableWidget>
+#include <QtWidgets/QHeaderView>
+// Stats reports
+#include <Engine/StatsCollector.hpp>
+
+
+/**
+ * Dock with live stats of audio thread, workers, players and their devices.
+ */
+class StatsDock: public QDockWidget
+{
+    // Mandatory for QWidget stuff to work
+    Q_OBJECT
+
+    // Source of reports.
+    StatsCollector collector;
+    // Stats table.
+    QTableWidget *table = nullptr;
+    // Refresh timer (runs only while dock is visible).
+    QTimer *timer = nullptr;
+
+public:
+
+    /**
+     * Constructor.
+     *
+     * @param engine observed engine
+     */
+    explicit StatsDock(AudioEngine *engine, QWidget *parent = nullptr);
+
+protected:
+
+    /**
+     * Updates table with fresh report.
+     */
+    void refresh();
+
+    /**
+     * Appends row to table.
+     */
+    void addRow(const QString &name, const QString &value);
+};
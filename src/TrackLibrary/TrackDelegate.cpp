@@ -0,0 +1,29 @@
+#include <TrackLibrary/TrackDelegate.hpp>
+
+
+// Waveform drawing
+#include <TrackLibrary/WaveformPainter.hpp>
+
+
+// Vertical padding of waveform inside cell (pixels)
+#define WAVEFORM_PADDING 3
+
+
+TrackDelegate::TrackDelegate(const TrackLibraryModel *model, QObject *parent) : QStyledItemDelegate(parent)
+{
+    this->model = model;
+}
+
+
+void TrackDelegate::paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const
+{
+    // Background, selection and text (waveform cell has no text but asks for measurement)
+    QStyledItemDelegate::paint(painter, option, index);
+    if (index.column() != TrackLibraryModel::WAVEFORM_COLUMN)
+        return;
+
+    // Pyramid level matching cell width is drawn
+    QRect rect = option.rect.adjusted(0, WAVEFORM_PADDING, 0, -WAVEFORM_PADDING);
+    WaveformPainter::paint(painter, rect, model->getPeaks(index.row()),
+                           option.palette.color((option.state & QStyle::State_Selected) ? QPalette::HighlightedText : QPalette::Text));
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+
+// Qt GUI
+#include <QtGui/QPainter>
+// Qt widgets
+#include <QtWidgets/QStyledItemDelegate>
+// Track library model
+#include <TrackLibrary/TrackLibraryModel.hpp>
+
+
+/**
+ * Draws track library cells. Waveform column is painted from measured peak pyramid, others are drawn by Qt.
+ */
+class TrackDelegate : public QStyledItemDelegate
+{
+    // Mandatory for QWidget stuff to work
+    Q_OBJECT
+
+    // Model whose waveforms are drawn.
+    const TrackLibraryModel *model;
+
+public:
+
+    /**
+     * Constructor.
+     *
+     * @param model model whose waveforms are drawn
+     */
+    explicit TrackDelegate(const TrackLibraryModel *model, QObject *parent = nullptr);
+
+    /**
+     * Paints cell.
+     */
+    void paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const override;
+};
@@ -0,0 +1,576 @@
+#include <TrackLibrary/TrackLibraryModel.hpp>
+
+
+// Track measurement
+#include <Library/TrackSummary.hpp>
+// Min/max
+#include <algorithm>
+
+
+// MIME type of dragged track (file path and name separated by '?')
+#define TRACK_MIME_TYPE "filepath&name"
+// Workers background analysis leaves free (playback needs them)
+#define ANALYSIS_RESERVED_WORKERS 1
+
+
+TrackLibraryModel::TrackLibraryModel(WorkerPool *workers, QObject *parent) : QAbstractTableModel(parent)
+{
+    this->workers = workers;
+
+    // Results come back to GUI thread in batches
+    search.setResultsCallback([this](uint64_t query, const std::vector<uint32_t> &ids, bool isFirst)
+    {
+        QMetaObject::invokeMethod(this, [this, query, ids, isFirst]() { onResults(query, ids, isFirst); }, Qt::QueuedConnection);
+    });
+    search.start();
+}
+
+
+int TrackLibraryModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+        return 0;
+    return static_cast<int>(isFiltered ? shown.size() : tracks.size());
+}
+
+
+int TrackLibraryModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : COLUMN_COUNT;
+}
+
+
+QVariant TrackLibraryModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || (index.row() >= rowCount()))
+        return QVariant();
+    int track_index = trackAt(index.row());
+    const Track &track = tracks[track_index];
+
+    if (role == Qt::ToolTipRole)
+        return track.filepath;
+    if (role != Qt::DisplayRole)
+        return QVariant();
+
+    switch (index.column())
+    {
+        case NAME_COLUMN:
+            return track.name;
+        case DURATION_COLUMN:
+        {
+            // Row is visible so it is worth measuring
+            requestSummary(track_index);
+            if (track.duration < 0)
+                return QVariant();
+            int seconds = static_cast<int>(track.duration);
+            return QString("%1:%2").arg(seconds / 60).arg(seconds % 60, 2, 10, QChar('0'));
+        }
+        case WAVEFORM_COLUMN:
+            requestSummary(track_index);
+            return QVariant();
+        default:
+            return QVariant();
+    }
+}
+
+
+QVariant TrackLibraryModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if ((orientation != Qt::Horizontal) || (role != Qt::DisplayRole))
+        return QVariant();
+
+    switch (section)
+    {
+        case NAME_COLUMN:
+            return "Tracks";
+        case DURATION_COLUMN:
+            return "Duration";
+        case WAVEFORM_COLUMN:
+            return "Waveform";
+        default:
+            return QVariant();
+    }
+}
+
+
+Qt::ItemFlags TrackLibraryModel::flags(const QModelIndex &index) const
+{
+    if (!index.isValid())
+        return Qt::NoItemFlags;
+    return Qt::ItemIsEnabled | Qt::ItemIsSelectable | Qt::ItemIsDragEnabled;
+}
+
+
+QStringList TrackLibraryModel::mimeTypes() const
+{
+    return QStringList() << TRACK_MIME_TYPE;
+}
+
+
+QMimeData* TrackLibraryModel::mimeData(const QModelIndexList &indexes) const
+{
+    if (indexes.isEmpty())
+        return nullptr;
+
+    // Players accept one track ('?' is not allowed in file path so it is used as delimiter)
+    const Track &track = tracks[trackAt(indexes.first().row())];
+    QMimeData *mimeData = new QMimeData;
+    mimeData->setData(TRACK_MIME_TYPE, (track.filepath + "?" + track.name).toUtf8());
+    return mimeData;
+}
+
+
+void TrackLibraryModel::setRoot(const QString &root)
+{
+    this->root = root;
+}
+
+
+void TrackLibraryModel::setFilter(const QString &text)
+{
+    // Rows stay as they are until results arrive
+    filter = text.trimmed();
+    if (!filter.isEmpty())
+    {
+        currentQuery = search.search(filter.toStdString());
+        return;
+    }
+
+    currentQuery = 0;
+    if (isFiltered)
+    {
+        beginResetModel();
+        isFiltered = false;
+        shown.clear();
+        endResetModel();
+    }
+}
+
+
+void TrackLibraryModel::clear()
+{
+    beginResetModel();
+    tracks.clear();
+    shown.clear();
+    trackOfId.clear();
+    isTrackOfIdStale = false;
+    generation++;
+    analysisCursor = 0;
+    search.clear();
+    saved.close();
+    endResetModel();
+}
+
+
+bool TrackLibraryModel::load(const std::string &path)
+{
+    beginResetModel();
+    tracks.clear();
+    shown.clear();
+    trackOfId.clear();
+    isTrackOfIdStale = false;
+    generation++;
+    search.clear();
+    // Old tracks are gone, so old index can be replaced
+    if (!saved.open(path))
+    {
+        endResetModel();
+        return false;
+    }
+    root = QString::fromStdString(saved.getRoot());
+    // Silence measured at other level is measured again
+    bool is_threshold_same = saved.getSilenceThreshold() == silenceThreshold;
+    tracks.resize(saved.size());
+    for (size_t i = 0; i < saved.size(); i++)
+    {
+        Track &track = tracks[i];
+        track.id = nextId++;
+        track.filepath = QString::fromStdString(saved.getFilepath(i));
+        track.name = track.filepath.mid(track.filepath.lastIndexOf('/') + 1);
+        track.size = saved.getSize(i);
+        track.modified = saved.getModified(i);
+        track.duration = saved.getDuration(i);
+        track.analysis.loudness = saved.getLoudness(i);
+        track.analysis.truePeak = saved.getTruePeak(i);
+        if (is_threshold_same)
+        {
+            track.analysis.audibleStart = saved.getAudibleStart(i);
+            track.analysis.audibleEnd = saved.getAudibleEnd(i);
+        }
+        track.record = static_cast<int>(i);
+        track.isRequested = (track.duration >= 0) && is_threshold_same;
+        trackOfId[track.id] = static_cast<int>(i);
+        search.add(track.id, searchTextOf(track));
+    }
+    endResetModel();
+    refreshFilter();
+
+    for (const Track &track : tracks)
+    {
+        if (track.analysis.isMeasured())
+            notifyAnalysis(track.filepath, track.analysis);
+    }
+    analysisCursor = 0;
+    continueAnalysis();
+    return true;
+}
+
+
+std::shared_ptr<const PeakPyramid> TrackLibraryModel::findPeaks(const QString &filepath) const
+{
+    int track_index = find(filepath);
+    if (track_index < 0)
+        return nullptr;
+    const Track &track = tracks[track_index];
+    if (track.peaks)
+        return track.peaks;
+
+    // Saved waveform is copied, so it outlives index
+    const PeakBucket *peaks = peaksOf(track);
+    if (!peaks)
+        return nullptr;
+    std::shared_ptr<PeakPyramid> pyramid = std::make_shared<PeakPyramid>();
+    pyramid->buckets.assign(peaks, peaks + PeakPyramid::BUCKET_COUNT);
+    return pyramid;
+}
+
+
+std::vector<LibraryRecord> TrackLibraryModel::getRecords() const
+{
+    std::vector<LibraryRecord> records(tracks.size());
+    for (size_t i = 0; i < tracks.size(); i++)
+    {
+        const Track &track = tracks[i];
+        LibraryRecord &record = records[i];
+        record.filepath = track.filepath.toStdString();
+        record.size = track.size;
+        record.modified = track.modified;
+        record.duration = static_cast<float>(track.duration);
+        record.loudness = static_cast<float>(track.analysis.loudness);
+        record.truePeak = static_cast<float>(track.analysis.truePeak);
+        record.audibleStart = track.analysis.audibleStart;
+        record.audibleEnd = track.analysis.audibleEnd;
+        record.peaks = peaksOf(track);
+    }
+    return records;
+}
+
+
+void TrackLibraryModel::append(const std::vector<LibraryChange> &added)
+{
+    if (added.empty())
+        return;
+
+    // Filtered table gets new tracks with next results
+    int first = rowCount();
+    if (!isFiltered)
+        beginInsertRows(QModelIndex(), first, first + static_cast<int>(added.size()) - 1);
+    for (const LibraryChange &change : added)
+    {
+        Track track;
+        track.id = nextId++;
+        track.filepath = QString::fromStdString(change.path);
+        track.name = track.filepath.mid(track.filepath.lastIndexOf('/') + 1);
+        track.size = change.size;
+        track.modified = change.modified;
+        trackOfId[track.id] = static_cast<int>(tracks.size());
+        search.add(track.id, searchTextOf(track));
+        tracks.push_back(track);
+    }
+    if (!isFiltered)
+        endInsertRows();
+    refreshFilter();
+    continueAnalysis();
+}
+
+
+void TrackLibraryModel::invalidate(const QString &filepath, uint64_t size, int64_t modified)
+{
+    int track_index = find(filepath);
+    if (track_index < 0)
+        return;
+
+    // Measurement of old contents that is still running is dropped by its stamp
+    Track &track = tracks[track_index];
+    track.size = size;
+    track.modified = modified;
+    track.duration = -1;
+    track.analysis = ClipAnalysis();
+    track.peaks.reset();
+    track.record = -1;
+    track.isRequested = false;
+    notifyAnalysis(filepath, ClipAnalysis());
+    int row = rowOf(track_index);
+    if (row >= 0)
+        emit dataChanged(index(row, DURATION_COLUMN), index(row, WAVEFORM_COLUMN));
+
+    analysisCursor = std::min(analysisCursor, track_index);
+    continueAnalysis();
+}
+
+
+void TrackLibraryModel::remove(const QString &path, bool isDirectory)
+{
+    // Consecutive tracks of directory are removed at once (from the end so indices of others stay valid)
+    std::vector<std::pair<int, int>> ranges;
+    QString prefix = path + "/";
+    for (int last = static_cast<int>(tracks.size()) - 1; last >= 0; last--)
+    {
+        if (isDirectory ? !tracks[last].filepath.startsWith(prefix) : (tracks[last].filepath != path))
+            continue;
+        int first = last;
+        while (isDirectory && (first > 0) && tracks[first - 1].filepath.startsWith(prefix))
+            first--;
+        ranges.push_back({first, last});
+        last = first;
+    }
+    if (ranges.empty())
+        return;
+
+    // Rows of filtered table do not follow track indices, they come back with next results
+    if (isFiltered)
+        beginResetModel();
+    for (const auto &range : ranges)
+    {
+        for (int track_index = range.first; track_index <= range.second; track_index++)
+        {
+            search.remove(tracks[track_index].id);
+            notifyAnalysis(tracks[track_index].filepath, ClipAnalysis());
+        }
+        if (!isFiltered)
+            beginRemoveRows(QModelIndex(), range.first, range.second);
+        tracks.erase(tracks.begin() + range.first, tracks.begin() + range.second + 1);
+        if (!isFiltered)
+            endRemoveRows();
+    }
+    isTrackOfIdStale = true;
+    if (isFiltered)
+    {
+        shown.clear();
+        endResetModel();
+        refreshFilter();
+    }
+
+    // Tracks after removed ones moved back
+    analysisCursor = std::min(analysisCursor, ranges.back().first);
+    continueAnalysis();
+}
+
+
+void TrackLibraryModel::rename(const QString &from, const QString &to, bool isDirectory)
+{
+    QString prefix = isDirectory ? from + "/" : from;
+    bool is_renamed = false;
+    for (int track_index = 0; track_index < static_cast<int>(tracks.size()); track_index++)
+    {
+        Track &track = tracks[track_index];
+        if (isDirectory ? !track.filepath.startsWith(prefix) : (track.filepath != from))
+            continue;
+
+        notifyAnalysis(track.filepath, ClipAnalysis());
+        track.filepath = to + track.filepath.mid(from.size());
+        track.name = track.filepath.mid(track.filepath.lastIndexOf('/') + 1);
+        if (track.analysis.isMeasured())
+            notifyAnalysis(track.filepath, track.analysis);
+        // Measurement of old path is dropped when it comes back
+        if (track.duration < 0)
+        {
+            track.isRequested = false;
+            analysisCursor = std::min(analysisCursor, track_index);
+        }
+        search.add(track.id, searchTextOf(track));
+        is_renamed = true;
+        int row = rowOf(track_index);
+        if (row >= 0)
+            emit dataChanged(index(row, NAME_COLUMN), index(row, NAME_COLUMN));
+        if (!isDirectory)
+            break;
+    }
+
+    if (is_renamed)
+    {
+        refreshFilter();
+        continueAnalysis();
+    }
+}
+
+
+const PeakBucket* TrackLibraryModel::peaksOf(const Track &track) const
+{
+    if (track.peaks)
+        return track.peaks->buckets.data();
+    if (track.record >= 0)
+        return saved.getPeaks(track.record);
+    return nullptr;
+}
+
+
+int TrackLibraryModel::rowOf(int track) const
+{
+    if (!isFiltered)
+        return track;
+    for (size_t row = 0; row < shown.size(); row++)
+    {
+        if (shown[row] == track)
+            return static_cast<int>(row);
+    }
+    return -1;
+}
+
+
+std::string TrackLibraryModel::searchTextOf(const Track &track) const
+{
+    // Folders above library root match everything, so they are left out
+    QString prefix = root + "/";
+    if (!root.isEmpty() && track.filepath.startsWith(prefix))
+        return track.filepath.mid(prefix.size()).toStdString();
+    return track.filepath.toStdString();
+}
+
+
+void TrackLibraryModel::refreshFilter()
+{
+    if (!filter.isEmpty())
+        currentQuery = search.search(filter.toStdString());
+}
+
+
+void TrackLibraryModel::onResults(uint64_t query, const std::vector<uint32_t> &ids, bool isFirst)
+{
+    // Query was replaced meanwhile
+    if (query != currentQuery)
+        return;
+
+    if (isTrackOfIdStale)
+    {
+        trackOfId.clear();
+        for (size_t track_index = 0; track_index < tracks.size(); track_index++)
+            trackOfId[tracks[track_index].id] = static_cast<int>(track_index);
+        isTrackOfIdStale = false;
+    }
+    std::vector<int> found;
+    found.reserve(ids.size());
+    for (uint32_t id : ids)
+    {
+        auto track = trackOfId.find(id);
+        if (track != trackOfId.end())
+            found.push_back(track->second);
+    }
+
+    // First batch replaces rows, next ones are added below it
+    if (isFirst)
+    {
+        beginResetModel();
+        isFiltered = true;
+        shown.swap(found);
+        endResetModel();
+    }
+    else if (!found.empty())
+    {
+        int first = rowCount();
+        beginInsertRows(QModelIndex(), first, first + static_cast<int>(found.size()) - 1);
+        shown.insert(shown.end(), found.begin(), found.end());
+        endInsertRows();
+    }
+}
+
+
+void TrackLibraryModel::requestSummary(int track_index) const
+{
+    const Track &track = tracks[track_index];
+    if (track.isRequested)
+        return;
+    track.isRequested = true;
+    pendingSummaries++;
+
+    // Result comes back to GUI thread (model outlives worker pool jobs it is notified by)
+    TrackLibraryModel *model = const_cast<TrackLibraryModel*>(this);
+    int current_generation = generation;
+    int64_t modified = track.modified;
+    QString path = track.filepath;
+    std::string filepath = path.toStdString();
+    double silence_threshold = silenceThreshold;
+    workers->submit([model, current_generation, track_index, modified, path, filepath, silence_threshold]()
+    {
+        double duration = 0;
+        ClipAnalysis analysis;
+        std::shared_ptr<const PeakPyramid> peaks;
+        try
+        {
+            TrackSummary summary = TrackSummary::of(filepath, silence_threshold);
+            duration = summary.duration;
+            analysis = summary.analysis;
+            peaks = std::make_shared<const PeakPyramid>(std::move(summary.peaks));
+        }
+        catch(const std::exception&)
+        {
+            // Broken file shows no duration and no waveform
+        }
+        QMetaObject::invokeMethod(model, [model, current_generation, track_index, modified, path, duration, analysis,
+                                          peaks]()
+        {
+            model->onSummary(current_generation, track_index, path, modified, duration, analysis, peaks);
+        }, Qt::QueuedConnection);
+    }, WorkerPool::LOW);
+}
+
+
+void TrackLibraryModel::continueAnalysis()
+{
+    // Jobs are low priority and few, so visible rows and playback never wait behind whole library
+    int limit = std::max(1, workers->getThreadCount() - ANALYSIS_RESERVED_WORKERS);
+    int count = static_cast<int>(tracks.size());
+    while ((pendingSummaries < limit) && (analysisCursor < count))
+    {
+        requestSummary(analysisCursor);
+        analysisCursor++;
+    }
+}
+
+
+void TrackLibraryModel::notifyAnalysis(const QString &filepath, const ClipAnalysis &analysis)
+{
+    if (analysisCallback)
+        analysisCallback(filepath, analysis);
+}
+
+
+void TrackLibraryModel::onSummary(int generation, int track_index, const QString &filepath, int64_t modified, double duration,
+                                  const ClipAnalysis &analysis, std::shared_ptr<const PeakPyramid> peaks)
+{
+    // Worker is free for next track whatever happens to this one
+    pendingSummaries--;
+    continueAnalysis();
+
+    // Library was replaced, track was removed or its file changed meanwhile
+    if (generation != this->generation)
+        return;
+    track_index = find(filepath, track_index);
+    if ((track_index < 0) || (tracks[track_index].modified != modified))
+        return;
+
+    Track &track = tracks[track_index];
+    track.duration = duration;
+    track.analysis = analysis;
+    track.peaks = std::move(peaks);
+    track.record = -1;
+    if (analysis.isMeasured())
+        notifyAnalysis(filepath, analysis);
+    int row = rowOf(track_index);
+    if (row >= 0)
+        emit dataChanged(index(row, DURATION_COLUMN), index(row, WAVEFORM_COLUMN));
+}
+
+
+int TrackLibraryModel::find(const QString &filepath, int hint) const
+{
+    int count = static_cast<int>(tracks.size());
+    if ((hint >= 0) && (hint < count) && (tracks[hint].filepath == filepath))
+        return hint;
+    for (int track_index = 0; track_index < count; track_index++)
+    {
+        if (tracks[track_index].filepath == filepath)
+            return track_index;
+    }
+    return -1;
+}
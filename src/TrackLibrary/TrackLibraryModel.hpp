@@ -0,0 +1,316 @@
+#pragma once
+
+
+// Fixed width integers
+#include <cstdint>
+// Containers
+#include <vector>
+#include <unordered_map>
+// Shared waveforms
+#include <memory>
+// Callbacks
+#include <functional>
+// Qt core
+#include <QtCore/QAbstractTableModel>
+#include <QtCore/QMimeData>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+// Background jobs
+#include <Engine/WorkerPool.hpp>
+// Library changes
+#include <Library/LibraryScanner.hpp>
+// Saved library
+#include <Library/LibraryIndex.hpp>
+// Waveforms
+#include <Library/PeakPyramid.hpp>
+// Loudness and silence
+#include <Library/ClipAnalysis.hpp>
+// Library search
+#include <Library/TrackSearch.hpp>
+
+
+/**
+ * Tracks of library as table (name, duration, waveform). Rows that views ask for are measured first, on
+ * worker pool. Rest of library is analyzed in background (loudness and silence around every track are needed
+ * to play it),
+ * few tracks at a time so one worker is always left free for playback. Waveforms of saved tracks are drawn
+ * straight from mapped library index. Table can be filtered by search query, matching runs on search thread
+ * and rows are shown as results stream in, best first.
+ */
+class TrackLibraryModel : public QAbstractTableModel
+{
+    // Mandatory for QWidget stuff to work
+    Q_OBJECT
+
+public:
+
+    /**
+     * Describes table columns.
+     */
+    enum Column
+    {
+        NAME_COLUMN,
+        DURATION_COLUMN,
+        WAVEFORM_COLUMN,
+        COLUMN_COUNT
+    };
+
+    /**
+     * Notified when analysis of media file becomes known or stops being valid (unmeasured).
+     */
+    typedef std::function<void(const QString&, const ClipAnalysis&)> AnalysisCallback;
+
+private:
+
+    /**
+     * Library track.
+     */
+    struct Track
+    {
+        // Stable ID (search results refer to it).
+        uint32_t id = 0;
+        // Media file path.
+        QString filepath;
+        // Media file name.
+        QString name;
+        // File size in bytes.
+        uint64_t size = 0;
+        // File modification time.
+        int64_t modified = 0;
+        // Duration in seconds (negative until measured).
+        double duration = -1;
+        // Loudness and silence around track.
+        ClipAnalysis analysis;
+        // Waveform measured since launch (nullptr if there is none).
+        std::shared_ptr<const PeakPyramid> peaks;
+        // Record of saved library holding waveform (-1 if there is none).
+        int record = -1;
+        // Whether track was sent to be measured.
+        mutable bool isRequested = false;
+    };
+
+    // Tracks.
+    std::vector<Track> tracks;
+    // Changes on clear (measurements of old tracks are dropped).
+    int generation = 0;
+    // ID of next track.
+    uint32_t nextId = 0;
+    // Library root directory (searched paths are relative to it).
+    QString root;
+    // Saved library (stays mapped while tracks draw waveforms from it).
+    LibraryIndex saved;
+
+    // Searches tracks.
+    TrackSearch search;
+    // Number of query whose results are expected (0 if there is none).
+    uint64_t currentQuery = 0;
+    // Whether table shows search results instead of all tracks.
+    bool isFiltered = false;
+    // Tracks shown while filtered (indices into tracks, best match first).
+    std::vector<int> shown;
+    // Index of each track ID (rebuilt when tracks are removed).
+    std::unordered_map<uint32_t, int> trackOfId;
+    // Whether trackOfId must be rebuilt.
+    bool isTrackOfIdStale = false;
+    // Current query text (empty if table is not filtered).
+    QString filter;
+
+    // Measures tracks.
+    WorkerPool *workers;
+    // Measurements submitted and not stored yet.
+    mutable int pendingSummaries = 0;
+    // Tracks before it were all sent to be measured.
+    int analysisCursor = 0;
+    // Level below which samples are silence around track (dBFS).
+    double silenceThreshold = DEFAULT_SILENCE_THRESHOLD;
+    // Notified about analyzed tracks.
+    AnalysisCallback analysisCallback;
+
+public:
+
+    /**
+     * Constructor.
+     *
+     * @param workers pool that measures tracks
+     */
+    explicit TrackLibraryModel(WorkerPool *workers, QObject *parent = nullptr);
+
+    /**
+     * @return number of tracks
+     */
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    /**
+     * @return number of columns
+     */
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    /**
+     * @return cell data (asking for it schedules measurement of track)
+     */
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    /**
+     * @return column titles
+     */
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    /**
+     * @return cell flags (tracks can be dragged)
+     */
+    Qt::ItemFlags flags(const QModelIndex &index) const override;
+
+    /**
+     * @return MIME type of dragged tracks
+     */
+    QStringList mimeTypes() const override;
+    /**
+     * @return dragged track in format accepted by players
+     */
+    QMimeData* mimeData(const QModelIndexList &indexes) const override;
+
+    /**
+     * @return media file path of track shown in row
+     */
+    const QString& getFilepath(int row) const { return tracks[trackAt(row)].filepath; }
+
+    /**
+     * @return waveform pyramid of track shown in row (nullptr until measured)
+     */
+    const PeakBucket* getPeaks(int row) const { return peaksOf(tracks[trackAt(row)]); }
+
+    /**
+     * @return waveform pyramid of media file (nullptr if it is not in library or was not measured yet)
+     */
+    std::shared_ptr<const PeakPyramid> findPeaks(const QString &filepath) const;
+
+    /**
+     * @return library root directory
+     */
+    const QString& getRoot() const { return root; }
+
+    /**
+     * Sets library root directory (must be set before tracks are added).
+     */
+    void setRoot(const QString &root);
+
+    /**
+     * Sets callback that receives analysis of tracks (GUI thread).
+     */
+    void setAnalysisCallback(AnalysisCallback callback) { analysisCallback = std::move(callback); }
+
+    /**
+     * @return level below which samples are silence around track (dBFS)
+     */
+    double getSilenceThreshold() const { return silenceThreshold; }
+
+    /**
+     * Sets level below which samples are silence around track (must be set before library is loaded, saved
+     * tracks measured at other level are analyzed again).
+     */
+    void setSilenceThreshold(double threshold) { silenceThreshold = threshold; }
+
+    /**
+     * Shows only tracks matching query (results replace rows once first batch arrives).
+     *
+     * @param text words looked up in folders and file names (empty shows all tracks)
+     */
+    void setFilter(const QString &text);
+
+    /**
+     * Removes all tracks.
+     */
+    void clear();
+
+    /**
+     * Replaces all tracks with saved library (measured tracks are not measured again).
+     *
+     * @param path library index file path
+     *
+     * @return whether index was loaded (library is left empty otherwise)
+     */
+    bool load(const std::string &path);
+
+    /**
+     * @return all tracks in form they are saved in (their waveforms are valid until model changes)
+     */
+    std::vector<LibraryRecord> getRecords() const;
+
+    /**
+     * Adds tracks to the end.
+     *
+     * @param added changes that added media files
+     */
+    void append(const std::vector<LibraryChange> &added);
+
+    /**
+     * Drops measurement of track whose file changed (it is measured again once visible).
+     */
+    void invalidate(const QString &filepath, uint64_t size, int64_t modified);
+
+    /**
+     * Removes track or all tracks inside directory.
+     */
+    void remove(const QString &path, bool isDirectory);
+
+    /**
+     * Changes path of track or of all tracks inside directory.
+     */
+    void rename(const QString &from, const QString &to, bool isDirectory);
+
+private:
+
+    /**
+     * @return index of track shown in row
+     */
+    int trackAt(int row) const { return isFiltered ? shown[row] : row; }
+    /**
+     * @return row track is shown in (-1 if it is filtered out)
+     */
+    int rowOf(int track) const;
+
+    /**
+     * @return waveform pyramid of track (nullptr until measured)
+     */
+    const PeakBucket* peaksOf(const Track &track) const;
+
+    /**
+     * @return text track is found by
+     */
+    std::string searchTextOf(const Track &track) const;
+
+    /**
+     * Runs current query again after tracks changed.
+     */
+    void refreshFilter();
+
+    /**
+     * Shows batch of search results (GUI thread).
+     */
+    void onResults(uint64_t query, const std::vector<uint32_t> &ids, bool isFirst);
+
+    /**
+     * Measures track on worker pool unless it was already requested.
+     */
+    void requestSummary(int track) const;
+
+    /**
+     * Sends more tracks that were not measured yet to worker pool, keeping few of them in flight.
+     */
+    void continueAnalysis();
+
+    /**
+     * Passes analysis of media file to callback.
+     */
+    void notifyAnalysis(const QString &filepath, const ClipAnalysis &analysis);
+
+    /**
+     * Stores measured track (GUI thread).
+     *
+     * @param track index track had when it was requested (tracks may have moved since)
+     * @param modified modification time of measured file
+     */
+    void onSummary(int generation, int track, const QString &filepath, int64_t modified, double duration,
+                   const ClipAnalysis &analysis, std::shared_ptr<const PeakPyramid> peaks);
+
+    /**
+     * @return index of track (-1 if there is none)
+     */
+    int find(const QString &filepath, int hint = 0) const;
+};
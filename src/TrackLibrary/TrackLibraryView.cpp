@@ -0,0 +1,108 @@
+#include <TrackLibrary/TrackLibraryView.hpp>
+
+
+// Qt GUI
+#include <QtGui/QMouseEvent>
+
+
+// Cursor resting on row this long tells it is likely to be played (milliseconds)
+#define HOVER_DWELL_TIME 300
+
+
+TrackLibraryView::TrackLibraryView(TrackLibraryModel *model, QWidget *parent) : QTableView(parent)
+{
+    library = model;
+    setModel(model);
+    setItemDelegate(new TrackDelegate(model, this));
+
+    // Name takes free space, duration and waveform keep their size
+    horizontalHeader()->setSectionResizeMode(TrackLibraryModel::NAME_COLUMN, QHeaderView::Stretch);
+    horizontalHeader()->setSectionResizeMode(TrackLibraryModel::DURATION_COLUMN, QHeaderView::ResizeToContents);
+    horizontalHeader()->setSectionResizeMode(TrackLibraryModel::WAVEFORM_COLUMN, QHeaderView::Fixed);
+    horizontalHeader()->resizeSection(TrackLibraryModel::WAVEFORM_COLUMN, 120);
+    horizontalHeader()->setDisabled(true);
+    // Disable horisontal scroll bar
+    setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    // Rows have same height so view never measures them
+    verticalHeader()->setVisible(false);
+    verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    setShowGrid(false);
+
+    // Tracks are only dragged
+    setEditTriggers(QAbstractItemView::NoEditTriggers);
+    setFocusPolicy(Qt::NoFocus);
+    setSelectionBehavior(QAbstractItemView::SelectRows);
+    setSelectionMode(QAbstractItemView::SingleSelection);
+    setDragEnabled(true);
+    setDragDropMode(QAbstractItemView::DragOnly);
+
+    // Selected row and row cursor rests on are likely to be played (table takes no keyboard focus, so
+    // selection covers keyboard as well)
+    setMouseTracking(true);
+    hoverTimer = new QTimer(this);
+    hoverTimer->setSingleShot(true);
+    hoverTimer->setInterval(HOVER_DWELL_TIME);
+    connect(hoverTimer, &QTimer::timeout, this, [this]() { notifyIntent(hoveredRow); });
+    connect(selectionModel(), &QItemSelectionModel::currentRowChanged, this, [this](const QModelIndex &current)
+    {
+        notifyIntent(current.row());
+    });
+}
+
+
+void TrackLibraryView::setIntentCallback(IntentCallback callback)
+{
+    intentCallback = callback;
+}
+
+
+void TrackLibraryView::startDrag(Qt::DropActions supportedActions)
+{
+    QModelIndexList indexes = selectionModel()->selectedRows();
+    if (indexes.isEmpty())
+        return;
+
+    // Dragged track is prefetched while it travels to player
+    notifyIntent(indexes.first().row());
+
+    QDrag *drag = new QDrag(this);
+    drag->setMimeData(model()->mimeData(indexes));
+    drag->setPixmap(QPixmap(":/resources/dragged_track.png"));
+    drag->exec(supportedActions);
+}
+
+
+void TrackLibraryView::mouseMoveEvent(QMouseEvent *event)
+{
+    int row = indexAt(event->position().toPoint()).row();
+    if (row != hoveredRow)
+    {
+        hoveredRow = row;
+        if (row >= 0)
+            hoverTimer->start();
+        else
+            hoverTimer->stop();
+    }
+    QTableView::mouseMoveEvent(event);
+}
+
+
+void TrackLibraryView::leaveEvent(QEvent *event)
+{
+    hoveredRow = -1;
+    hoverTimer->stop();
+    QTableView::leaveEvent(event);
+}
+
+
+void TrackLibraryView::notifyIntent(int row)
+{
+    if ((row < 0) || (row >= library->rowCount()))
+        return;
+
+    const QString &filepath = library->getFilepath(row);
+    if ((filepath == intendedTrack) || !intentCallback)
+        return;
+    intendedTrack = filepath;
+    intentCallback(filepath);
+}
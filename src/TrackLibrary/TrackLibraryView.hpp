@@ -0,0 +1,83 @@
+#pragma once
+
+
+// Callbacks
+#include <functional>
+// Qt core
+#include <QtCore/QTimer>
+// Qt GUI
+#include <QtGui/QDrag>
+// Qt widgets
+#include <QtWidgets/QTableView>
+#include <QtWidgets/QHeaderView>
+// Track library model and its delegate
+#include <TrackLibrary/TrackLibraryModel.hpp>
+#include <TrackLibrary/TrackDelegate.hpp>
+
+
+/**
+ * Table of library tracks. Only visible rows are drawn, tracks are dragged onto players.
+ */
+class TrackLibraryView : public QTableView
+{
+    // Mandatory for QWidget stuff to work
+    Q_OBJECT
+
+public:
+
+    /**
+     * Receives media file user is likely to play soon.
+     */
+    typedef std::function<void(const QString&)> IntentCallback;
+
+private:
+
+    // Shown tracks.
+    TrackLibraryModel *library = nullptr;
+    // Row under cursor (-1 if there is none).
+    int hoveredRow = -1;
+    // Fires once cursor rests on row.
+    QTimer *hoverTimer = nullptr;
+    // Notified when user drags, selects or rests cursor on track.
+    IntentCallback intentCallback;
+    // Media file of latest intent (repeated intents are not reported).
+    QString intendedTrack;
+
+public:
+
+    /**
+     * Constructor.
+     *
+     * @param model shown tracks
+     */
+    explicit TrackLibraryView(TrackLibraryModel *model, QWidget *parent = nullptr);
+
+    /**
+     * @param callback function that will receive tracks user is likely to play soon
+     */
+    void setIntentCallback(IntentCallback callback);
+
+protected:
+
+    /**
+     * Drags selected track with track icon.
+     */
+    void startDrag(Qt::DropActions supportedActions) override;
+
+    /**
+     * Restarts hover dwell when cursor moves to other row.
+     */
+    void mouseMoveEvent(QMouseEvent *event) override;
+
+    /**
+     * Cancels hover dwell.
+     */
+    void leaveEvent(QEvent *event) override;
+
+private:
+
+    /**
+     * Reports track shown in row as likely to be played.
+     */
+    void notifyIntent(int row);
+};
@@ -0,0 +1,58 @@
+#include <TrackLibrary/WaveformPainter.hpp>
+
+
+// Min/max
+#include <algorithm>
+// Qt core
+#include <QtCore/QLine>
+#include <QtCore/QVector>
+
+
+// Opacity of min/max envelope (0..255)
+#define ENVELOPE_ALPHA 110
+
+
+void WaveformPainter::paint(QPainter *painter, const QRect &rect, const PeakBucket *pyramid, const QColor &color)
+{
+    int width = rect.width();
+    PeakLevel level = PeakPyramid::levelFor(pyramid, width);
+    if (!level.buckets || (width <= 0) || (rect.height() <= 0))
+        return;
+
+    // One vertical line per pixel column, each covers one or two buckets of level
+    int middle = rect.center().y();
+    float half_height = rect.height() / 2.0f;
+    QVector<QLine> envelope;
+    QVector<QLine> rms;
+    envelope.reserve(width);
+    rms.reserve(width);
+    for (int x = 0; x < width; x++)
+    {
+        int first = static_cast<int>(static_cast<int64_t>(x) * level.size / width);
+        int last = std::max(first + 1, static_cast<int>(static_cast<int64_t>(x + 1) * level.size / width));
+        int minimum = 127;
+        int maximum = -127;
+        int power = 0;
+        for (int bucket = first; bucket < last; bucket++)
+        {
+            minimum = std::min<int>(minimum, level.buckets[bucket].min);
+            maximum = std::max<int>(maximum, level.buckets[bucket].max);
+            power = std::max<int>(power, level.buckets[bucket].rms);
+        }
+
+        int left = rect.left() + x;
+        envelope.append(QLine(left, middle - static_cast<int>(maximum * half_height / 127),
+                              left, middle - static_cast<int>(minimum * half_height / 127)));
+        int height = static_cast<int>(power * half_height / 255);
+        rms.append(QLine(left, middle - height, left, middle + height));
+    }
+
+    painter->save();
+    QColor envelope_color = color;
+    envelope_color.setAlpha(ENVELOPE_ALPHA);
+    painter->setPen(envelope_color);
+    painter->drawLines(envelope);
+    painter->setPen(color);
+    painter->drawLines(rms);
+    painter->restore();
+}
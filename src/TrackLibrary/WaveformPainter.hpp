@@ -0,0 +1,28 @@
+#pragma once
+
+
+// Qt GUI
+#include <QtGui/QPainter>
+#include <QtGui/QColor>
+// Qt core
+#include <QtCore/QRect>
+// Waveforms
+#include <Library/PeakPyramid.hpp>
+
+
+/**
+ * Draws waveform pyramids. Only level matching drawn width is read, so cost depends on pixels and not on
+ * track duration.
+ */
+class WaveformPainter
+{
+public:
+
+    /**
+     * Draws min/max envelope (translucent) with RMS level over it, mirrored around the middle of rect.
+     *
+     * @param pyramid PeakPyramid::BUCKET_COUNT buckets (nothing is drawn if nullptr)
+     * @param color RMS color (envelope uses it translucent)
+     */
+    static void paint(QPainter *painter, const QRect &rect, const PeakBucket *pyramid, const QColor &color);
+};
@@ -0,0 +1,647 @@
+// Console output
+#include <cstdio>
+// Signals
+#include <csignal>
+// Strings
+#include <string>
+// Exceptions
+#include <stdexcept>
+// Atomics
+#include <atomic>
+// Smart pointers
+#include <memory>
+// Containers
+#include <map>
+// Decibels
+#include <cmath>
+// SDL3
+#include <SDL3/SDL.h>
+// SDL3 devices list
+#include <SDL/DevicesList.hpp>
+#include <SDL/DeviceRegistry.hpp>
+// Audio engine
+#include <Engine/AudioEngine.hpp>
+// Library directory scanner
+#include <Library/LibraryScanner.hpp>
+// Saved library
+#include <Library/LibraryIndex.hpp>
+// Track measurement
+#include <Library/TrackSummary.hpp>
+// Stats file writer
+#include <Engine/StatsExporter.hpp>
+// Pipeline spans
+#include <Engine/Tracer.hpp>
+// Local control socket
+#ifdef CONTROL_SOCKET
+#include <Control/ControlServer.hpp>
+#include <Control/OscServer.hpp>
+#endif
+
+
+// Raised by SIGINT/SIGTERM.
+static std::atomic<bool> interrupted = false;
+
+
+/**
+ * Command line options.
+ */
+struct Options
+{
+    // Command name.
+    std::string command;
+    // Media file path (play command) or directory (scan command).
+    std::string filepath;
+    // SDL audio driver override (e.g. dummy or disk).
+    std::string driver;
+    // Input device.
+    SDL_AudioDeviceID input = SDL_AUDIO_DEVICE_DEFAULT_RECORDING;
+    // Virtual cable output device.
+    SDL_AudioDeviceID cable = SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK;
+    // Output device.
+    SDL_AudioDeviceID output = SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK;
+    // Playback volume.
+    float volume = 1;
+    // Microphone reroute duration (negative means until interrupted).
+    double seconds = -1;
+#ifdef CONTROL_SOCKET
+    // Control socket path.
+    std::string socket = ControlServer::defaultSocketPath();
+    // OSC server port on localhost (0 disables it).
+    int oscPort = 9000;
+#endif
+    // Number of voices served by control socket.
+    int voices = 8;
+    // Memory budget of clip cache in MB (negative keeps default).
+    double cacheSize = -1;
+    // Audio thread scheduling.
+    RealtimeConfig realtime;
+    // Stats file (empty disables export).
+    std::string statsFile;
+    // Stats file format (json or prometheus).
+    std::string statsFormat = "json";
+    // Seconds between stats reports.
+    double statsInterval = 10;
+    // Trace file written on exit (empty disables tracing).
+    std::string traceFile;
+    // Library index file of scan command (empty disables it).
+    std::string index;
+    // Level below which samples are silence around clip (dBFS).
+    double silenceThreshold = DEFAULT_SILENCE_THRESHOLD;
+};
+
+
+/**
+ * Stops main loops on interruption.
+ */
+static void onInterrupt(int)
+{
+    interrupted = true;
+}
+
+
+/**
+ * Prints usage.
+ */
+static void printUsage()
+{
+    std::printf("Usage: OpenSoundBoardCLI [--driver <name>] <command> [options]\n"
+                "Commands:\n"
+                "  list                                    list audio devices\n"
+                "  play <file> [--output <id>] [--cable <id>] [--volume <0..1>]\n"
+                "                                          play media file\n"
+                "  mic [--input <id>] [--cable <id>] [--seconds <n>]\n"
+                "                                          reroute microphone to virtual cable\n"
+                "  analyze <file> [--silence <dBFS>]       print duration, loudness, true peak, normalization gain\n"
+                "                                          and audible part (silence threshold defaults to -60 dBFS)\n"
+                "  scan <directory> [--seconds <n>] [--index <path>]\n"
+                "                                          list media files of directory tree and follow its changes\n"
+                "                                          (index is loaded first, so only changes since are listed, and saved on exit)\n"
+                "  serve [--socket <path>] [--osc-port <port>] [--voices <n>] [--output <id>] [--cable <id>] [--input <id>]\n"
+                "        [--cache-mb <n>]                  run engine controlled by local socket and OSC\n"
+                "                                          (--cache-mb sets memory budget of decoded track starts)\n"
+                "Audio thread: [--rt-priority <0..99>] (0 disables real-time scheduling) [--cpu <core>] [--mlock on|off]\n"
+                "Stats: [--stats-file <path>] [--stats-format json|prometheus] [--stats-interval <seconds>]\n"
+                "Tracing: [--trace <path>] (Chrome trace-event JSON written on exit)\n"
+                "Devices default to system default devices. SDL_AUDIO_DRIVER is respected when --driver is absent.\n");
+}
+
+
+/**
+ * Parses command line options.
+ *
+ * @throws Runtime Error on invalid arguments.
+ */
+static Options parseOptions(int argc, char *argv[])
+{
+    Options options;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+
+        // Options with value
+        if (arg.rfind("--", 0) == 0)
+        {
+            if (i + 1 >= argc)
+                throw std::runtime_error("Missing value for " + arg);
+            std::string value = argv[++i];
+
+            if (arg == "--driver")
+                options.driver = value;
+            else if (arg == "--input")
+                options.input = std::stoul(value);
+            else if (arg == "--cable")
+                options.cable = std::stoul(value);
+            else if (arg == "--output")
+                options.output = std::stoul(value);
+            else if (arg == "--volume")
+                options.volume = std::stof(value);
+            else if (arg == "--seconds")
+                options.seconds = std::stod(value);
+#ifdef CONTROL_SOCKET
+            else if (arg == "--socket")
+                options.socket = value;
+            else if (arg == "--osc-port")
+                options.oscPort = std::stoi(value);
+#endif
+            else if (arg == "--voices")
+                options.voices = std::stoi(value);
+            else if (arg == "--cache-mb")
+                options.cacheSize = std::stod(value);
+            else if (arg == "--rt-priority")
+                options.realtime.priority = std::stoi(value);
+            else if (arg == "--cpu")
+                options.realtime.cpu = std::stoi(value);
+            else if (arg == "--mlock")
+                options.realtime.lockMemory = (value == "on");
+            else if (arg == "--stats-file")
+                options.statsFile = value;
+            else if (arg == "--stats-format")
+                options.statsFormat = value;
+            else if (arg == "--stats-interval")
+                options.statsInterval = std::stod(value);
+            else if (arg == "--trace")
+                options.traceFile = value;
+            else if (arg == "--index")
+                options.index = value;
+            else if (arg == "--silence")
+                options.silenceThreshold = std::stod(value);
+            else
+                throw std::runtime_error("Unknown option " + arg);
+        }
+        // Positional arguments
+        else if (options.command.empty())
+            options.command = arg;
+        else if (options.filepath.empty())
+            options.filepath = arg;
+        else
+            throw std::runtime_error("Unexpected argument " + arg);
+    }
+
+    if (options.command.empty())
+        throw std::runtime_error("No command provided");
+
+    return options;
+}
+
+
+/**
+ * Routes voices to virtual cable and output device, microphone to virtual cable (device given for both is
+ * routed once).
+ */
+static void routeDevices(AudioEngine &engine, const Options &options)
+{
+    engine.setInputDevice(options.input);
+    for (int i = 0; i < engine.getVoiceCount(); i++)
+    {
+        engine.setRoute(i, options.cable, 1);
+        engine.setRoute(i, options.output, 1);
+    }
+    engine.setRoute(AudioEngine::MICROPHONE_SOURCE, options.cable, 1);
+}
+
+
+/**
+ * Prints available audio devices.
+ */
+static int listDevices()
+{
+    std::printf("Audio driver: %s\n", SDL_GetCurrentAudioDriver());
+
+    for (DevicesList::DeviceType type : {DevicesList::INPUT, DevicesList::OUTPUT})
+    {
+        DevicesList list(type);
+        list.refresh();
+        std::printf("%s devices:\n", (list.type() == DevicesList::INPUT) ? "Input" : "Output");
+        for (int i = 0; i < list.count(); i++)
+        {
+            DeviceInfo info = DeviceRegistry::describe(list.get(i), list.type() == DevicesList::INPUT);
+            std::printf("  %u\t%s (%d Hz, %d channels, %d frames)\n", info.id, info.name.c_str(), info.format.freq,
+                        info.format.channels, info.bufferFrames);
+        }
+    }
+
+    return 0;
+}
+
+
+/**
+ * Prints scheduling achieved by audio thread.
+ */
+static void printScheduling(AudioEngine &engine)
+{
+    RealtimeStatus status = engine.getAudioThreadStats().scheduling;
+    std::printf("Audio thread: %s priority %d", status.policy.c_str(), status.priority);
+    if (status.cpu >= 0)
+        std::printf(", cpu %d", status.cpu);
+    std::printf("%s\n", status.memoryLocked ? ", memory locked" : "");
+}
+
+
+/**
+ * Starts stats export if requested.
+ *
+ * @return exporter (empty if export is disabled)
+ */
+static std::unique_ptr<StatsExporter> exportStats(AudioEngine &engine, const Options &options)
+{
+    if (options.statsFile.empty())
+        return nullptr;
+    return std::make_unique<StatsExporter>(&engine, options.statsFile, StatsExporter::formatOf(options.statsFormat), options.statsInterval);
+}
+
+
+/**
+ * Reports player errors to console.
+ */
+static void reportErrors(AudioPlayer *player, std::atomic<bool> &failed)
+{
+    // Player errors are reported from player thread
+    player->setErrorCallback([&failed](const std::string &message)
+    {
+        std::fprintf(stderr, "Player error: %s\n", message.c_str());
+        failed = true;
+    });
+}
+
+
+/**
+ * Plays media file until it ends or user interrupts.
+ */
+static int playTrack(const Options &options)
+{
+    if (options.filepath.empty())
+        throw std::runtime_error("No media file provided");
+
+    std::atomic<bool> failed = false;
+    AudioEngine engine(1, options.realtime);
+    routeDevices(engine, options);
+    printScheduling(engine);
+    std::unique_ptr<StatsExporter> stats_exporter = exportStats(engine, options);
+    reportErrors(engine.getVoice(0), failed);
+
+    engine.load(0, options.filepath);
+    if (failed)
+        return 1;
+    std::printf("Duration: %.2f s\n", engine.getVoice(0)->getDuration());
+    engine.setGain(0, options.volume);
+
+    // Player reports its end from audio thread
+    std::atomic<bool> finished = false;
+    engine.getVoice(0)->setStateCallback([&finished](MediaFilesPlayer::State state)
+    {
+        if (state == MediaFilesPlayer::STOPPED)
+            finished = true;
+    });
+
+    // Wait for track to end
+    engine.play(0);
+    while (!finished && !failed)
+    {
+        if (interrupted)
+            engine.stop(0);
+        // Lets engine notice unplugged devices
+        SDL_PumpEvents();
+        SDL_Delay(10);
+    }
+    engine.stop(0, true);
+    std::printf("Trigger latency: %.2f ms\n", engine.getVoice(0)->getTriggerLatency() * 1000);
+
+    return failed ? 1 : 0;
+}
+
+
+/**
+ * Reroutes microphone until timeout or user interrupts.
+ */
+static int rerouteMicrophone(const Options &options)
+{
+    std::atomic<bool> failed = false;
+    AudioEngine engine(0, options.realtime);
+    routeDevices(engine, options);
+    printScheduling(engine);
+    std::unique_ptr<StatsExporter> stats_exporter = exportStats(engine, options);
+    reportErrors(engine.getMicrophone(), failed);
+
+    // Run until timeout, error or interruption
+    engine.startMicrophone();
+    Uint64 start = SDL_GetTicks();
+    while (!interrupted && !failed)
+    {
+        if ((options.seconds >= 0) && (SDL_GetTicks() - start >= options.seconds * 1000))
+            break;
+        SDL_PumpEvents();
+        SDL_Delay(10);
+    }
+    engine.stopMicrophone();
+
+    return failed ? 1 : 0;
+}
+
+
+/**
+ * Measures media file the way library does.
+ */
+static int analyzeTrack(const Options &options)
+{
+    if (options.filepath.empty())
+        throw std::runtime_error("No media file provided");
+
+    Uint64 start = SDL_GetTicks();
+    TrackSummary summary = TrackSummary::of(options.filepath, options.silenceThreshold);
+    const ClipAnalysis &analysis = summary.analysis;
+    std::printf("Duration: %.2f s\n", summary.duration);
+    std::printf("Integrated loudness: %.2f LUFS\n", analysis.loudness);
+    std::printf("True peak: %.2f dBTP\n", analysis.truePeak);
+    std::printf("Normalization gain: %.2f dB\n",
+                20 * std::log10(AudioEngine::normalizationGain(analysis.loudness, analysis.truePeak)));
+    if (analysis.audibleEnd >= 0)
+        std::printf("Audible samples: %lld - %lld\n", static_cast<long long>(analysis.audibleStart),
+                    static_cast<long long>(analysis.audibleEnd));
+    else
+        std::printf("Audible samples: none\n");
+    std::printf("Analyzed in %.3f s\n", (SDL_GetTicks() - start) / 1000.0);
+
+    return 0;
+}
+
+
+/**
+ * Applies library change to saved tracks.
+ */
+static void applyChange(std::map<std::string, LibraryRecord> &records, const LibraryChange &change)
+{
+    auto directory = [&change](const std::string &path)
+    {
+        const std::string &root = (change.type == LibraryChange::RENAMED) ? change.oldPath : change.path;
+        return (path.compare(0, root.size(), root) == 0) && (path.size() > root.size()) && (path[root.size()] == '/');
+    };
+
+    switch (change.type)
+    {
+        case LibraryChange::ADDED:
+        case LibraryChange::CHANGED:
+        {
+            LibraryRecord &record = records[change.path];
+            record = LibraryRecord();
+            record.filepath = change.path;
+            record.size = change.size;
+            record.modified = change.modified;
+            break;
+        }
+        case LibraryChange::REMOVED:
+            for (auto record = records.begin(); record != records.end();)
+            {
+                if (change.isDirectory ? directory(record->first) : (record->first == change.path))
+                    record = records.erase(record);
+                else
+                    record++;
+            }
+            break;
+        case LibraryChange::RENAMED:
+        {
+            std::vector<LibraryRecord> moved;
+            for (auto record = records.begin(); record != records.end();)
+            {
+                if (change.isDirectory ? directory(record->first) : (record->first == change.oldPath))
+                {
+                    moved.push_back(record->second);
+                    moved.back().filepath = change.path + record->first.substr(change.oldPath.size());
+                    record = records.erase(record);
+                }
+                else
+                    record++;
+            }
+            for (LibraryRecord &record : moved)
+                records[record.filepath] = std::move(record);
+            break;
+        }
+    }
+}
+
+
+/**
+ * Prints media files of directory tree and then its changes until timeout or user interrupts.
+ */
+static int scanLibrary(const Options &options)
+{
+    // Indexed files are only reported if they changed
+    Uint64 start = SDL_GetTicks();
+    std::map<std::string, LibraryRecord> records;
+    std::unordered_map<std::string, FileStamp> known;
+    // Stays open, loaded records point at its waveforms until new index is written
+    LibraryIndex index;
+    // Audible bounds of loaded records keep threshold they were measured at
+    double silence_threshold = options.silenceThreshold;
+    if (!options.index.empty() && index.open(options.index) && (index.getRoot() == options.filepath))
+    {
+        silence_threshold = index.getSilenceThreshold();
+        for (LibraryRecord &record : index.getRecords())
+        {
+            known.emplace(record.filepath, FileStamp{record.size, record.modified});
+            records.emplace(record.filepath, std::move(record));
+        }
+        std::fprintf(stderr, "Loaded %zu indexed files in %.3f s\n", records.size(), (SDL_GetTicks() - start) / 1000.0);
+    }
+
+    WorkerPool workers;
+    LibraryScanner scanner(&workers);
+    std::mutex output_mutex;
+    scanner.setChangesCallback([&output_mutex, &records](const std::vector<LibraryChange> &changes)
+    {
+        std::lock_guard<std::mutex> lock(output_mutex);
+        for (const LibraryChange &change : changes)
+        {
+            if (change.type == LibraryChange::ADDED)
+                std::printf("+ %s\n", change.path.c_str());
+            else if (change.type == LibraryChange::REMOVED)
+                std::printf("- %s\n", change.path.c_str());
+            else if (change.type == LibraryChange::CHANGED)
+                std::printf("~ %s\n", change.path.c_str());
+            else
+                std::printf("> %s -> %s\n", change.oldPath.c_str(), change.path.c_str());
+            applyChange(records, change);
+        }
+        std::fflush(stdout);
+    });
+
+    // Scan, then keep watching until timeout or interruption
+    scanner.start(options.filepath, std::move(known));
+    bool is_scanning = true;
+    while (!interrupted)
+    {
+        if (is_scanning && !scanner.isScanning())
+        {
+            std::fprintf(stderr, "Scan finished in %.2f s\n", (SDL_GetTicks() - start) / 1000.0);
+            is_scanning = false;
+        }
+        if ((options.seconds >= 0) && (SDL_GetTicks() - start >= options.seconds * 1000))
+            break;
+        SDL_Delay(10);
+    }
+
+    if (options.index.empty())
+        return 0;
+
+    // Watcher may still be reporting changes
+    std::vector<LibraryRecord> saved;
+    {
+        std::lock_guard<std::mutex> lock(output_mutex);
+        for (auto &record : records)
+            saved.push_back(std::move(record.second));
+    }
+    try
+    {
+        LibraryIndex::write(options.index, options.filepath, saved, silence_threshold);
+    }
+    catch(const std::exception& e)
+    {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
+
+
+#ifdef CONTROL_SOCKET
+/**
+ * Runs audio engine controlled by local socket and OSC until user interrupts.
+ */
+static int serve(const Options &options)
+{
+    std::atomic<bool> failed = false;
+    AudioEngine engine(options.voices, options.realtime);
+    routeDevices(engine, options);
+    if (options.cacheSize >= 0)
+        engine.getCache()->setBudget(static_cast<size_t>(options.cacheSize * 1024 * 1024));
+    printScheduling(engine);
+    std::unique_ptr<StatsExporter> stats_exporter = exportStats(engine, options);
+    for (int i = 0; i < engine.getVoiceCount(); i++)
+        reportErrors(engine.getVoice(i), failed);
+    reportErrors(engine.getMicrophone(), failed);
+
+    ControlServer server(&engine, options.socket);
+    server.start();
+    std::printf("Listening on %s\n", options.socket.c_str());
+    OscServer osc_server(&engine, options.oscPort);
+    if (options.oscPort > 0)
+    {
+        osc_server.start();
+        std::printf("Listening for OSC on 127.0.0.1:%d\n", options.oscPort);
+    }
+
+    while (!interrupted)
+    {
+        SDL_PumpEvents();
+        SDL_Delay(50);
+    }
+    osc_server.stop();
+    server.stop();
+
+    return 0;
+}
+#endif
+
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    try
+    {
+        options = parseOptions(argc, argv);
+    }
+    catch(const std::exception& e)
+    {
+        std::fprintf(stderr, "%s\n", e.what());
+        printUsage();
+        return 2;
+    }
+
+    // Stop gracefully on Ctrl+C
+    std::signal(SIGINT, onInterrupt);
+    std::signal(SIGTERM, onInterrupt);
+
+    // Select audio driver (dummy/disk drivers allow running on headless machines)
+    if (!options.driver.empty())
+        SDL_SetHint(SDL_HINT_AUDIO_DRIVER, options.driver.c_str());
+
+    // Init SDL3
+    if (!SDL_Init(SDL_INIT_AUDIO))
+    {
+        std::fprintf(stderr, "SDL3 init error: %s\n", SDL_GetError());
+        return 1;
+    }
+
+    // Record spans of whole run
+    if (!options.traceFile.empty())
+        Tracer::start();
+
+    int result = 0;
+    try
+    {
+        if (options.command == "list")
+            result = listDevices();
+        else if (options.command == "play")
+            result = playTrack(options);
+        else if (options.command == "mic")
+            result = rerouteMicrophone(options);
+        else if (options.command == "analyze")
+            result = analyzeTrack(options);
+        else if (options.command == "scan")
+            result = scanLibrary(options);
+#ifdef CONTROL_SOCKET
+        else if (options.command == "serve")
+            result = serve(options);
+#endif
+        else
+        {
+            printUsage();
+            result = 2;
+        }
+    }
+    catch(const std::exception& e)
+    {
+        std::fprintf(stderr, "%s\n", e.what());
+        result = 1;
+    }
+
+    if (!options.traceFile.empty())
+    {
+        Tracer::stop();
+        try
+        {
+            Tracer::dump(options.traceFile);
+            std::printf("Trace written to %s\n", options.traceFile.c_str());
+        }
+        catch(const std::exception& e)
+        {
+            std::fprintf(stderr, "%s\n", e.what());
+            result = 1;
+        }
+    }
+
+    // Free SDL resources
+    SDL_Quit();
+
+    return result;
+}